@@ -32,6 +32,12 @@ const Feature Feature::ExperimentalVxORenderersIndexing("vertex-object-renderers
 const Feature Feature::ExperimentalTextMetricsFunctions("textmetrics", "Enable the <code>textmetrics()</code> and <code>fontmetrics()</code> functions.");
 const Feature Feature::ExperimentalImportFunction("import-function", "Enable import function returning data instead of geometry.");
 const Feature Feature::ExperimentalPredictibleOutput("predictible-output", "Attempt to produce predictible, diffable outputs (e.g. sorting the STL, or remeshing in a determined order)");
+const Feature Feature::ExperimentalParallelGeometry("parallel-geometry", "Evaluate independent child subtrees concurrently (Manifold backend only)");
+const Feature Feature::ExperimentalParallelComprehensions("parallel-comprehensions", "Evaluate the iterations of large list comprehensions without side effects concurrently");
+const Feature Feature::ExperimentalFunctionBytecode("function-bytecode", "Compile the bodies of named functions to bytecode for a faster interpreter");
+const Feature Feature::ExperimentalMemoize("memoize", "Reuse the results of calls of pure functions with the same arguments");
+const Feature Feature::ExperimentalIncrementalInstantiation("incremental-instantiation", "Reuse the nodes of unchanged top-level statements when a file is evaluated again");
+const Feature Feature::ExperimentalInstancedGeometry("instanced-geometry", "Share the mesh of transformed objects instead of copying it for each placement");
 #ifdef ENABLE_PYTHON
 const Feature Feature::ExperimentalPythonEngine("python-engine", "Enable experimental Python Engine (implies risk of malicious scripts downloaded).");
 #endif
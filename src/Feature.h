@@ -20,6 +20,12 @@ public:
   static const Feature ExperimentalTextMetricsFunctions;
   static const Feature ExperimentalImportFunction;
   static const Feature ExperimentalPredictibleOutput;
+  static const Feature ExperimentalParallelGeometry;
+  static const Feature ExperimentalParallelComprehensions;
+  static const Feature ExperimentalFunctionBytecode;
+  static const Feature ExperimentalMemoize;
+  static const Feature ExperimentalIncrementalInstantiation;
+  static const Feature ExperimentalInstancedGeometry;
 #ifdef ENABLE_PYTHON
   static const Feature ExperimentalPythonEngine;
 #endif
@@ -108,6 +108,7 @@ const uint32_t FontInfo::get_hash() const
 FontCache *FontCache::self = nullptr;
 FontCache::InitHandlerFunc *FontCache::cb_handler = FontCache::defaultInitHandler;
 void *FontCache::cb_userdata = nullptr;
+std::mutex FontCache::mutex;
 const std::string FontCache::DEFAULT_FONT("Liberation Sans:style=Regular");
 
 /**
@@ -28,6 +28,7 @@
 #include <utility>
 #include <cstdint>
 #include <map>
+#include <mutex>
 #include <string>
 
 #include <ctime>
@@ -96,6 +97,8 @@ public:
   [[nodiscard]] const std::string get_freetype_version() const;
 
   static FontCache *instance();
+  // FreeType isn't thread-safe; held while the cache or its faces are in use
+  static std::mutex mutex;
 
   using InitHandlerFunc = void (FontCacheInitializer *, void *);
   static void registerProgressHandler(InitHandlerFunc *handler, void *userdata = nullptr);
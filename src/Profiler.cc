@@ -0,0 +1,215 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/AST.h"
+#include "core/ModuleInstantiation.h"
+#include "core/node.h"
+#include "geometry/Geometry.h"
+#include "io/fileutils.h"
+#include "json/json.hpp"
+#include "utils/printutils.h"
+
+namespace {
+
+thread_local Profiler::Scope *current_scope = nullptr;
+
+const char *phaseName(Profiler::Phase phase)
+{
+  switch (phase) {
+  case Profiler::Phase::INSTANTIATION: return "instantiation";
+  case Profiler::Phase::GEOMETRY: return "geometry";
+  case Profiler::Phase::BOOLEAN: return "boolean";
+  }
+  return "";
+}
+
+double microseconds(std::chrono::steady_clock::duration duration)
+{
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::is_enabled{false};
+std::chrono::steady_clock::time_point Profiler::epoch;
+std::string Profiler::document_root;
+std::mutex Profiler::mutex;
+std::vector<Profiler::Span> Profiler::spans;
+std::unordered_map<std::thread::id, size_t> Profiler::threads;
+
+Profiler::Scope::Scope(Phase phase, const AbstractNode& node)
+{
+  if (!enabled()) return;
+  begin(phase, node.verbose_name(), node.modinst ? node.modinst->location() : Location::NONE, &node);
+}
+
+void Profiler::Scope::begin(Phase phase, const std::string& name, const Location& loc, const AbstractNode *node)
+{
+  this->active = true;
+  this->phase = phase;
+  this->name = name;
+  if (!loc.isNone()) {
+    this->location = relativePath(loc) + ":" + std::to_string(loc.firstLine());
+  }
+  this->node = node;
+  this->parent = current_scope;
+  current_scope = this;
+  this->start = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+  if (!this->active) return;
+  const auto duration = std::chrono::steady_clock::now() - this->start;
+  current_scope = this->parent;
+  if (this->parent) this->parent->children += duration;
+  if (!enabled()) return;
+  record({this->phase, std::move(this->name), std::move(this->location), 0, microseconds(this->start - epoch),
+          microseconds(duration), microseconds(duration - this->children), this->cache, this->facets},
+         std::this_thread::get_id());
+}
+
+const std::string& Profiler::relativePath(const Location& loc)
+{
+  // fs_uncomplete() queries the file system, which would show up in the measured times
+  thread_local std::unordered_map<std::string, std::string> relative_paths;
+  const std::string path = loc.fileName();
+  auto it = relative_paths.find(path);
+  if (it == relative_paths.end()) {
+    it = relative_paths.emplace(path, fs_uncomplete(loc.filePath(), document_root).generic_string()).first;
+  }
+  return it->second;
+}
+
+void Profiler::start(const std::string& document_root)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  spans.clear();
+  threads.clear();
+  Profiler::document_root = document_root;
+  epoch = std::chrono::steady_clock::now();
+  is_enabled = true;
+}
+
+Profiler::Scope *Profiler::innermost(const AbstractNode& node)
+{
+  if (!enabled()) return nullptr;
+  // Nodes are only evaluated in their own scope, not in the scopes of boolean operations on them
+  for (Scope *scope = current_scope; scope; scope = scope->parent) {
+    if (scope->node == &node && scope->phase == Phase::GEOMETRY) return scope;
+  }
+  return nullptr;
+}
+
+void Profiler::cacheHit(const AbstractNode& node)
+{
+  if (Scope *scope = innermost(node)) scope->cache = 1;
+}
+
+void Profiler::result(const AbstractNode& node, const std::shared_ptr<const Geometry>& geom)
+{
+  Scope *scope = innermost(node);
+  if (!scope) return;
+  if (!scope->cache) scope->cache = -1;
+  // GeometryList doesn't count its facets
+  if (geom && !std::dynamic_pointer_cast<const GeometryList>(geom)) scope->facets = static_cast<long>(geom->numFacets());
+}
+
+void Profiler::record(Span&& span, std::thread::id thread)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  span.thread = threads.emplace(thread, threads.size() + 1).first->second;
+  spans.push_back(std::move(span));
+}
+
+bool Profiler::finish(const std::string& filename, size_t hottest)
+{
+  std::vector<Span> recorded;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    is_enabled = false;
+    recorded.swap(spans);
+  }
+
+  nlohmann::json events = nlohmann::json::array();
+  for (const auto& span : recorded) {
+    nlohmann::json args{{"self_ms", span.self_us / 1000}};
+    if (!span.location.empty()) args["location"] = span.location;
+    if (span.cache) args["cache"] = span.cache > 0 ? "hit" : "miss";
+    if (span.facets >= 0) args["facets"] = span.facets;
+    events.push_back({
+      {"name", span.name},
+      {"cat", phaseName(span.phase)},
+      {"ph", "X"},
+      {"ts", span.start_us},
+      {"dur", span.duration_us},
+      {"pid", 1},
+      {"tid", span.thread},
+      {"args", std::move(args)},
+    });
+  }
+  nlohmann::json trace{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+
+  bool ok = true;
+  if (filename == "-") {
+    std::cout << trace.dump() << "\n";
+  } else {
+    std::ofstream stream(filename);
+    stream << trace.dump() << "\n";
+    if (!stream) {
+      LOG(message_group::Error, "Can't write profile to '%1$s'", filename);
+      ok = false;
+    }
+  }
+
+  printHottest(recorded, hottest);
+  return ok;
+}
+
+void Profiler::printHottest(const std::vector<Span>& recorded, size_t count)
+{
+  struct Line {
+    double self_us[3]{};
+    size_t calls{0};
+    size_t hits{0};
+    size_t misses{0};
+    long facets{0};
+    double total() const { return self_us[0] + self_us[1] + self_us[2]; }
+  };
+  std::map<std::string, Line> lines;
+  for (const auto& span : recorded) {
+    if (span.location.empty()) continue;
+    Line& line = lines[span.location];
+    line.self_us[static_cast<int>(span.phase)] += span.self_us;
+    if (span.phase == Phase::BOOLEAN) continue;
+    if (span.phase == Phase::INSTANTIATION) ++line.calls;
+    if (span.cache > 0) ++line.hits;
+    if (span.cache < 0) ++line.misses;
+    if (span.facets > 0) line.facets += span.facets;
+  }
+
+  std::vector<std::pair<std::string, Line>> sorted(lines.begin(), lines.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.total() > b.second.total(); });
+  if (sorted.size() > count) sorted.resize(count);
+  if (sorted.empty()) return;
+
+  LOG("Hottest source lines (self time in ms: instantiation, geometry, boolean):");
+  for (const auto& [location, line] : sorted) {
+    LOG("  %1$s: %2$.1f ms (%3$.1f, %4$.1f, %5$.1f), %6$d instantiations, cache %7$d hits %8$d misses, %9$d facets",
+        location, line.total() / 1000, line.self_us[0] / 1000, line.self_us[1] / 1000, line.self_us[2] / 1000,
+        line.calls, line.hits, line.misses, line.facets);
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class AbstractNode;
+class Geometry;
+class Location;
+
+/**
+ * Records how long instantiating modules, evaluating the geometry of nodes
+ * and applying boolean operations take, for --profile.
+ *
+ * Each measured span is a Scope on the stack of the thread doing the work.
+ * Scopes nest, so the time of a scope without the time of the scopes inside
+ * it on the same thread is its self time. Spans are written as a Chrome trace,
+ * which speedscope and chrome://tracing can open, and summed up by source
+ * location for a report of the hottest lines.
+ */
+class Profiler
+{
+public:
+  enum class Phase { INSTANTIATION, GEOMETRY, BOOLEAN };
+
+  class Scope
+  {
+  public:
+    // Measures the instantiation of a module
+    Scope(const std::string& name, const Location& loc) {
+      if (enabled()) begin(Phase::INSTANTIATION, name, loc, nullptr);
+    }
+    // Measures the geometry evaluation or a boolean operation of a node
+    Scope(Phase phase, const AbstractNode& node);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    friend class Profiler;
+    void begin(Phase phase, const std::string& name, const Location& loc, const AbstractNode *node);
+
+    bool active{false};
+    Phase phase{Phase::INSTANTIATION};
+    std::string name;
+    std::string location;
+    const AbstractNode *node{nullptr};
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration children{0};
+    int cache{0}; // 1 for a hit, -1 for a miss
+    long facets{-1};
+    Scope *parent{nullptr};
+  };
+
+  static bool enabled() { return is_enabled.load(std::memory_order_relaxed); }
+  // Starts recording, with source locations given relative to document_root
+  static void start(const std::string& document_root);
+
+  // Marks the geometry of node as found in a geometry cache
+  static void cacheHit(const AbstractNode& node);
+  // Records the geometry of node, which was computed unless cacheHit() was called
+  static void result(const AbstractNode& node, const std::shared_ptr<const Geometry>& geom);
+
+  /**
+   * Stops recording, writes the trace to filename ("-" for stdout) and logs
+   * the source locations with the most self time.
+   */
+  static bool finish(const std::string& filename, size_t hottest = 20);
+
+private:
+  struct Span {
+    Phase phase;
+    std::string name;
+    std::string location;
+    size_t thread;
+    double start_us;
+    double duration_us;
+    double self_us;
+    int cache;
+    long facets;
+  };
+
+  static Scope *innermost(const AbstractNode& node);
+  static const std::string& relativePath(const Location& loc);
+  static void record(Span&& span, std::thread::id thread);
+  static void printHottest(const std::vector<Span>& recorded, size_t count);
+
+  static std::atomic<bool> is_enabled;
+  static std::chrono::steady_clock::time_point epoch;
+  static std::string document_root;
+  static std::mutex mutex;
+  static std::vector<Span> spans;
+  static std::unordered_map<std::thread::id, size_t> threads;
+};
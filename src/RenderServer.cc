@@ -0,0 +1,225 @@
+#include "RenderServer.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "json/json.hpp"
+#include "utils/exceptions.h"
+#include "utils/printutils.h"
+
+namespace {
+
+void captureMessage(const Message& msg, void *userdata)
+{
+  auto messages = static_cast<nlohmann::json *>(userdata);
+  nlohmann::json msgJson;
+  msgJson["group"] = getGroupName(msg.group);
+  msgJson["text"] = msg.str();
+  messages->push_back(msgJson);
+}
+
+nlohmann::json errorResponse(const std::string& error)
+{
+  nlohmann::json response;
+  response["status"] = "error";
+  response["error"] = error;
+  return response;
+}
+
+template <typename T>
+T optionalField(const nlohmann::json& request, const char *name, T defaultValue = {})
+{
+  auto it = request.find(name);
+  return it == request.end() ? defaultValue : it->template get<T>();
+}
+
+} // namespace
+
+nlohmann::json RenderServer::runJob(const nlohmann::json& request)
+{
+  RenderJob job;
+  job.file = request.at("file").get<std::string>();
+  job.output = request.at("output").get<std::string>();
+  job.exportFormat = optionalField<std::string>(request, "export_format");
+  job.defines = optionalField<std::vector<std::string>>(request, "defines");
+  job.parameterFile = optionalField<std::string>(request, "parameter_file");
+  job.parameterSet = optionalField<std::string>(request, "parameter_set");
+  if (job.output == "-") return errorResponse("Output to stdout is not supported in server mode");
+
+  nlohmann::json messages = nlohmann::json::array();
+  auto *prevhandler = outputhandler;
+  auto *prevhandler2 = outputhandler2;
+  auto *prevdata = outputhandler_data;
+  set_output_handler(captureMessage, nullptr, &messages);
+  resetSuppressedMessages();
+
+  nlohmann::json response;
+  const auto start = std::chrono::steady_clock::now();
+  try {
+    const int rc = this->runner(job);
+    response["status"] = rc == 0 ? "ok" : "error";
+    response["exit_code"] = rc;
+  } catch (const HardWarningException&) {
+    response["status"] = "error";
+    response["exit_code"] = 1;
+  } catch (const std::exception& e) {
+    response["status"] = "error";
+    response["exit_code"] = 1;
+    response["error"] = e.what();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  set_output_handler(prevhandler, prevhandler2, prevdata);
+
+  response["time_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+  response["messages"] = std::move(messages);
+  return response;
+}
+
+std::string RenderServer::handleRequest(const std::string& line)
+{
+  nlohmann::json response;
+  nlohmann::json request;
+  try {
+    request = nlohmann::json::parse(line);
+    const auto command = optionalField<std::string>(request, "command", "render");
+    if (command == "render") {
+      response = runJob(request);
+    } else if (command == "ping") {
+      response["status"] = "ok";
+    } else if (command == "shutdown") {
+      this->shutdown = true;
+      response["status"] = "ok";
+    } else {
+      response = errorResponse("Unknown command '" + command + "'");
+    }
+  } catch (const nlohmann::json::exception& e) {
+    response = errorResponse(std::string("Invalid request: ") + e.what());
+  }
+  if (request.is_object() && request.contains("id")) response["id"] = request["id"];
+  return response.dump() + "\n";
+}
+
+int RenderServer::serveStdio()
+{
+  std::string line;
+  while (!this->shutdown && std::getline(std::cin, line)) {
+    if (line.empty()) continue;
+    std::cout << handleRequest(line) << std::flush;
+  }
+  return 0;
+}
+
+#ifndef _WIN32
+namespace {
+
+bool writeAll(int fd, const std::string& data)
+{
+  size_t written = 0;
+  while (written < data.size()) {
+    const auto n = ::write(fd, data.data() + written, data.size() - written);
+    if (n <= 0) return false;
+    written += n;
+  }
+  return true;
+}
+
+// Removes a socket left at path, but never any other kind of file
+bool removeSocket(const std::string& path)
+{
+  struct stat st;
+  if (::lstat(path.c_str(), &st) < 0) return errno == ENOENT;
+  if (!S_ISSOCK(st.st_mode)) {
+    errno = EEXIST;
+    return false;
+  }
+  return ::unlink(path.c_str()) == 0;
+}
+
+} // namespace
+
+int RenderServer::serveSocket(const std::string& path)
+{
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG(message_group::Error, "Server socket path '%1$s' is too long", path);
+    return 1;
+  }
+  // Clients disconnecting early must not terminate the server
+  std::signal(SIGPIPE, SIG_IGN);
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  const int listenfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenfd < 0) {
+    LOG(message_group::Error, "Unable to create server socket: %1$s", std::strerror(errno));
+    return 1;
+  }
+  if (!removeSocket(path)) {
+    LOG(message_group::Error, "Unable to listen on '%1$s': %2$s", path,
+        errno == EEXIST ? "A file which is not a socket exists at that path" : std::strerror(errno));
+    ::close(listenfd);
+    return 1;
+  }
+  if (::bind(listenfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(listenfd, 8) < 0) {
+    LOG(message_group::Error, "Unable to listen on '%1$s': %2$s", path, std::strerror(errno));
+    ::close(listenfd);
+    return 1;
+  }
+  LOG("Listening on %1$s", path);
+
+  // Clients are served one at a time; jobs share the caches, so they run sequentially anyway.
+  while (!this->shutdown) {
+    const int fd = ::accept(listenfd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      LOG(message_group::Error, "Server socket accept failed: %1$s", std::strerror(errno));
+      break;
+    }
+    std::string buffer;
+    char chunk[4096];
+    bool connected = true;
+    while (connected && !this->shutdown) {
+      const auto n = ::read(fd, chunk, sizeof(chunk));
+      if (n <= 0) break;
+      buffer.append(chunk, n);
+      size_t pos;
+      while (!this->shutdown && (pos = buffer.find('\n')) != std::string::npos) {
+        const std::string line = buffer.substr(0, pos);
+        buffer.erase(0, pos + 1);
+        if (line.empty()) continue;
+        // The client is gone, drop its remaining requests
+        if (!writeAll(fd, handleRequest(line))) {
+          connected = false;
+          break;
+        }
+      }
+    }
+    ::close(fd);
+  }
+
+  ::close(listenfd);
+  removeSocket(path);
+  return 0;
+}
+#else
+int RenderServer::serveSocket(const std::string& /*path*/)
+{
+  LOG(message_group::Error, "Server sockets are not supported on this platform, use --server without a path for stdin/stdout");
+  return 1;
+}
+#endif // _WIN32
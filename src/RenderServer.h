@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "json/json.hpp"
+
+struct RenderJob
+{
+  std::string file;
+  std::string output;
+  std::string exportFormat; // empty: derived from the output file suffix
+  std::vector<std::string> defines; // -D style "var=value" assignments
+  std::string parameterFile;
+  std::string parameterSet;
+};
+
+/*!
+   Long-running render server (--server).
+
+   Reads one JSON request per line, either from stdin or from clients of a
+   Unix domain socket, runs it and writes one JSON response line back.
+   Since jobs run in the same process, parsed library files, fonts and the
+   geometry caches stay warm between jobs. With the experimental
+   "incremental-instantiation" feature, a job on a file that was rendered
+   before also reuses the nodes of its unchanged top-level statements.
+
+   Requests:
+     {"id": 1, "file": "model.scad", "output": "model.stl",
+      "export_format": "binstl", "defines": ["size=10"],
+      "parameter_file": "sets.json", "parameter_set": "large"}
+     {"command": "ping"}
+     {"command": "shutdown"}
+
+   Responses echo "id" and contain "status" ("ok" or "error"), the job's
+   "exit_code", "time_ms" and all "messages" logged while running it.
+ */
+class RenderServer
+{
+public:
+  using JobRunner = std::function<int (const RenderJob&)>;
+
+  RenderServer(JobRunner runner) : runner(std::move(runner)) {}
+
+  int serveStdio();
+  int serveSocket(const std::string& path);
+
+private:
+  std::string handleRequest(const std::string& line);
+  nlohmann::json runJob(const nlohmann::json& request);
+
+  JobRunner runner;
+  bool shutdown{false};
+};
@@ -41,6 +41,7 @@
 
 #include "utils/printutils.h"
 #include "geometry/GeometryCache.h"
+#include "geometry/GeometryDiskCache.h"
 #include "geometry/PolySet.h"
 #include "geometry/Polygon2d.h"
 #ifdef ENABLE_CGAL
@@ -160,6 +161,33 @@ static nlohmann::json getCache(C cache)
   return cacheJson;
 }
 
+template <typename C>
+static nlohmann::json getCacheShards(C cache)
+{
+  nlohmann::json shardsJson = nlohmann::json::array();
+  for (const auto& shard : cache->statistics()) {
+    nlohmann::json shardJson;
+    shardJson["entries"] = shard.entries;
+    shardJson["bytes"] = shard.cost;
+    shardJson["hits"] = shard.hits;
+    shardJson["misses"] = shard.misses;
+    shardJson["evictions"] = shard.evictions;
+    shardsJson.push_back(shardJson);
+  }
+  return shardsJson;
+}
+
+template <typename C>
+static void logCacheShards(const char *name, C cache)
+{
+  const auto shards = cache->statistics();
+  for (size_t i = 0; i < shards.size(); ++i) {
+    const auto& shard = shards[i];
+    LOG("   %1$s shard %2$2d: %3$d entries, %4$d bytes, %5$d hits, %6$d misses, %7$d evictions",
+        name, i, shard.entries, shard.cost, shard.hits, shard.misses, shard.evictions);
+  }
+}
+
 } // namespace
 
 RenderStatistic::RenderStatistic() : begin(std::chrono::steady_clock::now())
@@ -312,6 +340,14 @@ void LogVisitor::printCacheStatistic()
 #ifdef ENABLE_CGAL
   CGALCache::instance()->print();
 #endif
+  GeometryDiskCache::instance()->print();
+
+  if (is_enabled(RenderStatistic::CACHE)) {
+    logCacheShards("Geometry cache", GeometryCache::instance());
+#ifdef ENABLE_CGAL
+    logCacheShards("CGAL cache", CGALCache::instance());
+#endif
+  }
 }
 
 void LogVisitor::printRenderingTime(const std::chrono::milliseconds ms)
@@ -417,9 +453,17 @@ void StreamVisitor::printCacheStatistic()
   if (is_enabled(RenderStatistic::CACHE)) {
     nlohmann::json cacheJson;
     cacheJson["geometry_cache"] = getCache(GeometryCache::instance());
+    cacheJson["geometry_cache"]["shards"] = getCacheShards(GeometryCache::instance());
 #ifdef ENABLE_CGAL
     cacheJson["cgal_cache"] = getCache(CGALCache::instance());
+    cacheJson["cgal_cache"]["shards"] = getCacheShards(CGALCache::instance());
 #endif // ENABLE_CGAL
+    if (GeometryDiskCache::instance()->isEnabled()) {
+      auto diskJson = getCache(GeometryDiskCache::instance());
+      diskJson["hits"] = GeometryDiskCache::instance()->getHits();
+      diskJson["misses"] = GeometryDiskCache::instance()->getMisses();
+      cacheJson["disk_cache"] = diskJson;
+    }
     json["cache"] = cacheJson;
   }
 }
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct CacheShardStatistic {
+  size_t entries;
+  size_t cost;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+};
+
+/*!
+   Thread-safe, cost-limited cache, split into independently locked shards.
+
+   Lookups only take a shard's lock in shared mode and mark the hit entry as
+   referenced, so concurrent hits never block each other, not even in the same
+   shard. Inserts and evictions lock their shard exclusively.
+
+   Eviction order is an approximate LRU ("second chance"): entries are kept in
+   insertion order, and an entry that was hit since it was last passed over is
+   moved to the end of its shard's list instead of being evicted.
+
+   The cost limit is global. When it is exceeded, entries are evicted starting
+   with the shards holding more than their fair share, so a single large
+   object is never rejected just because its shard is small.
+
+   Hits and misses are counted by get(); contains() only checks for an entry,
+   e.g. before inserting, and isn't counted.
+ */
+template <class Key, class T, class Hash = std::hash<Key>>
+class ShardedCache
+{
+public:
+  using ShardStatistic = CacheShardStatistic;
+
+  explicit ShardedCache(size_t maxCost, size_t numShards = 16)
+    : numShards(std::max<size_t>(numShards, 1)), shards(new Shard[this->numShards]), mx(maxCost) {}
+
+  [[nodiscard]] bool contains(const Key& key) const {
+    const Shard& shard = shardFor(key);
+    std::shared_lock lock(shard.mutex);
+    return shard.map.find(key) != shard.map.end();
+  }
+
+  // Returns nullptr on miss
+  std::shared_ptr<const T> get(const Key& key) const {
+    const Shard& shard = shardFor(key);
+    std::shared_lock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      shard.misses.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    // Check first to not write to a cache line shared by all readers of a popular entry
+    if (!it->second.referenced.load(std::memory_order_relaxed)) {
+      it->second.referenced.store(true, std::memory_order_relaxed);
+    }
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second.value;
+  }
+
+  bool insert(const Key& key, std::shared_ptr<const T> value, size_t cost);
+
+  [[nodiscard]] size_t maxCost() const { return mx.load(std::memory_order_relaxed); }
+  void setMaxCost(size_t m) { mx.store(m, std::memory_order_relaxed); trim(nullptr); }
+  [[nodiscard]] size_t totalCost() const { return total.load(std::memory_order_relaxed); }
+  [[nodiscard]] size_t size() const {
+    size_t result = 0;
+    for (size_t i = 0; i < numShards; ++i) {
+      std::shared_lock lock(shards[i].mutex);
+      result += shards[i].map.size();
+    }
+    return result;
+  }
+
+  void clear() {
+    for (size_t i = 0; i < numShards; ++i) {
+      Shard& shard = shards[i];
+      std::unique_lock lock(shard.mutex);
+      total.fetch_sub(shard.cost.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      shard.cost.store(0, std::memory_order_relaxed);
+      shard.map.clear();
+      shard.lru.clear();
+    }
+  }
+
+  std::vector<ShardStatistic> statistics() const {
+    std::vector<ShardStatistic> result;
+    result.reserve(numShards);
+    for (size_t i = 0; i < numShards; ++i) {
+      const Shard& shard = shards[i];
+      std::shared_lock lock(shard.mutex);
+      result.push_back({shard.map.size(), shard.cost.load(std::memory_order_relaxed),
+                        shard.hits.load(std::memory_order_relaxed), shard.misses.load(std::memory_order_relaxed),
+                        shard.evictions.load(std::memory_order_relaxed)});
+    }
+    return result;
+  }
+
+private:
+  using LruList = std::list<Key>;
+
+  struct Entry {
+    Entry(std::shared_ptr<const T> value, size_t cost, typename LruList::iterator lruPos)
+      : value(std::move(value)), cost(cost), lruPos(lruPos) {}
+    std::shared_ptr<const T> value;
+    size_t cost;
+    typename LruList::iterator lruPos;
+    // Set by hits, cleared when eviction passes over the entry
+    mutable std::atomic<bool> referenced{false};
+  };
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<Key, Entry, Hash> map;
+    // Keys in the order they are considered for eviction, changed only with
+    // the shard locked exclusively
+    LruList lru;
+    std::atomic<size_t> cost{0};
+    mutable std::atomic<size_t> hits{0};
+    mutable std::atomic<size_t> misses{0};
+    std::atomic<size_t> evictions{0};
+  };
+
+  size_t shardIndex(const Key& key) const {
+    // Mix the hash, as the shard's own map uses the low bits of the same hash
+    uint64_t h = Hash{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h % numShards;
+  }
+  Shard& shardFor(const Key& key) { return shards[shardIndex(key)]; }
+  const Shard& shardFor(const Key& key) const { return shards[shardIndex(key)]; }
+
+  size_t evictFrom(Shard& shard, size_t shardLimit, const Key *keep);
+  void trim(const Key *keep);
+
+  const size_t numShards;
+  std::unique_ptr<Shard[]> shards;
+  std::atomic<size_t> mx;
+  std::atomic<size_t> total{0};
+  // Serializes eviction, so concurrent inserts don't evict twice for the same overflow
+  std::mutex trimMutex;
+};
+
+template <class Key, class T, class Hash>
+bool ShardedCache<Key, T, Hash>::insert(const Key& key, std::shared_ptr<const T> value, size_t cost)
+{
+  Shard& shard = shardFor(key);
+  {
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+      shard.cost.fetch_sub(it->second.cost, std::memory_order_relaxed);
+      total.fetch_sub(it->second.cost, std::memory_order_relaxed);
+      shard.lru.erase(it->second.lruPos);
+      shard.map.erase(it);
+    }
+    if (cost > maxCost()) return false;
+    shard.lru.push_back(key);
+    shard.map.try_emplace(key, std::move(value), cost, std::prev(shard.lru.end()));
+    shard.cost.fetch_add(cost, std::memory_order_relaxed);
+    total.fetch_add(cost, std::memory_order_relaxed);
+  }
+  trim(&key);
+  return true;
+}
+
+/*!
+   Evicts entries from one shard until its cost is within shardLimit or the
+   total cost is within the cache limit. Entries referenced since they were
+   last passed over get a second chance at the end of the list.
+   Returns the number of evicted entries.
+ */
+template <class Key, class T, class Hash>
+size_t ShardedCache<Key, T, Hash>::evictFrom(Shard& shard, size_t shardLimit, const Key *keep)
+{
+  std::unique_lock lock(shard.mutex);
+  size_t evicted = 0;
+  // Every entry is passed over at most once before it can be evicted
+  for (size_t steps = 2 * shard.lru.size(); steps > 0 && !shard.lru.empty(); --steps) {
+    if (shard.cost.load(std::memory_order_relaxed) <= shardLimit || totalCost() <= maxCost()) break;
+    const auto pos = shard.lru.begin();
+    const auto it = shard.map.find(*pos);
+    if ((keep && *pos == *keep) || it->second.referenced.exchange(false, std::memory_order_relaxed)) {
+      shard.lru.splice(shard.lru.end(), shard.lru, pos);
+      continue;
+    }
+    shard.cost.fetch_sub(it->second.cost, std::memory_order_relaxed);
+    total.fetch_sub(it->second.cost, std::memory_order_relaxed);
+    shard.map.erase(it);
+    shard.lru.erase(pos);
+    ++evicted;
+  }
+  shard.evictions.fetch_add(evicted, std::memory_order_relaxed);
+  return evicted;
+}
+
+template <class Key, class T, class Hash>
+void ShardedCache<Key, T, Hash>::trim(const Key *keep)
+{
+  if (totalCost() <= maxCost()) return;
+  std::lock_guard lock(trimMutex);
+
+  // Largest shards first. Costs change concurrently, so sort a snapshot.
+  std::vector<std::pair<size_t, size_t>> order;
+  order.reserve(numShards);
+  for (size_t i = 0; i < numShards; ++i) order.emplace_back(shards[i].cost.load(std::memory_order_relaxed), i);
+  std::sort(order.begin(), order.end(), std::greater<>());
+
+  // First bring oversized shards down to their fair share, then evict from any shard
+  const size_t fairShare = maxCost() / numShards;
+  for (const size_t limit : {fairShare, size_t(0)}) {
+    for (const auto& [cost, i] : order) {
+      if (totalCost() <= maxCost()) return;
+      evictFrom(shards[i], limit, keep);
+    }
+  }
+}
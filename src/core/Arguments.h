@@ -30,16 +30,14 @@ class Arguments : public std::vector<Argument>
 {
 public:
   Arguments(const AssignmentList& argument_expressions, const std::shared_ptr<const Context>& context);
+  // Empty arguments, to be added by the caller
+  explicit Arguments(EvaluationSession *session) : evaluation_session(session) {}
   Arguments(Arguments&& other) = default;
   Arguments& operator=(Arguments&& other) = default;
   Arguments(const Arguments& other) = delete;
   Arguments& operator=(const Arguments& other) = delete;
   ~Arguments() = default;
 
-private:
-  Arguments(EvaluationSession *session) : evaluation_session(session) {}
-
-public:
   [[nodiscard]] Arguments clone() const;
 
   [[nodiscard]] EvaluationSession *session() const { return evaluation_session; }
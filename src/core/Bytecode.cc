@@ -0,0 +1,596 @@
+#include "core/Bytecode.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "core/Arguments.h"
+#include "core/EvaluationSession.h"
+#include "core/Expression.h"
+#include "core/LexicalScope.h"
+#include "core/function.h"
+#include "utils/StackCheck.h"
+#include "utils/compiler_specific.h"
+#include "utils/exceptions.h"
+#include "utils/printutils.h"
+
+using namespace Bytecode;
+
+void TailCalls::enter(const FunctionCall *call, const Expression *body, const std::string& documentRoot)
+{
+  current_call = call;
+  if (depth++ == 1000000) {
+    LOG(message_group::Error, body->location(), documentRoot, "Recursion detected calling function '%1$s'", call->name);
+    throw RecursionException::create("function", call->name, call->location());
+  }
+}
+
+BytecodeCompiler::BytecodeCompiler(CompiledFunction& function) : function(function)
+{
+  for (const auto& parameter : function.function().parameters) {
+    variables.emplace_back(parameter->getName(), reserve());
+  }
+}
+
+void BytecodeCompiler::compile(const Expression& expression, Register dst, bool tail)
+{
+  expression.compile(*this, dst, tail);
+}
+
+void BytecodeCompiler::fallback(const Expression& expression, Register dst, bool tail)
+{
+  Register site = index(function.fallbacks.size());
+  function.fallbacks.push_back({&expression, layers});
+  // These are the expressions the FunctionCall::evaluate() loop continues with in tail position
+  const auto& type = typeid(expression);
+  if (tail && (type == typeid(FunctionCall) || type == typeid(Let) || type == typeid(Assert) || type == typeid(Echo))) {
+    emit(Opcode::TailFallback, expression, 0, site);
+  } else {
+    emit(Opcode::Fallback, expression, dst, site);
+    result(expression, dst, tail);
+  }
+}
+
+void BytecodeCompiler::constant(const Expression& origin, const Value& value, Register dst, bool tail)
+{
+  Register constant = index(function.constants.size());
+  function.constants.push_back(value.clone());
+  emit(Opcode::Constant, origin, dst, constant);
+  result(origin, dst, tail);
+}
+
+void BytecodeCompiler::lookup(const Expression& origin, const std::string& name, Register dst, bool tail)
+{
+  auto variable = std::find_if(variables.rbegin(), variables.rend(), [&name](const auto& v) { return v.first == name; });
+  if (variable != variables.rend()) {
+    emit(Opcode::Move, origin, dst, variable->second);
+  } else {
+    Register global = index(function.globals.size());
+    function.globals.push_back({name, &origin});
+    emit(Opcode::Global, origin, dst, global);
+  }
+  result(origin, dst, tail);
+}
+
+void BytecodeCompiler::call(const FunctionCall& call, Register dst, bool tail)
+{
+  // Special functions are found on the stack, and variables may hold function literals
+  bool variable = std::any_of(variables.begin(), variables.end(), [&call](const auto& v) { return v.first == call.name; });
+  if (!call.isLookup || variable || ContextFrame::is_config_variable(call.name)) {
+    fallback(call, dst, tail);
+    return;
+  }
+
+  Register site = index(function.calls.size());
+  Register first = reserve(call.arguments.size());
+  function.calls.push_back({&call, first, tail, layers});
+  size_t resolve = emit(Opcode::Resolve, call, dst, site);
+  for (size_t i = 0; i < call.arguments.size(); ++i) {
+    compile(call.arguments[i]->getExpr(), first + i, false);
+  }
+  emit(tail ? Opcode::TailCall : Opcode::Call, call, dst, site);
+  release(first);
+  if (!tail) patch(resolve);
+}
+
+void BytecodeCompiler::let(const Let& let, const AssignmentList& assignments, const LexicalScope& scope, const Expression& body, Register dst, bool tail)
+{
+  // Special variables must be on the stack, and duplicates are warned about when assigned
+  std::set<std::string> names;
+  for (const auto& assignment : assignments) {
+    const std::string& name = assignment->getName();
+    if (name.empty() || ContextFrame::is_config_variable(name) || !names.insert(name).second) {
+      fallback(let, dst, tail);
+      return;
+    }
+  }
+
+  Register first = index(next_register);
+  layers.push_back({&scope, first, 0});
+  for (const auto& assignment : assignments) {
+    Register variable = reserve();
+    compile(assignment->getExpr(), variable, false);
+    variables.emplace_back(assignment->getName(), variable);
+    layers.back().visible++;
+  }
+  compile(body, dst, tail);
+  variables.resize(variables.size() - assignments.size());
+  layers.pop_back();
+  release(first);
+}
+
+void BytecodeCompiler::result(const Expression& origin, Register dst, bool tail)
+{
+  if (tail) emit(Opcode::Return, origin, dst);
+}
+
+size_t BytecodeCompiler::emit(Opcode op, const Expression& origin, Register a, Register b, Register c)
+{
+  function.code.push_back({op, a, b, c});
+  function.origins.push_back(&origin);
+  return function.code.size() - 1;
+}
+
+void BytecodeCompiler::patch(size_t instruction)
+{
+  Instruction& jump = function.code[instruction];
+  (jump.op == Opcode::Resolve ? jump.c : jump.b) = index(function.code.size());
+}
+
+BytecodeCompiler::Register BytecodeCompiler::reserve(size_t count)
+{
+  Register first = index(next_register);
+  next_register += count;
+  function.register_count = std::max(function.register_count, next_register);
+  index(next_register);
+  return first;
+}
+
+BytecodeCompiler::Register BytecodeCompiler::index(size_t i)
+{
+  if (i > std::numeric_limits<Register>::max()) {
+    overflow = true;
+    return 0;
+  }
+  return static_cast<Register>(i);
+}
+
+std::unique_ptr<const CompiledFunction> CompiledFunction::compile(const UserFunction& function)
+{
+  std::set<std::string> names;
+  for (const auto& parameter : function.parameters) {
+    const std::string& name = parameter->getName();
+    if (ContextFrame::is_config_variable(name) || !names.insert(name).second) return nullptr;
+  }
+
+  std::unique_ptr<CompiledFunction> compiled{new CompiledFunction(function)};
+  BytecodeCompiler compiler(*compiled);
+  compiler.compile(function.expr, compiler.reserve(), true);
+  if (compiler.failed()) return nullptr;
+  return compiled;
+}
+
+boost::optional<std::vector<Register>> CompiledFunction::mapArguments(const AssignmentList& arguments) const
+{
+  // Follows Parameters::parse(), leaving anything it would warn about to it
+  const AssignmentList& parameters = user_function->parameters;
+  std::vector<Register> mapping;
+  std::vector<bool> set(parameters.size());
+  std::set<std::string> named_arguments;
+  size_t position = 0;
+  for (const auto& argument : arguments) {
+    const std::string& name = argument->getName();
+    size_t parameter = 0;
+    if (!name.empty()) {
+      while (parameter < parameters.size() && parameters[parameter]->getName() != name) ++parameter;
+      if (parameter == parameters.size() || set[parameter]) return boost::none;
+      named_arguments.insert(name);
+    } else {
+      while (position < parameters.size() && named_arguments.count(parameters[position]->getName())) ++position;
+      if (position == parameters.size()) return boost::none;
+      parameter = position++;
+    }
+    set[parameter] = true;
+    mapping.push_back(static_cast<Register>(parameter));
+  }
+  return mapping;
+}
+
+/*!
+   Runs compiled functions. One interpreter serves a call from the
+   FunctionCall::evaluate() loop and the calls it makes in turn, and caches
+   what the functions and variables named in the code resolve to.
+ */
+class BytecodeInterpreter
+{
+public:
+  // What a call site resolves to in a defining context
+  struct Callee {
+    enum class Kind { Unresolved, Builtin, Compiled, Fallback };
+    Kind kind{Kind::Unresolved};
+    Value (*builtin)(Arguments, const Location&){nullptr};
+    const CompiledFunction *function{nullptr};
+    std::shared_ptr<const Context> defining_context;
+    std::vector<Register> parameters; // the parameter each argument sets
+  };
+
+  // Inline caches of a compiled function called from a defining context
+  struct Cache {
+    const CompiledFunction *function;
+    std::shared_ptr<const Context> defining_context; // keeps the cached variables alive
+    std::vector<const Value *> globals;
+    std::vector<Callee> callees;
+  };
+
+  struct Frame {
+    const CompiledFunction *function{nullptr};
+    std::shared_ptr<const Context> defining_context;
+    Cache *cache{nullptr};
+    std::vector<Value> registers;
+  };
+
+  BytecodeInterpreter(EvaluationSession *session) : session(session) {}
+
+  // Sets up frame for a call of function, evaluating the defaults of parameters without arguments
+  void enter(Frame& frame, const CompiledFunction *function, std::shared_ptr<const Context> defining_context,
+             std::vector<Value>&& arguments, const std::vector<Register>& parameters);
+
+  /*
+   * Runs the function of frame. config_source is the context whose special
+   * variables the FunctionCall::evaluate() loop would carry over to the
+   * contexts of the function bodies, if any.
+   */
+  BytecodeResult run(Frame& frame, TailCalls& calls, const Context *config_source);
+
+  // Returns the memoized result of the call frame was entered for, if any
+  boost::optional<Value> recall(const Frame& frame, TailCalls& calls);
+
+private:
+  Cache& cache(const CompiledFunction *function, const std::shared_ptr<const Context>& defining_context);
+  const Value& global(const Frame& frame, Register index);
+  Callee& resolve(const Frame& frame, Register index);
+  std::vector<Value> takeArguments(Frame& frame, const CallSite& site);
+  Value callBuiltin(Frame& frame, const CallSite& site, const Callee& callee);
+  Value call(Frame& frame, const CallSite& site, const Callee& callee);
+  Value makeVector(std::vector<Value>& registers, Register first, size_t count);
+  Value checkUndef(Value&& value, const Expression& origin);
+  // Rebuilds the contexts the tree walk would evaluate an expression in
+  ContextHandle<Context> materialize(const Frame& frame, const std::vector<Layer>& layers, const Context *config_source);
+
+  EvaluationSession *session;
+  std::vector<std::unique_ptr<Cache>> caches;
+};
+
+/**
+ * This is separated because PRINTB uses quite a lot of stack space
+ * and the method using it is called often when recursive functions
+ * are evaluated.
+ */
+static void NOINLINE print_err(const FunctionCall *call, const std::string& documentRoot){
+  LOG(message_group::Error, call->location(), documentRoot, "Recursion detected calling function '%1$s'", call->name);
+}
+
+static void NOINLINE print_trace(const FunctionCall *call, const std::string& documentRoot){
+  LOG(message_group::Trace, call->location(), documentRoot, "called by '%1$s'", call->get_name());
+}
+
+void BytecodeInterpreter::enter(Frame& frame, const CompiledFunction *function, std::shared_ptr<const Context> defining_context,
+                                std::vector<Value>&& arguments, const std::vector<Register>& parameters)
+{
+  if (!frame.cache || frame.cache->function != function || frame.cache->defining_context != defining_context) {
+    frame.cache = &cache(function, defining_context);
+  }
+  frame.function = function;
+  frame.defining_context = std::move(defining_context);
+
+  std::vector<Value> registers;
+  registers.reserve(function->register_count);
+  for (size_t i = 0; i < function->register_count; ++i) registers.push_back(Value::undefined.clone());
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    registers[parameters[i]] = std::move(arguments[i]);
+  }
+  const AssignmentList& declared = function->function().parameters;
+  for (size_t i = 0; i < declared.size(); ++i) {
+    if (std::find(parameters.begin(), parameters.end(), i) != parameters.end()) continue;
+    if (declared[i]->getExpr()) {
+      registers[i] = declared[i]->getExpr()->evaluate(frame.defining_context);
+    } else {
+      registers[i] = Value::undefined.clone();
+    }
+  }
+  frame.registers = std::move(registers);
+}
+
+BytecodeResult BytecodeInterpreter::run(Frame& frame, TailCalls& calls, const Context *config_source)
+{
+  const CompiledFunction *function = frame.function;
+  std::vector<Value>& r = frame.registers;
+  // Non-tail calls between resolving the function and calling it, each printed in a trace like a FunctionCall::evaluate() loop
+  std::vector<const FunctionCall *> active_calls;
+  size_t pc = 0;
+
+  try {
+    while (true) {
+      const Instruction& in = function->code[pc];
+      const Expression& origin = *function->origins[pc];
+      ++pc;
+      switch (in.op) {
+      case Opcode::Constant:     r[in.a] = function->constants[in.b].clone(); break;
+      case Opcode::Move:         r[in.a] = r[in.b].clone(); break;
+      case Opcode::Global:       r[in.a] = global(frame, in.b).clone(); break;
+      case Opcode::Not:          r[in.a] = !r[in.b].toBool(); break;
+      case Opcode::Negate:       r[in.a] = checkUndef(-r[in.b], origin); break;
+      case Opcode::Exponent:     r[in.a] = checkUndef(r[in.b] ^ r[in.c], origin); break;
+      case Opcode::Multiply:     r[in.a] = checkUndef(r[in.b] * r[in.c], origin); break;
+      case Opcode::Divide:       r[in.a] = checkUndef(r[in.b] / r[in.c], origin); break;
+      case Opcode::Modulo:       r[in.a] = checkUndef(r[in.b] % r[in.c], origin); break;
+      case Opcode::Plus:         r[in.a] = checkUndef(r[in.b] + r[in.c], origin); break;
+      case Opcode::Minus:        r[in.a] = checkUndef(r[in.b] - r[in.c], origin); break;
+      case Opcode::Less:         r[in.a] = checkUndef(r[in.b] < r[in.c], origin); break;
+      case Opcode::LessEqual:    r[in.a] = checkUndef(r[in.b] <= r[in.c], origin); break;
+      case Opcode::Greater:      r[in.a] = checkUndef(r[in.b] > r[in.c], origin); break;
+      case Opcode::GreaterEqual: r[in.a] = checkUndef(r[in.b] >= r[in.c], origin); break;
+      case Opcode::Equal:        r[in.a] = checkUndef(r[in.b] == r[in.c], origin); break;
+      case Opcode::NotEqual:     r[in.a] = checkUndef(r[in.b] != r[in.c], origin); break;
+      case Opcode::Index:        r[in.a] = r[in.b][r[in.c]]; break;
+      case Opcode::ToBool:       r[in.a] = r[in.b].toBool(); break;
+      case Opcode::Jump:         pc = in.b; break;
+      case Opcode::JumpIfFalse:  if (!r[in.a].toBool()) pc = in.b; break;
+      case Opcode::JumpIfTrue:   if (r[in.a].toBool()) pc = in.b; break;
+      case Opcode::MakeVector:   r[in.a] = makeVector(r, in.b, in.c); break;
+      case Opcode::Resolve: {
+        const CallSite& site = function->calls[in.b];
+        const Callee& callee = resolve(frame, in.b);
+        if (callee.kind == Callee::Kind::Builtin || callee.kind == Callee::Kind::Compiled) {
+          if (!site.tail) active_calls.push_back(site.call);
+          break;
+        }
+        if (callee.kind == Callee::Kind::Unresolved) {
+          // The lookup has warned already
+          if (site.tail) return Value::undefined.clone();
+          r[in.a] = Value::undefined.clone();
+        } else if (site.tail) {
+          return TailExpression{site.call, materialize(frame, site.layers, config_source)};
+        } else {
+          auto context = materialize(frame, site.layers, config_source);
+          r[in.a] = site.call->evaluate(*context);
+        }
+        pc = in.c;
+        break;
+      }
+      case Opcode::Call: {
+        const CallSite& site = function->calls[in.b];
+        const Callee& callee = frame.cache->callees[in.b];
+        if (callee.kind == Callee::Kind::Builtin) {
+          r[in.a] = callBuiltin(frame, site, callee);
+          active_calls.pop_back();
+        } else {
+          // The called function prints its own trace
+          active_calls.pop_back();
+          r[in.a] = call(frame, site, callee);
+        }
+        break;
+      }
+      case Opcode::TailCall: {
+        const CallSite& site = function->calls[in.b];
+        const Callee& callee = frame.cache->callees[in.b];
+        if (callee.kind == Callee::Kind::Builtin) return callBuiltin(frame, site, callee);
+        enter(frame, callee.function, callee.defining_context, takeArguments(frame, site), callee.parameters);
+        if (auto result = recall(frame, calls)) return std::move(*result);
+        calls.enter(site.call, frame.function->function().expr.get(), session->documentRoot());
+        function = frame.function;
+        pc = 0;
+        break;
+      }
+      case Opcode::Fallback: {
+        const FallbackSite& site = function->fallbacks[in.b];
+        auto context = materialize(frame, site.layers, config_source);
+        r[in.a] = site.expression->evaluate(*context);
+        break;
+      }
+      case Opcode::TailFallback: {
+        const FallbackSite& site = function->fallbacks[in.b];
+        return TailExpression{site.expression, materialize(frame, site.layers, config_source)};
+      }
+      case Opcode::Return:
+        return std::move(r[in.a]);
+      }
+    }
+  } catch (EvaluationException& e) {
+    for (auto call = active_calls.rbegin(); call != active_calls.rend() && e.traceDepth > 0; ++call) {
+      print_trace(*call, session->documentRoot());
+      e.traceDepth--;
+    }
+    throw;
+  }
+}
+
+BytecodeInterpreter::Cache& BytecodeInterpreter::cache(const CompiledFunction *function, const std::shared_ptr<const Context>& defining_context)
+{
+  for (const auto& cache : caches) {
+    if (cache->function == function && cache->defining_context == defining_context) return *cache;
+  }
+  caches.push_back(std::make_unique<Cache>(Cache{function, defining_context, {}, {}}));
+  caches.back()->globals.resize(function->globals.size());
+  caches.back()->callees.resize(function->calls.size());
+  return *caches.back();
+}
+
+const Value& BytecodeInterpreter::global(const Frame& frame, Register index)
+{
+  const Value *& cached = frame.cache->globals[index];
+  if (cached) return *cached;
+
+  // Variables in the defining contexts don't change while the interpreter runs, but special variables do
+  const GlobalSite& site = frame.function->globals[index];
+  if (!ContextFrame::is_config_variable(site.name)) {
+    if (auto value = frame.defining_context->try_lookup_variable(site.name)) {
+      cached = &*value;
+      return *value;
+    }
+  }
+  return frame.defining_context->lookup_variable(site.name, site.expression->location());
+}
+
+BytecodeInterpreter::Callee& BytecodeInterpreter::resolve(const Frame& frame, Register index)
+{
+  Callee& callee = frame.cache->callees[index];
+  if (callee.kind != Callee::Kind::Unresolved) return callee;
+
+  const FunctionCall *call = frame.function->calls[index].call;
+  auto f = frame.defining_context->lookup_function(call->name, call->location());
+  if (!f) return callee;
+
+  callee.kind = Callee::Kind::Fallback;
+  if (const auto *builtin = std::get_if<const BuiltinFunction *>(&*f)) {
+    if ((*builtin)->arguments_function) {
+      callee.kind = Callee::Kind::Builtin;
+      callee.builtin = (*builtin)->arguments_function;
+    }
+  } else if (const auto *user = std::get_if<CallableUserFunction>(&*f)) {
+    if (const CompiledFunction *compiled = user->function->compiled()) {
+      if (auto parameters = compiled->mapArguments(call->arguments)) {
+        callee.kind = Callee::Kind::Compiled;
+        callee.function = compiled;
+        callee.defining_context = user->defining_context;
+        callee.parameters = std::move(*parameters);
+      }
+    }
+  }
+  return callee;
+}
+
+std::vector<Value> BytecodeInterpreter::takeArguments(Frame& frame, const CallSite& site)
+{
+  std::vector<Value> arguments;
+  arguments.reserve(site.call->arguments.size());
+  for (size_t i = 0; i < site.call->arguments.size(); ++i) {
+    arguments.push_back(std::move(frame.registers[site.first_argument + i]));
+  }
+  return arguments;
+}
+
+Value BytecodeInterpreter::callBuiltin(Frame& frame, const CallSite& site, const Callee& callee)
+{
+  Arguments arguments(session);
+  for (size_t i = 0; i < site.call->arguments.size(); ++i) {
+    const std::string& name = site.call->arguments[i]->getName();
+    arguments.emplace_back(name.empty() ? boost::none : boost::optional<std::string>(name),
+                           std::move(frame.registers[site.first_argument + i]));
+  }
+  return callee.builtin(std::move(arguments), site.call->location());
+}
+
+Value BytecodeInterpreter::call(Frame& frame, const CallSite& site, const Callee& callee)
+{
+  if (StackCheck::inst().check()) {
+    print_err(site.call, session->documentRoot());
+    throw RecursionException::create("function", site.call->name, site.call->location());
+  }
+
+  Frame called;
+  TailCalls calls(site.call);
+  boost::optional<BytecodeResult> result;
+  try {
+    enter(called, callee.function, callee.defining_context, takeArguments(frame, site), callee.parameters);
+    if (auto memoized = recall(called, calls)) return std::move(*memoized);
+    calls.enter(site.call, callee.function->function().expr.get(), session->documentRoot());
+    result.emplace(run(called, calls, nullptr));
+  } catch (EvaluationException& e) {
+    if (e.traceDepth > 0) {
+      print_trace(calls.current_call, session->documentRoot());
+      e.traceDepth--;
+    }
+    throw;
+  }
+  if (auto *value = std::get_if<Value>(&*result)) {
+    if (calls.memoized) session->functionMemo().store(std::move(*calls.memoized), *value);
+    return std::move(*value);
+  }
+  return FunctionCall::evaluateTail(std::move(std::get<TailExpression>(*result)), calls);
+}
+
+boost::optional<Value> BytecodeInterpreter::recall(const Frame& frame, TailCalls& calls)
+{
+  const UserFunction& function = frame.function->function();
+  FunctionMemo& memo = session->functionMemo();
+  if (!memo.memoizes(function)) return boost::none;
+  std::vector<Value> arguments;
+  arguments.reserve(function.parameters.size());
+  for (size_t i = 0; i < function.parameters.size(); ++i) {
+    arguments.push_back(frame.registers[i].clone());
+  }
+  return memo.lookup(function, frame.defining_context, std::move(arguments), calls.memoized);
+}
+
+Value BytecodeInterpreter::makeVector(std::vector<Value>& registers, Register first, size_t count)
+{
+  // As Vector::evaluate()
+  if (count == 1) {
+    Value& value = registers[first];
+    if (value.type() == Value::Type::EMBEDDED_VECTOR) {
+      return VectorType(std::move(value.toEmbeddedVectorNonConst()));
+    }
+    VectorType vec(session);
+    vec.emplace_back(std::move(value));
+    return std::move(vec);
+  }
+  VectorType vec(session);
+  vec.reserve(count);
+  for (size_t i = 0; i < count; ++i) vec.emplace_back(std::move(registers[first + i]));
+  return std::move(vec);
+}
+
+Value BytecodeInterpreter::checkUndef(Value&& value, const Expression& origin)
+{
+  if (value.isUncheckedUndef()) LOG(message_group::Warning, origin.location(), session->documentRoot(), "%1$s", value.toUndefString());
+  return std::move(value);
+}
+
+ContextHandle<Context> BytecodeInterpreter::materialize(const Frame& frame, const std::vector<Layer>& layers, const Context *config_source)
+{
+  const UserFunction& function = frame.function->function();
+  ContextHandle<Context> context{Context::create<Context>(frame.defining_context)};
+  if (config_source) context->apply_config_variables(*config_source);
+  context->set_scope(&function.scope);
+  for (size_t i = 0; i < function.parameters.size(); ++i) {
+    context->set_variable(function.parameters[i]->getName(), frame.registers[i].clone());
+  }
+  for (const auto& layer : layers) {
+    ContextHandle<Context> let_context{Context::create<Context>(*context)};
+    if (config_source) let_context->apply_config_variables(*config_source);
+    let_context->set_scope(layer.scope);
+    for (size_t slot = 0; slot < layer.visible; ++slot) {
+      let_context->set_variable(layer.scope->name(slot), frame.registers[layer.first_register + slot].clone());
+    }
+    context = std::move(let_context);
+  }
+  return context;
+}
+
+boost::optional<BytecodeResult> CompiledFunction::call(const std::shared_ptr<const Context>& defining_context, const FunctionCall *call,
+                                                       const std::shared_ptr<const Context>& context, bool replaces_context, TailCalls& calls) const
+{
+  auto parameters = mapArguments(call->arguments);
+  if (!parameters) return boost::none;
+
+  std::vector<Value> arguments;
+  arguments.reserve(call->arguments.size());
+  for (const auto& argument : call->arguments) {
+    arguments.push_back(argument->getExpr()->evaluate(context));
+  }
+
+  BytecodeInterpreter interpreter(context->session());
+  BytecodeInterpreter::Frame frame;
+  interpreter.enter(frame, this, defining_context, std::move(arguments), *parameters);
+  if (auto result = interpreter.recall(frame, calls)) return BytecodeResult{std::move(*result)};
+  calls.enter(call, user_function->expr.get(), context->documentRoot());
+  return interpreter.run(frame, calls, replaces_context ? context.get() : nullptr);
+}
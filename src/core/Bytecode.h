@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <boost/optional.hpp>
+
+#include "core/Assignment.h"
+#include "core/Context.h"
+#include "core/FunctionMemo.h"
+#include "core/Value.h"
+
+class Expression;
+class FunctionCall;
+class Let;
+class LexicalScope;
+class UserFunction;
+
+/*!
+   The function call a FunctionCall::evaluate() loop is in, and how many
+   calls it made in tail position. The first call of a memoized function in
+   the loop has the loop's result as its own.
+ */
+struct TailCalls
+{
+  explicit TailCalls(const FunctionCall *call) : current_call(call) {}
+
+  // Counts a call whose body starts at body, throwing once there are too many
+  void enter(const FunctionCall *call, const Expression *body, const std::string& documentRoot);
+
+  const FunctionCall *current_call;
+  unsigned int depth{0};
+  boost::optional<FunctionMemo::Call> memoized;
+};
+
+/*!
+   An expression in tail position that compiled code leaves to the
+   FunctionCall::evaluate() loop, with the context to evaluate it in.
+ */
+struct TailExpression
+{
+  const Expression *expression;
+  ContextHandle<Context> context;
+};
+using BytecodeResult = std::variant<Value, TailExpression>;
+
+namespace Bytecode {
+
+using Register = uint16_t;
+
+enum class Opcode : uint16_t {
+  Constant,     // a = constants[b]
+  Move,         // a = b
+  Global,       // a = variable of globals[b], looked up in the defining context
+  Not,          // a = !b
+  Negate,       // a = -b
+  Exponent,     // a = b ^ c, and so on for the binary operators
+  Multiply,
+  Divide,
+  Modulo,
+  Plus,
+  Minus,
+  Less,
+  LessEqual,
+  Greater,
+  GreaterEqual,
+  Equal,
+  NotEqual,
+  Index,        // a = b[c]
+  ToBool,       // a = bool(b)
+  Jump,         // continue at b
+  JumpIfFalse,  // continue at b if !a
+  JumpIfTrue,   // continue at b if a
+  MakeVector,   // a = [c registers from b on]
+  Resolve,      // finds the function of calls[b]; if it can't be called directly, a = the call by tree walk and continue at c
+  Call,         // a = calls[b] with the arguments in the registers from calls[b].first_argument on
+  TailCall,     // return calls[b], reusing the frame for a compiled function
+  Fallback,     // a = fallbacks[b] by tree walk
+  TailFallback, // leave fallbacks[b] to the FunctionCall::evaluate() loop
+  Return        // return a
+};
+
+struct Instruction
+{
+  Opcode op;
+  Register a;
+  Register b;
+  Register c;
+};
+
+/*
+ * The let() variables in registers when an instruction runs: the first
+ * visible variables of scope, in registers from first_register on.
+ */
+struct Layer
+{
+  const LexicalScope *scope;
+  Register first_register;
+  size_t visible;
+};
+
+struct GlobalSite
+{
+  std::string name;
+  const Expression *expression;
+};
+
+struct CallSite
+{
+  const FunctionCall *call;
+  Register first_argument;
+  bool tail;
+  std::vector<Layer> layers;
+};
+
+struct FallbackSite
+{
+  const Expression *expression;
+  std::vector<Layer> layers;
+};
+
+} // namespace Bytecode
+
+/*!
+   The body of a UserFunction compiled to register bytecode.
+
+   The parameters are in the first registers, followed by let() variables
+   and temporaries. Calls of builtins and of compiled functions whose
+   arguments map directly onto their parameters run in the interpreter,
+   calls in tail position reusing the caller's frame. Expressions the
+   compiler doesn't handle, like list comprehensions or assert(), are
+   evaluated by tree walk in contexts rebuilt from the registers; in tail
+   position they are handed back to the FunctionCall::evaluate() loop, so
+   tail recursion through them still doesn't grow the stack.
+ */
+class CompiledFunction
+{
+public:
+  // Returns nullptr for functions whose calls need a context frame, e.g. ones with special variable parameters
+  static std::unique_ptr<const CompiledFunction> compile(const UserFunction& function);
+
+  /*
+   * Calls the function with the arguments of call, evaluated in context, as
+   * the next step of a FunctionCall::evaluate() loop. Returns boost::none
+   * before evaluating anything if the arguments don't map directly onto the
+   * parameters, e.g. if extra or special variables are passed. If
+   * replaces_context, context is a function body the call replaces.
+   */
+  boost::optional<BytecodeResult> call(const std::shared_ptr<const Context>& defining_context, const FunctionCall *call,
+                                       const std::shared_ptr<const Context>& context, bool replaces_context, TailCalls& calls) const;
+
+  // The parameter each argument of call sets, if they map directly onto the parameters
+  [[nodiscard]] boost::optional<std::vector<Bytecode::Register>> mapArguments(const AssignmentList& arguments) const;
+
+  [[nodiscard]] const UserFunction& function() const { return *user_function; }
+
+private:
+  friend class BytecodeCompiler;
+  friend class BytecodeInterpreter;
+
+  CompiledFunction(const UserFunction& function) : user_function(&function) {}
+
+  const UserFunction *user_function;
+  std::vector<Bytecode::Instruction> code;
+  std::vector<const Expression *> origins; // the expression each instruction is part of, for messages
+  std::vector<Value> constants;
+  std::vector<Bytecode::GlobalSite> globals;
+  std::vector<Bytecode::CallSite> calls;
+  std::vector<Bytecode::FallbackSite> fallbacks;
+  size_t register_count{0};
+};
+
+/*!
+   Compiles expressions into a CompiledFunction. Each Expression subclass
+   compiles itself through Expression::compile(), falling back to tree walk
+   by default.
+ */
+class BytecodeCompiler
+{
+public:
+  using Register = Bytecode::Register;
+  using Opcode = Bytecode::Opcode;
+
+  BytecodeCompiler(CompiledFunction& function);
+
+  /*
+   * Compiles expression to leave its value in dst. In tail position, the
+   * code returns the value instead.
+   */
+  void compile(const Expression& expression, Register dst, bool tail);
+  void compile(const std::shared_ptr<Expression>& expression, Register dst, bool tail) { compile(*expression, dst, tail); }
+
+  // Evaluates expression by tree walk
+  void fallback(const Expression& expression, Register dst, bool tail);
+  void constant(const Expression& origin, const Value& value, Register dst, bool tail);
+  void lookup(const Expression& origin, const std::string& name, Register dst, bool tail);
+  void call(const FunctionCall& call, Register dst, bool tail);
+  void let(const Let& let, const AssignmentList& assignments, const LexicalScope& scope, const Expression& body, Register dst, bool tail);
+  // Returns dst if in tail position
+  void result(const Expression& origin, Register dst, bool tail);
+
+  // Returns the index of the instruction
+  size_t emit(Opcode op, const Expression& origin, Register a = 0, Register b = 0, Register c = 0);
+  // Makes the jump at instruction continue at the next instruction emitted
+  void patch(size_t instruction);
+
+  // Reserves count consecutive registers above the ones in use
+  Register reserve(size_t count = 1);
+  // Frees the registers from first on
+  void release(Register first) { next_register = first; }
+
+  // Set if the function got too large for 16 bit operands
+  [[nodiscard]] bool failed() const { return overflow; }
+
+private:
+  Register index(size_t i);
+
+  CompiledFunction& function;
+  std::vector<std::pair<std::string, Register>> variables; // visible parameters and let() variables, innermost last
+  std::vector<Bytecode::Layer> layers;
+  size_t next_register{0};
+  bool overflow{false};
+};
@@ -3,7 +3,10 @@
 #include <cassert>
 #include <memory>
 #include <cstddef>
+#include <new>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "core/ContextFrame.h"
@@ -66,6 +69,8 @@ private:
   std::shared_ptr<T> context;
 };
 
+template <typename T> class ContextAllocator;
+
 class Context : public ContextFrame, public std::enable_shared_from_this<Context>
 {
 protected:
@@ -75,9 +80,11 @@ protected:
 public:
   ~Context() override;
 
+  // Contexts share a block from the session's ContextArena with their control block
   template <typename C, typename ... T>
   static ContextHandle<C> create(T&& ... t) {
-    return ContextHandle<C>{std::shared_ptr<C>(new C(std::forward<T>(t)...))};
+    ContextAllocator<C> allocator(&sessionOf(t ...)->contextArena());
+    return ContextHandle<C>{std::allocate_shared<C>(allocator, std::forward<T>(t)...)};
   }
 
   virtual void init() { }
@@ -102,6 +109,20 @@ public:
 protected:
   std::shared_ptr<const Context> parent;
 
+private:
+  template <typename T> friend class ContextAllocator;
+
+  // Constructors take the session, or the parent context, first
+  template <typename ... T>
+  static EvaluationSession *sessionOf(EvaluationSession *session, const T& ...) { return session; }
+  template <typename P, typename ... T>
+  static EvaluationSession *sessionOf(const std::shared_ptr<P>& parent, const T& ...) { return parent->session(); }
+
+  template <typename C, typename ... T>
+  static void construct(C *p, T&& ... t) { ::new (static_cast<void *>(p)) C(std::forward<T>(t)...); }
+
+protected:
+
   bool accountingAdded = false;   // avoiding bad accounting when exception threw in constructor issue #3871
 
 public:
@@ -109,3 +130,47 @@ public:
   std::string dump() const;
 #endif
 };
+
+/*
+ * Allocates contexts from a ContextArena, falling back to the heap on
+ * threads that don't own the arena. Constructs them through Context, which
+ * has access to the protected constructors.
+ */
+template <typename T>
+class ContextAllocator
+{
+public:
+  using value_type = T;
+
+  explicit ContextAllocator(ContextArena *arena) : arena(arena), pooled(arena->owned()) {}
+  template <typename U>
+  ContextAllocator(const ContextAllocator<U>& other) : arena(other.arena), pooled(other.pooled) {}
+
+  T *allocate(size_t n) {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned context");
+    const size_t size = n * sizeof(T);
+    if (pooled && ContextArena::fits(size)) return static_cast<T *>(arena->allocate(size));
+    return static_cast<T *>(::operator new(size));
+  }
+  void deallocate(T *p, size_t n) {
+    const size_t size = n * sizeof(T);
+    if (pooled && ContextArena::fits(size)) arena->deallocate(p, size);
+    else ::operator delete(p);
+  }
+
+  template <typename C, typename ... Args>
+  void construct(C *p, Args&& ... args) { Context::construct(p, std::forward<Args>(args)...); }
+  template <typename C>
+  void destroy(C *p) { p->~C(); }
+
+  template <typename U>
+  bool operator==(const ContextAllocator<U>& other) const { return arena == other.arena && pooled == other.pooled; }
+  template <typename U>
+  bool operator!=(const ContextAllocator<U>& other) const { return !(*this == other); }
+
+private:
+  template <typename U> friend class ContextAllocator;
+
+  ContextArena *arena;
+  bool pooled; // set if the arena was owned by the thread creating the context
+};
@@ -26,6 +26,7 @@
 
 #include "core/AST.h"
 #include "core/ContextFrame.h"
+#include "core/LexicalScope.h"
 
 #include <utility>
 #include <cstddef>
@@ -45,6 +46,13 @@ boost::optional<const Value&> ContextFrame::lookup_local_variable(const std::str
       return result->second;
     }
   } else {
+    if (scope) {
+      int slot = scope->find(name);
+      if (slot >= 0) {
+        if (slots[slot]) return *slots[slot];
+        return boost::none;
+      }
+    }
     auto result = lexical_variables.find(name);
     if (result != lexical_variables.end()) {
       return result->second;
@@ -70,6 +78,9 @@ boost::optional<InstantiableModule> ContextFrame::lookup_local_module(const std:
 std::vector<const Value *> ContextFrame::list_embedded_values() const
 {
   std::vector<const Value *> output;
+  for (const auto& slot : slots) {
+    if (slot) output.push_back(&*slot);
+  }
   for (const auto& variable : lexical_variables) {
     output.push_back(&variable.second);
   }
@@ -82,6 +93,12 @@ std::vector<const Value *> ContextFrame::list_embedded_values() const
 size_t ContextFrame::clear()
 {
   size_t removed = lexical_variables.size() + config_variables.size();
+  for (auto& slot : slots) {
+    if (slot) {
+      slot.reset();
+      ++removed;
+    }
+  }
   lexical_variables.clear();
   config_variables.clear();
   return removed;
@@ -92,10 +109,26 @@ bool ContextFrame::set_variable(const std::string& name, Value&& value)
   if (is_config_variable(name)) {
     return config_variables.insert_or_assign(name, std::move(value)).second;
   } else {
+    if (scope) {
+      int slot = scope->find(name);
+      if (slot >= 0) {
+        bool new_variable = !slots[slot];
+        slots[slot] = std::move(value);
+        return new_variable;
+      }
+    }
     return lexical_variables.insert_or_assign(name, std::move(value)).second;
   }
 }
 
+void ContextFrame::set_scope(const LexicalScope *scope)
+{
+  assert(lexical_variables.empty());
+  this->scope = scope;
+  slots.clear();
+  slots.resize(scope ? scope->size() : 0);
+}
+
 void ContextFrame::apply_variables(const ValueMap& variables)
 {
   for (const auto& variable : variables) {
@@ -105,6 +138,9 @@ void ContextFrame::apply_variables(const ValueMap& variables)
 
 void ContextFrame::apply_lexical_variables(const ContextFrame& other)
 {
+  for (size_t i = 0; i < other.slots.size(); ++i) {
+    if (other.slots[i]) set_variable(other.scope->name(i), other.slots[i]->clone());
+  }
   apply_variables(other.lexical_variables);
 }
 
@@ -123,6 +159,10 @@ void ContextFrame::apply_variables(ValueMap&& variables)
 
 void ContextFrame::apply_lexical_variables(ContextFrame&& other)
 {
+  for (size_t i = 0; i < other.slots.size(); ++i) {
+    if (other.slots[i]) set_variable(other.scope->name(i), std::move(*other.slots[i]));
+    other.slots[i].reset();
+  }
   apply_variables(std::move(other.lexical_variables));
 }
 
@@ -133,7 +173,7 @@ void ContextFrame::apply_config_variables(ContextFrame&& other)
 
 void ContextFrame::apply_variables(ContextFrame&& other)
 {
-  apply_variables(std::move(other.lexical_variables));
+  apply_lexical_variables(std::move(other));
   apply_variables(std::move(other.config_variables));
 }
 
@@ -147,6 +187,9 @@ std::string ContextFrame::dumpFrame() const
 {
   std::ostringstream s;
   s << boost::format("ContextFrame %p:\n") % this;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    if (slots[i]) s << boost::format("    %s = %s\n") % scope->name(i) % slots[i]->toEchoString();
+  }
   for (const auto& v : lexical_variables) {
     s << boost::format("    %s = %s\n") % v.first % v.second.toEchoString();
   }
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,8 @@
 #include "core/AST.h"
 #include "core/ValueMap.h"
 
+class LexicalScope;
+
 class ContextFrame
 {
 public:
@@ -41,6 +44,17 @@ public:
 
   static bool is_config_variable(const std::string& name);
 
+  /*
+   * Stores the variables named by scope in slots from now on. Must be set
+   * before any lexical variable is set.
+   */
+  void set_scope(const LexicalScope *scope);
+  const LexicalScope *lexical_scope() const { return scope; }
+  // The value in the given slot of the scope, or nullptr if it is not set
+  const Value *slot_value(size_t slot) const { return slots[slot] ? &*slots[slot] : nullptr; }
+  // True if variables not named by the scope were set, e.g. extra named function arguments
+  bool has_unscoped_variables() const { return !lexical_variables.empty(); }
+
   EvaluationSession *session() const { return evaluation_session; }
   const std::string& documentRoot() const { return evaluation_session->documentRoot(); }
 
@@ -48,6 +62,8 @@ protected:
   ValueMap lexical_variables;
   ValueMap config_variables;
   EvaluationSession *evaluation_session;
+  const LexicalScope *scope{nullptr};
+  std::vector<std::optional<Value>> slots;
 
 public:
 #ifdef DEBUG
@@ -31,7 +31,9 @@
 #include <utility>
 #include <memory>
 #include <deque>
+#include <iterator>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -355,6 +357,11 @@ static void collectGarbage(std::vector<std::weak_ptr<Context>>& managedContexts)
 
 ContextMemoryManager::~ContextMemoryManager()
 {
+  if (!this->collecting) {
+    // Non-collecting managers are merged before they go away
+    assert(managedContexts.empty());
+    return;
+  }
   collectGarbage(managedContexts);
   assert(managedContexts.empty());
   assert(heapSizeAccounting.size() == 0);
@@ -373,7 +380,7 @@ void ContextMemoryManager::addContext(const std::shared_ptr<Context>& context)
   if (context.use_count() > 1) {
     managedContexts.emplace_back(context);
 
-    if (heapSizeAccounting.size() >= nextGarbageCollectSize) {
+    if (this->collecting && heapSizeAccounting.size() >= nextGarbageCollectSize) {
       collectGarbage(managedContexts);
       /*
        * The cost of a garbage collection run is proportional to the heap
@@ -388,3 +395,68 @@ void ContextMemoryManager::addContext(const std::shared_ptr<Context>& context)
     }
   }
 }
+
+void ContextMemoryManager::merge(ContextMemoryManager&& other)
+{
+  managedContexts.insert(managedContexts.end(),
+                         std::make_move_iterator(other.managedContexts.begin()),
+                         std::make_move_iterator(other.managedContexts.end()));
+  other.managedContexts.clear();
+  heapSizeAccounting.merge(other.heapSizeAccounting);
+  other.heapSizeAccounting = HeapSizeAccounting();
+}
+
+void *ContextArena::allocate(size_t size)
+{
+  assert(owned() && fits(size));
+  const size_t index = sizeClass(size);
+  if (!free_blocks[index] && has_returned.load(std::memory_order_acquire)) {
+    takeReturned();
+  }
+  if (Block *block = free_blocks[index]) {
+    free_blocks[index] = block->next;
+    return block;
+  }
+
+  const size_t block_size = (index + 1) * granularity;
+  if (static_cast<size_t>(chunk_end - chunk_next) < block_size) {
+    // Not value-initialized, the blocks are constructed into
+    chunks.emplace_back(new char[chunk_size]);
+    chunk_next = chunks.back().get();
+    chunk_end = chunk_next + chunk_size;
+  }
+  void *block = chunk_next;
+  chunk_next += block_size;
+  return block;
+}
+
+void ContextArena::deallocate(void *block, size_t size)
+{
+  assert(fits(size));
+  auto *returned = static_cast<Block *>(block);
+  const size_t index = sizeClass(size);
+  if (owned()) {
+    returned->next = free_blocks[index];
+    free_blocks[index] = returned;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(returned_mutex);
+  returned->next = returned_blocks[index];
+  returned_blocks[index] = returned;
+  has_returned.store(true, std::memory_order_release);
+}
+
+void ContextArena::takeReturned()
+{
+  std::lock_guard<std::mutex> lock(returned_mutex);
+  for (size_t index = 0; index < size_classes; ++index) {
+    Block *returned = returned_blocks[index];
+    if (!returned) continue;
+    Block *last = returned;
+    while (last->next) last = last->next;
+    last->next = free_blocks[index];
+    free_blocks[index] = returned;
+    returned_blocks[index] = nullptr;
+  }
+  has_returned.store(false, std::memory_order_relaxed);
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 class Context;
@@ -26,6 +30,8 @@ public:
   void removeVectorElement(size_t number = 1) { count -= number; }
 
   [[nodiscard]] size_t size() const { return count; }
+  // Counts may go below zero in between, for objects created elsewhere
+  void merge(const HeapSizeAccounting& other) { count += other.count; }
 
 private:
   size_t count = 0;
@@ -34,15 +40,80 @@ private:
 class ContextMemoryManager
 {
 public:
+  /*
+   * A manager that doesn't collect garbage only keeps track of its contexts,
+   * until they are merged into another manager.
+   */
+  explicit ContextMemoryManager(bool collecting = true) : collecting(collecting) {}
   ~ContextMemoryManager();
 
   void addContext(const std::shared_ptr<Context>& context);
   void releaseContext() { heapSizeAccounting.removeContext(); }
 
+  // Takes over the contexts and accounting of other
+  void merge(ContextMemoryManager&& other);
+
   HeapSizeAccounting& accounting() { return heapSizeAccounting; }
 
 private:
   std::vector<std::weak_ptr<Context>> managedContexts;
   HeapSizeAccounting heapSizeAccounting;
   size_t nextGarbageCollectSize = 0;
+  bool collecting;
+};
+
+/*
+ * Memory for the contexts of an EvaluationSession. Evaluation creates and
+ * drops contexts at a high rate, most of them living for a single let(),
+ * function call or for() iteration, so their blocks are carved from large
+ * chunks and recycled through free lists by size. The chunks are released in
+ * bulk when the arena goes away with the session. Contexts never outlive
+ * their session, so the ones that escape, e.g. as part of a function
+ * literal, simply keep their block until they are dropped.
+ *
+ * Only the thread owning the arena allocates from it, without locking.
+ * Blocks can be returned from any thread; those returned by other threads
+ * are handed back to the owner under a lock.
+ */
+class ContextArena
+{
+public:
+  ContextArena() : owner(std::this_thread::get_id()) {}
+  ContextArena(const ContextArena&) = delete;
+  ContextArena& operator=(const ContextArena&) = delete;
+
+  // Whether the current thread may allocate from the arena
+  [[nodiscard]] bool owned() const { return owner.load(std::memory_order_relaxed) == std::this_thread::get_id(); }
+  // Hands the arena to another thread; a default id leaves it without an owner
+  void setOwner(std::thread::id id) { owner.store(id, std::memory_order_relaxed); }
+  // Whether blocks of size bytes can come from an arena, rather than from the heap
+  static bool fits(size_t size) { return size > 0 && size <= max_size; }
+
+  // Only valid on the owning thread, for sizes that fit
+  void *allocate(size_t size);
+  void deallocate(void *block, size_t size);
+
+private:
+  struct Block
+  {
+    Block *next;
+  };
+  static constexpr size_t granularity = 16;
+  static constexpr size_t max_size = 1024;
+  static constexpr size_t chunk_size = 64 * 1024;
+  static constexpr size_t size_classes = max_size / granularity;
+  static size_t sizeClass(size_t size) { return (size - 1) / granularity; }
+
+  // Moves the blocks returned by other threads to the free lists
+  void takeReturned();
+
+  std::atomic<std::thread::id> owner;
+  std::array<Block *, size_classes> free_blocks{};
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char *chunk_next{nullptr};
+  char *chunk_end{nullptr};
+
+  std::mutex returned_mutex;
+  std::array<Block *, size_classes> returned_blocks{};
+  std::atomic<bool> has_returned{false};
 };
@@ -78,6 +78,18 @@ void DrawingCallback::add_glyph_advance(double advance_x, double advance_y)
   advance += Vector2d(advance_x, advance_y);
 }
 
+// Adds the outlines of a glyph drawn before by a callback of size 1 and without offset
+void DrawingCallback::add_glyph(const Polygon2d& glyph)
+{
+  for (const auto& o : glyph.outlines()) {
+    for (const auto& v : o.vertices) {
+      add_vertex(v);
+    }
+    this->polygon->addOutline(this->outline);
+    this->outline.vertices.clear();
+  }
+}
+
 void DrawingCallback::add_vertex(const Vector2d& v)
 {
   this->outline.vertices.push_back(size * (v + offset + advance));
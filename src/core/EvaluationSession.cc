@@ -28,14 +28,83 @@
 
 #include <cassert>
 #include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 
 #include "core/AST.h"
 #include "core/ContextFrame.h"
 #include "utils/printutils.h"
 
+namespace {
+
+thread_local EvaluationSession::Worker *current_worker = nullptr;
+
+} // namespace
+
+EvaluationSession::Worker::Worker(EvaluationSession *session) :
+  session(session),
+  previous(current_worker)
+{
+  current_worker = this;
+  std::lock_guard<std::mutex> lock(session->worker_mutex);
+  if (session->idle_arenas.empty()) {
+    context_arena = std::make_unique<ContextArena>();
+  } else {
+    context_arena = std::move(session->idle_arenas.back());
+    session->idle_arenas.pop_back();
+    context_arena->setOwner(std::this_thread::get_id());
+  }
+}
+
+EvaluationSession::Worker::~Worker()
+{
+  assert(stack.empty());
+  current_worker = previous;
+  std::lock_guard<std::mutex> lock(session->worker_mutex);
+  session->context_memory_manager.merge(std::move(context_memory_manager));
+  context_arena->setOwner(std::thread::id());
+  session->idle_arenas.push_back(std::move(context_arena));
+}
+
+bool EvaluationSession::Worker::active()
+{
+  return current_worker != nullptr;
+}
+
+void EvaluationSession::Worker::checkSafe(const std::string& operation)
+{
+  if (active()) {
+    throw UnsafeWorkerOperation(STR(operation, " cannot be evaluated concurrently"));
+  }
+}
+
+EvaluationSession::Worker *EvaluationSession::worker() const
+{
+  if (current_worker && current_worker->session == this) return current_worker;
+  return nullptr;
+}
+
+ContextMemoryManager& EvaluationSession::contextMemoryManager()
+{
+  if (Worker *w = worker()) return w->context_memory_manager;
+  return context_memory_manager;
+}
+
+ContextArena& EvaluationSession::contextArena()
+{
+  if (Worker *w = worker()) return *w->context_arena;
+  return context_arena;
+}
+
 size_t EvaluationSession::push_frame(ContextFrame *frame)
 {
+  if (Worker *w = worker()) {
+    w->stack.push_back(frame);
+    return stack.size() + w->stack.size() - 1;
+  }
   size_t index = stack.size();
   stack.push_back(frame);
   return index;
@@ -43,20 +112,41 @@ size_t EvaluationSession::push_frame(ContextFrame *frame)
 
 void EvaluationSession::replace_frame(size_t index, ContextFrame *frame)
 {
+  if (Worker *w = worker()) {
+    assert(index >= stack.size() && index - stack.size() < w->stack.size());
+    w->stack[index - stack.size()] = frame;
+    return;
+  }
   assert(index < stack.size());
   stack[index] = frame;
 }
 
 void EvaluationSession::pop_frame(size_t index)
 {
+  if (Worker *w = worker()) {
+    w->stack.pop_back();
+    assert(stack.size() + w->stack.size() == index);
+    return;
+  }
   stack.pop_back();
   assert(stack.size() == index);
 }
 
-boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(const std::string& name) const
+// Calls lookup on the frames from the top of the stack down, until one has a result
+template <typename Result, typename Lookup>
+boost::optional<Result> EvaluationSession::lookup_frames(const Lookup& lookup) const
 {
+  function_memo.taint();
+  if (const Worker *w = worker()) {
+    for (auto it = w->stack.crbegin(); it != w->stack.crend(); ++it) {
+      boost::optional<Result> result = lookup(**it);
+      if (result) {
+        return result;
+      }
+    }
+  }
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
-    boost::optional<const Value&> result = (*it)->lookup_local_variable(name);
+    boost::optional<Result> result = lookup(**it);
     if (result) {
       return result;
     }
@@ -64,6 +154,13 @@ boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(con
   return boost::none;
 }
 
+boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(const std::string& name) const
+{
+  return lookup_frames<const Value&>([&name](const ContextFrame& frame) {
+    return frame.lookup_local_variable(name);
+  });
+}
+
 const Value& EvaluationSession::lookup_special_variable(const std::string& name, const Location& loc) const
 {
   boost::optional<const Value&> result = try_lookup_special_variable(name);
@@ -76,24 +173,22 @@ const Value& EvaluationSession::lookup_special_variable(const std::string& name,
 
 boost::optional<CallableFunction> EvaluationSession::lookup_special_function(const std::string& name, const Location& loc) const
 {
-  for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
-    boost::optional<CallableFunction> result = (*it)->lookup_local_function(name, loc);
-    if (result) {
-      return result;
-    }
+  auto result = lookup_frames<CallableFunction>([&name, &loc](const ContextFrame& frame) {
+    return frame.lookup_local_function(name, loc);
+  });
+  if (!result) {
+    LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name);
   }
-  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name);
-  return boost::none;
+  return result;
 }
 
 boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(const std::string& name, const Location& loc) const
 {
-  for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
-    boost::optional<InstantiableModule> result = (*it)->lookup_local_module(name, loc);
-    if (result) {
-      return result;
-    }
+  auto result = lookup_frames<InstantiableModule>([&name, &loc](const ContextFrame& frame) {
+    return frame.lookup_local_module(name, loc);
+  });
+  if (!result) {
+    LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown module '%1$s'", name);
   }
-  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown module '%1$s'", name);
-  return boost::none;
+  return result;
 }
@@ -1,19 +1,34 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 #include <boost/optional.hpp>
 
 #include "core/ContextMemoryManager.h"
+#include "core/FunctionMemo.h"
 #include "core/AST.h"
 #include "core/function.h"
 #include "core/module.h"
 #include "core/Value.h"
+#include "utils/exceptions.h"
 
 class ContextFrame;
 
+/*
+ * Thrown by builtins that mustn't run on an EvaluationSession::Worker, such as
+ * rands() which shares its generator across the session. The caller is
+ * expected to redo the work without workers.
+ */
+class UnsafeWorkerOperation : public EvaluationException
+{
+public:
+  UnsafeWorkerOperation(const std::string& what_arg) : EvaluationException(what_arg) {}
+};
+
 class EvaluationSession
 {
 public:
@@ -31,11 +46,54 @@ public:
   [[nodiscard]] boost::optional<InstantiableModule> lookup_special_module(const std::string& name, const Location& loc) const;
 
   [[nodiscard]] const std::string& documentRoot() const { return document_root; }
-  ContextMemoryManager& contextMemoryManager() { return context_memory_manager; }
-  HeapSizeAccounting& accounting() { return context_memory_manager.accounting(); }
+  ContextMemoryManager& contextMemoryManager();
+  ContextArena& contextArena();
+  HeapSizeAccounting& accounting() { return contextMemoryManager().accounting(); }
+  FunctionMemo& functionMemo() { return function_memo; }
+  [[nodiscard]] const FunctionMemo& functionMemo() const { return function_memo; }
+
+  /*
+   * Lets the current thread evaluate expressions of the session concurrently
+   * with other workers, while the thread that owns the session waits for
+   * them. A worker has a frame stack on top of the session's frame stack,
+   * which stays unchanged meanwhile, and its own context memory manager.
+   * Both are merged back into the session when the worker goes away. New
+   * contexts come from an arena the worker takes from the session and
+   * returns to it, keeping the contexts it created valid.
+   */
+  class Worker
+  {
+public:
+    Worker(EvaluationSession *session);
+    ~Worker();
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+
+    // Whether the current thread is evaluating on a worker
+    static bool active();
+    static void checkSafe(const std::string& operation);
 
 private:
+    friend class EvaluationSession;
+    EvaluationSession *session;
+    Worker *previous;
+    std::vector<ContextFrame *> stack;
+    ContextMemoryManager context_memory_manager{false};
+    std::unique_ptr<ContextArena> context_arena;
+  };
+
+private:
+  [[nodiscard]] Worker *worker() const;
+  template <typename Result, typename Lookup>
+  boost::optional<Result> lookup_frames(const Lookup& lookup) const;
+
   std::string document_root;
   std::vector<ContextFrame *> stack;
+  // Before the memory manager, which drops the remaining contexts
+  ContextArena context_arena;
+  std::vector<std::unique_ptr<ContextArena>> idle_arenas; // of workers that went away
   ContextMemoryManager context_memory_manager;
+  // After the memory manager, as it holds values accounted for there
+  FunctionMemo function_memo;
+  std::mutex worker_mutex;
 };
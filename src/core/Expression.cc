@@ -35,14 +35,21 @@
 #include <cassert>
 #include <cstddef>
 #include <memory>
+#include <numeric>
 #include <sstream>
+#include <thread>
 #include <algorithm>
 #include <typeinfo>
 #include <utility>
 #include <variant>
+#include <vector>
 #include "utils/printutils.h"
 #include "utils/StackCheck.h"
+#include "utils/parallel.h"
 #include "core/Context.h"
+#include "core/EvaluationSession.h"
+#include "core/Bytecode.h"
+#include "Feature.h"
 #include "utils/exceptions.h"
 #include "core/Parameters.h"
 #include "utils/printutils.h"
@@ -61,6 +68,11 @@ bool Expression::isLiteral() const
   return false;
 }
 
+void Expression::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.fallback(*this, dst, tail);
+}
+
 UnaryOp::UnaryOp(UnaryOp::Op op, Expression *expr, const Location& loc) : Expression(loc), op(op), expr(expr)
 {
 }
@@ -96,6 +108,18 @@ void UnaryOp::print(std::ostream& stream, const std::string&) const
   stream << opString() << *this->expr;
 }
 
+void UnaryOp::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(expr);
+}
+
+void UnaryOp::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.compile(expr, dst, false);
+  compiler.emit(op == Op::Not ? BytecodeCompiler::Opcode::Not : BytecodeCompiler::Opcode::Negate, *this, dst, dst);
+  compiler.result(*this, dst, tail);
+}
+
 BinaryOp::BinaryOp(Expression *left, BinaryOp::Op op, Expression *right, const Location& loc) :
   Expression(loc), op(op), left(left), right(right)
 {
@@ -166,6 +190,51 @@ void BinaryOp::print(std::ostream& stream, const std::string&) const
   stream << "(" << *this->left << " " << opString() << " " << *this->right << ")";
 }
 
+void BinaryOp::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(left);
+  resolver.resolve(right);
+}
+
+void BinaryOp::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  using Opcode = BytecodeCompiler::Opcode;
+  if (op == Op::LogicalAnd || op == Op::LogicalOr) {
+    compiler.compile(left, dst, false);
+    size_t jump = compiler.emit(op == Op::LogicalAnd ? Opcode::JumpIfFalse : Opcode::JumpIfTrue, *this, dst);
+    compiler.compile(right, dst, false);
+    compiler.patch(jump);
+    compiler.emit(Opcode::ToBool, *this, dst, dst);
+    compiler.result(*this, dst, tail);
+    return;
+  }
+
+  Opcode opcode;
+  switch (op) {
+  case Op::Exponent:     opcode = Opcode::Exponent; break;
+  case Op::Multiply:     opcode = Opcode::Multiply; break;
+  case Op::Divide:       opcode = Opcode::Divide; break;
+  case Op::Modulo:       opcode = Opcode::Modulo; break;
+  case Op::Plus:         opcode = Opcode::Plus; break;
+  case Op::Minus:        opcode = Opcode::Minus; break;
+  case Op::Less:         opcode = Opcode::Less; break;
+  case Op::LessEqual:    opcode = Opcode::LessEqual; break;
+  case Op::Greater:      opcode = Opcode::Greater; break;
+  case Op::GreaterEqual: opcode = Opcode::GreaterEqual; break;
+  case Op::Equal:        opcode = Opcode::Equal; break;
+  case Op::NotEqual:     opcode = Opcode::NotEqual; break;
+  default:
+    assert(false && "Non-existent binary operator!");
+    throw EvaluationException("Non-existent binary operator!");
+  }
+  compiler.compile(left, dst, false);
+  uint16_t rhs = compiler.reserve();
+  compiler.compile(right, rhs, false);
+  compiler.emit(opcode, *this, dst, dst, rhs);
+  compiler.release(rhs);
+  compiler.result(*this, dst, tail);
+}
+
 TernaryOp::TernaryOp(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc)
   : Expression(loc), cond(cond), ifexpr(ifexpr), elseexpr(elseexpr)
 {
@@ -186,6 +255,29 @@ void TernaryOp::print(std::ostream& stream, const std::string&) const
   stream << "(" << *this->cond << " ? " << *this->ifexpr << " : " << *this->elseexpr << ")";
 }
 
+void TernaryOp::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(cond);
+  resolver.resolve(ifexpr);
+  resolver.resolve(elseexpr);
+}
+
+void TernaryOp::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.compile(cond, dst, false);
+  size_t jump_else = compiler.emit(BytecodeCompiler::Opcode::JumpIfFalse, *this, dst);
+  compiler.compile(ifexpr, dst, tail);
+  if (tail) {
+    compiler.patch(jump_else);
+    compiler.compile(elseexpr, dst, tail);
+  } else {
+    size_t jump_end = compiler.emit(BytecodeCompiler::Opcode::Jump, *this);
+    compiler.patch(jump_else);
+    compiler.compile(elseexpr, dst, tail);
+    compiler.patch(jump_end);
+  }
+}
+
 ArrayLookup::ArrayLookup(Expression *array, Expression *index, const Location& loc)
   : Expression(loc), array(array), index(index)
 {
@@ -200,6 +292,22 @@ void ArrayLookup::print(std::ostream& stream, const std::string&) const
   stream << *array << "[" << *index << "]";
 }
 
+void ArrayLookup::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(array);
+  resolver.resolve(index);
+}
+
+void ArrayLookup::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.compile(array, dst, false);
+  uint16_t i = compiler.reserve();
+  compiler.compile(index, i, false);
+  compiler.emit(BytecodeCompiler::Opcode::Index, *this, dst, dst, i);
+  compiler.release(i);
+  compiler.result(*this, dst, tail);
+}
+
 Value Literal::evaluate(const std::shared_ptr<const Context>&) const
 {
   return value.clone();
@@ -210,6 +318,11 @@ void Literal::print(std::ostream& stream, const std::string&) const
   stream << value;
 }
 
+void Literal::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.constant(*this, value, dst, tail);
+}
+
 Range::Range(Expression *begin, Expression *end, const Location& loc)
   : Expression(loc), begin(begin), end(end)
 {
@@ -277,6 +390,13 @@ void Range::print(std::ostream& stream, const std::string&) const
   stream << "]";
 }
 
+void Range::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(begin);
+  resolver.resolve(step);
+  resolver.resolve(end);
+}
+
 bool Range::isLiteral() const {
   return this->step ?
          begin->isLiteral() && end->isLiteral() && step->isLiteral() :
@@ -337,12 +457,40 @@ void Vector::print(std::ostream& stream, const std::string&) const
   stream << "]";
 }
 
+void Vector::resolveScopes(ScopeResolver& resolver)
+{
+  for (const auto& child : children) {
+    resolver.resolve(child);
+  }
+}
+
+void Vector::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  // List comprehension elements are embedded by tree walk
+  for (const auto& child : children) {
+    if (dynamic_cast<const ListComprehension *>(child.get())) {
+      compiler.fallback(*this, dst, tail);
+      return;
+    }
+  }
+  uint16_t first = compiler.reserve(children.size());
+  for (size_t i = 0; i < children.size(); ++i) {
+    compiler.compile(children[i], first + i, false);
+  }
+  compiler.emit(BytecodeCompiler::Opcode::MakeVector, *this, dst, first, static_cast<uint16_t>(children.size()));
+  compiler.release(first);
+  compiler.result(*this, dst, tail);
+}
+
 Lookup::Lookup(std::string name, const Location& loc) : Expression(loc), name(std::move(name))
 {
 }
 
 Value Lookup::evaluate(const std::shared_ptr<const Context>& context) const
 {
+  if (binding) {
+    if (const Value *value = binding->find(*context)) return value->clone();
+  }
   return context->lookup_variable(this->name, loc).clone();
 }
 
@@ -351,6 +499,17 @@ void Lookup::print(std::ostream& stream, const std::string&) const
   stream << this->name;
 }
 
+void Lookup::resolveScopes(ScopeResolver& resolver)
+{
+  binding = resolver.bind(name);
+  if (ContextFrame::is_config_variable(name)) resolver.markSpecialRead();
+}
+
+void Lookup::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.lookup(*this, name, dst, tail);
+}
+
 MemberLookup::MemberLookup(Expression *expr, std::string member, const Location& loc)
   : Expression(loc), expr(expr), member(std::move(member))
 {
@@ -402,14 +561,19 @@ void MemberLookup::print(std::ostream& stream, const std::string&) const
   stream << *this->expr << "." << this->member;
 }
 
+void MemberLookup::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(expr);
+}
+
 FunctionDefinition::FunctionDefinition(Expression *expr, AssignmentList parameters, const Location& loc)
-  : Expression(loc), context(nullptr), parameters(std::move(parameters)), expr(expr)
+  : Expression(loc), context(nullptr), parameters(std::move(parameters)), scope(this->parameters), expr(expr)
 {
 }
 
 Value FunctionDefinition::evaluate(const std::shared_ptr<const Context>& context) const
 {
-  return FunctionPtr{FunctionType{context, expr, std::make_unique<AssignmentList>(parameters)}};
+  return FunctionPtr{FunctionType{context, expr, std::make_unique<AssignmentList>(parameters), &scope}};
 }
 
 void FunctionDefinition::print(std::ostream& stream, const std::string& indent) const
@@ -426,6 +590,11 @@ void FunctionDefinition::print(std::ostream& stream, const std::string& indent)
   stream << ") " << *this->expr;
 }
 
+void FunctionDefinition::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolveFunction(parameters, scope, expr);
+}
+
 /**
  * This is separated because PRINTB uses quite a lot of stack space
  * and the method using it evaluate()
@@ -468,6 +637,10 @@ FunctionCall::FunctionCall(Expression *expr, AssignmentList args, const Location
 boost::optional<CallableFunction> FunctionCall::evaluate_function_expression(const std::shared_ptr<const Context>& context) const
 {
   if (isLookup) {
+    if (binding) {
+      const Value *value = binding->find(*context);
+      if (value && value->type() == Value::Type::FUNCTION) return CallableFunction{value};
+    }
     return context->lookup_function(name, location());
   } else {
     auto v = expr->evaluate(context);
@@ -487,7 +660,13 @@ struct SimplifiedExpression {
 };
 using SimplificationResult = std::variant<SimplifiedExpression, Value>;
 
-static SimplificationResult simplify_function_body(const Expression *expression, const std::shared_ptr<const Context>& context)
+/*
+ * replaces_context is set when a new context replaces the given one rather
+ * than being stacked on top of it, in which case the special variables of
+ * the given context are carried over. Compiled functions count their calls
+ * in calls themselves.
+ */
+static SimplificationResult simplify_function_body(const Expression *expression, const std::shared_ptr<const Context>& context, bool replaces_context, TailCalls& calls)
 {
   if (!expression) {
     return Value::undefined.clone();
@@ -505,14 +684,16 @@ static SimplificationResult simplify_function_body(const Expression *expression,
     } else if (type == typeid(Let)) {
       const Let *let = static_cast<const Let *>(expression);
       ContextHandle<Context> let_context{Context::create<Context>(context)};
-      let_context->apply_config_variables(*context);
+      if (replaces_context) let_context->apply_config_variables(*context);
       return SimplifiedExpression{let->evaluateStep(let_context), std::move(let_context)};
     } else if (type == typeid(FunctionCall)) {
       const auto *call = static_cast<const FunctionCall *>(expression);
 
       const Expression *function_body;
       const AssignmentList *required_parameters;
+      const LexicalScope *scope;
       std::shared_ptr<const Context> defining_context;
+      const UserFunction *memoized = nullptr;
 
       auto f = call->evaluate_function_expression(context);
       if (!f) {
@@ -523,9 +704,20 @@ static SimplificationResult simplify_function_body(const Expression *expression,
           return std::get<const BuiltinFunction *>(*f)->evaluate(context, call);
         } else if (index == 1) {
           CallableUserFunction callable = std::get<CallableUserFunction>(*f);
+          if (const CompiledFunction *compiled = callable.function->compiled()) {
+            auto result = compiled->call(callable.defining_context, call, context, replaces_context, calls);
+            if (result) {
+              if (auto *tail = std::get_if<TailExpression>(&*result)) {
+                return SimplifiedExpression{tail->expression, std::move(tail->context)};
+              }
+              return std::move(std::get<Value>(*result));
+            }
+          }
           function_body = callable.function->expr.get();
           required_parameters = &callable.function->parameters;
+          scope = &callable.function->scope;
           defining_context = callable.defining_context;
+          if (context->session()->functionMemo().memoizes(*callable.function)) memoized = callable.function;
         } else {
           const FunctionType *function;
           if (index == 2) {
@@ -537,13 +729,24 @@ static SimplificationResult simplify_function_body(const Expression *expression,
           }
           function_body = function->getExpr().get();
           required_parameters = function->getParameters().get();
+          scope = function->getScope();
           defining_context = function->getContext();
         }
       }
       ContextHandle<Context> body_context{Context::create<Context>(defining_context)};
-      body_context->apply_config_variables(*context);
+      if (replaces_context) body_context->apply_config_variables(*context);
+      body_context->set_scope(scope);
       Arguments arguments{call->arguments, context};
       Parameters parameters = Parameters::parse(std::move(arguments), call->location(), *required_parameters, defining_context);
+      if (memoized) {
+        std::vector<Value> values;
+        values.reserve(required_parameters->size());
+        for (const auto& parameter : *required_parameters) {
+          values.push_back(parameters.get(parameter->getName()).clone());
+        }
+        auto result = context->session()->functionMemo().lookup(*memoized, defining_context, std::move(values), calls.memoized);
+        if (result) return std::move(*result);
+      }
       body_context->apply_variables(std::move(parameters).to_context_frame());
 
       return SimplifiedExpression{function_body, std::move(body_context), call};
@@ -553,27 +756,21 @@ static SimplificationResult simplify_function_body(const Expression *expression,
   }
 }
 
-Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) const
+/*
+ * Repeatedly simplifies expression until it reduces to either a tail call,
+ * or an expression that cannot be simplified in-place. If the latter,
+ * recurse. If the former, substitute the function body for expression,
+ * thereby implementing tail recursion optimization. body_context, if set,
+ * owns expression_context.
+ */
+static Value evaluate_tail_calls(const Expression *expression, std::shared_ptr<const Context> expression_context,
+                                 boost::optional<ContextHandle<Context>>& body_context, TailCalls& calls)
 {
-  const auto& name = get_name();
-  if (StackCheck::inst().check()) {
-    print_err(name.c_str(), loc, context);
-    throw RecursionException::create("function", name, this->loc);
-  }
-
-  // Repeatedly simplify expr until it reduces to either a tail call,
-  // or an expression that cannot be simplified in-place. If the latter,
-  // recurse. If the former, substitute the function body for expr,
-  // thereby implementing tail recursion optimization.
-  unsigned int recursion_depth = 0;
-  const FunctionCall *current_call = this;
-
-  ContextHandle<Context> expression_context{Context::create<Context>(context)};
-  const Expression *expression = this;
   while (true) {
     try {
-      auto result = simplify_function_body(expression, *expression_context);
+      auto result = simplify_function_body(expression, expression_context, body_context.has_value(), calls);
       if (Value *value = std::get_if<Value>(&result)) {
+        if (calls.memoized) expression_context->session()->functionMemo().store(std::move(*calls.memoized), *value);
         return std::move(*value);
       }
 
@@ -582,18 +779,19 @@ Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) cons
 
       expression = simplified_expression->expression;
       if (simplified_expression->new_context) {
-        expression_context = std::move(*simplified_expression->new_context);
+        if (body_context) {
+          *body_context = std::move(*simplified_expression->new_context);
+        } else {
+          body_context.emplace(std::move(*simplified_expression->new_context));
+        }
+        expression_context = **body_context;
       }
       if (simplified_expression->new_active_function_call) {
-        current_call = *simplified_expression->new_active_function_call;
-        if (recursion_depth++ == 1000000) {
-          LOG(message_group::Error, expression->location(), expression_context->documentRoot(), "Recursion detected calling function '%1$s'", current_call->name);
-          throw RecursionException::create("function", current_call->name, current_call->location());
-        }
+        calls.enter(*simplified_expression->new_active_function_call, expression, expression_context->documentRoot());
       }
     } catch (EvaluationException& e) {
       if (e.traceDepth > 0) {
-        print_trace(current_call, *expression_context);
+        print_trace(calls.current_call, expression_context);
         e.traceDepth--;
       }
       throw;
@@ -601,11 +799,48 @@ Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) cons
   }
 }
 
+Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  const auto& name = get_name();
+  if (StackCheck::inst().check()) {
+    print_err(name.c_str(), loc, context);
+    throw RecursionException::create("function", name, this->loc);
+  }
+
+  // The arguments of the first call are evaluated directly in the caller's
+  // context; the contexts of the function bodies are owned here.
+  TailCalls calls(this);
+  boost::optional<ContextHandle<Context>> body_context;
+  return evaluate_tail_calls(this, context, body_context, calls);
+}
+
+Value FunctionCall::evaluateTail(TailExpression&& tail, TailCalls& calls)
+{
+  boost::optional<ContextHandle<Context>> body_context{std::move(tail.context)};
+  return evaluate_tail_calls(tail.expression, **body_context, body_context, calls);
+}
+
 void FunctionCall::print(std::ostream& stream, const std::string&) const
 {
   stream << this->get_name() << "(" << this->arguments << ")";
 }
 
+void FunctionCall::resolveScopes(ScopeResolver& resolver)
+{
+  if (isLookup) {
+    binding = resolver.bind(name);
+    if (!binding) resolver.markCall(name);
+  } else {
+    resolver.resolve(expr);
+  }
+  resolver.resolve(arguments);
+}
+
+void FunctionCall::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.call(*this, dst, tail);
+}
+
 Expression *FunctionCall::create(const std::string& funcname, const AssignmentList& arglist, Expression *expr, const Location& loc)
 {
   if (funcname == "assert") {
@@ -663,6 +898,12 @@ void Assert::print(std::ostream& stream, const std::string&) const
   if (this->expr) stream << " " << *this->expr;
 }
 
+void Assert::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(arguments);
+  resolver.resolve(expr);
+}
+
 Echo::Echo(AssignmentList args, Expression *expr, const Location& loc)
   : Expression(loc), arguments(std::move(args)), expr(expr)
 {
@@ -672,6 +913,7 @@ Echo::Echo(AssignmentList args, Expression *expr, const Location& loc)
 const Expression *Echo::evaluateStep(const std::shared_ptr<const Context>& context) const
 {
   Arguments arguments{this->arguments, context};
+  context->session()->functionMemo().taint();
   LOG(message_group::Echo, "%1$s", STR(arguments));
   return expr.get();
 }
@@ -688,13 +930,22 @@ void Echo::print(std::ostream& stream, const std::string&) const
   if (this->expr) stream << " " << *this->expr;
 }
 
+void Echo::resolveScopes(ScopeResolver& resolver)
+{
+  // Echoes would be printed only once the whole comprehension is done
+  resolver.markSideEffect();
+  resolver.resolve(arguments);
+  resolver.resolve(expr);
+}
+
 Let::Let(AssignmentList args, Expression *expr, const Location& loc)
-  : Expression(loc), arguments(std::move(args)), expr(expr)
+  : Expression(loc), arguments(std::move(args)), scope(arguments), expr(expr)
 {
 }
 
-void Let::doSequentialAssignment(const AssignmentList& assignments, const Location& location, ContextHandle<Context>& targetContext)
+void Let::doSequentialAssignment(const AssignmentList& assignments, const Location& location, ContextHandle<Context>& targetContext, const LexicalScope *scope)
 {
+  if (scope) targetContext->set_scope(scope);
   std::set<std::string> seen;
   for (const auto& assignment : assignments) {
     Value value = assignment->getExpr()->evaluate(*targetContext);
@@ -710,16 +961,16 @@ void Let::doSequentialAssignment(const AssignmentList& assignments, const Locati
   }
 }
 
-ContextHandle<Context> Let::sequentialAssignmentContext(const AssignmentList& assignments, const Location& location, const std::shared_ptr<const Context>& context)
+ContextHandle<Context> Let::sequentialAssignmentContext(const AssignmentList& assignments, const Location& location, const std::shared_ptr<const Context>& context, const LexicalScope *scope)
 {
   ContextHandle<Context> letContext{Context::create<Context>(context)};
-  doSequentialAssignment(assignments, location, letContext);
+  doSequentialAssignment(assignments, location, letContext, scope);
   return letContext;
 }
 
 const Expression *Let::evaluateStep(ContextHandle<Context>& targetContext) const
 {
-  doSequentialAssignment(this->arguments, this->location(), targetContext);
+  doSequentialAssignment(this->arguments, this->location(), targetContext, &this->scope);
   return this->expr.get();
 }
 
@@ -734,6 +985,18 @@ void Let::print(std::ostream& stream, const std::string&) const
   stream << "let(" << this->arguments << ") " << *expr;
 }
 
+void Let::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.pushSequential(arguments, scope);
+  resolver.resolve(expr);
+  resolver.pop();
+}
+
+void Let::compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const
+{
+  compiler.let(*this, arguments, scope, *expr, dst, tail);
+}
+
 ListComprehension::ListComprehension(const Location& loc) : Expression(loc)
 {
 }
@@ -761,6 +1024,13 @@ void LcIf::print(std::ostream& stream, const std::string&) const
   }
 }
 
+void LcIf::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(cond);
+  resolver.resolve(ifexpr);
+  resolver.resolve(elseexpr);
+}
+
 LcEach::LcEach(Expression *expr, const Location& loc) : ListComprehension(loc), expr(expr)
 {
 }
@@ -813,34 +1083,32 @@ void LcEach::print(std::ostream& stream, const std::string&) const
   stream << "each (" << *this->expr << ")";
 }
 
+void LcEach::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.resolve(expr);
+}
+
 LcFor::LcFor(AssignmentList args, Expression *expr, const Location& loc)
-  : ListComprehension(loc), arguments(std::move(args)), expr(expr)
+  : ListComprehension(loc), arguments(std::move(args)), scopes(arguments.size()), expr(expr)
 {
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    scopes[i].add(arguments[i]->getName());
+  }
 }
 
-static inline ContextHandle<Context> forContext(const std::shared_ptr<const Context>& context, const std::string& name, Value value)
+static inline ContextHandle<Context> forContext(const std::shared_ptr<const Context>& context, const LexicalScope *scope, const std::string& name, Value value)
 {
   ContextHandle<Context> innerContext{Context::create<Context>(context)};
+  if (scope) innerContext->set_scope(scope);
   innerContext->set_variable(name, std::move(value));
   return innerContext;
 }
 
-static void doForEach(
-  const AssignmentList& assignments,
-  const Location& location,
-  const std::function<void(const std::shared_ptr<const Context>&)>& operation,
-  size_t assignment_index,
-  const std::shared_ptr<const Context>& context,
-  const std::function<void(size_t)> *pReserve = nullptr
-  ) {
-  if (assignment_index >= assignments.size()) {
-    operation(context);
-    return;
-  }
-
-  const std::string& variable_name = assignments[assignment_index]->getName();
-  Value variable_values = assignments[assignment_index]->getExpr()->evaluate(context);
-
+// Calls f with each value a for() variable takes for the given values
+template <typename F>
+static void forEachValue(Value& variable_values, const Location& location, const std::shared_ptr<const Context>& context,
+                         const std::function<void(size_t)> *pReserve, const F& f)
+{
   if (variable_values.type() == Value::Type::RANGE) {
     const RangeType& range = variable_values.toRange();
     uint32_t steps = range.numValues();
@@ -852,9 +1120,7 @@ static void doForEach(
         (*pReserve)(steps);
       }
       for (double value : range) {
-        doForEach(assignments, location, operation, assignment_index + 1,
-                  *forContext(context, variable_name, value)
-                  );
+        f(Value(value));
       }
     }
   } else if (variable_values.type() == Value::Type::VECTOR) {
@@ -863,9 +1129,7 @@ static void doForEach(
       (*pReserve)(vec.size());
     }
     for (const auto& value : vec) {
-      doForEach(assignments, location, operation, assignment_index + 1,
-                *forContext(context, variable_name, value.clone())
-                );
+      f(value.clone());
     }
   } else if (variable_values.type() == Value::Type::OBJECT) {
     auto &keys = variable_values.toObject().keys();
@@ -873,9 +1137,7 @@ static void doForEach(
       (*pReserve)(keys.size());
     }
     for (auto key : keys) {
-      doForEach(assignments, location, operation, assignment_index + 1,
-                *forContext(context, variable_name, key)
-                );
+      f(Value(key));
     }
   } else if (variable_values.type() == Value::Type::STRING) {
     auto &wrapper = variable_values.toStrUtf8Wrapper();
@@ -883,32 +1145,154 @@ static void doForEach(
       (*pReserve)(wrapper.size());
     }
     for (auto value : wrapper) {
-      doForEach(assignments, location, operation, assignment_index + 1,
-                *forContext(context, variable_name, Value(std::move(value)))
-                );
+      f(Value(std::move(value)));
     }
   } else if (variable_values.type() != Value::Type::UNDEFINED) {
+    f(std::move(variable_values));
+  }
+}
+
+static void doForEach(
+  const AssignmentList& assignments,
+  const Location& location,
+  const std::function<void(const std::shared_ptr<const Context>&)>& operation,
+  size_t assignment_index,
+  const std::shared_ptr<const Context>& context,
+  const std::function<void(size_t)> *pReserve = nullptr,
+  const std::vector<LexicalScope> *scopes = nullptr
+  ) {
+  if (assignment_index >= assignments.size()) {
+    operation(context);
+    return;
+  }
+
+  const std::string& variable_name = assignments[assignment_index]->getName();
+  const LexicalScope *scope = scopes ? &(*scopes)[assignment_index] : nullptr;
+  Value variable_values = assignments[assignment_index]->getExpr()->evaluate(context);
+  forEachValue(variable_values, location, context, pReserve, [&](Value value) {
     doForEach(assignments, location, operation, assignment_index + 1,
-              *forContext(context, variable_name, std::move(variable_values))
+              *forContext(context, scope, variable_name, std::move(value)), nullptr, scopes
               );
-  }
+  });
+}
+
+void LcFor::forEach(const AssignmentList& assignments, const Location& loc, const std::shared_ptr<const Context>& context, const std::function<void(const std::shared_ptr<const Context>&)>& operation, const std::function<void(size_t)>* pReserve, const std::vector<LexicalScope> *scopes)
+{
+  doForEach(assignments, loc, operation, 0, context, pReserve, scopes);
+}
+
+namespace {
+
+// Comprehensions with fewer iterations aren't worth spreading over threads
+constexpr size_t parallel_min_iterations = 256;
+constexpr size_t parallel_min_chunk_size = 64;
+
+struct IterationChunk {
+  std::vector<Value> values;
+  std::vector<Message> messages;
+  bool failed = false;
+};
+
+/*
+ * Evaluates iterate(i, values) for all i below count, in chunks that run
+ * concurrently on session workers. Messages are collected for each chunk, to
+ * be printed in order once all are done. Returns false if a chunk failed, e.g.
+ * by throwing an error or calling a builtin that isn't safe on a worker; the
+ * caller then evaluates the iterations again in order.
+ */
+template <typename Iterate>
+bool evaluateChunks(EvaluationSession *session, size_t count, const Iterate& iterate, std::vector<IterationChunk>& chunks)
+{
+  size_t concurrency = std::max(1U, std::thread::hardware_concurrency());
+  size_t chunk_count = std::min(count / parallel_min_chunk_size, 4 * concurrency);
+  std::vector<size_t> indices(chunk_count);
+  std::iota(indices.begin(), indices.end(), 0);
+  chunks.resize(chunk_count);
+
+  const auto caller = std::this_thread::get_id();
+  parallelizable_transform(indices.begin(), indices.end(), chunks.begin(), [&](size_t index) {
+    IterationChunk chunk;
+    if (std::this_thread::get_id() != caller) {
+      // The stack of a worker thread is usually smaller than that of the main thread
+      if (size_t stack_size = parallel_worker_stack_size()) StackCheck::inst().restart(stack_size);
+    }
+    MessageCapture capture;
+    try {
+      EvaluationSession::Worker worker(session);
+      size_t end = count * (index + 1) / chunk_count;
+      for (size_t i = count * index / chunk_count; i < end; ++i) {
+        iterate(i, chunk.values);
+      }
+    } catch (...) {
+      chunk.failed = true;
+    }
+    chunk.messages = capture.take();
+    return chunk;
+  });
+
+  return std::none_of(chunks.begin(), chunks.end(), [](const IterationChunk& chunk) { return chunk.failed; });
 }
 
-void LcFor::forEach(const AssignmentList& assignments, const Location& loc, const std::shared_ptr<const Context>& context, const std::function<void(const std::shared_ptr<const Context>&)>& operation, const std::function<void(size_t)>* pReserve)
+bool parallelComprehensionsEnabled()
 {
-  doForEach(assignments, loc, operation, 0, context, pReserve);
+  // Hard warnings must abort where they occur, not when messages are printed
+  return Feature::ExperimentalParallelComprehensions.is_enabled() && parallelization_enabled() &&
+         !OpenSCAD::hardwarnings && !EvaluationSession::Worker::active();
 }
 
+} // namespace
+
 Value LcFor::evaluate(const std::shared_ptr<const Context>& context) const
 {
   EmbeddedVectorType vec(context->session());
   std::function<void(size_t)> reserve = [&vec](size_t capacity) {
     vec.reserve(capacity);
   };
-  forEach(this->arguments, this->loc, context,
-          [&vec, expression = expr.get()] (const std::shared_ptr<const Context>& iterationContext) {
+  std::function<void(const std::shared_ptr<const Context>&)> operation =
+    [&vec, expression = expr.get()] (const std::shared_ptr<const Context>& iterationContext) {
     vec.emplace_back(expression->evaluate(iterationContext));
-  }, &reserve);
+  };
+  if (!this->parallelizable || !parallelComprehensionsEnabled()) {
+    forEach(this->arguments, this->loc, context, operation, &reserve, &this->scopes);
+    return {std::move(vec)};
+  }
+
+  // Split up the values of the first variable, which are evaluated only once
+  std::vector<Value> values;
+  Value variable_values = this->arguments[0]->getExpr()->evaluate(context);
+  forEachValue(variable_values, this->loc, context, nullptr, [&values](Value value) {
+    values.push_back(std::move(value));
+  });
+  const std::string& variable_name = this->arguments[0]->getName();
+  auto iterate = [&](Value value, const std::function<void(const std::shared_ptr<const Context>&)>& op) {
+    doForEach(this->arguments, this->loc, op, 1,
+              *forContext(context, &this->scopes[0], variable_name, std::move(value)), nullptr, &this->scopes);
+  };
+
+  std::vector<IterationChunk> chunks;
+  if (values.size() >= parallel_min_iterations &&
+      evaluateChunks(context->session(), values.size(), [&](size_t i, std::vector<Value>& output) {
+    iterate(values[i].clone(), [&output, expression = expr.get()](const std::shared_ptr<const Context>& iterationContext) {
+      output.push_back(expression->evaluate(iterationContext));
+    });
+  }, chunks)) {
+    size_t size = 0;
+    for (const auto& chunk : chunks) size += chunk.values.size();
+    vec.reserve(size);
+    for (auto& chunk : chunks) {
+      LOG(std::move(chunk.messages));
+      for (auto& value : chunk.values) {
+        vec.emplace_back(std::move(value));
+      }
+    }
+  } else {
+    // Anything the chunks printed would be printed again
+    chunks.clear();
+    vec.reserve(values.size());
+    for (auto& value : values) {
+      iterate(std::move(value), operation);
+    }
+  }
   return {std::move(vec)};
 }
 
@@ -917,8 +1301,27 @@ void LcFor::print(std::ostream& stream, const std::string&) const
   stream << "for(" << this->arguments << ") (" << *this->expr << ")";
 }
 
+void LcFor::resolveScopes(ScopeResolver& resolver)
+{
+  // Each variable is bound in a nested context, in which the next range is evaluated
+  bool outer = false;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    resolver.resolve(arguments[i]->getExpr());
+    // The first range is evaluated once, everything after it per iteration
+    if (i == 0) outer = resolver.beginSideEffects();
+    resolver.push(scopes[i]);
+  }
+  if (arguments.empty()) outer = resolver.beginSideEffects();
+  resolver.resolve(expr);
+  parallelizable = !resolver.endSideEffects(outer) && !arguments.empty();
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    resolver.pop();
+  }
+}
+
 LcForC::LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, Expression *expr, const Location& loc)
-  : ListComprehension(loc), arguments(std::move(args)), incr_arguments(std::move(incrargs)), cond(cond), expr(expr)
+  : ListComprehension(loc), arguments(std::move(args)), incr_arguments(std::move(incrargs)),
+  scope(arguments), incr_scope(incr_arguments), cond(cond), expr(expr)
 {
 }
 
@@ -926,8 +1329,9 @@ Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
 {
   EmbeddedVectorType output(context->session());
 
-  ContextHandle<Context> initialContext{Let::sequentialAssignmentContext(this->arguments, this->location(), context)};
+  ContextHandle<Context> initialContext{Let::sequentialAssignmentContext(this->arguments, this->location(), context, &this->scope)};
   ContextHandle<Context> currentContext{Context::create<Context>(*initialContext)};
+  currentContext->set_scope(&this->incr_scope);
 
   unsigned int counter = 0;
   while (this->cond->evaluate(*currentContext).toBool()) {
@@ -949,7 +1353,7 @@ Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
      * captured context references in lambda functions.
      * So, we reparent the next context to the initial context.
      */
-    ContextHandle<Context> nextContext{Let::sequentialAssignmentContext(this->incr_arguments, this->location(), *currentContext)};
+    ContextHandle<Context> nextContext{Let::sequentialAssignmentContext(this->incr_arguments, this->location(), *currentContext, &this->incr_scope)};
     currentContext = std::move(nextContext);
     currentContext->setParent(*initialContext);
   }
@@ -965,17 +1369,37 @@ void LcForC::print(std::ostream& stream, const std::string&) const
     << ") " << *this->expr;
 }
 
+void LcForC::resolveScopes(ScopeResolver& resolver)
+{
+  // See evaluate(): each iteration is a context of incr_scope on top of the initial context
+  resolver.pushSequential(arguments, scope);
+  resolver.push(incr_scope);
+  resolver.resolve(cond);
+  resolver.resolve(expr);
+  resolver.pushSequential(incr_arguments, incr_scope);
+  resolver.pop();
+  resolver.pop();
+  resolver.pop();
+}
+
 LcLet::LcLet(AssignmentList args, Expression *expr, const Location& loc)
-  : ListComprehension(loc), arguments(std::move(args)), expr(expr)
+  : ListComprehension(loc), arguments(std::move(args)), scope(arguments), expr(expr)
 {
 }
 
 Value LcLet::evaluate(const std::shared_ptr<const Context>& context) const
 {
-  return this->expr->evaluate(*Let::sequentialAssignmentContext(this->arguments, this->location(), context));
+  return this->expr->evaluate(*Let::sequentialAssignmentContext(this->arguments, this->location(), context, &this->scope));
 }
 
 void LcLet::print(std::ostream& stream, const std::string&) const
 {
   stream << "let(" << this->arguments << ") (" << *this->expr << ")";
 }
+
+void LcLet::resolveScopes(ScopeResolver& resolver)
+{
+  resolver.pushSequential(arguments, scope);
+  resolver.resolve(expr);
+  resolver.pop();
+}
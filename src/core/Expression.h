@@ -3,6 +3,7 @@
 #include <ostream>
 #include <utility>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -11,9 +12,14 @@
 #include "core/Assignment.h"
 #include "core/AST.h"
 #include "core/function.h"
+#include "core/LexicalScope.h"
+#include "core/ScopeResolver.h"
 #include "core/Value.h"
 
 template <class T> class ContextHandle;
+class BytecodeCompiler;
+struct TailCalls;
+struct TailExpression;
 
 class Expression : public ASTNode
 {
@@ -21,6 +27,10 @@ public:
   Expression(const Location& loc) : ASTNode(loc) {}
   [[nodiscard]] virtual bool isLiteral() const;
   [[nodiscard]] virtual Value evaluate(const std::shared_ptr<const Context>& context) const = 0;
+  // Binds the variable references in this expression, see ScopeResolver
+  virtual void resolveScopes(ScopeResolver& /*resolver*/) {}
+  // Compiles this expression into the register dst, see BytecodeCompiler. Falls back to tree walk by default.
+  virtual void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const;
   Value checkUndef(Value&& val, const std::shared_ptr<const Context>& context) const;
 };
 
@@ -35,6 +45,8 @@ public:
   UnaryOp(Op op, Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
 
 private:
   [[nodiscard]] const char *opString() const;
@@ -66,6 +78,8 @@ public:
   BinaryOp(Expression *left, Op op, Expression *right, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
 
 private:
   [[nodiscard]] const char *opString() const;
@@ -82,6 +96,8 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
 private:
   std::shared_ptr<Expression> cond;
   std::shared_ptr<Expression> ifexpr;
@@ -94,6 +110,8 @@ public:
   ArrayLookup(Expression *array, Expression *index, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
 private:
   std::shared_ptr<Expression> array;
   std::shared_ptr<Expression> index;
@@ -114,6 +132,7 @@ public:
 
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
   [[nodiscard]] bool isLiteral() const override { return true; }
 private:
   const Value value;
@@ -129,6 +148,7 @@ public:
   [[nodiscard]] const Expression *getEnd() const { return end.get(); }
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
   [[nodiscard]] bool isLiteral() const override;
 private:
   std::shared_ptr<Expression> begin;
@@ -143,6 +163,8 @@ public:
   const std::vector<std::shared_ptr<Expression>>& getChildren() const { return children; }
   Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
   void emplace_back(Expression *expr);
   bool isLiteral() const override;
 private:
@@ -156,9 +178,12 @@ public:
   Lookup(std::string name, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
   [[nodiscard]] const std::string& get_name() const { return name; }
 private:
   std::string name;
+  std::unique_ptr<const VariableBinding> binding;
 };
 
 class MemberLookup : public Expression
@@ -167,6 +192,7 @@ public:
   MemberLookup(Expression *expr, std::string member, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   std::shared_ptr<Expression> expr;
   std::string member;
@@ -179,13 +205,18 @@ public:
   [[nodiscard]] boost::optional<CallableFunction> evaluate_function_expression(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
   [[nodiscard]] const std::string& get_name() const { return name; }
   static Expression *create(const std::string& funcname, const AssignmentList& arglist, Expression *expr, const Location& loc);
+  // Continues the tail calls of a call whose compiled code left tail to the loop of evaluate()
+  static Value evaluateTail(TailExpression&& tail, TailCalls& calls);
 public:
   bool isLookup;
   std::string name;
   std::shared_ptr<Expression> expr;
   AssignmentList arguments;
+  std::unique_ptr<const VariableBinding> binding;
 };
 
 class FunctionDefinition : public Expression
@@ -194,9 +225,11 @@ public:
   FunctionDefinition(Expression *expr, AssignmentList parameters, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 public:
   std::shared_ptr<const Context> context;
   AssignmentList parameters;
+  LexicalScope scope;
   std::shared_ptr<Expression> expr;
 };
 
@@ -208,6 +241,7 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
@@ -220,6 +254,7 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   AssignmentList arguments;
   std::shared_ptr<Expression> expr;
@@ -229,13 +264,16 @@ class Let : public Expression
 {
 public:
   Let(AssignmentList args, Expression *expr, const Location& loc);
-  static void doSequentialAssignment(const AssignmentList& assignments, const Location& location, ContextHandle<Context>& targetContext);
-  static ContextHandle<Context> sequentialAssignmentContext(const AssignmentList& assignments, const Location& location, const std::shared_ptr<const Context>& context);
+  static void doSequentialAssignment(const AssignmentList& assignments, const Location& location, ContextHandle<Context>& targetContext, const LexicalScope *scope = nullptr);
+  static ContextHandle<Context> sequentialAssignmentContext(const AssignmentList& assignments, const Location& location, const std::shared_ptr<const Context>& context, const LexicalScope *scope = nullptr);
   const Expression *evaluateStep(ContextHandle<Context>& targetContext) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
+  void compile(BytecodeCompiler& compiler, uint16_t dst, bool tail) const override;
 private:
   AssignmentList arguments;
+  LexicalScope scope;
   std::shared_ptr<Expression> expr;
 };
 
@@ -251,6 +289,7 @@ public:
   LcIf(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   std::shared_ptr<Expression> cond;
   std::shared_ptr<Expression> ifexpr;
@@ -261,12 +300,15 @@ class LcFor : public ListComprehension
 {
 public:
   LcFor(AssignmentList args, Expression *expr, const Location& loc);
-  static void forEach(const AssignmentList& assignments, const Location& loc, const std::shared_ptr<const Context>& context, const std::function<void(const std::shared_ptr<const Context>&)>& operation, const std::function<void(size_t)>* pReserve = nullptr);
+  static void forEach(const AssignmentList& assignments, const Location& loc, const std::shared_ptr<const Context>& context, const std::function<void(const std::shared_ptr<const Context>&)>& operation, const std::function<void(size_t)>* pReserve = nullptr, const std::vector<LexicalScope> *scopes = nullptr);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   AssignmentList arguments;
+  std::vector<LexicalScope> scopes; // one per assignment
   std::shared_ptr<Expression> expr;
+  bool parallelizable{false}; // iterations have no side effects, see ScopeResolver
 };
 
 class LcForC : public ListComprehension
@@ -275,9 +317,12 @@ public:
   LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   AssignmentList arguments;
   AssignmentList incr_arguments;
+  LexicalScope scope;
+  LexicalScope incr_scope;
   std::shared_ptr<Expression> cond;
   std::shared_ptr<Expression> expr;
 };
@@ -288,6 +333,7 @@ public:
   LcEach(Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   Value evalRecur(Value&& v, const std::shared_ptr<const Context>& context) const;
   std::shared_ptr<Expression> expr;
@@ -299,7 +345,9 @@ public:
   LcLet(AssignmentList args, Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  void resolveScopes(ScopeResolver& resolver) override;
 private:
   AssignmentList arguments;
+  LexicalScope scope;
   std::shared_ptr<Expression> expr;
 };
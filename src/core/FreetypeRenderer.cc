@@ -29,8 +29,13 @@
 #include <limits>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <cmath>
 #include <cstdio>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 
@@ -41,6 +46,7 @@
 
 #include "FontCache.h"
 #include "core/DrawingCallback.h"
+#include "geometry/Polygon2d.h"
 #include "utils/calc.h"
 
 #include FT_OUTLINE_H
@@ -319,17 +325,19 @@ void FreetypeRenderer::Params::set(Parameters& parameters)
 }
 
 
-FreetypeRenderer::ShapeResults::ShapeResults(
-  const FreetypeRenderer::Params& params)
+std::unordered_map<std::string, std::shared_ptr<const FreetypeRenderer::ShapedText>> FreetypeRenderer::shaped_texts;
+std::map<std::tuple<std::string, FT_UInt, unsigned int>, std::shared_ptr<const Polygon2d>> FreetypeRenderer::glyphs;
+const size_t FreetypeRenderer::max_cached_texts = 10000;
+const size_t FreetypeRenderer::max_cached_glyphs = 10000;
+
+std::shared_ptr<const FreetypeRenderer::ShapedText> FreetypeRenderer::shape(
+  const FreetypeRenderer::Params& params, FT_Face face, bool& cacheable)
 {
-  FT_Face face = params.get_font_face();
-  if (face == nullptr) {
-    return;
-  }
+  auto result = std::make_shared<ShapedText>();
 
-  hb_ft_font = hb_ft_font_create(face, nullptr);
+  hb_font_t *hb_ft_font = hb_ft_font_create(face, nullptr);
 
-  hb_buf = hb_buffer_create();
+  hb_buffer_t *hb_buf = hb_buffer_create();
   hb_buffer_set_direction(hb_buf, hb_direction_from_string(params.direction.c_str(), -1));
   hb_buffer_set_script(hb_buf, hb_script_from_string(params.script.c_str(), -1));
   hb_buffer_set_language(hb_buf, hb_language_from_string(params.language.c_str(), -1));
@@ -353,6 +361,7 @@ FreetypeRenderer::ShapeResults::ShapeResults(
       LOG(message_group::Warning, params.loc, params.documentPath,
           "Ignoring text with invalid UTF-8 encoding: \"%1$s\"",
           params.text.c_str());
+      cacheable = false;
     }
   } else {
     hb_buffer_add_utf8(hb_buf, params.text.c_str(), strlen(params.text.c_str()), 0, strlen(params.text.c_str()));
@@ -363,7 +372,16 @@ FreetypeRenderer::ShapeResults::ShapeResults(
   hb_glyph_info_t *glyph_info = hb_buffer_get_glyph_infos(hb_buf, &glyph_count);
   hb_glyph_position_t *glyph_pos = hb_buffer_get_glyph_positions(hb_buf, &glyph_count);
 
-  glyph_array.reserve(glyph_count);
+  double ascent = std::numeric_limits<double>::lowest();
+  double descent = std::numeric_limits<double>::max();
+  double advance_x = 0;
+  double advance_y = 0;
+  double left = std::numeric_limits<double>::max();
+  double right = std::numeric_limits<double>::lowest();
+  double bottom = std::numeric_limits<double>::max();
+  double top = std::numeric_limits<double>::lowest();
+
+  result->glyphs.reserve(glyph_count);
   for (unsigned int idx = 0; idx < glyph_count; ++idx) {
     FT_Error error;
     FT_UInt glyph_index = glyph_info[idx].codepoint;
@@ -373,6 +391,7 @@ FreetypeRenderer::ShapeResults::ShapeResults(
           "Could not load glyph %1$u"
           " for char at index %2$u in text '%3$s'",
           glyph_index, idx, params.text);
+      cacheable = false;
       continue;
     }
 
@@ -383,24 +402,18 @@ FreetypeRenderer::ShapeResults::ShapeResults(
           "Could not get glyph %1$u"
           " for char at index %2$u in text '%3$s'",
           glyph_index, idx, params.text);
+      cacheable = false;
       continue;
     }
 
-    glyph_array.emplace_back(glyph, idx, &glyph_pos[idx]);
-  }
-
-  ascent = std::numeric_limits<double>::lowest();
-  descent = std::numeric_limits<double>::max();
-  advance_x = 0;
-  advance_y = 0;
-  left = std::numeric_limits<double>::max();
-  right = std::numeric_limits<double>::lowest();
-  bottom = std::numeric_limits<double>::max();
-  top = std::numeric_limits<double>::lowest();
+    const ShapedGlyph shaped{glyph_index,
+                             glyph_pos[idx].x_offset / scale, glyph_pos[idx].y_offset / scale,
+                             glyph_pos[idx].x_advance / scale, glyph_pos[idx].y_advance / scale};
+    result->glyphs.push_back(shaped);
 
-  for (const auto& glyph : glyph_array) {
     FT_BBox bbox;
-    FT_Glyph_Get_CBox(glyph.get_glyph(), FT_GLYPH_BBOX_GRIDFIT, &bbox);
+    FT_Glyph_Get_CBox(glyph, FT_GLYPH_BBOX_GRIDFIT, &bbox);
+    FT_Done_Glyph(glyph);
 
     // Note that glyphs can extend left of their origin
     // and right of their advance-width, into the next
@@ -415,64 +428,94 @@ FreetypeRenderer::ShapeResults::ShapeResults(
       ascent = std::max(ascent, bbox.yMax / scale);
       descent = std::min(descent, bbox.yMin / scale);
 
-      const double gxoff = glyph.get_x_offset();
-      const double gyoff = glyph.get_y_offset();
-
       left = std::min(left,
-                      advance_x + gxoff + bbox.xMin / scale);
+                      advance_x + shaped.x_offset + bbox.xMin / scale);
       right = std::max(right,
-                       advance_x + gxoff + bbox.xMax / scale);
+                       advance_x + shaped.x_offset + bbox.xMax / scale);
 
       top = std::max(top,
-                     advance_y + gyoff + bbox.yMax / scale);
+                     advance_y + shaped.y_offset + bbox.yMax / scale);
       bottom = std::min(bottom,
-                        advance_y + gyoff + bbox.yMin / scale);
+                        advance_y + shaped.y_offset + bbox.yMin / scale);
     }
 
-    advance_x += glyph.get_x_advance() * params.spacing;
-    advance_y += glyph.get_y_advance() * params.spacing;
+    advance_x += shaped.x_advance * params.spacing;
+    advance_y += shaped.y_advance * params.spacing;
   }
 
+  result->horizontal = HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buf));
+  result->advance_x = advance_x;
+  result->advance_y = advance_y;
   // Right and left start out reversed.  If any ink is ever
   // contributed they will flip.  If they're still reversed,
   // there was no ink.
   if (right >= left) {
-    if (HB_DIRECTION_IS_HORIZONTAL(
-          hb_buffer_get_direction(hb_buf))) {
-      calc_offsets_horiz(params);
-    } else {
-      calc_offsets_vert(params);
-    }
-  } else {
-    left = 0;
-    right = 0;
-    top = 0;
-    bottom = 0;
-    ascent = 0;
-    descent = 0;
-    x_offset = 0;
-    y_offset = 0;
+    result->has_ink = true;
+    result->left = left;
+    result->right = right;
+    result->top = top;
+    result->bottom = bottom;
+    result->ascent = ascent;
+    result->descent = descent;
   }
 
-  ok = true;
+  hb_buffer_destroy(hb_buf);
+  hb_font_destroy(hb_ft_font);
+  return result;
 }
 
-FreetypeRenderer::ShapeResults::~ShapeResults()
+FreetypeRenderer::ShapeResults::ShapeResults(
+  const FreetypeRenderer::Params& params)
 {
-  if (hb_buf != nullptr) {
-    hb_buffer_destroy(hb_buf);
-    hb_buf = nullptr;
+  face = params.get_font_face();
+  if (face == nullptr) {
+    return;
+  }
+
+  // Shaping doesn't depend on the size, so the size isn't part of the key
+  std::string key;
+  for (const auto *part : {&params.font, &params.text, &params.direction, &params.language, &params.script}) {
+    key += *part;
+    key += '\0';
+  }
+  key.append(reinterpret_cast<const char *>(&params.spacing), sizeof(params.spacing));
+
+  auto found = shaped_texts.find(key);
+  if (found != shaped_texts.end()) {
+    text = found->second;
+  } else {
+    bool cacheable = true;
+    text = shape(params, face, cacheable);
+    if (cacheable) {
+      if (shaped_texts.size() >= max_cached_texts) shaped_texts.clear();
+      shaped_texts.emplace(std::move(key), text);
+    }
   }
-  if (hb_ft_font != nullptr) {
-    hb_font_destroy(hb_ft_font);
-    hb_ft_font = nullptr;
+
+  advance_x = text->advance_x;
+  advance_y = text->advance_y;
+  if (text->has_ink) {
+    left = text->left;
+    right = text->right;
+    top = text->top;
+    bottom = text->bottom;
+    ascent = text->ascent;
+    descent = text->descent;
+    if (text->horizontal) {
+      calc_offsets_horiz(params);
+    } else {
+      calc_offsets_vert(params);
+    }
   }
+
+  ok = true;
 }
 
 FreetypeRenderer::FontMetrics::FontMetrics(
   const FreetypeRenderer::Params& params)
 {
   ok = false;
+  std::lock_guard<std::mutex> lock(FontCache::mutex);
 
   FT_Face face = params.get_font_face();
   if (face == nullptr) {
@@ -508,6 +551,7 @@ FreetypeRenderer::TextMetrics::TextMetrics(
 {
   ok = false;
 
+  std::lock_guard<std::mutex> lock(FontCache::mutex);
   ShapeResults sr(params);
 
   if (!sr.ok) {
@@ -547,8 +591,34 @@ FreetypeRenderer::TextMetrics::TextMetrics(
   ok = true;
 }
 
+std::shared_ptr<const Polygon2d> FreetypeRenderer::glyph_outlines(const std::string& font, FT_Face face,
+                                                                  FT_UInt index, unsigned int segments) const
+{
+  const auto key = std::make_tuple(font, index, segments);
+  auto found = glyphs.find(key);
+  if (found != glyphs.end()) return found->second;
+
+  std::shared_ptr<const Polygon2d> result;
+  FT_Glyph glyph;
+  if (!FT_Load_Glyph(face, index, FT_LOAD_DEFAULT) && !FT_Get_Glyph(face->glyph, &glyph)) {
+    // Drawn at size 1 without offset, so the vertices can be placed like the callback does
+    DrawingCallback callback(segments, 1.0);
+    callback.start_glyph();
+    FT_Outline outline = reinterpret_cast<FT_OutlineGlyph>(glyph)->outline;
+    FT_Outline_Decompose(&outline, &funcs, &callback);
+    callback.finish_glyph();
+    FT_Done_Glyph(glyph);
+    auto polygons = callback.get_result();
+    if (!polygons.empty()) result = polygons.front();
+  }
+  if (glyphs.size() >= max_cached_glyphs) glyphs.clear();
+  glyphs.emplace(key, result);
+  return result;
+}
+
 std::vector<std::shared_ptr<const Polygon2d>> FreetypeRenderer::render(const FreetypeRenderer::Params& params) const
 {
+  std::lock_guard<std::mutex> lock(FontCache::mutex);
   ShapeResults sr(params);
 
   if (!sr.ok) {
@@ -556,16 +626,17 @@ std::vector<std::shared_ptr<const Polygon2d>> FreetypeRenderer::render(const Fre
   }
 
   DrawingCallback callback(params.segments, params.size);
-  for (const auto& glyph : sr.glyph_array) {
+  for (const auto& glyph : sr.text->glyphs) {
     callback.start_glyph();
     callback.set_glyph_offset(
-      sr.x_offset + glyph.get_x_offset(),
-      sr.y_offset + glyph.get_y_offset());
-    FT_Outline outline = reinterpret_cast<FT_OutlineGlyph>(glyph.get_glyph())->outline;
-    FT_Outline_Decompose(&outline, &funcs, &callback);
+      sr.x_offset + glyph.x_offset,
+      sr.y_offset + glyph.y_offset);
+    if (const auto outlines = glyph_outlines(params.font, sr.face, glyph.index, params.segments)) {
+      callback.add_glyph(*outlines);
+    }
 
-    double adv_x = glyph.get_x_advance() * params.spacing;
-    double adv_y = glyph.get_y_advance() * params.spacing;
+    double adv_x = glyph.x_advance * params.spacing;
+    double adv_y = glyph.y_advance * params.spacing;
     callback.add_glyph_advance(adv_x, adv_y);
     callback.finish_glyph();
   }
@@ -25,8 +25,12 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <ostream>
 
@@ -37,6 +41,8 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 
+class Polygon2d;
+
 class FreetypeRenderer
 {
 public:
@@ -163,25 +169,29 @@ private:
   const static double scale;
   FT_Outline_Funcs funcs;
 
-  // The GlyphData assumes responsibility for "glyph" and will ensure
-  // that it is freed when the GlyphData is destroyed.
-  // However, glyph_pos points to data that the caller must ensure
-  // remains valid until the GlyphData is destroyed.
-  class GlyphData
-  {
-public:
-    GlyphData(FT_Glyph glyph, unsigned int idx, hb_glyph_position_t *glyph_pos) : glyph(glyph), idx(idx), glyph_pos(glyph_pos) {}
-    [[nodiscard]] unsigned int get_idx() const { return idx; }
-    [[nodiscard]] FT_Glyph get_glyph() const { return glyph; }
-    [[nodiscard]] double get_x_offset() const { return glyph_pos->x_offset / scale; }
-    [[nodiscard]] double get_y_offset() const { return glyph_pos->y_offset / scale; }
-    [[nodiscard]] double get_x_advance() const { return glyph_pos->x_advance / scale; }
-    [[nodiscard]] double get_y_advance() const { return glyph_pos->y_advance / scale; }
-    ~GlyphData() { FT_Done_Glyph(glyph); }
-private:
-    FT_Glyph glyph;
-    unsigned int idx;
-    hb_glyph_position_t *glyph_pos;
+  // A glyph of a shaped text. The values are in fractions of the size.
+  struct ShapedGlyph {
+    FT_UInt index; // in the font face
+    double x_offset;
+    double y_offset;
+    double x_advance;
+    double y_advance;
+  };
+
+  // The result of shaping a text, which doesn't depend on its size or alignment
+  struct ShapedText {
+    std::vector<ShapedGlyph> glyphs;
+    bool horizontal{true};
+    // Ink extents, advance and ascent/descent of the whole text; zero without ink
+    bool has_ink{false};
+    double left{0.0};
+    double right{0.0};
+    double top{0.0};
+    double bottom{0.0};
+    double advance_x{0.0};
+    double advance_y{0.0};
+    double ascent{0.0};
+    double descent{0.0};
   };
 
   class ShapeResults
@@ -192,7 +202,8 @@ public:
     // They have been downscaled from the 1e+5 unit size used for
     // when rendering from Freetype, and have not yet been scaled
     // back up to the desired font size.
-    std::vector<GlyphData> glyph_array;
+    FT_Face face{nullptr};
+    std::shared_ptr<const ShapedText> text;
     double x_offset{0.0};
     double y_offset{0.0};
     double left{0.0};
@@ -204,14 +215,23 @@ public:
     double ascent{0.0};
     double descent{0.0};
     ShapeResults(const FreetypeRenderer::Params& params);
-    virtual ~ShapeResults();
 private:
     void calc_offsets_horiz(const FreetypeRenderer::Params& params);
     void calc_offsets_vert(const FreetypeRenderer::Params& params);
-    hb_font_t *hb_ft_font{nullptr};
-    hb_buffer_t *hb_buf{nullptr};
   };
 
+  // Shapes the text of params with HarfBuzz. Sets cacheable to false if there were warnings.
+  static std::shared_ptr<const ShapedText> shape(const FreetypeRenderer::Params& params, FT_Face face, bool& cacheable);
+  // The outlines of a glyph flattened with the given number of segments per curve, at size 1
+  std::shared_ptr<const Polygon2d> glyph_outlines(const std::string& font, FT_Face face, FT_UInt index, unsigned int segments) const;
+
+  // Shaped texts and flattened glyphs of earlier calls, by font name like the FontCache.
+  // Guarded by FontCache::mutex.
+  static std::unordered_map<std::string, std::shared_ptr<const ShapedText>> shaped_texts;
+  static std::map<std::tuple<std::string, FT_UInt, unsigned int>, std::shared_ptr<const Polygon2d>> glyphs;
+  const static size_t max_cached_texts;
+  const static size_t max_cached_glyphs;
+
   static int outline_move_to_func(const FT_Vector *to, void *user);
   static int outline_line_to_func(const FT_Vector *to, void *user);
   static int outline_conic_to_func(const FT_Vector *c1, const FT_Vector *to, void *user);
@@ -0,0 +1,193 @@
+#include "core/FunctionMemo.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/functional/hash.hpp>
+
+#include "Feature.h"
+#include "utils/printutils.h"
+
+namespace {
+
+void hashDouble(double d, size_t& seed)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  boost::hash_combine(seed, bits);
+}
+
+bool sameDouble(double a, double b)
+{
+  return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// Returns false for values calls can't be identified by
+bool hashValue(const Value& value, size_t& seed)
+{
+  boost::hash_combine(seed, static_cast<int>(value.type()));
+  switch (value.type()) {
+  case Value::Type::UNDEFINED:
+    return true;
+  case Value::Type::BOOL:
+    boost::hash_combine(seed, value.toBool());
+    return true;
+  case Value::Type::NUMBER:
+    hashDouble(value.toDouble(), seed);
+    return true;
+  case Value::Type::STRING:
+    boost::hash_combine(seed, value.toStrUtf8Wrapper().toString());
+    return true;
+  case Value::Type::VECTOR: {
+    const auto& vec = value.toVector();
+    boost::hash_combine(seed, vec.size());
+    if (vec.size() > FunctionMemo::small_vector) {
+      boost::hash_combine(seed, vec.ptr.get());
+    } else if (const auto *numbers = vec.numbers()) {
+      for (double d : *numbers) hashDouble(d, seed);
+    } else {
+      for (const auto& element : vec) {
+        if (!hashValue(element, seed)) return false;
+      }
+    }
+    return true;
+  }
+  case Value::Type::RANGE: {
+    const auto& range = value.toRange();
+    hashDouble(range.begin_value(), seed);
+    hashDouble(range.step_value(), seed);
+    hashDouble(range.end_value(), seed);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool identical(const Value& a, const Value& b)
+{
+  if (a.type() != b.type()) return false;
+  switch (a.type()) {
+  case Value::Type::UNDEFINED:
+    return true;
+  case Value::Type::BOOL:
+    return a.toBool() == b.toBool();
+  case Value::Type::NUMBER:
+    return sameDouble(a.toDouble(), b.toDouble());
+  case Value::Type::STRING:
+    return a.toStrUtf8Wrapper().toString() == b.toStrUtf8Wrapper().toString();
+  case Value::Type::VECTOR: {
+    const auto& va = a.toVector();
+    const auto& vb = b.toVector();
+    if (va.ptr == vb.ptr) return true;
+    if (va.size() != vb.size() || va.size() > FunctionMemo::small_vector) return false;
+    const auto *na = va.numbers();
+    const auto *nb = vb.numbers();
+    if (na && nb) {
+      return na->empty() || std::memcmp(na->data(), nb->data(), na->size() * sizeof(double)) == 0;
+    }
+    VectorType::iterator element = vb.begin();
+    for (const auto& value : va) {
+      if (!identical(value, *element)) return false;
+      ++element;
+    }
+    return true;
+  }
+  case Value::Type::RANGE: {
+    const auto& ra = a.toRange();
+    const auto& rb = b.toRange();
+    return sameDouble(ra.begin_value(), rb.begin_value()) && sameDouble(ra.step_value(), rb.step_value()) &&
+           sameDouble(ra.end_value(), rb.end_value());
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+FunctionMemo::FunctionMemo() : enabled(Feature::ExperimentalMemoize.is_enabled())
+{
+}
+
+FunctionMemo::Position FunctionMemo::find(Table& table, const Context *defining, const std::vector<Value>& arguments, size_t hash)
+{
+  auto range = table.index.equal_range(hash);
+  for (auto position = range.first; position != range.second; ++position) {
+    const Entry& entry = *position->second;
+    if (entry.defining != defining || entry.arguments.size() != arguments.size()) continue;
+    bool same = true;
+    for (size_t i = 0; same && i < arguments.size(); ++i) {
+      same = identical(entry.arguments[i], arguments[i]);
+    }
+    if (same) return position;
+  }
+  return table.index.end();
+}
+
+boost::optional<Value> FunctionMemo::lookup(const UserFunction& function, const std::shared_ptr<const Context>& defining_context,
+                                            std::vector<Value>&& arguments, boost::optional<Call>& pending)
+{
+  size_t hash = 0;
+  boost::hash_combine(hash, defining_context.get());
+  for (const auto& argument : arguments) {
+    if (!hashValue(argument, hash)) return boost::none;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    Table& table = tables[&function];
+    auto position = find(table, defining_context.get(), arguments, hash);
+    if (position != table.index.end()) {
+      ++hits;
+      table.entries.splice(table.entries.begin(), table.entries, position->second);
+      return position->second->result.clone();
+    }
+    ++misses;
+  }
+  if (!pending) {
+    pending.emplace(Call{&function, defining_context, std::move(arguments), hash, taints.load(std::memory_order_relaxed)});
+  }
+  return boost::none;
+}
+
+void FunctionMemo::store(Call&& call, const Value& result)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (taints.load(std::memory_order_relaxed) != call.taints) {
+    ++tainted;
+    return;
+  }
+  Table& table = tables[call.function];
+  // Another worker may have stored the same call meanwhile
+  if (find(table, call.defining_context.get(), call.arguments, call.hash) != table.index.end()) return;
+
+  const Context *defining = call.defining_context.get();
+  table.entries.push_front(Entry{std::move(call.defining_context), defining, std::move(call.arguments), call.hash, result.clone()});
+  table.index.emplace(call.hash, table.entries.begin());
+
+  if (table.entries.size() > max_entries) {
+    auto last = std::prev(table.entries.end());
+    auto range = table.index.equal_range(last->hash);
+    for (auto position = range.first; position != range.second; ++position) {
+      if (position->second == last) {
+        table.index.erase(position);
+        break;
+      }
+    }
+    table.entries.pop_back();
+    ++evictions;
+  }
+}
+
+void FunctionMemo::printStatistics() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!enabled || hits + misses == 0) return;
+  LOG("Memoized function calls: %1$d hits, %2$d misses, %3$d results tainted, %4$d evicted", hits, misses, tainted, evictions);
+}
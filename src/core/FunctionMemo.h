@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <boost/optional.hpp>
+
+#include "core/function.h"
+#include "core/Value.h"
+
+class Context;
+
+/*!
+   Results of calls of pure user functions in an EvaluationSession, kept
+   with the experimental "memoize" feature.
+
+   A call is identified by the function, its defining context and the values
+   of its parameters. Numbers are compared bit for bit, so 0 and -0 differ.
+   Vectors of up to small_vector elements are compared by content, larger
+   ones by identity, so identifying a call never walks big data structures.
+   Calls with function or object arguments aren't memoized.
+
+   Pure functions are found by the ScopeResolver, which doesn't follow calls
+   of other user functions. Those are guarded at runtime: reading a special
+   variable, echo() or builtins such as rands() taint the calls in progress,
+   whose results then aren't stored. Warnings are printed only by the
+   evaluation whose result got stored.
+
+   Each function keeps at most max_entries results, dropping the least
+   recently used ones.
+ */
+class FunctionMemo
+{
+public:
+  // A call in progress, whose result can be stored once known
+  struct Call {
+    const UserFunction *function;
+    std::shared_ptr<const Context> defining_context;
+    std::vector<Value> arguments;
+    size_t hash;
+    uint64_t taints; // taint count when the call started
+  };
+
+  FunctionMemo();
+
+  [[nodiscard]] bool memoizes(const UserFunction& function) const { return enabled && function.pure; }
+
+  // Marks the results of the calls in progress as depending on more than their arguments
+  void taint() const {
+    if (enabled) taints.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /*
+   * Looks up a call of function with arguments, the values of its
+   * parameters. Returns the result of an identical earlier call. Otherwise,
+   * unless pending is set already, sets it to the call for store().
+   */
+  boost::optional<Value> lookup(const UserFunction& function, const std::shared_ptr<const Context>& defining_context,
+                                std::vector<Value>&& arguments, boost::optional<Call>& pending);
+  // Keeps the result of call, unless something tainted it since lookup()
+  void store(Call&& call, const Value& result);
+
+  void printStatistics() const;
+
+  static constexpr size_t max_entries = 65536;
+  static constexpr size_t small_vector = 16;
+
+private:
+  struct Entry {
+    // Pins the memory of the defining context, so its address can't identify another one
+    std::weak_ptr<const Context> defining_context;
+    const Context *defining;
+    std::vector<Value> arguments;
+    size_t hash;
+    Value result;
+  };
+  struct Table {
+    std::list<Entry> entries; // most recently used first
+    std::unordered_multimap<size_t, std::list<Entry>::iterator> index; // by hash
+  };
+  using Position = std::unordered_multimap<size_t, std::list<Entry>::iterator>::iterator;
+
+  Position find(Table& table, const Context *defining, const std::vector<Value>& arguments, size_t hash);
+
+  bool enabled;
+  mutable std::atomic<uint64_t> taints{0};
+  mutable std::mutex mutex;
+  std::unordered_map<const UserFunction *, Table> tables;
+  size_t hits{0};
+  size_t misses{0};
+  size_t tainted{0};
+  size_t evictions{0};
+};
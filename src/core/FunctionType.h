@@ -8,13 +8,14 @@
 
 class Context;
 class Expression;
+class LexicalScope;
 class Value;
 
 class FunctionType
 {
 public:
-  FunctionType(std::shared_ptr<const Context> context, std::shared_ptr<Expression> expr, std::shared_ptr<AssignmentList> parameters)
-    : context(std::move(context)), expr(std::move(expr)), parameters(std::move(parameters)) { }
+  FunctionType(std::shared_ptr<const Context> context, std::shared_ptr<Expression> expr, std::shared_ptr<AssignmentList> parameters, const LexicalScope *scope = nullptr)
+    : context(std::move(context)), expr(std::move(expr)), parameters(std::move(parameters)), scope(scope) { }
   Value operator==(const FunctionType& other) const;
   Value operator!=(const FunctionType& other) const;
   Value operator<(const FunctionType& other) const;
@@ -25,10 +26,13 @@ public:
   [[nodiscard]] const std::shared_ptr<const Context>& getContext() const { return context; }
   [[nodiscard]] const std::shared_ptr<Expression>& getExpr() const { return expr; }
   [[nodiscard]] const std::shared_ptr<AssignmentList>& getParameters() const { return parameters; }
+  // Scope of the call frame, owned by the defining FunctionDefinition
+  [[nodiscard]] const LexicalScope *getScope() const { return scope; }
 private:
   std::shared_ptr<const Context> context;
   std::shared_ptr<Expression> expr;
   std::shared_ptr<AssignmentList> parameters;
+  const LexicalScope *scope;
 };
 
 std::ostream& operator<<(std::ostream& stream, const FunctionType& f);
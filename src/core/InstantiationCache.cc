@@ -0,0 +1,279 @@
+#include "core/InstantiationCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "core/AST.h"
+#include "core/Context.h"
+#include "core/ModuleInstantiation.h"
+#include "core/NodeHash.h"
+#include "core/ScopeContext.h"
+#include "core/SourceFile.h"
+#include "core/SourceFileCache.h"
+#include "core/UserModule.h"
+#include "core/function.h"
+#include "core/node.h"
+#include "utils/exceptions.h"
+#include "utils/printutils.h"
+
+namespace {
+
+// Names whose calls make a statement depend on more than its text
+bool volatile_name(const std::string& name)
+{
+  return name == "rands" || name == "import" || name == "surface" || name == "dxf_dim" || name == "dxf_cross";
+}
+
+/*
+ * Hashes the parts of a syntax tree that affect the nodes made from it, and
+ * collects the names they mention. Names are collected from the printed
+ * text, which may find too many, e.g. in strings, but never too few.
+ */
+class Fingerprint
+{
+public:
+  void text(const std::string& text) {
+    hash.update(text);
+    hash.update('\0');
+    for (size_t i = 0; i < text.size();) {
+      const auto c = static_cast<unsigned char>(text[i]);
+      if (std::isalpha(c) || c == '_' || c == '$') {
+        size_t end = i + 1;
+        while (end < text.size() && (std::isalnum(static_cast<unsigned char>(text[end])) || text[end] == '_')) ++end;
+        names.insert(text.substr(i, end - i));
+        i = end;
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  void location(const Location& loc) {
+    std::ostringstream stream;
+    stream << loc.fileName() << ':' << loc.firstLine() << ':' << loc.firstColumn() << '-' << loc.lastLine() << ':' << loc.lastColumn();
+    hash.update(stream.str());
+  }
+
+  template <typename Node>
+  void print(const Node& node) {
+    std::ostringstream stream;
+    node.print(stream, "");
+    text(stream.str());
+  }
+
+  // ModuleInstantiation::print() leaves out modifiers, so instantiations are walked here
+  void instantiation(const ModuleInstantiation& instantiation) {
+    location(instantiation.location());
+    hash.update(instantiation.isRoot() ? '!' : '-');
+    hash.update(instantiation.isHighlight() ? '#' : '-');
+    hash.update(instantiation.isBackground() ? '%' : '-');
+    std::ostringstream stream;
+    stream << instantiation.name() << "(" << instantiation.arguments << ")";
+    text(stream.str());
+    scope(instantiation.scope);
+    if (const auto *ifelse = dynamic_cast<const IfElseModuleInstantiation *>(&instantiation)) {
+      hash.update(ifelse->getElseScope() ? "else" : "");
+      if (ifelse->getElseScope()) scope(*ifelse->getElseScope());
+    }
+  }
+
+  void scope(const LocalScope& scope) {
+    hash.update('{');
+    for (const auto& assignment : scope.assignments) print(*assignment);
+    for (const auto& function : scope.astFunctions) print(*function.second);
+    for (const auto& module : scope.astModules) this->module(*module.second);
+    for (const auto& instantiation : scope.moduleInstantiations) this->instantiation(*instantiation);
+    hash.update('}');
+  }
+
+  void module(const UserModule& module) {
+    location(module.location());
+    std::ostringstream stream;
+    stream << "module " << module.name << "(" << module.parameters << ")";
+    text(stream.str());
+    scope(module.body);
+  }
+
+  NodeHashBuilder hash;
+  std::set<std::string> names;
+};
+
+} // namespace
+
+void InstantiationCache::retire(SourceFile *file)
+{
+  if (!file) return;
+  retired.emplace_back(file);
+  release();
+}
+
+void InstantiationCache::clear()
+{
+  entries.clear();
+  library_parses.clear();
+  retired.clear();
+}
+
+void InstantiationCache::release()
+{
+  std::unordered_set<const SourceFile *> used;
+  for (const auto& entry : entries) used.insert(entry.second.file);
+  retired.erase(std::remove_if(retired.begin(), retired.end(), [&used](const std::unique_ptr<SourceFile>& file) {
+    return used.count(file.get()) == 0;
+  }), retired.end());
+}
+
+std::shared_ptr<AbstractNode> InstantiationCache::instantiate(const SourceFile *file, const std::shared_ptr<const Context>& context,
+                                                              std::shared_ptr<const FileContext> *resulting_file_context)
+{
+  if (OpenSCAD::hardwarnings) {
+    // Messages are only printed after each statement, too late to stop at the first warning
+    clear();
+    AbstractNode::resetIndexCounter();
+    return file->instantiate(context, resulting_file_context);
+  }
+
+  // What every statement depends on
+  Fingerprint global;
+  for (const Value *value : context->list_embedded_values()) global.text(value->toEchoString());
+  std::set<const SourceFile *> libraries;
+  std::map<std::string, unsigned long> parses;
+  std::vector<const SourceFile *> pending{file};
+  while (!pending.empty()) {
+    const SourceFile *current = pending.back();
+    pending.pop_back();
+    for (const auto& filename : current->usedlibs) {
+      const SourceFile *library = SourceFileCache::instance()->lookup(filename);
+      global.text(filename);
+      if (!library || !libraries.insert(library).second) continue;
+      parses[filename] = SourceFileCache::instance()->parseCount(filename);
+      global.print(*library);
+      pending.push_back(library);
+    }
+  }
+  // A parsed again library may be at the address of the deleted one, which cached nodes still point into
+  if (parses != library_parses) {
+    entries.clear();
+    release();
+    library_parses = std::move(parses);
+  }
+
+  const LocalScope& scope = file->scope;
+  std::unordered_multimap<std::string, const Assignment *> assignments;
+  for (const auto& assignment : scope.assignments) {
+    assignments.emplace(assignment->getName(), assignment.get());
+    if (ContextFrame::is_config_variable(assignment->getName())) {
+      global.location(assignment->location());
+      global.print(*assignment);
+    }
+  }
+  const NodeHash global_hash = global.hash.digest();
+
+  if (entries.empty()) next_index = 1;
+  AbstractNode::resetIndexCounter(next_index);
+
+  auto root = std::make_shared<RootNode>();
+  std::unordered_map<std::string, Entry> made;
+  std::unordered_map<std::string, size_t> occurrences;
+  size_t reused = 0;
+  try {
+    ContextHandle<FileContext> file_context{Context::create<FileContext>(context, file)};
+    *resulting_file_context = *file_context;
+
+    for (const auto& instantiation : scope.moduleInstantiations) {
+      Fingerprint fingerprint;
+      fingerprint.hash.update(global_hash);
+      fingerprint.instantiation(*instantiation);
+
+      // Adds the top-level definitions of the names mentioned, until no new ones are found
+      std::set<std::string> done;
+      bool cacheable = true;
+      while (cacheable && done.size() < fingerprint.names.size()) {
+        std::vector<std::string> names;
+        std::set_difference(fingerprint.names.begin(), fingerprint.names.end(), done.begin(), done.end(), std::back_inserter(names));
+        for (const auto& name : names) {
+          done.insert(name);
+          if (volatile_name(name)) cacheable = false;
+          auto range = assignments.equal_range(name);
+          for (auto it = range.first; it != range.second; ++it) {
+            fingerprint.location(it->second->location());
+            fingerprint.print(*it->second);
+          }
+          auto function = scope.functions.find(name);
+          if (function != scope.functions.end()) {
+            fingerprint.location(function->second->location());
+            fingerprint.print(*function->second);
+          }
+          auto module = scope.modules.find(name);
+          if (module != scope.modules.end()) fingerprint.module(*module->second);
+        }
+      }
+
+      if (!cacheable) {
+        auto node = instantiation->evaluate(*file_context);
+        if (node) root->children.push_back(node);
+        continue;
+      }
+
+      // Identical statements get separate entries, so each has its own nodes
+      std::string key = fingerprint.hash.digest().toString();
+      key += "#" + std::to_string(occurrences[key]++);
+
+      auto found = entries.find(key);
+      if (found != entries.end()) {
+        Entry& entry = found->second;
+        if (entry.node) root->children.push_back(entry.node);
+        LOG(std::vector<Message>(entry.messages));
+        made.emplace(std::move(key), std::move(entry));
+        entries.erase(found);
+        ++reused;
+        continue;
+      }
+
+      Entry entry{nullptr, {}, file};
+      std::exception_ptr error;
+      {
+        MessageCapture capture;
+        try {
+          entry.node = instantiation->evaluate(*file_context);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        entry.messages = capture.take();
+      }
+      LOG(std::vector<Message>(entry.messages));
+      if (error) std::rethrow_exception(error);
+      if (entry.node) root->children.push_back(entry.node);
+      made.emplace(std::move(key), std::move(entry));
+    }
+  } catch (HardWarningException& e) {
+    for (auto& entry : made) entries.insert(std::move(entry));
+    throw;
+  } catch (EvaluationException& e) {
+    // Keeps what was reused, for the next attempt
+    for (auto& entry : made) entries.insert(std::move(entry));
+    *resulting_file_context = nullptr;
+    next_index = AbstractNode::nextIndex();
+    return root;
+  }
+
+  if (!scope.moduleInstantiations.empty()) {
+    LOG("Reused %1$d of %2$d top-level statements", reused, scope.moduleInstantiations.size());
+  }
+  entries = std::move(made);
+  next_index = AbstractNode::nextIndex();
+  release();
+  return root;
+}
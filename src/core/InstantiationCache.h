@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/printutils.h"
+
+class AbstractNode;
+class Context;
+class FileContext;
+class SourceFile;
+
+/*!
+   Reuses the nodes of top-level module instantiations when an edited file
+   is evaluated again, with the experimental "incremental-instantiation"
+   feature.
+
+   A top-level statement depends on the top-level assignments, functions and
+   modules named in it, transitively, on all top-level assignments of special
+   variables, on the special variables of the calling context and on the used
+   libraries. If none of these changed, including their positions in the
+   file, the node subtree made by the previous evaluation is reused as it is,
+   keeping its node indices, and the messages printed while making it are
+   printed again. Statements calling rands() or reading files are always
+   instantiated anew.
+
+   Reused nodes point into the syntax tree they were made from, so previous
+   SourceFiles are kept alive while nodes made from them are cached. Used
+   libraries are owned by the SourceFileCache, which deletes them when they
+   are parsed again, so then all entries are dropped.
+ */
+class InstantiationCache
+{
+public:
+  InstantiationCache() = default;
+  InstantiationCache(const InstantiationCache&) = delete;
+  InstantiationCache& operator=(const InstantiationCache&) = delete;
+
+  // Takes ownership of a SourceFile that has been replaced by a new parse
+  void retire(SourceFile *file);
+
+  /*
+   * Instantiates the top-level statements of file like
+   * SourceFile::instantiate(), reusing the nodes of unchanged ones from the
+   * previous call.
+   */
+  std::shared_ptr<AbstractNode> instantiate(const SourceFile *file, const std::shared_ptr<const Context>& context,
+                                            std::shared_ptr<const FileContext> *resulting_file_context);
+
+  void clear();
+
+private:
+  struct Entry {
+    std::shared_ptr<AbstractNode> node; // null if the statement made no node
+    std::vector<Message> messages;
+    const SourceFile *file; // the syntax tree the nodes point into
+  };
+
+  // Deletes the retired files no entry refers to
+  void release();
+
+  std::unordered_map<std::string, Entry> entries; // by fingerprint of the statement and its dependencies
+  std::vector<std::unique_ptr<SourceFile>> retired;
+  std::map<std::string, unsigned long> library_parses; // SourceFileCache::parseCount() of the used libraries
+  size_t next_index{1};
+};
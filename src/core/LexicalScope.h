@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "core/Assignment.h"
+
+/*!
+   The variables introduced by a let(), a for() or a function call, as far as
+   they are known after parsing.
+
+   A context created for such a construct stores the variables named by its
+   scope in slots indexed by their position in the scope, rather than in its
+   ValueMap. Special ($) variables never get a slot.
+ */
+class LexicalScope
+{
+public:
+  LexicalScope() = default;
+  explicit LexicalScope(const AssignmentList& assignments) {
+    for (const auto& assignment : assignments) add(assignment->getName());
+  }
+
+  // Adds a variable name, ignoring duplicates and special variables
+  void add(const std::string& name) {
+    if (name.empty() || (name[0] == '$' && name != "$children") || find(name) >= 0) return;
+    names.push_back(name);
+  }
+
+  // Returns the slot of the given variable, or -1
+  [[nodiscard]] int find(const std::string& name) const {
+    for (size_t i = 0; i < names.size(); ++i) {
+      if (names[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+  }
+
+  [[nodiscard]] size_t size() const { return names.size(); }
+  [[nodiscard]] const std::string& name(size_t slot) const { return names[slot]; }
+
+private:
+  std::vector<std::string> names;
+};
@@ -8,6 +8,8 @@
 #include "utils/compiler_specific.h"
 #include "core/Context.h"
 #include "core/Expression.h"
+#include "core/NodeDumper.h"
+#include "Profiler.h"
 #include "utils/exceptions.h"
 #include "utils/printutils.h"
 
@@ -72,7 +74,9 @@ std::shared_ptr<AbstractNode> ModuleInstantiation::evaluate(const std::shared_pt
   }
 
   try{
+    Profiler::Scope profile(this->name(), this->loc);
     auto node = module->module->instantiate(module->defining_context, this, context);
+    if (node) NodeHasher::hashInstantiated(*node);
     return node;
   } catch (EvaluationException& e) {
     if (e.traceDepth > 0) {
@@ -6,7 +6,63 @@
 #include <ostream>
 #include <string>
 #include <sstream>
-#include <boost/regex.hpp>
+#include <cctype>
+#include <cstddef>
+#include <utility>
+
+namespace {
+
+// Removes all whitespace outside of string literals. An unterminated quote is dropped.
+std::string stripWhitespace(const std::string& str)
+{
+  std::string result;
+  result.reserve(str.size());
+  size_t i = 0;
+  while (i < str.size()) {
+    const char c = str[i];
+    if (c == '"') {
+      size_t end = i + 1;
+      while (end < str.size() && str[end] != '"') {
+        end += (str[end] == '\\' && end + 1 < str.size()) ? 2 : 1;
+      }
+      if (end < str.size()) {
+        result.append(str, i, end + 1 - i);
+        i = end + 1;
+      } else {
+        ++i;
+      }
+    } else {
+      if (!std::isspace(static_cast<unsigned char>(c))) result += c;
+      ++i;
+    }
+  }
+  return result;
+}
+
+std::string modifierPrefix(const AbstractNode& node, const State& state)
+{
+  std::string prefix;
+  // ListNodes can pass down modifiers to children via state, so check both modinst and state
+  if (node.modinst->isBackground() || state.isBackground()) prefix += "%";
+  if (node.modinst->isHighlight() || state.isHighlight()) prefix += "#";
+  return prefix;
+}
+
+// Hashes a node's own text together with the hashes of its non-empty children
+NodeHash combineHashes(const std::string& text, const std::vector<NodeHash>& children, const char *suffix, bool& empty)
+{
+  const bool passthrough = text.empty() && *suffix == '\0';
+  // Empty nodes contribute nothing to their parent, just like in ID strings
+  empty = passthrough && children.empty();
+  if (passthrough && children.size() == 1) return children.front();
+  NodeHashBuilder builder;
+  builder.update(text);
+  for (const auto& child : children) builder.update(child);
+  builder.update(suffix, std::char_traits<char>::length(suffix));
+  return builder.digest();
+}
+
+} // namespace
 
 
 void GroupNodeChecker::incChildCount(int groupNodeIndex) {
@@ -151,10 +207,7 @@ Response NodeDumper::visit(State& state, const AbstractNode& node)
 
     if (this->idString) {
 
-      static const boost::regex re(R"([^\s\"]+|\"(?:[^\"\\]|\\.)*\")");
-      const auto name = STR(node);
-      boost::sregex_token_iterator it(name.begin(), name.end(), re, 0);
-      std::copy(it, boost::sregex_token_iterator(), std::ostream_iterator<std::string>(this->dumpstream));
+      this->dumpstream << stripWhitespace(STR(node));
 
       if (node.getChildren().size() > 0) {
         this->dumpstream << "{";
@@ -249,3 +302,165 @@ Response NodeDumper::visit(State& state, const RootNode& node)
 
   return Response::ContinueTraversal;
 }
+
+/*!
+   \class NodeHasher
+
+   A visitor computing the structural hash of every node in a tree. Each node
+   gets a frame collecting its own text and the digests of its children.
+   Nodes without text of their own (lists, single-child groups) pass the digest of
+   a single child through unchanged, so they share cache entries with that
+   child, as they do with ID strings.
+
+   Hashes are computed bottom-up as instantiation completes each node, see
+   hashInstantiated(), so the visitor mostly just collects them. Only nodes
+   built outside of module instantiation (e.g. the root) and subtrees with
+   modifiers passed down from a ListNode are hashed when visited.
+ */
+
+/*!
+   Stores the hash of a node's subtree in the node, as the visitor would compute
+   it with no modifiers passed down from above. Called when the instantiation of
+   the node is complete, so its children already have theirs. Subtrees reused by
+   the InstantiationCache keep their hashes, and the text of each node is
+   hashed only once.
+ */
+void NodeHasher::hashInstantiated(AbstractNode& node)
+{
+  const bool list = dynamic_cast<const ListNode *>(&node) != nullptr;
+  // Modifiers passed down to the children change their hashes
+  if (list && (node.modinst->isBackground() || node.modinst->isHighlight())) return;
+
+  std::vector<NodeHash> children;
+  int groupChildren = 0;
+  for (const auto& child : node.children) {
+    if (!child->subtree_hash) return;
+    if (!child->subtree_hash->empty) children.push_back(child->subtree_hash->hash);
+    if (child->subtree_hash->counted) ++groupChildren;
+  }
+
+  // Same texts as the visit() functions below
+  const State nostate(nullptr);
+  std::string text;
+  const char *suffix = "";
+  bool counted = true;
+  if (dynamic_cast<const RootNode *>(&node)) {
+    counted = groupChildren > 0;
+  } else if (dynamic_cast<const GroupNode *>(&node)) {
+    counted = groupChildren > 0;
+    text = modifierPrefix(node, nostate);
+    if (groupChildren > 1) {
+      text += STR(node) + "{";
+      suffix = "}";
+    }
+  } else if (!list) {
+    text = modifierPrefix(node, nostate) + stripWhitespace(STR(node));
+    if (!node.children.empty()) text += "{";
+    suffix = node.children.empty() ? ";" : "}";
+  }
+
+  bool empty;
+  const NodeHash hash = combineHashes(text, children, suffix, empty);
+  node.subtree_hash = AbstractNode::SubtreeHash{hash, empty, counted};
+}
+
+// Whether the hash stored by hashInstantiated() holds, i.e. no modifiers are passed down to the node
+bool NodeHasher::precomputed(const AbstractNode& node, const State& state) const
+{
+  return node.subtree_hash && !state.isBackground() && !state.isHighlight();
+}
+
+// Records the stored hashes of a subtree, instead of visiting it
+void NodeHasher::usePrecomputed(const AbstractNode& node)
+{
+  record(node);
+  if (!node.subtree_hash->empty && !this->stack.empty()) {
+    this->stack.back().children.push_back(node.subtree_hash->hash);
+  }
+}
+
+void NodeHasher::record(const AbstractNode& node)
+{
+  this->hashes[node.index()] = node.subtree_hash->hash;
+  for (const auto& child : node.children) record(*child);
+}
+
+void NodeHasher::enter(std::string text)
+{
+  this->stack.push_back({std::move(text), {}});
+}
+
+void NodeHasher::leave(const AbstractNode& node, const char *suffix)
+{
+  Frame frame = std::move(this->stack.back());
+  this->stack.pop_back();
+
+  bool empty;
+  const NodeHash hash = combineHashes(frame.text, frame.children, suffix, empty);
+  this->hashes[node.index()] = hash;
+  if (!empty && !this->stack.empty()) this->stack.back().children.push_back(hash);
+}
+
+Response NodeHasher::visit(State& state, const AbstractNode& node)
+{
+  if (precomputed(node, state)) {
+    if (state.isPrefix()) usePrecomputed(node);
+    return Response::PruneTraversal;
+  }
+  if (state.isPrefix()) {
+    std::string text = modifierPrefix(node, state) + stripWhitespace(STR(node));
+    if (!node.getChildren().empty()) text += "{";
+    enter(std::move(text));
+  } else if (state.isPostfix()) {
+    leave(node, node.getChildren().empty() ? ";" : "}");
+  }
+  return Response::ContinueTraversal;
+}
+
+Response NodeHasher::visit(State& state, const GroupNode& node)
+{
+  if (precomputed(node, state)) {
+    if (state.isPrefix()) usePrecomputed(node);
+    return Response::PruneTraversal;
+  }
+  const bool hasGroupText = this->groupChecker.getChildCount(node.index()) > 1;
+  if (state.isPrefix()) {
+    std::string text = modifierPrefix(node, state);
+    if (hasGroupText) text += STR(node) + "{";
+    enter(std::move(text));
+  } else if (state.isPostfix()) {
+    leave(node, hasGroupText ? "}" : "");
+  }
+  return Response::ContinueTraversal;
+}
+
+Response NodeHasher::visit(State& state, const ListNode& node)
+{
+  if (precomputed(node, state)) {
+    if (state.isPrefix()) usePrecomputed(node);
+    return Response::PruneTraversal;
+  }
+  if (state.isPrefix()) {
+    // pass modifiers down to children via state
+    if (node.modinst->isHighlight()) state.setHighlight(true);
+    if (node.modinst->isBackground()) state.setBackground(true);
+    enter({});
+  } else if (state.isPostfix()) {
+    leave(node, "");
+  }
+  return Response::ContinueTraversal;
+}
+
+Response NodeHasher::visit(State& state, const RootNode& node)
+{
+  if (precomputed(node, state)) {
+    if (state.isPrefix()) usePrecomputed(node);
+    return Response::PruneTraversal;
+  }
+  if (state.isPrefix()) {
+    enter({});
+  } else if (state.isPostfix()) {
+    leave(node, "");
+  }
+  return Response::ContinueTraversal;
+}
@@ -5,9 +5,11 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include "core/NodeVisitor.h"
 #include "core/node.h"
 #include "core/NodeCache.h"
+#include "core/NodeHash.h"
 
 // GroupNodeChecker does a quick first pass to count children of group nodes
 // If a GroupNode has 0 children, don't include in node id strings
@@ -63,3 +65,42 @@ private:
 };
 
 
+
+/*!
+   Computes a Merkle-style structural hash for every node of a tree in a
+   single pass. The hash of a node covers the same information as its
+   NodeDumper ID string (whitespace-stripped node text, modifiers, collapsed
+   group nodes), but child subtrees are folded in by their digest instead of
+   their text.
+ */
+class NodeHasher : public NodeVisitor
+{
+public:
+  NodeHasher(std::unordered_map<size_t, NodeHash>& hashes, std::shared_ptr<const AbstractNode> root_node) :
+    hashes(hashes), root(std::move(root_node)) {
+    groupChecker.traverse(*root);
+  }
+
+  static void hashInstantiated(AbstractNode& node);
+
+  Response visit(State& state, const AbstractNode& node) override;
+  Response visit(State& state, const GroupNode& node) override;
+  Response visit(State& state, const ListNode& node) override;
+  Response visit(State& state, const RootNode& node) override;
+
+private:
+  struct Frame {
+    std::string text;
+    std::vector<NodeHash> children;
+  };
+  void enter(std::string text);
+  void leave(const AbstractNode& node, const char *suffix);
+  bool precomputed(const AbstractNode& node, const State& state) const;
+  void usePrecomputed(const AbstractNode& node);
+  void record(const AbstractNode& node);
+
+  std::unordered_map<size_t, NodeHash>& hashes;
+  std::shared_ptr<const AbstractNode> root;
+  GroupNodeChecker groupChecker;
+  std::vector<Frame> stack;
+};
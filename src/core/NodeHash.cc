@@ -0,0 +1,54 @@
+#include "core/NodeHash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// Finalizer from splitmix64
+uint64_t mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+} // namespace
+
+std::string NodeHash::toString() const
+{
+  char hex[33];
+  snprintf(hex, sizeof(hex), "%016llx%016llx", static_cast<unsigned long long>(hi), static_cast<unsigned long long>(lo));
+  return hex;
+}
+
+void NodeHashBuilder::update(const char *data, size_t len)
+{
+  for (size_t i = 0; i < len; ++i) {
+    const auto c = static_cast<unsigned char>(data[i]);
+    a = (a ^ c) * 0x100000001b3ull;
+    b = ((b ^ c) * 0x9e3779b97f4a7c15ull);
+    b ^= b >> 29;
+  }
+  length += len;
+}
+
+void NodeHashBuilder::update(const NodeHash& hash)
+{
+  // Mark the boundary so a digest cannot be confused with the same bytes in text
+  update('\0');
+  for (int i = 0; i < 8; ++i) update(static_cast<char>(hash.hi >> (8 * i)));
+  for (int i = 0; i < 8; ++i) update(static_cast<char>(hash.lo >> (8 * i)));
+}
+
+NodeHash NodeHashBuilder::digest() const
+{
+  const uint64_t x = mix(a ^ length);
+  const uint64_t y = mix(b + 0x9e3779b97f4a7c15ull * length);
+  return {x ^ mix(y), y ^ mix(x + 1)};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*!
+   128-bit structural hash of a node subtree.
+
+   Used as key for the geometry caches instead of the full ID string dump of
+   the subtree. See NodeHasher for how it is computed.
+
+   The in-memory caches trust the hash without comparing the subtrees. Two
+   different subtrees share a hash with a probability of about 2^-128, so even
+   with a million cached nodes a collision is less likely than 1e-26. Inputs
+   are the user's own models, not crafted to collide. The disk cache outlives
+   the session and may be shared, so it also compares the full ID string, see
+   GeometryDiskCache.
+ */
+struct NodeHash {
+  uint64_t hi{0};
+  uint64_t lo{0};
+
+  bool operator==(const NodeHash& other) const { return hi == other.hi && lo == other.lo; }
+  bool operator!=(const NodeHash& other) const { return !(*this == other); }
+  std::string toString() const;
+};
+
+/*!
+   Incremental builder for NodeHash. Two independent 64-bit lanes are
+   combined into the final 128-bit value.
+ */
+class NodeHashBuilder
+{
+public:
+  void update(const char *data, size_t len);
+  void update(const std::string& str) { update(str.data(), str.size()); }
+  void update(char c) { update(&c, 1); }
+  void update(const NodeHash& hash);
+  NodeHash digest() const;
+
+private:
+  uint64_t a{0xcbf29ce484222325ull};
+  uint64_t b{0x6a09e667f3bcc909ull};
+  uint64_t length{0};
+};
+
+template <>
+struct std::hash<NodeHash> {
+  size_t operator()(const NodeHash& h) const { return static_cast<size_t>(h.lo ^ (h.hi * 0x9e3779b97f4a7c15ull)); }
+};
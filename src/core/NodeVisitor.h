@@ -32,7 +32,7 @@ class NodeVisitor :
 public:
   NodeVisitor() = default;
 
-  Response traverse(const AbstractNode& node, const State& state = NodeVisitor::nullstate);
+  virtual Response traverse(const AbstractNode& node, const State& state = NodeVisitor::nullstate);
 
   Response visit(State& state, const AbstractNode& node) override = 0;
   Response visit(State& state, const AbstractIntersectionNode& node) override {
@@ -95,6 +95,6 @@ public:
   }
   // Add visit() methods for new visitable subtypes of AbstractNode here
 
-private:
+protected:
   static State nullstate;
 };
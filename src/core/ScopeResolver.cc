@@ -0,0 +1,138 @@
+#include "core/ScopeResolver.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "core/Context.h"
+#include "core/Expression.h"
+#include "core/LexicalScope.h"
+#include "core/LocalScope.h"
+#include "core/ModuleInstantiation.h"
+#include "core/UserModule.h"
+#include "core/function.h"
+
+const Value *VariableBinding::find(const Context& context) const
+{
+  const Context *current = &context;
+  for (size_t i = 0;; ++i) {
+    const Frame& frame = frames[i];
+    if (!current || current->lexical_scope() != frame.scope) return nullptr;
+    if (i + 1 == frames.size()) return current->slot_value(slot);
+    if (current->has_unscoped_variables()) return nullptr;
+    if (frame.shadowing_slot >= 0 && current->slot_value(frame.shadowing_slot)) return nullptr;
+    current = current->getParent().get();
+  }
+}
+
+void ScopeResolver::resolve(LocalScope& scope)
+{
+  // File and module scopes are looked up by name, so every statement starts without lexical scopes
+  ScopeResolver resolver;
+  resolver.resolve(scope.assignments);
+  for (const auto& function : scope.astFunctions) {
+    function.second->pure = resolver.resolveFunction(function.second->parameters, function.second->scope, function.second->expr);
+  }
+  for (const auto& module : scope.astModules) {
+    resolver.resolve(module.second->parameters);
+    resolve(module.second->body);
+  }
+  for (const auto& instantiation : scope.moduleInstantiations) {
+    resolver.resolve(instantiation->arguments);
+    resolve(instantiation->scope);
+    if (const auto *ifelse = dynamic_cast<const IfElseModuleInstantiation *>(instantiation.get())) {
+      if (ifelse->getElseScope()) resolve(*ifelse->getElseScope());
+    }
+  }
+}
+
+void ScopeResolver::resolve(const std::shared_ptr<Expression>& expression)
+{
+  if (expression) expression->resolveScopes(*this);
+}
+
+void ScopeResolver::resolve(const AssignmentList& assignments)
+{
+  for (const auto& assignment : assignments) {
+    resolve(assignment->getExpr());
+  }
+}
+
+bool ScopeResolver::resolveFunction(const AssignmentList& parameters, const LexicalScope& scope, const std::shared_ptr<Expression>& body)
+{
+  bool outer = beginSideEffects();
+  bool outer_reads = special_reads;
+  special_reads = false;
+  for (const auto& parameter : parameters) {
+    if (ContextFrame::is_config_variable(parameter->getName())) markSpecialRead();
+  }
+
+  // Default values are evaluated in the defining context
+  resolve(parameters);
+  push(scope);
+  resolve(body);
+  pop();
+
+  bool reads = special_reads;
+  special_reads = outer_reads || reads;
+  return !endSideEffects(outer) && !reads;
+}
+
+void ScopeResolver::pushSequential(const AssignmentList& assignments, const LexicalScope& scope)
+{
+  frames.push_back({&scope, 0});
+  for (const auto& assignment : assignments) {
+    resolve(assignment->getExpr());
+    int slot = scope.find(assignment->getName());
+    if (slot >= 0) frames.back().visible = std::max(frames.back().visible, static_cast<size_t>(slot) + 1);
+  }
+}
+
+void ScopeResolver::push(const LexicalScope& scope)
+{
+  frames.push_back({&scope, scope.size()});
+}
+
+void ScopeResolver::pop()
+{
+  frames.pop_back();
+}
+
+std::unique_ptr<const VariableBinding> ScopeResolver::bind(const std::string& name) const
+{
+  auto binding = std::make_unique<VariableBinding>();
+  for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+    int slot = frame->scope->find(name);
+    if (slot >= 0 && static_cast<size_t>(slot) < frame->visible) {
+      binding->frames.push_back({frame->scope, -1});
+      binding->slot = slot;
+      return binding;
+    }
+    binding->frames.push_back({frame->scope, slot});
+  }
+  return nullptr;
+}
+
+void ScopeResolver::markCall(const std::string& name)
+{
+  if (name == "rands" || name == "textmetrics" || name == "fontmetrics" || name == "import") {
+    markSideEffect();
+  } else if (name == "parent_module" || ContextFrame::is_config_variable(name)) {
+    markSpecialRead();
+  }
+}
+
+bool ScopeResolver::beginSideEffects()
+{
+  bool outer = side_effects;
+  side_effects = false;
+  return outer;
+}
+
+bool ScopeResolver::endSideEffects(bool outer)
+{
+  bool found = side_effects;
+  side_effects = outer || found;
+  return found;
+}
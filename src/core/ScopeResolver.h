@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/Assignment.h"
+
+class Context;
+class Expression;
+class LexicalScope;
+class LocalScope;
+class Value;
+
+/*!
+   Where a variable reference finds its variable when the contexts at runtime
+   have the shape seen by the ScopeResolver: in a slot of the context
+   frames.size() - 1 levels up the parent chain.
+ */
+struct VariableBinding
+{
+  struct Frame {
+    const LexicalScope *scope;
+    int shadowing_slot; // slot of a same-named variable not yet visible here, or -1
+  };
+  std::vector<Frame> frames; // innermost first; the last one holds the variable
+  int slot;
+
+  /*
+   * Returns the bound variable, or nullptr if the contexts differ from what
+   * the resolver expected or the variable isn't set. The caller then falls
+   * back to looking up the variable by name.
+   */
+  const Value *find(const Context& context) const;
+};
+
+/*!
+   Binds variable references to slots after parsing.
+
+   Walks the expressions of a file, tracking the let(), for() and function
+   scopes enclosing each expression, and binds every Lookup and FunctionCall
+   naming a variable of such a scope. References to file, module or special
+   variables stay unbound and are looked up by name. Also finds the list
+   comprehensions free of side effects, and the pure functions.
+ */
+class ScopeResolver
+{
+public:
+  static void resolve(LocalScope& scope);
+
+  void resolve(const std::shared_ptr<Expression>& expression);
+  void resolve(const AssignmentList& assignments);
+  /*
+   * Resolves the function body for a call frame holding its parameters.
+   * Returns whether the function is pure: free of side effects and of reads
+   * of special variables, so its result depends on its arguments only.
+   */
+  bool resolveFunction(const AssignmentList& parameters, const LexicalScope& scope, const std::shared_ptr<Expression>& body);
+  // Pushes a scope whose assignments each see the previous ones, as in let()
+  void pushSequential(const AssignmentList& assignments, const LexicalScope& scope);
+  void push(const LexicalScope& scope);
+  void pop();
+
+  [[nodiscard]] std::unique_ptr<const VariableBinding> bind(const std::string& name) const;
+
+  /*
+   * Side effects are those that make evaluation order observable, like
+   * echo() or calls to builtins with global state such as rands(). The
+   * iterations of a list comprehension without them may run concurrently.
+   * Calls of user functions aren't followed; those are guarded at runtime.
+   */
+  void markSideEffect() { side_effects = true; }
+  // Marks calls of builtins with side effects, or reading special variables, by their name
+  void markCall(const std::string& name);
+  // Marks a dependency on the dynamic scope, like reading $fn
+  void markSpecialRead() { special_reads = true; }
+  // Starts looking for side effects, returning the state to pass to endSideEffects()
+  [[nodiscard]] bool beginSideEffects();
+  // Returns whether side effects were found since the matching beginSideEffects()
+  bool endSideEffects(bool outer);
+
+private:
+  struct Frame {
+    const LexicalScope *scope;
+    size_t visible; // slots below this are set when expressions in this frame are evaluated
+  };
+  std::vector<Frame> frames;
+  bool side_effects{false};
+  bool special_reads{false};
+};
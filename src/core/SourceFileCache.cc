@@ -107,6 +107,7 @@ std::time_t SourceFileCache::evaluate(const std::string& mainFile, const std::st
     PRINTDB("compiled file: %s", filename);
     cacheEntry.file = file;
     cacheEntry.cache_id = cache_id;
+    cacheEntry.parse_count = ++this->parses;
     auto mod = file ? file : cacheEntry.parsed_file;
     if (!found && mod) cacheEntry.includes_mtime = mod->includesChanged();
     print_messages_pop();
@@ -130,6 +131,12 @@ SourceFile *SourceFileCache::lookup(const std::string& filename)
   return it != this->entries.end() ? it->second.file : nullptr;
 }
 
+unsigned long SourceFileCache::parseCount(const std::string& filename) const
+{
+  auto it = this->entries.find(filename);
+  return it != this->entries.end() ? it->second.parse_count : 0;
+}
+
 void SourceFileCache::clear_markers() {
   for (const auto& entry : instance()->entries)
     if (auto lib = entry.second.file) lib->clearHandlingDependencies();
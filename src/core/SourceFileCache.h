@@ -16,6 +16,8 @@ public:
 
   std::time_t evaluate(const std::string& mainFile, const std::string& filename, SourceFile *& sourceFile);
   SourceFile *lookup(const std::string& filename);
+  // Changes every time filename is parsed again, 0 if it was never parsed
+  unsigned long parseCount(const std::string& filename) const;
   size_t size() const { return this->entries.size(); }
   void clear();
   static void clear_markers();
@@ -31,6 +33,8 @@ private:
     std::string cache_id;
     std::time_t mtime{}; // time file last modified
     std::time_t includes_mtime{}; // time the includes last changed
+    unsigned long parse_count{}; // value of parses when this file was last parsed
   };
   std::unordered_map<std::string, cache_entry> entries;
+  unsigned long parses{0}; // not reset by clear(), so a count is never reused
 };
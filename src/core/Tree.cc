@@ -3,12 +3,15 @@
 
 #include <memory>
 #include <cassert>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <tuple>
 
 Tree::~Tree()
 {
   this->nodecachemap.clear();
+  this->nodehashes.clear();
 }
 
 /*!
@@ -18,6 +21,7 @@ Tree::~Tree()
 const std::string Tree::getString(const AbstractNode& node, const std::string& indent) const
 {
   assert(this->root_node);
+  std::lock_guard lock(this->nodecachemutex);
   bool idString = false;
 
   // Retrieve a nodecache given a tuple of NodeDumper constructor options
@@ -39,10 +43,13 @@ const std::string Tree::getString(const AbstractNode& node, const std::string& i
    The difference between this method and getString() is that the ID string
    is stripped for whitespace. Especially indentation whitespace is important to
    strip to enable cache hits for equivalent nodes from different scopes.
+
+   Geometry caches are keyed by getHash() instead; this is mostly useful for debugging.
  */
 const std::string Tree::getIdString(const AbstractNode& node) const
 {
   assert(this->root_node);
+  std::lock_guard lock(this->nodecachemutex);
   const std::string indent = "";
   const bool idString = true;
 
@@ -59,13 +66,39 @@ const std::string Tree::getIdString(const AbstractNode& node) const
   return nodecache[node];
 }
 
+/*!
+   Returns the structural hash of the subtree rooted by \a node.
+   Hashes for the whole tree are computed in one pass on first use.
+ */
+NodeHash Tree::getHash(const AbstractNode& node) const
+{
+  assert(this->root_node);
+  {
+    std::shared_lock lock(this->nodehashmutex);
+    const auto it = this->nodehashes.find(node.index());
+    if (it != this->nodehashes.end()) return it->second;
+  }
+  std::unique_lock lock(this->nodehashmutex);
+  auto it = this->nodehashes.find(node.index());
+  if (it == this->nodehashes.end()) {
+    this->nodehashes.clear();
+    NodeHasher hasher(this->nodehashes, this->root_node);
+    hasher.traverse(*this->root_node);
+    it = this->nodehashes.find(node.index());
+    assert(it != this->nodehashes.end() && "NodeHasher failed to hash node");
+  }
+  return it->second;
+}
+
 /*!
    Sets a new root. Will clear the existing cache.
  */
 void Tree::setRoot(const std::shared_ptr<const AbstractNode> &root)
 {
+  std::scoped_lock lock(this->nodecachemutex, this->nodehashmutex);
   this->root_node = root;
   this->nodecachemap.clear();
+  this->nodehashes.clear();
 }
 
 void Tree::setDocumentPath(const std::string& path){
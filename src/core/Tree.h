@@ -1,10 +1,14 @@
 #pragma once
 
 #include "core/NodeCache.h"
+#include "core/NodeHash.h"
 #include <tuple>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 /*!
@@ -25,11 +29,18 @@ public:
 
   const std::string getString(const AbstractNode& node, const std::string& indent) const;
   const std::string getIdString(const AbstractNode& node) const;
+  NodeHash getHash(const AbstractNode& node) const;
   const std::string getDocumentPath() const;
 
 private:
   std::shared_ptr<const AbstractNode> root_node;
   // keep a separate nodecache per tuple of NodeDumper constructor parameters
   mutable std::map<std::tuple<std::string, bool>, NodeCache> nodecachemap;
+  // structural hash per node index, used as geometry cache key
+  mutable std::unordered_map<size_t, NodeHash> nodehashes;
+  // Guards nodecachemap, as geometry may be evaluated from multiple threads
+  mutable std::mutex nodecachemutex;
+  // Guards nodehashes, which are only written when they are computed
+  mutable std::shared_mutex nodehashmutex;
   std::string document_path;
 };
@@ -26,7 +26,9 @@
 
 #include "core/Value.h"
 
+#include <algorithm>
 #include <filesystem>
+#include <functional>
 #include <cmath>
 #include <variant>
 #include <limits>
@@ -36,6 +38,7 @@
 #include <cassert>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -544,11 +547,28 @@ VectorType::VectorType(class EvaluationSession *session, double x, double y, dou
   emplace_back(z);
 }
 
+VectorType::VectorType(class EvaluationSession *session, std::vector<double>&& numbers) :
+  ptr(std::shared_ptr<VectorObject>(new VectorObject(), VectorObjectDeleter() ))
+{
+  ptr->evaluation_session = session;
+  ptr->numbers = std::move(numbers);
+  if (ptr->evaluation_session) {
+    ptr->evaluation_session->accounting().addVectorElement(ptr->numbers.size());
+  }
+}
+
 void VectorType::emplace_back(Value&& val)
 {
   if (val.type() == Value::Type::EMBEDDED_VECTOR) {
     emplace_back(std::move(val.toEmbeddedVectorNonConst()));
+  } else if (ptr->dense && val.type() == Value::Type::NUMBER) {
+    dropValues();
+    ptr->numbers.push_back(val.toDouble());
+    if (ptr->evaluation_session) {
+      ptr->evaluation_session->accounting().addVectorElement(1);
+    }
   } else {
+    if (ptr->dense) makeGeneric();
     ptr->vec.push_back(std::move(val));
     if (ptr->evaluation_session) {
       ptr->evaluation_session->accounting().addVectorElement(1);
@@ -560,6 +580,31 @@ void VectorType::emplace_back(Value&& val)
 void VectorType::emplace_back(EmbeddedVectorType&& mbed)
 {
   if (mbed.size() > 1) {
+    if (ptr->dense && mbed.ptr->dense) {
+      // Rather than embedding a vector of numbers, take over the numbers of a
+      // temporary, e.g. the result of a list comprehension, or copy them if that
+      // at most doubles the size of this vector.
+      auto& numbers = mbed.ptr->numbers;
+      if (this->empty() && mbed.ptr.use_count() == 1) {
+        if (mbed.ptr->evaluation_session) {
+          mbed.ptr->evaluation_session->accounting().removeVectorElement(numbers.size());
+        }
+        if (ptr->evaluation_session) {
+          ptr->evaluation_session->accounting().addVectorElement(numbers.size());
+        }
+        ptr->materialized = false;
+        ptr->numbers.swap(numbers);
+        return;
+      } else if (!this->empty() && numbers.size() <= this->size()) {
+        dropValues();
+        ptr->numbers.insert(ptr->numbers.end(), numbers.begin(), numbers.end());
+        if (ptr->evaluation_session) {
+          ptr->evaluation_session->accounting().addVectorElement(numbers.size());
+        }
+        return;
+      }
+    }
+    if (ptr->dense) makeGeneric();
     // embed_excess represents how many to add to vec.size() to get the total elements after flattening,
     // the embedded vector itself already counts towards an element in the parent's size, so subtract 1 from its size.
     ptr->embed_excess += mbed.size() - 1;
@@ -571,31 +616,119 @@ void VectorType::emplace_back(EmbeddedVectorType&& mbed)
     // If embedded vector contains only one value, then insert a copy of that element
     // Due to the above mentioned "-1" count, putting it in directaly as an EmbeddedVector
     // would not change embed_excess, which is needed to check if flatten is required.
-    emplace_back(mbed.ptr->vec[0].clone());
+    if (const auto *numbers = mbed.numbers()) emplace_back((*numbers)[0]);
+    else emplace_back(mbed.ptr->vec[0].clone());
   }
   // else mbed.size() == 0, do nothing
 }
 
+void VectorType::dropValues()
+{
+  // Only the owner adds elements, so nobody holds references into the copy
+  if (ptr->materialized) {
+    if (ptr->evaluation_session) {
+      ptr->evaluation_session->accounting().removeVectorElement(ptr->vec.size());
+    }
+    ptr->vec.clear();
+    ptr->materialized = false;
+  }
+}
+
+void VectorType::makeGeneric()
+{
+  assert(ptr->dense);
+  if (!ptr->materialized) {
+    ptr->vec.reserve(ptr->numbers.capacity());
+    for (double number : ptr->numbers) ptr->vec.emplace_back(number);
+    if (ptr->evaluation_session) {
+      ptr->evaluation_session->accounting().addVectorElement(ptr->vec.size());
+    }
+  }
+  if (ptr->evaluation_session) {
+    ptr->evaluation_session->accounting().removeVectorElement(ptr->numbers.size());
+  }
+  ptr->numbers = std::vector<double>();
+  ptr->dense = false;
+  ptr->materialized = false;
+}
+
 void VectorType::flatten() const
 {
   vec_t ret;
-  ret.reserve(this->size());
-  // VectorType::iterator already handles the tricky recursive navigation of embedded vectors,
-  // so just build up our new vector from that.
-  for (const auto& el : *this) ret.emplace_back(el.clone());
+  if (vec_t *flat = ptr->flat.exchange(nullptr)) {
+    ret = std::move(*flat);
+    delete flat;
+  } else {
+    ret.reserve(this->size());
+    // VectorType::iterator already handles the tricky recursive navigation of embedded vectors,
+    // so just build up our new vector from that.
+    for (const auto& el : *this) ret.emplace_back(el.clone());
+    if (ptr->evaluation_session) {
+      ptr->evaluation_session->accounting().addVectorElement(ret.size());
+    }
+  }
   assert(ret.size() == this->size());
   ptr->embed_excess = 0;
   if (ptr->evaluation_session) {
-    ptr->evaluation_session->accounting().addVectorElement(ret.size());
     ptr->evaluation_session->accounting().removeVectorElement(ptr->vec.size());
   }
   ptr->vec = std::move(ret);
 }
 
+namespace {
+
+// Guards lazily made copies of the elements of vectors that may be shared between threads
+std::mutex lazy_elements_mutex;
+
+} // namespace
+
+void VectorType::materialize() const
+{
+  std::lock_guard<std::mutex> lock(lazy_elements_mutex);
+  if (ptr->materialized.load(std::memory_order_relaxed)) return;
+  ptr->vec.reserve(ptr->numbers.size());
+  for (double number : ptr->numbers) ptr->vec.emplace_back(number);
+  if (ptr->evaluation_session) {
+    ptr->evaluation_session->accounting().addVectorElement(ptr->vec.size());
+  }
+  ptr->materialized.store(true, std::memory_order_release);
+}
+
+const VectorType::vec_t& VectorType::flattened() const
+{
+  // Workers may share this vector, and be iterating over vec
+  if (!EvaluationSession::Worker::active()) {
+    flatten();
+    return ptr->vec;
+  }
+  vec_t *flat = ptr->flat.load(std::memory_order_acquire);
+  if (!flat) {
+    std::lock_guard<std::mutex> lock(lazy_elements_mutex);
+    flat = ptr->flat.load(std::memory_order_acquire);
+    if (!flat) {
+      auto *ret = new vec_t();
+      ret->reserve(this->size());
+      for (const auto& el : *this) ret->emplace_back(el.clone());
+      if (ptr->evaluation_session) {
+        ptr->evaluation_session->accounting().addVectorElement(ret->size());
+      }
+      ptr->flat.store(ret, std::memory_order_release);
+      flat = ret;
+    }
+  }
+  return *flat;
+}
+
 void VectorType::VectorObjectDeleter::operator()(VectorObject *v)
 {
   if (v->evaluation_session) {
-    v->evaluation_session->accounting().removeVectorElement(v->vec.size());
+    v->evaluation_session->accounting().removeVectorElement(v->vec.size() + v->numbers.size());
+  }
+  if (const vec_t *flat = v->flat.exchange(nullptr)) {
+    if (v->evaluation_session) {
+      v->evaluation_session->accounting().removeVectorElement(flat->size());
+    }
+    delete flat;
   }
 
   VectorObject *orig = v;
@@ -656,6 +789,12 @@ bool Value::getVec2(double& x, double& y, bool ignoreInfinite) const
   if (this->type() != Type::VECTOR) return false;
   const auto& v = this->toVector();
   if (v.size() != 2) return false;
+  if (const auto *numbers = v.numbers()) {
+    if (ignoreInfinite && !(std::isfinite((*numbers)[0]) && std::isfinite((*numbers)[1]))) return false;
+    x = (*numbers)[0];
+    y = (*numbers)[1];
+    return true;
+  }
   double rx, ry;
   bool valid = ignoreInfinite
     ? v[0].getFiniteDouble(rx) && v[1].getFiniteDouble(ry)
@@ -672,6 +811,12 @@ bool Value::getVec3(double& x, double& y, double& z) const
   if (this->type() != Type::VECTOR) return false;
   const VectorType& v = this->toVector();
   if (v.size() != 3) return false;
+  if (const auto *numbers = v.numbers()) {
+    x = (*numbers)[0];
+    y = (*numbers)[1];
+    z = (*numbers)[2];
+    return true;
+  }
   return (v[0].getDouble(x) && v[1].getDouble(y) && v[2].getDouble(z));
 }
 
@@ -686,6 +831,12 @@ bool Value::getVec3(double& x, double& y, double& z, double defaultval) const
   } else {
     if (v.size() != 3) return false;
   }
+  if (const auto *numbers = v.numbers()) {
+    x = (*numbers)[0];
+    y = (*numbers)[1];
+    z = (*numbers)[2];
+    return true;
+  }
   return (v[0].getDouble(x) && v[1].getDouble(y) && v[2].getDouble(z));
 }
 
@@ -870,6 +1021,24 @@ bool Value::cmp_less(const Value& v1, const Value& v2) {
   return v1.operator<(v2).toBool();
 }
 
+// Combines the elements of two vectors of numbers, up to the length of the shorter one
+template <typename Operation>
+static Value combine_numbers(EvaluationSession *session, const std::vector<double>& numbers1, const std::vector<double>& numbers2, const Operation& op)
+{
+  std::vector<double> result(std::min(numbers1.size(), numbers2.size()));
+  for (size_t i = 0; i < result.size(); ++i) result[i] = op(numbers1[i], numbers2[i]);
+  return VectorType(session, std::move(result));
+}
+
+// Maps the elements of a vector of numbers
+template <typename Operation>
+static Value map_numbers(EvaluationSession *session, const std::vector<double>& numbers, const Operation& op)
+{
+  std::vector<double> result(numbers.size());
+  for (size_t i = 0; i < result.size(); ++i) result[i] = op(numbers[i]);
+  return VectorType(session, std::move(result));
+}
+
 class plus_visitor
 {
 public:
@@ -882,6 +1051,9 @@ public:
   }
 
   Value operator()(const VectorType& op1, const VectorType& op2) const {
+    if (op1.numbers() && op2.numbers()) {
+      return combine_numbers(op1.evaluation_session(), *op1.numbers(), *op2.numbers(), std::plus<>());
+    }
     VectorType sum(op1.evaluation_session());
     sum.reserve(op1.size());
     // FIXME: should we really truncate to shortest vector here?
@@ -913,6 +1085,9 @@ public:
   }
 
   Value operator()(const VectorType& op1, const VectorType& op2) const {
+    if (op1.numbers() && op2.numbers()) {
+      return combine_numbers(op1.evaluation_session(), *op1.numbers(), *op2.numbers(), std::minus<>());
+    }
     VectorType sum(op1.evaluation_session());
     sum.reserve(op1.size());
     for (size_t i = 0; i < op1.size() && i < op2.size(); ++i) {
@@ -930,6 +1105,10 @@ Value Value::operator-(const Value& v) const
 Value multvecnum(const VectorType& vecval, const Value& numval)
 {
   // Vector * Number
+  if (vecval.numbers() && numval.type() == Value::Type::NUMBER) {
+    const double factor = numval.toDouble();
+    return map_numbers(vecval.evaluation_session(), *vecval.numbers(), [factor](double x) { return x * factor; });
+  }
   VectorType dstv(vecval.evaluation_session());
   dstv.reserve(vecval.size());
   for (const auto& val : vecval) {
@@ -943,12 +1122,21 @@ Value multmatvec(const VectorType& matrixvec, const VectorType& vectorvec)
   // Matrix * Vector
   VectorType dstv(matrixvec.evaluation_session());
   dstv.reserve(matrixvec.size());
+  const auto *vector_numbers = vectorvec.numbers();
   for (size_t i = 0; i < matrixvec.size(); ++i) {
     if (matrixvec[i].type() != Value::Type::VECTOR ||
         matrixvec[i].toVector().size() != vectorvec.size()) {
       return Value::undef(STR("Matrix must be rectangular. Problem at row ", i));
     }
     double r_e = 0.0;
+    const auto *row_numbers = matrixvec[i].toVector().numbers();
+    if (row_numbers && vector_numbers) {
+      for (size_t j = 0; j < row_numbers->size(); ++j) {
+        r_e += (*row_numbers)[j] * (*vector_numbers)[j];
+      }
+      dstv.emplace_back(Value(r_e));
+      continue;
+    }
     for (size_t j = 0; j < matrixvec[i].toVector().size(); ++j) {
       if (matrixvec[i].toVector()[j].type() != Value::Type::NUMBER) {
         return Value::undef(STR("Matrix must contain only numbers. Problem at row ", i, ", col ", j));
@@ -969,6 +1157,26 @@ Value multvecmat(const VectorType& vectorvec, const VectorType& matrixvec)
   // Vector * Matrix
   VectorType dstv(matrixvec[0].toVector().evaluation_session());
   size_t firstRowSize = matrixvec[0].toVector().size();
+  if (const auto *vector_numbers = vectorvec.numbers()) {
+    // Rectangular matrix of numbers
+    std::vector<const std::vector<double> *> rows;
+    rows.reserve(matrixvec.size());
+    for (const auto& row : matrixvec) {
+      if (row.type() != Value::Type::VECTOR || row.toVector().size() != firstRowSize || !row.toVector().numbers()) break;
+      rows.push_back(row.toVector().numbers());
+    }
+    if (rows.size() == vector_numbers->size()) {
+      std::vector<double> result(firstRowSize);
+      for (size_t i = 0; i < firstRowSize; ++i) {
+        double r_e = 0.0;
+        for (size_t j = 0; j < rows.size(); ++j) {
+          r_e += (*vector_numbers)[j] * (*rows[j])[i];
+        }
+        result[i] = r_e;
+      }
+      return VectorType(dstv.evaluation_session(), std::move(result));
+    }
+  }
   dstv.reserve(firstRowSize);
   for (size_t i = 0; i < firstRowSize; ++i) {
     double r_e = 0.0;
@@ -996,6 +1204,12 @@ Value multvecmat(const VectorType& vectorvec, const VectorType& matrixvec)
 Value multvecvec(const VectorType& vec1, const VectorType& vec2) {
   // Vector dot product.
   auto r = 0.0;
+  if (vec1.numbers() && vec2.numbers()) {
+    const auto& numbers1 = *vec1.numbers();
+    const auto& numbers2 = *vec2.numbers();
+    for (size_t i = 0; i < numbers1.size(); i++) r += numbers1[i] * numbers2[i];
+    return {r};
+  }
   for (size_t i = 0; i < vec1.size(); i++) {
     if (vec1[i].type() != Value::Type::NUMBER || vec2[i].type() != Value::Type::NUMBER) {
       return Value::undef(STR("undefined operation (", vec1[i].typeName(), " * ", vec2[i].typeName(), ")"));
@@ -1069,6 +1283,10 @@ Value Value::operator/(const Value& v) const
   if (this->type() == Type::NUMBER && v.type() == Type::NUMBER) {
     return this->toDouble() / v.toDouble();
   } else if (this->type() == Type::VECTOR && v.type() == Type::NUMBER) {
+    if (const auto *numbers = this->toVector().numbers()) {
+      const double divisor = v.toDouble();
+      return map_numbers(this->toVector().evaluation_session(), *numbers, [divisor](double x) { return x / divisor; });
+    }
     VectorType dstv(this->toVector().evaluation_session());
     dstv.reserve(this->toVector().size());
     for (const auto& vecval : this->toVector()) {
@@ -1076,6 +1294,10 @@ Value Value::operator/(const Value& v) const
     }
     return std::move(dstv);
   } else if (this->type() == Type::NUMBER && v.type() == Type::VECTOR) {
+    if (const auto *numbers = v.toVector().numbers()) {
+      const double dividend = this->toDouble();
+      return map_numbers(v.toVector().evaluation_session(), *numbers, [dividend](double x) { return dividend / x; });
+    }
     VectorType dstv(v.toVector().evaluation_session());
     dstv.reserve(v.toVector().size());
     for (const auto& vecval : v.toVector()) {
@@ -1099,6 +1321,9 @@ Value Value::operator-() const
   if (this->type() == Type::NUMBER) {
     return {-this->toDouble()};
   } else if (this->type() == Type::VECTOR) {
+    if (const auto *numbers = this->toVector().numbers()) {
+      return map_numbers(this->toVector().evaluation_session(), *numbers, std::negate<>());
+    }
     VectorType dstv(this->toVector().evaluation_session());
     dstv.reserve(this->toVector().size());
     for (const auto& vecval : this->toVector()) {
@@ -1136,7 +1361,10 @@ public:
 
   Value operator()(const VectorType& vec, const double& idx) const {
     const auto i = convert_to_uint32(idx);
-    if (i < vec.size()) return vec[i].clone();
+    if (i < vec.size()) {
+      if (const auto *numbers = vec.numbers()) return (*numbers)[i];
+      return vec[i].clone();
+    }
     return Value::undef(STR("index ", i, " out of bounds for vector of size ", vec.size()));
   }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <iterator>
 #include <unordered_map>
 #include <utility>
@@ -122,10 +123,17 @@ protected:
       using vec_t = std::vector<Value>;
       using size_type = vec_t::size_type;
       vec_t vec;
+      // As long as all elements are numbers, they are stored here instead of in vec.
+      // vec then only gets a copy of them when Value references are needed, see VectorType::values().
+      std::vector<double> numbers;
+      bool dense = true;
+      std::atomic<bool> materialized{false}; // whether vec holds a copy of numbers
       size_type embed_excess = 0; // Keep count of the number of embedded elements *excess of* vec.size()
       class EvaluationSession *evaluation_session = nullptr; // Used for heap size bookkeeping. May be null for vectors of known small maximum size.
-      [[nodiscard]] size_type size() const { return vec.size() + embed_excess;  }
-      [[nodiscard]] bool empty() const { return vec.empty() && embed_excess == 0;  }
+      // Flattened copy of vec, made instead of flattening vec itself while other threads may be iterating over it
+      std::atomic<vec_t *> flat{nullptr};
+      [[nodiscard]] size_type size() const { return dense ? numbers.size() : vec.size() + embed_excess;  }
+      [[nodiscard]] bool empty() const { return size() == 0;  }
     };
     using vec_t = VectorObject::vec_t;
 public:
@@ -142,72 +150,24 @@ protected:
     void flatten() const; // flatten replaces VectorObject::vec with a new vector
                           // where any embedded elements are copied directly into the top level vec,
                           // leaving only true elements for straightforward indexing by operator[].
+    [[nodiscard]] const vec_t& flattened() const; // the flattened elements, see VectorObject::flat
+    // The elements as Values, copying the numbers of a dense vector into vec once
+    [[nodiscard]] const vec_t& values() const {
+      if (ptr->dense && !ptr->materialized.load(std::memory_order_acquire)) materialize();
+      return ptr->vec;
+    }
+    void materialize() const;
+    void dropValues(); // drops the copy made by materialize(), before adding numbers
+    void makeGeneric(); // stores the numbers of a dense vector as Values, before adding other elements
     explicit VectorType(const std::shared_ptr<VectorObject>& copy) : ptr(copy) { } // called by clone()
 public:
     using size_type = VectorObject::size_type;
     static const VectorType EMPTY;
-    // EmbeddedVectorType-aware iterator, manages its own stack of begin/end vec_t::const_iterators
-    // such that calling code will only receive references to "true" elements (i.e. NOT EmbeddedVectorTypes).
-    // Also tracks the overall element index. In case flattening occurs during iteration, it can continue based on that index. (Issue #3541)
-    class iterator
-    {
-private:
-      const VectorObject *vo;
-      std::vector<std::pair<vec_t::const_iterator, vec_t::const_iterator>> it_stack;
-      vec_t::const_iterator it, end;
-      size_t index;
-
-      // Recursively push stack while current (pseudo)element is an EmbeddedVector
-      //  - Depends on the fact that VectorType::emplace_back(EmbeddedVectorType&& mbed)
-      //    will not embed an empty vector, which ensures iterator will arrive at an actual element,
-      //    unless already at end of parent VectorType.
-      void check_and_push()
-      {
-        if (it != end) {
-          while (it->type() == Type::EMBEDDED_VECTOR) {
-            const vec_t& cur = it->toEmbeddedVector().ptr->vec;
-            it_stack.emplace_back(it, end);
-            it = cur.begin();
-            end = cur.end();
-          }
-        }
-      }
-public:
-      using iterator_category = std::forward_iterator_tag;
-      using value_type = Value;
-      using difference_type = void;
-      using reference = const value_type&;
-      using pointer = const value_type *;
-
-      iterator() : vo(EMPTY.ptr.get()), it_stack(), it(EMPTY.ptr->vec.begin()), end(EMPTY.ptr->vec.end()), index(0) {}
-      iterator(const VectorObject *v) : vo(v), it(v->vec.begin()), end(v->vec.end()), index(0) {
-        if (vo->embed_excess) check_and_push();
-      }
-      iterator(const VectorObject *v, bool /*end*/) : vo(v), index(v->size()) { }
-      iterator& operator++() {
-        ++index;
-        if (vo->embed_excess) {
-          // recursively increment and pop stack while at the end of EmbeddedVector(s)
-          while (++it == end && !it_stack.empty()) {
-            const auto& up = it_stack.back();
-            it = up.first;
-            end = up.second;
-            it_stack.pop_back();
-          }
-          check_and_push();
-        } else { // vo->vec is flat
-          it = vo->vec.begin() + static_cast<vec_t::iterator::difference_type>(index);
-        }
-        return *this;
-      }
-      reference operator*() const { return *it; }
-      pointer operator->() const { return &*it; }
-      bool operator==(const iterator& other) const { return this->vo == other.vo && this->index == other.index; }
-      bool operator!=(const iterator& other) const { return this->vo != other.vo || this->index != other.index; }
-    };
+    class iterator;
     using const_iterator = const iterator;
     VectorType(class EvaluationSession *session);
     VectorType(class EvaluationSession *session, double x, double y, double z);
+    VectorType(class EvaluationSession *session, std::vector<double>&& numbers);
     VectorType(const VectorType&) = delete; // never copy, move instead
     VectorType& operator=(const VectorType&) = delete; // never copy, move instead
     VectorType(VectorType&&) = default;
@@ -217,18 +177,21 @@ public:
     static Value Empty() { return VectorType(nullptr); }
 
     void reserve(size_t size) {
-      ptr->vec.reserve(size);
+      if (ptr->dense) ptr->numbers.reserve(size);
+      else ptr->vec.reserve(size);
     }
 
-    [[nodiscard]] const_iterator begin() const { return iterator(ptr.get()); }
-    [[nodiscard]] const_iterator   end() const { return iterator(ptr.get(), true); }
+    [[nodiscard]] const_iterator begin() const;
+    [[nodiscard]] const_iterator   end() const;
     [[nodiscard]] size_type size() const { return ptr->size(); }
     [[nodiscard]] bool empty() const { return ptr->empty(); }
+    // The elements as contiguous doubles if they are all numbers, otherwise nullptr
+    [[nodiscard]] const std::vector<double> *numbers() const { return ptr->dense ? &ptr->numbers : nullptr; }
     // const accesses to VectorObject require .clone to be move-able
     const Value& operator[](size_t idx) const {
       if (idx < this->size()) {
-        if (ptr->embed_excess) flatten();
-        return ptr->vec[idx];
+        if (ptr->embed_excess) return flattened()[idx];
+        return values()[idx];
       } else {
         return Value::undefined;
       }
@@ -379,6 +342,122 @@ private:
   Variant value;
 };
 
+// EmbeddedVectorType-aware iterator, manages its own stack of begin/end vec_t::const_iterators
+// such that calling code will only receive references to "true" elements (i.e. NOT EmbeddedVectorTypes).
+// Also tracks the overall element index. In case flattening occurs during iteration, it can continue based on that index. (Issue #3541)
+// Elements of dense vectors are handed out as a Value held by the iterator, which is only valid until the iterator moves on.
+class Value::VectorType::iterator
+{
+private:
+  const VectorObject *vo;
+  std::vector<std::pair<vec_t::const_iterator, vec_t::const_iterator>> it_stack;
+  vec_t::const_iterator it, end;
+  const double *number = nullptr, *numbers_end = nullptr; // position within a dense vector
+  Value current{0.0};
+  size_t index;
+
+  void enter_numbers(const VectorObject *v)
+  {
+    number = v->numbers.data();
+    numbers_end = number + v->numbers.size();
+    if (number != numbers_end) current = Value(*number);
+  }
+
+  // Recursively push stack while current (pseudo)element is an EmbeddedVector
+  //  - Depends on the fact that VectorType::emplace_back(EmbeddedVectorType&& mbed)
+  //    will not embed an empty vector, which ensures iterator will arrive at an actual element,
+  //    unless already at end of parent VectorType.
+  void check_and_push()
+  {
+    if (it != end) {
+      while (it->type() == Type::EMBEDDED_VECTOR) {
+        const VectorObject *embedded = it->toEmbeddedVector().ptr.get();
+        it_stack.emplace_back(it, end);
+        if (embedded->dense) {
+          enter_numbers(embedded);
+          return;
+        }
+        it = embedded->vec.begin();
+        end = embedded->vec.end();
+      }
+    }
+  }
+
+  // recursively increment and pop stack while at the end of EmbeddedVector(s)
+  void next()
+  {
+    while (++it == end && !it_stack.empty()) {
+      const auto& up = it_stack.back();
+      it = up.first;
+      end = up.second;
+      it_stack.pop_back();
+    }
+    check_and_push();
+  }
+
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Value;
+  using difference_type = void;
+  using reference = const value_type&;
+  using pointer = const value_type *;
+
+  iterator() : vo(EMPTY.ptr.get()), it_stack(), it(EMPTY.ptr->vec.begin()), end(EMPTY.ptr->vec.end()), index(0) {}
+  iterator(const VectorObject *v) : vo(v), it(v->vec.begin()), end(v->vec.end()), index(0) {
+    if (vo->dense) enter_numbers(vo);
+    else if (vo->embed_excess) check_and_push();
+  }
+  iterator(const VectorObject *v, bool /*end*/) : vo(v), index(v->size()) { }
+  iterator(const iterator& other) :
+    vo(other.vo), it_stack(other.it_stack), it(other.it), end(other.end),
+    number(other.number), numbers_end(other.numbers_end), current(other.current.clone()), index(other.index) {}
+  iterator& operator=(const iterator& other) {
+    if (this != &other) {
+      vo = other.vo;
+      it_stack = other.it_stack;
+      it = other.it;
+      end = other.end;
+      number = other.number;
+      numbers_end = other.numbers_end;
+      current = other.current.clone();
+      index = other.index;
+    }
+    return *this;
+  }
+  iterator(iterator&&) = default;
+  iterator& operator=(iterator&&) = default;
+
+  iterator& operator++() {
+    ++index;
+    if (number) {
+      if (++number != numbers_end) {
+        current = Value(*number);
+        return *this;
+      }
+      number = nullptr;
+      // leave an embedded dense vector
+      if (!it_stack.empty()) {
+        it = it_stack.back().first;
+        end = it_stack.back().second;
+        it_stack.pop_back();
+        next();
+      }
+    } else if (vo->embed_excess) {
+      next();
+    } else { // vo->vec is flat
+      it = vo->vec.begin() + static_cast<vec_t::iterator::difference_type>(index);
+    }
+    return *this;
+  }
+  reference operator*() const { return number ? current : *it; }
+  pointer operator->() const { return number ? &current : &*it; }
+  bool operator==(const iterator& other) const { return this->vo == other.vo && this->index == other.index; }
+  bool operator!=(const iterator& other) const { return this->vo != other.vo || this->index != other.index; }
+};
+
+inline Value::VectorType::const_iterator Value::VectorType::begin() const { return iterator(ptr.get()); }
+inline Value::VectorType::const_iterator Value::VectorType::end() const { return iterator(ptr.get(), true); }
+
 // The object type which ObjectType's shared_ptr points to.
 struct Value::ObjectType::ObjectObject {
   using obj_t = std::unordered_map<std::string, Value>;
@@ -29,6 +29,7 @@
 #include "core/Arguments.h"
 #include "core/Expression.h"
 #include "core/Builtins.h"
+#include "core/EvaluationSession.h"
 #include "utils/printutils.h"
 #include "core/UserModule.h"
 #include "utils/degree_trig.h"
@@ -40,6 +41,7 @@
 #include <utility>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <cmath>
 #include <sstream>
 #include <ctime>
@@ -62,7 +64,10 @@ int process_id = getpid();
 #endif
 
 std::mt19937 deterministic_rng(std::time(nullptr) + process_id);
+// Animation frames may be evaluated concurrently
+std::mutex rng_mutex;
 void initialize_rng() {
+  std::lock_guard<std::mutex> lock(rng_mutex);
   static uint64_t seed_val = 0;
   seed_val ^= uint64_t(std::time(nullptr) + process_id);
   deterministic_rng.seed(seed_val);
@@ -129,6 +134,8 @@ Value builtin_sign(Arguments arguments, const Location& loc)
 
 Value builtin_rands(Arguments arguments, const Location& loc)
 {
+  EvaluationSession::Worker::checkSafe("rands()");
+  arguments.session()->functionMemo().taint();
   if (arguments.size() < 3 || arguments.size() > 4) {
     print_argCnt_warning("rands", arguments.size(), "3 or 4", loc, arguments.documentRoot());
     return Value::undefined.clone();
@@ -167,6 +174,7 @@ Value builtin_rands(Arguments arguments, const Location& loc)
   }
   auto numresults = boost_numeric_cast<size_t, double>(numresultsd);
 
+  std::lock_guard<std::mutex> lock(rng_mutex);
   if (arguments.size() > 3) {
     auto seed = static_cast<uint32_t>(hash_floating_point(arguments[3]->toDouble() ));
     deterministic_rng.seed(seed);
@@ -698,6 +706,7 @@ Value builtin_version_num(Arguments arguments, const Location& loc)
 
 Value builtin_parent_module(Arguments arguments, const Location& loc)
 {
+  arguments.session()->functionMemo().taint();
   double d;
   if (arguments.size() == 0) {
     d = 1;
@@ -726,6 +735,10 @@ Value builtin_norm(Arguments arguments, const Location& loc)
     return Value::undefined.clone();
   }
   double sum = 0;
+  if (const auto *numbers = arguments[0]->toVector().numbers()) {
+    for (double x : *numbers) sum += x * x;
+    return {sqrt(sum)};
+  }
   for (const auto& v : arguments[0]->toVector()) {
     if (v.type() == Value::Type::NUMBER) {
       double x = v.toDouble();
@@ -746,8 +759,13 @@ Value builtin_cross(Arguments arguments, const Location& loc)
 
   const auto& v0 = arguments[0]->toVector();
   const auto& v1 = arguments[1]->toVector();
+  // Reads vectors of numbers without making Values of their elements
+  auto at = [](const VectorType& v, size_t i) {
+    const auto *numbers = v.numbers();
+    return numbers ? (*numbers)[i] : v[i].toDouble();
+  };
   if ((v0.size() == 2) && (v1.size() == 2)) {
-    return {v0[0].toDouble() * v1[1].toDouble() - v0[1].toDouble() * v1[0].toDouble()};
+    return {at(v0, 0) * at(v1, 1) - at(v0, 1) * at(v1, 0)};
   }
 
   if ((v0.size() != 3) || (v1.size() != 3)) {
@@ -755,12 +773,12 @@ Value builtin_cross(Arguments arguments, const Location& loc)
     return Value::undefined.clone();
   }
   for (unsigned int a = 0; a < 3; ++a) {
-    if ((v0[a].type() != Value::Type::NUMBER) || (v1[a].type() != Value::Type::NUMBER)) {
+    if ((!v0.numbers() && v0[a].type() != Value::Type::NUMBER) || (!v1.numbers() && v1[a].type() != Value::Type::NUMBER)) {
       LOG(message_group::Warning, loc, arguments.documentRoot(), "Invalid value in parameter vector for cross()");
       return Value::undefined.clone();
     }
-    double d0 = v0[a].toDouble();
-    double d1 = v1[a].toDouble();
+    double d0 = at(v0, a);
+    double d1 = at(v1, a);
     if (std::isnan(d0) || std::isnan(d1)) {
       LOG(message_group::Warning, loc, arguments.documentRoot(), "Invalid value (NaN) in parameter vector for cross()");
       return Value::undefined.clone();
@@ -771,15 +789,17 @@ Value builtin_cross(Arguments arguments, const Location& loc)
     }
   }
 
-  double x = v0[1].toDouble() * v1[2].toDouble() - v0[2].toDouble() * v1[1].toDouble();
-  double y = v0[2].toDouble() * v1[0].toDouble() - v0[0].toDouble() * v1[2].toDouble();
-  double z = v0[0].toDouble() * v1[1].toDouble() - v0[1].toDouble() * v1[0].toDouble();
+  double x = at(v0, 1) * at(v1, 2) - at(v0, 2) * at(v1, 1);
+  double y = at(v0, 2) * at(v1, 0) - at(v0, 0) * at(v1, 2);
+  double z = at(v0, 0) * at(v1, 1) - at(v0, 1) * at(v1, 0);
 
   return VectorType(arguments.session(), x, y, z);
 }
 
 Value builtin_textmetrics(Arguments arguments, const Location& loc)
 {
+  EvaluationSession::Worker::checkSafe("textmetrics()");
+  arguments.session()->functionMemo().taint();
   auto *session = arguments.session();
   Parameters parameters = Parameters::parse(std::move(arguments), loc,
                                             { "text", "size", "font" },
@@ -834,6 +854,8 @@ Value builtin_textmetrics(Arguments arguments, const Location& loc)
 
 Value builtin_fontmetrics(Arguments arguments, const Location& loc)
 {
+  EvaluationSession::Worker::checkSafe("fontmetrics()");
+  arguments.session()->functionMemo().taint();
   auto *session = arguments.session();
   Parameters parameters = Parameters::parse(std::move(arguments), loc,
                                             { "size", "font" }
@@ -936,6 +958,8 @@ Value builtin_is_object(Arguments arguments, const Location& loc)
 
 Value builtin_import(Arguments arguments, const Location& loc)
 {
+  EvaluationSession::Worker::checkSafe("import()");
+  arguments.session()->functionMemo().taint();
   auto session = arguments.session();
   const Parameters parameters = Parameters::parse(std::move(arguments), loc, {}, {"file"});
   std::string raw_filename = parameters.get("file", "");
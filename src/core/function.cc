@@ -28,6 +28,7 @@
 
 #include "core/AST.h"
 #include "core/Arguments.h"
+#include "core/Bytecode.h"
 #include "core/Expression.h"
 
 #include <ostream>
@@ -41,6 +42,7 @@ BuiltinFunction::BuiltinFunction(Value(*f)(const std::shared_ptr<const Context>&
 {}
 
 BuiltinFunction::BuiltinFunction(Value(*f)(Arguments, const Location&), const Feature *feature) :
+  arguments_function(f),
   feature(feature)
 {
   evaluate = [f] (const std::shared_ptr<const Context>& context, const FunctionCall *call) {
@@ -49,10 +51,21 @@ BuiltinFunction::BuiltinFunction(Value(*f)(Arguments, const Location&), const Fe
 }
 
 UserFunction::UserFunction(const char *name, AssignmentList& parameters, std::shared_ptr<Expression> expr, const Location& loc)
-  : ASTNode(loc), name(name), parameters(parameters), expr(std::move(expr))
+  : ASTNode(loc), name(name), parameters(parameters), scope(this->parameters), expr(std::move(expr))
 {
 }
 
+UserFunction::~UserFunction() = default;
+
+const CompiledFunction *UserFunction::compiled() const
+{
+  if (!Feature::ExperimentalFunctionBytecode.is_enabled()) return nullptr;
+  std::call_once(compile_flag, [this]() {
+      bytecode = CompiledFunction::compile(*this);
+    });
+  return bytecode.get();
+}
+
 void UserFunction::print(std::ostream& stream, const std::string& indent) const
 {
   stream << indent << "function " << name << "(";
@@ -2,22 +2,27 @@
 
 #include "core/AST.h"
 #include "core/Assignment.h"
+#include "core/LexicalScope.h"
 #include "Feature.h"
 #include "core/Value.h"
 
 #include <ostream>
 #include <memory>
+#include <mutex>
 #include <functional>
 #include <string>
 #include <variant>
 
 class Arguments;
+class CompiledFunction;
 class FunctionCall;
 
 class BuiltinFunction
 {
 public:
   std::function<Value(const std::shared_ptr<const Context>&, const FunctionCall *)> evaluate;
+  // Set for builtins that only need their evaluated arguments, so compiled code can call them directly
+  Value (*arguments_function)(Arguments, const Location&){nullptr};
 
 private:
   const Feature *feature;
@@ -35,11 +40,21 @@ class UserFunction : public ASTNode
 public:
   std::string name;
   AssignmentList parameters;
+  LexicalScope scope; // parameters of the call frame
   std::shared_ptr<Expression> expr;
+  bool pure{false}; // no side effects or special variable reads, set by the ScopeResolver
 
   UserFunction(const char *name, AssignmentList& parameters, std::shared_ptr<Expression> expr, const Location& loc);
+  ~UserFunction() override;
 
   void print(std::ostream& stream, const std::string& indent) const override;
+
+  // The body compiled on first use, or nullptr if function-bytecode is disabled or the function can't be compiled
+  [[nodiscard]] const CompiledFunction *compiled() const;
+
+private:
+  mutable std::once_flag compile_flag;
+  mutable std::unique_ptr<const CompiledFunction> bytecode;
 };
 
 
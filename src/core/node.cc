@@ -37,7 +37,7 @@
 #include <algorithm>
 #include <string>
 
-size_t AbstractNode::idx_counter;
+thread_local size_t AbstractNode::idx_counter;
 
 AbstractNode::AbstractNode(const ModuleInstantiation *mi) :
   modinst(mi),
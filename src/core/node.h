@@ -3,6 +3,7 @@
 #include <ostream>
 #include <memory>
 #include <cstddef>
+#include <optional>
 #include <utility>
 #include <vector>
 #include <string>
@@ -11,6 +12,7 @@
 #include "core/BaseVisitable.h"
 #include "core/AST.h"
 #include "core/ModuleInstantiation.h"
+#include "core/NodeHash.h"
 
 extern int progress_report_count;
 extern void (*progress_report_f)(const std::shared_ptr<const AbstractNode>&, void *, int);
@@ -32,7 +34,7 @@ class AbstractNode : public BaseVisitable, public std::enable_shared_from_this<A
   // We can hash on pointer value or smth. else.
   //  -> remove and
   // use smth. else to display node identifier in CSG tree output?
-  static size_t idx_counter; // Node instantiation index
+  static thread_local size_t idx_counter; // Node instantiation index, per thread evaluating a tree
 public:
   VISITABLE();
   AbstractNode(const ModuleInstantiation *mi);
@@ -50,7 +52,8 @@ public:
   }
   size_t index() const { return this->idx; }
 
-  static void resetIndexCounter() { idx_counter = 1; }
+  static void resetIndexCounter(size_t next = 1) { idx_counter = next; }
+  static size_t nextIndex() { return idx_counter; }
 
   // FIXME: Make protected
   std::vector<std::shared_ptr<AbstractNode>> children;
@@ -64,6 +67,15 @@ public:
 
   int idx; // Node index (unique per tree)
 
+  // What NodeHasher needs to fold this subtree into its parent
+  struct SubtreeHash {
+    NodeHash hash;
+    bool empty;   // contributes nothing to the hash of its parent
+    bool counted; // counts as a child of a parent group, see GroupNodeChecker
+  };
+  // Set by NodeHasher::hashInstantiated() once the subtree is instantiated
+  std::optional<SubtreeHash> subtree_hash;
+
   std::shared_ptr<const AbstractNode> getNodeByID(int idx, std::deque<std::shared_ptr<const AbstractNode>>& path) const;
 };
 
@@ -41,6 +41,7 @@
 #include "core/ModuleInstantiation.h"
 #include "core/Assignment.h"
 #include "core/Expression.h"
+#include "core/ScopeResolver.h"
 #include "core/function.h"
 #include "io/fileutils.h"
 #include "utils/printutils.h"
@@ -802,5 +803,6 @@ bool parse(SourceFile *&file, const std::string& text, const std::string &filena
   parser_input_buffer = nullptr;
   scope_stack.pop();
 
+  ScopeResolver::resolve(rootfile->scope);
   return true;
 }
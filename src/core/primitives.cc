@@ -208,9 +208,9 @@ std::unique_ptr<const Geometry> SphereNode::createGeometry() const
     generate_circle(std::back_inserter(polyset->vertices), radius, r * cos_degrees(phi), num_fragments);
   }
 
-  polyset->indices.push_back({});
+  polyset->indices.emplace_back();
   for (int i = 0; i < num_fragments; ++i) {
-    polyset->indices.back().push_back(i);
+    polyset->indices.add_to_back(i);
   }
 
   for (int i = 0; i < num_rings - 1; ++i) {
@@ -224,9 +224,9 @@ std::unique_ptr<const Geometry> SphereNode::createGeometry() const
     }
   }
 
-  polyset->indices.push_back({});
+  polyset->indices.emplace_back();
   for (int i = 0; i < num_fragments; ++i) {
-    polyset->indices.back().push_back(num_rings * num_fragments - i - 1);
+    polyset->indices.add_to_back(num_rings * num_fragments - i - 1);
   }
 
   return polyset;
@@ -300,16 +300,16 @@ std::unique_ptr<const Geometry> CylinderNode::createGeometry() const
   }
 
   if (!inverted_cone) {
-    polyset->indices.push_back({});
+    polyset->indices.emplace_back();
     for (int i = 0; i < num_fragments; ++i) {
-      polyset->indices.back().push_back(num_fragments-i-1);
+      polyset->indices.add_to_back(num_fragments-i-1);
     }
   }
   if (!cone) {
-    polyset->indices.push_back({});
+    polyset->indices.emplace_back();
     int offset = inverted_cone ? 1 : num_fragments;
     for (int i = 0; i < num_fragments; ++i) {
-      polyset->indices.back().push_back(offset+i);
+      polyset->indices.add_to_back(offset+i);
     }
   }
 
@@ -411,7 +411,7 @@ std::unique_ptr<const Geometry> PolyhedronNode::createGeometry() const
   p->vertices=this->points;
   p->indices=this->faces;
   bool is_triangular = true;
-  for (auto &poly : p->indices) {
+  for (auto poly : p->indices) {
     std::reverse(poly.begin(),poly.end());
     if (is_triangular && poly.size() > 3) {
       is_triangular = false;
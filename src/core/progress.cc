@@ -1,6 +1,7 @@
 #include "core/progress.h"
 
 #include <memory>
+#include <mutex>
 #include "core/node.h"
 
 int progress_report_count;
@@ -8,6 +9,11 @@ int progress_mark_;
 void (*progress_report_f)(const std::shared_ptr<const AbstractNode> &, void *, int);
 void *progress_report_userdata;
 
+namespace {
+// Geometry may be evaluated from multiple threads, see GeometryEvaluator::evaluateChildrenInParallel()
+std::mutex progress_mutex;
+}
+
 void progress_report_prep(const std::shared_ptr<AbstractNode> &root, void (*f)(const std::shared_ptr<const AbstractNode> &node, void *userdata, int mark), void *userdata)
 {
   progress_report_count = 0;
@@ -26,6 +32,7 @@ void progress_report_fin()
 void progress_update(const std::shared_ptr<const AbstractNode> &node, int mark)
 {
   if (progress_report_f) {
+    std::lock_guard lock(progress_mutex);
     progress_mark_ = mark;
     progress_report_f(node, progress_report_userdata, progress_mark_);
   }
@@ -33,5 +40,8 @@ void progress_update(const std::shared_ptr<const AbstractNode> &node, int mark)
 
 void progress_tick()
 {
-  if (progress_report_f) progress_report_f(std::shared_ptr<const AbstractNode>(), progress_report_userdata, ++progress_mark_);
+  if (progress_report_f) {
+    std::lock_guard lock(progress_mutex);
+    progress_report_f(std::shared_ptr<const AbstractNode>(), progress_report_userdata, ++progress_mark_);
+  }
 }
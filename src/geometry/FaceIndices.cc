@@ -0,0 +1,94 @@
+#include "geometry/FaceIndices.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#include "geometry/GeometryUtils.h"
+
+FaceIndices::FaceIndices(std::initializer_list<std::initializer_list<int>> faces)
+{
+  reserve(faces.size());
+  for (const auto& face : faces) push_back(face);
+}
+
+FaceIndices::FaceIndices(const PolygonIndices& faces)
+{
+  size_t total = 0;
+  for (const auto& face : faces) total += face.size();
+  reserve(faces.size(), total);
+  for (const auto& face : faces) push_back(face);
+}
+
+size_t FaceIndices::memsize() const
+{
+  return indices_.capacity() * sizeof(int) + offsets_.capacity() * sizeof(size_t);
+}
+
+// Grows geometrically, as builders often reserve a little more at a time
+void FaceIndices::reserve(size_t faces, size_t indices)
+{
+  if (indices == 0) indices = 3 * faces;
+  if (indices > indices_.capacity()) indices_.reserve(std::max(indices, 2 * indices_.capacity()));
+  if (!offsets_.empty() && faces + 1 > offsets_.capacity()) {
+    offsets_.reserve(std::max(faces + 1, 2 * offsets_.capacity()));
+  }
+}
+
+void FaceIndices::clear()
+{
+  indices_.clear();
+  offsets_.clear();
+}
+
+// Also returns to the triangle layout if every face is a triangle
+void FaceIndices::shrink_to_fit()
+{
+  if (!offsets_.empty()) {
+    bool triangles = indices_.size() == 3 * size();
+    for (size_t i = 0, n = size(); triangles && i < n; ++i) {
+      triangles = faceSize(i) == 3;
+    }
+    if (triangles) offsets_.clear();
+  }
+  indices_.shrink_to_fit();
+  offsets_.shrink_to_fit();
+}
+
+void FaceIndices::emplace_back()
+{
+  addOffsets();
+  offsets_.push_back(indices_.size());
+}
+
+void FaceIndices::add_to_back(int index)
+{
+  addOffsets();
+  indices_.push_back(index);
+  offsets_.back() = indices_.size();
+}
+
+void FaceIndices::addOffsets()
+{
+  if (!offsets_.empty()) return;
+  const size_t n = indices_.size() / 3;
+  offsets_.reserve(std::max(n + 1, indices_.capacity() / 3 + 1));
+  for (size_t i = 0; i <= n; ++i) offsets_.push_back(3 * i);
+}
+
+void FaceIndices::append(const int *first, size_t n)
+{
+  const int *data = indices_.data();
+  const size_t size = indices_.size();
+  const std::less<const int *> before;
+  if (!before(first, data) && before(first, data + size)) {
+    // Growing indices_ may move them, so they are copied by position
+    const size_t from = first - data;
+    indices_.resize(size + n);
+    std::copy_n(indices_.begin() + from, n, indices_.begin() + size);
+  } else {
+    indices_.insert(indices_.end(), first, first + n);
+  }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "geometry/GeometryUtils.h"
+
+/*!
+   The vertex indices of one face of a FaceIndices. The indices can be
+   modified unless T is const, but the face can't change its size.
+ */
+template <typename T>
+class FaceSpan
+{
+public:
+  using value_type = std::remove_const_t<T>;
+  using iterator = T *;
+  using const_iterator = T *;
+
+  FaceSpan() = default;
+  FaceSpan(T *first, size_t size) : first_(first), size_(size) {}
+  // A modifiable face can be read as a const one
+  template <typename U, std::enable_if_t<std::is_same_v<const U, T> && !std::is_same_v<U, T>, int> = 0>
+  FaceSpan(const FaceSpan<U>& face) : first_(face.begin()), size_(face.size()) {}
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] T *data() const { return first_; }
+  [[nodiscard]] T *begin() const { return first_; }
+  [[nodiscard]] T *end() const { return first_ + size_; }
+  T& operator[](size_t i) const { return first_[i]; }
+  T& front() const { return first_[0]; }
+  T& back() const { return first_[size_ - 1]; }
+
+private:
+  T *first_{nullptr};
+  size_t size_{0};
+};
+
+/*!
+   The faces of a PolySet, as indices into its vertices.
+
+   All indices are stored in one flat array, face after face, with the
+   offset of each face into it in a second array (compressed sparse rows).
+   As long as every face is a triangle the offsets are left out, so a
+   triangle mesh takes 12 bytes per face, laid out like a
+   std::vector<Vector3i>, and finding a face is a multiplication.
+
+   Faces are read and modified through FaceSpans, which iterating yields by
+   value: use `for (auto face : indices)` to modify them in place. Only the
+   last face can grow, so faces are appended whole with push_back(), or
+   index by index with emplace_back() and add_to_back().
+ */
+class FaceIndices
+{
+public:
+  using Face = FaceSpan<int>;
+  using ConstFace = FaceSpan<const int>;
+  using value_type = ConstFace; // for std::back_inserter()
+
+  template <typename T>
+  class Iterator
+  {
+  public:
+    using Container = std::conditional_t<std::is_const_v<T>, const FaceIndices, FaceIndices>;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = FaceSpan<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = FaceSpan<T>;
+
+    Iterator() = default;
+    Iterator(Container *faces, size_t index) : faces_(faces), index_(index) {}
+
+    FaceSpan<T> operator*() const { return (*faces_)[index_]; }
+    FaceSpan<T> operator[](difference_type n) const { return (*faces_)[index_ + n]; }
+    Iterator& operator++() { ++index_; return *this; }
+    Iterator operator++(int) { Iterator it = *this; ++index_; return it; }
+    Iterator& operator--() { --index_; return *this; }
+    Iterator operator--(int) { Iterator it = *this; --index_; return it; }
+    Iterator& operator+=(difference_type n) { index_ += n; return *this; }
+    Iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+    Iterator operator+(difference_type n) const { return {faces_, index_ + n}; }
+    Iterator operator-(difference_type n) const { return {faces_, index_ - n}; }
+    difference_type operator-(const Iterator& other) const {
+      return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+    bool operator==(const Iterator& other) const { return index_ == other.index_; }
+    bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+    bool operator<(const Iterator& other) const { return index_ < other.index_; }
+    bool operator>(const Iterator& other) const { return index_ > other.index_; }
+    bool operator<=(const Iterator& other) const { return index_ <= other.index_; }
+    bool operator>=(const Iterator& other) const { return index_ >= other.index_; }
+    friend Iterator operator+(difference_type n, const Iterator& it) { return it + n; }
+
+  private:
+    Container *faces_{nullptr};
+    size_t index_{0};
+  };
+  using iterator = Iterator<int>;
+  using const_iterator = Iterator<const int>;
+
+  FaceIndices() = default;
+  FaceIndices(std::initializer_list<std::initializer_list<int>> faces);
+  FaceIndices(const PolygonIndices& faces);
+
+  [[nodiscard]] size_t size() const { return offsets_.empty() ? indices_.size() / 3 : offsets_.size() - 1; }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+  // The number of indices of all faces
+  [[nodiscard]] size_t numIndices() const { return indices_.size(); }
+  [[nodiscard]] size_t memsize() const;
+
+  /*!
+     True while every face is a triangle stored without offsets: data() is
+     then the corners of the triangles, three by three.
+   */
+  [[nodiscard]] bool onlyTriangles() const { return offsets_.empty(); }
+  [[nodiscard]] const int *data() const { return indices_.data(); }
+
+  Face operator[](size_t i) { return {indices_.data() + offset(i), faceSize(i)}; }
+  ConstFace operator[](size_t i) const { return {indices_.data() + offset(i), faceSize(i)}; }
+  Face front() { return (*this)[0]; }
+  ConstFace front() const { return (*this)[0]; }
+  Face back() { return (*this)[size() - 1]; }
+  ConstFace back() const { return (*this)[size() - 1]; }
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, size()}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, size()}; }
+
+  // Reserves for a number of faces, with three indices each unless given
+  void reserve(size_t faces, size_t indices = 0);
+  void clear();
+  void shrink_to_fit();
+
+  void push_back(std::initializer_list<int> face) { push_back<std::initializer_list<int>>(face); }
+  template <class Range>
+  void push_back(const Range& face) {
+    const size_t n = std::distance(std::begin(face), std::end(face));
+    if (n != 3) addOffsets();
+    if constexpr (std::is_pointer_v<decltype(std::begin(face))>) {
+      // May be a face of this, as in push_back(faces[i])
+      append(std::begin(face), n);
+    } else {
+      indices_.insert(indices_.end(), std::begin(face), std::end(face));
+    }
+    if (!offsets_.empty()) offsets_.push_back(indices_.size());
+  }
+  // Appends an empty face, to be filled with add_to_back()
+  void emplace_back();
+  void add_to_back(int index);
+
+private:
+  [[nodiscard]] size_t offset(size_t i) const { return offsets_.empty() ? 3 * i : offsets_[i]; }
+  [[nodiscard]] size_t faceSize(size_t i) const { return offsets_.empty() ? 3 : offsets_[i + 1] - offsets_[i]; }
+  // Switches from the triangle layout to explicit offsets
+  void addOffsets();
+  // Appends n indices, which may be some of indices_
+  void append(const int *first, size_t n);
+
+  std::vector<int> indices_;
+  std::vector<size_t> offsets_; // size() + 1 entries, or none if all faces are triangles
+};
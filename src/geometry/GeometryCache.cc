@@ -10,26 +10,34 @@
 #include "geometry/cgal/CGAL_Nef_polyhedron.h"
 #endif
 
-GeometryCache *GeometryCache::inst = nullptr;
+std::shared_ptr<const Geometry> GeometryCache::get(const NodeHash& id) const
+{
+  std::shared_ptr<const Geometry> geom;
+  get(id, geom);
+  return geom;
+}
 
-std::shared_ptr<const Geometry> GeometryCache::get(const std::string& id) const
+bool GeometryCache::get(const NodeHash& id, std::shared_ptr<const Geometry>& geom) const
 {
-  const auto& geom = this->cache[id]->geom;
+  const auto entry = this->cache.get(id);
+  // The entry may have been evicted by another thread since contains() was called
+  if (!entry) return false;
+  geom = entry->geom;
 #ifdef DEBUG
-  PRINTDB("Geometry Cache hit: %s (%d bytes)", id.substr(0, 40) % (geom ? geom->memsize() : 0));
+  PRINTDB("Geometry Cache hit: %s (%d bytes)", id.toString() % (geom ? geom->memsize() : 0));
 #endif
-  return geom;
+  return true;
 }
 
-bool GeometryCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& geom)
+bool GeometryCache::insert(const NodeHash& id, const std::shared_ptr<const Geometry>& geom)
 {
-  auto inserted = this->cache.insert(id, new cache_entry(geom), geom ? geom->memsize() : 0);
+  auto inserted = this->cache.insert(id, std::make_shared<const cache_entry>(geom), geom ? geom->memsize() : 0);
 #if defined(ENABLE_CGAL) && defined(DEBUG)
   assert(!dynamic_cast<const CGAL_Nef_polyhedron *>(geom.get()));
   if (inserted) PRINTDB("Geometry Cache insert: %s (%d bytes)",
-                        id.substr(0, 40) % (geom ? geom->memsize() : 0));
+                        id.toString() % (geom ? geom->memsize() : 0));
   else PRINTDB("Geometry Cache insert failed: %s (%d bytes)",
-               id.substr(0, 40) % (geom ? geom->memsize() : 0));
+               id.toString() % (geom ? geom->memsize() : 0));
 #endif
   return inserted;
 }
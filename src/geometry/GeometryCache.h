@@ -3,8 +3,10 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
-#include "Cache.h"
+#include "ShardedCache.h"
+#include "core/NodeHash.h"
 #include "geometry/Geometry.h"
 
 class GeometryCache
@@ -12,26 +14,27 @@ class GeometryCache
 public:
   GeometryCache(size_t memorylimit = 100ul * 1024ul * 1024ul) : cache(memorylimit) {}
 
-  static GeometryCache *instance() { if (!inst) inst = new GeometryCache; return inst; }
+  static GeometryCache *instance() { static auto *inst = new GeometryCache; return inst; }
 
-  bool contains(const std::string& id) const { return this->cache.contains(id); }
-  std::shared_ptr<const class Geometry> get(const std::string& id) const;
-  bool insert(const std::string& id, const std::shared_ptr<const Geometry>& geom);
+  bool contains(const NodeHash& id) const { return this->cache.contains(id); }
+  std::shared_ptr<const class Geometry> get(const NodeHash& id) const;
+  // Like get(), but also tells an empty cached result from a miss
+  bool get(const NodeHash& id, std::shared_ptr<const Geometry>& geom) const;
+  bool insert(const NodeHash& id, const std::shared_ptr<const Geometry>& geom);
   size_t size() const;
   size_t totalCost() const;
   size_t maxSizeMB() const;
   void setMaxSizeMB(size_t limit);
   void clear() { cache.clear(); }
   void print();
+  std::vector<CacheShardStatistic> statistics() const { return cache.statistics(); }
 
 private:
-  static GeometryCache *inst;
-
   struct cache_entry {
     std::shared_ptr<const class Geometry> geom;
     std::string msg;
     cache_entry(const std::shared_ptr<const Geometry>& geom);
   };
 
-  Cache<std::string, cache_entry> cache;
+  ShardedCache<NodeHash, cache_entry> cache;
 };
@@ -0,0 +1,598 @@
+#include "geometry/GeometryDiskCache.h"
+#include "geometry/Geometry.h"
+#include "geometry/PolySet.h"
+#include "geometry/Polygon2d.h"
+#include "glview/RenderSettings.h"
+#include "utils/printutils.h"
+#include "version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#ifdef ENABLE_CGAL
+#include "geometry/cgal/cgal.h"
+#include "geometry/cgal/CGAL_Nef_polyhedron.h"
+#include <CGAL/IO/Nef_polyhedron_iostream_3.h>
+#endif
+#ifdef ENABLE_MANIFOLD
+#include "geometry/manifold/ManifoldGeometry.h"
+#endif
+
+namespace fs = std::filesystem;
+namespace bip = boost::interprocess;
+
+GeometryDiskCache *GeometryDiskCache::inst = nullptr;
+
+namespace {
+
+constexpr char MAGIC[4] = {'O', 'S', 'G', 'C'};
+// Bump when the serialization format changes
+constexpr uint32_t FORMAT_VERSION = 2;
+constexpr auto FILE_EXTENSION = ".geom";
+constexpr auto TEMP_EXTENSION = ".tmp";
+// Temporary files older than this were left behind by a writer that crashed or was killed
+constexpr auto TEMP_FILE_GRACE = std::chrono::minutes(10);
+
+enum class GeometryType : uint8_t {
+  POLYSET = 1,
+  POLYGON2D = 2,
+  MANIFOLD = 3,
+  NEF = 4,
+};
+
+class BlobWriter
+{
+public:
+  template <typename T> void write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  template <typename T> void writeVector(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write<uint64_t>(values.size());
+    buffer.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+  }
+  void writeString(const std::string& str) {
+    write<uint64_t>(str.size());
+    buffer.append(str);
+  }
+
+  std::string buffer;
+};
+
+// Bounds-checked reader over a memory-mapped file. Any read past the end
+// clears ok and returns default values.
+class BlobReader
+{
+public:
+  BlobReader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+  template <typename T> T read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value{};
+    if (!has(sizeof(T))) return value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+  }
+  // Reads an element count, checking that count elements of the given size can follow
+  size_t readCount(size_t elementsize) {
+    const auto count = read<uint64_t>();
+    if (!ok || (elementsize > 0 && count > size_t(end - pos) / elementsize)) {
+      ok = false;
+      return 0;
+    }
+    return count;
+  }
+  template <typename T> void readVector(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    values.resize(readCount(sizeof(T)));
+    if (!values.empty()) {
+      std::memcpy(values.data(), pos, values.size() * sizeof(T));
+      pos += values.size() * sizeof(T);
+    }
+  }
+  std::string readString() {
+    const auto size = readCount(1);
+    std::string str(pos, size);
+    pos += size;
+    return str;
+  }
+
+  bool ok{true};
+
+private:
+  bool has(size_t size) {
+    if (size_t(end - pos) < size) ok = false;
+    return ok;
+  }
+
+  const char *pos;
+  const char *end;
+};
+
+class GeometrySerializer : public GeometryVisitor
+{
+public:
+  GeometrySerializer(BlobWriter& out) : out(out) {}
+
+  void visit(const GeometryList& /*geomlist*/) override { supported = false; }
+
+  void visit(const PolySet& ps) override {
+    out.write(GeometryType::POLYSET);
+    out.write<int32_t>(ps.getConvexity());
+    out.write<uint32_t>(ps.getDimension());
+    out.write<uint8_t>(ps.isTriangular());
+    const auto convex = ps.convexValue();
+    out.write<int8_t>(convex ? 1 : !convex ? 0 : -1);
+    out.write<uint64_t>(ps.vertices.size());
+    for (const auto& v : ps.vertices) {
+      out.write(v[0]);
+      out.write(v[1]);
+      out.write(v[2]);
+    }
+    out.write<uint64_t>(ps.indices.size());
+    for (const auto& face : ps.indices) {
+      out.write<uint32_t>(face.size());
+      for (const auto idx : face) out.write<int32_t>(idx);
+    }
+    out.writeVector(ps.color_indices);
+    out.write<uint64_t>(ps.colors.size());
+    for (const auto& c : ps.colors) {
+      for (int i = 0; i < 4; ++i) out.write(c[i]);
+    }
+  }
+
+  void visit(const Polygon2d& poly) override {
+    out.write(GeometryType::POLYGON2D);
+    out.write<int32_t>(poly.getConvexity());
+    out.write<uint8_t>(poly.isSanitized());
+    out.write<uint64_t>(poly.outlines().size());
+    for (const auto& outline : poly.outlines()) {
+      out.write<uint8_t>(outline.positive);
+      out.write<uint64_t>(outline.vertices.size());
+      for (const auto& v : outline.vertices) {
+        out.write(v[0]);
+        out.write(v[1]);
+      }
+    }
+  }
+
+#ifdef ENABLE_CGAL
+  void visit(const CGAL_Nef_polyhedron& N) override {
+    if (!N.p3) {
+      supported = false;
+      return;
+    }
+    // The exact SNC representation; converting to doubles would change later CSG results
+    std::ostringstream snc;
+    snc << const_cast<CGAL_Nef_polyhedron3&>(*N.p3);
+    out.write(GeometryType::NEF);
+    out.writeString(snc.str());
+  }
+#endif
+
+#ifdef ENABLE_MANIFOLD
+  void visit(const ManifoldGeometry& mani) override {
+    const auto mesh = mani.getManifold().GetMeshGL64();
+    out.write(GeometryType::MANIFOLD);
+    out.write<int32_t>(mani.getConvexity());
+    out.write<uint64_t>(mesh.numProp);
+    out.writeVector(mesh.vertProperties);
+    out.writeVector(mesh.triVerts);
+    out.writeVector(mesh.mergeFromVert);
+    out.writeVector(mesh.mergeToVert);
+    out.writeVector(mesh.runIndex);
+    out.writeVector(mesh.runOriginalID);
+    out.writeVector(mesh.runTransform);
+    out.writeVector(mesh.faceID);
+    out.write(mesh.tolerance);
+    out.writeVector(std::vector<uint32_t>(mani.getOriginalIDs().begin(), mani.getOriginalIDs().end()));
+    out.write<uint64_t>(mani.getOriginalIDToColor().size());
+    for (const auto& [id, color] : mani.getOriginalIDToColor()) {
+      out.write(id);
+      for (int i = 0; i < 4; ++i) out.write(color[i]);
+    }
+    out.writeVector(std::vector<uint32_t>(mani.getSubtractedIDs().begin(), mani.getSubtractedIDs().end()));
+  }
+#endif
+
+  bool supported{true};
+
+private:
+  BlobWriter& out;
+};
+
+std::shared_ptr<const Geometry> readPolySet(BlobReader& in)
+{
+  const auto convexity = in.read<int32_t>();
+  const auto dim = in.read<uint32_t>();
+  const auto triangular = in.read<uint8_t>();
+  const auto convex = in.read<int8_t>();
+  auto ps = std::make_shared<PolySet>(dim, convex < 0 ? boost::tribool(boost::indeterminate) : boost::tribool(convex > 0));
+  ps->setConvexity(convexity);
+  ps->setTriangular(triangular);
+
+  ps->vertices.resize(in.readCount(3 * sizeof(double)));
+  for (auto& v : ps->vertices) {
+    const auto x = in.read<double>();
+    const auto y = in.read<double>();
+    const auto z = in.read<double>();
+    v = {x, y, z};
+  }
+  const size_t num_faces = in.readCount(sizeof(uint32_t));
+  ps->indices.reserve(num_faces);
+  IndexedFace face;
+  for (size_t i = 0; i < num_faces; ++i) {
+    face.resize(in.readCount(sizeof(int32_t)));
+    for (auto& idx : face) {
+      idx = in.read<int32_t>();
+      if (idx < 0 || size_t(idx) >= ps->vertices.size()) in.ok = false;
+    }
+    if (!in.ok) return nullptr;
+    ps->indices.push_back(face);
+  }
+  in.readVector(ps->color_indices);
+  ps->colors.resize(in.readCount(4 * sizeof(float)));
+  for (auto& c : ps->colors) {
+    for (int i = 0; i < 4; ++i) c[i] = in.read<float>();
+  }
+  return in.ok ? ps : nullptr;
+}
+
+std::shared_ptr<const Geometry> readPolygon2d(BlobReader& in)
+{
+  auto poly = std::make_shared<Polygon2d>();
+  poly->setConvexity(in.read<int32_t>());
+  poly->setSanitized(in.read<uint8_t>());
+  const auto numoutlines = in.readCount(sizeof(uint8_t) + sizeof(uint64_t));
+  for (size_t i = 0; i < numoutlines && in.ok; ++i) {
+    Outline2d outline;
+    outline.positive = in.read<uint8_t>();
+    outline.vertices.resize(in.readCount(2 * sizeof(double)));
+    for (auto& v : outline.vertices) {
+      const auto x = in.read<double>();
+      const auto y = in.read<double>();
+      v = {x, y};
+    }
+    poly->addOutline(std::move(outline));
+  }
+  return in.ok ? poly : nullptr;
+}
+
+#ifdef ENABLE_CGAL
+std::shared_ptr<const Geometry> readNef(BlobReader& in)
+{
+  std::istringstream snc(in.readString());
+  if (!in.ok) return nullptr;
+  try {
+    auto nef = std::make_shared<CGAL_Nef_polyhedron3>();
+    snc >> *nef;
+    return std::make_shared<CGAL_Nef_polyhedron>(nef);
+  } catch (const CGAL::Failure_exception& e) {
+    LOG(message_group::Warning, "Geometry disk cache: Unable to read Nef polyhedron: %1$s", e.what());
+  }
+  return nullptr;
+}
+#endif
+
+#ifdef ENABLE_MANIFOLD
+std::shared_ptr<const Geometry> readManifold(BlobReader& in)
+{
+  const auto convexity = in.read<int32_t>();
+  manifold::MeshGL64 mesh;
+  mesh.numProp = in.read<uint64_t>();
+  in.readVector(mesh.vertProperties);
+  in.readVector(mesh.triVerts);
+  in.readVector(mesh.mergeFromVert);
+  in.readVector(mesh.mergeToVert);
+  in.readVector(mesh.runIndex);
+  in.readVector(mesh.runOriginalID);
+  in.readVector(mesh.runTransform);
+  in.readVector(mesh.faceID);
+  mesh.tolerance = in.read<decltype(mesh.tolerance)>();
+  std::vector<uint32_t> originalIDs;
+  in.readVector(originalIDs);
+  std::map<uint32_t, Color4f> originalIDToColor;
+  const auto numcolors = in.readCount(sizeof(uint32_t) + 4 * sizeof(float));
+  for (size_t i = 0; i < numcolors; ++i) {
+    const auto id = in.read<uint32_t>();
+    Color4f color;
+    for (int j = 0; j < 4; ++j) color[j] = in.read<float>();
+    originalIDToColor[id] = color;
+  }
+  std::vector<uint32_t> subtractedIDs;
+  in.readVector(subtractedIDs);
+  if (!in.ok) return nullptr;
+
+  // Original IDs are only unique within one process, so map the stored ones
+  // to freshly reserved IDs to avoid clashing with meshes created in this run.
+  std::map<uint32_t, uint32_t> idmap;
+  for (const auto id : mesh.runOriginalID) idmap.emplace(id, 0);
+  for (const auto id : originalIDs) idmap.emplace(id, 0);
+  for (const auto& [id, color] : originalIDToColor) idmap.emplace(id, 0);
+  for (const auto id : subtractedIDs) idmap.emplace(id, 0);
+  auto next_id = manifold::Manifold::ReserveIDs(idmap.size());
+  for (auto& [id, newid] : idmap) newid = next_id++;
+
+  for (auto& id : mesh.runOriginalID) id = idmap[id];
+  std::set<uint32_t> newOriginalIDs;
+  for (const auto id : originalIDs) newOriginalIDs.insert(idmap[id]);
+  std::map<uint32_t, Color4f> newOriginalIDToColor;
+  for (const auto& [id, color] : originalIDToColor) newOriginalIDToColor[idmap[id]] = color;
+  std::set<uint32_t> newSubtractedIDs;
+  for (const auto id : subtractedIDs) newSubtractedIDs.insert(idmap[id]);
+
+  manifold::Manifold mani(mesh);
+  if (mani.Status() != manifold::Manifold::Error::NoError) return nullptr;
+  auto geom = std::make_shared<ManifoldGeometry>(mani, newOriginalIDs, newOriginalIDToColor, newSubtractedIDs);
+  geom->setConvexity(convexity);
+  return geom;
+}
+#endif
+
+std::shared_ptr<const Geometry> readGeometry(BlobReader& in)
+{
+  switch (in.read<GeometryType>()) {
+  case GeometryType::POLYSET: return readPolySet(in);
+  case GeometryType::POLYGON2D: return readPolygon2d(in);
+#ifdef ENABLE_CGAL
+  case GeometryType::NEF: return readNef(in);
+#endif
+#ifdef ENABLE_MANIFOLD
+  case GeometryType::MANIFOLD: return readManifold(in);
+#endif
+  default: return nullptr;
+  }
+}
+
+} // namespace
+
+bool GeometryDiskCache::setDirectory(const fs::path& dir, size_t maxSizeMB)
+{
+  std::lock_guard lock(this->mutex);
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (!fs::is_directory(dir, ec)) {
+    LOG(message_group::Warning, "Geometry disk cache: Unable to use directory '%1$s'", dir.generic_string());
+    this->directory.clear();
+    return false;
+  }
+  this->directory = dir;
+  this->maxsize = maxSizeMB * 1024ul * 1024ul;
+  scan();
+  trim(this->maxsize);
+  return true;
+}
+
+/*!
+   Rebuilds the index from the files in the directory, including those
+   written by other processes, and removes stale temporary files. Must be
+   called with the mutex held.
+ */
+void GeometryDiskCache::scan()
+{
+  this->files.clear();
+  this->total = 0;
+  this->written = 0;
+  const auto stale = fs::file_time_type::clock::now() - TEMP_FILE_GRACE;
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(this->directory, ec)) {
+    if (entry.path().extension().string().rfind(TEMP_EXTENSION, 0) == 0 && entry.path().stem().extension() == FILE_EXTENSION) {
+      const auto modified = entry.last_write_time(ec);
+      if (!ec && modified < stale) fs::remove(entry.path(), ec);
+      continue;
+    }
+    if (entry.path().extension() != FILE_EXTENSION) continue;
+    const auto size = entry.file_size(ec);
+    if (ec) continue;
+    const auto accessed = entry.last_write_time(ec);
+    if (ec) continue;
+    this->files[entry.path().stem().string()] = {size, accessed};
+    this->total += size;
+  }
+}
+
+/*!
+   Adds a file missing from the index, if another process has written it
+   since the last scan. Must be called with the mutex held.
+ */
+bool GeometryDiskCache::addFile(const std::string& filekey)
+{
+  const auto path = filePath(filekey);
+  std::error_code ec;
+  const auto size = fs::file_size(path, ec);
+  if (ec) return false;
+  const auto accessed = fs::last_write_time(path, ec);
+  if (ec) return false;
+  this->files[filekey] = {size, accessed};
+  this->total += size;
+  return true;
+}
+
+std::string GeometryDiskCache::fileKey(const NodeHash& id) const
+{
+  NodeHashBuilder builder;
+  builder.update(renderBackend3DToString(RenderSettings::inst()->backend3D));
+  builder.update('\0');
+  builder.update(openscad_versionnumber);
+  builder.update(id);
+  return builder.digest().toString();
+}
+
+fs::path GeometryDiskCache::filePath(const std::string& filekey) const
+{
+  return this->directory / (filekey + FILE_EXTENSION);
+}
+
+std::shared_ptr<const Geometry> GeometryDiskCache::get(const NodeHash& id, const IdStringFunc& idstring)
+{
+  if (!isEnabled()) return nullptr;
+  const auto filekey = fileKey(id);
+  {
+    std::lock_guard lock(this->mutex);
+    if (this->files.find(filekey) == this->files.end() && !addFile(filekey)) {
+      this->misses++;
+      return nullptr;
+    }
+  }
+
+  const auto path = filePath(filekey);
+  std::shared_ptr<const Geometry> geom;
+  bool corrupt = false;
+  try {
+    bip::file_mapping mapping(path.string().c_str(), bip::read_only);
+    bip::mapped_region region(mapping, bip::read_only);
+    BlobReader in(static_cast<const char *>(region.get_address()), region.get_size());
+    char magic[sizeof(MAGIC)];
+    for (auto& c : magic) c = in.read<char>();
+    const auto version = in.read<uint32_t>();
+    if (!in.ok || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != FORMAT_VERSION) {
+      corrupt = true;
+    } else if (in.read<NodeHash>() == id && in.readString() == idstring()) {
+      geom = readGeometry(in);
+      corrupt = !geom;
+    } else {
+      // A hash collision, which is just treated as a miss, unless the file was truncated
+      corrupt = !in.ok;
+    }
+  } catch (const bip::interprocess_exception& e) {
+    // Most likely removed by another process sharing the directory
+    PRINTDB("Geometry disk cache: Unable to map '%s': %s", path.generic_string() % e.what());
+  }
+
+  std::lock_guard lock(this->mutex);
+  if (!geom) {
+    this->misses++;
+    if (corrupt) {
+      std::error_code ec;
+      fs::remove(path, ec);
+      auto it = this->files.find(filekey);
+      if (it != this->files.end()) {
+        this->total -= it->second.size;
+        this->files.erase(it);
+      }
+    }
+    return nullptr;
+  }
+  this->hits++;
+  // Touch the file to share the LRU order with other processes
+  const auto now = fs::file_time_type::clock::now();
+  std::error_code ec;
+  fs::last_write_time(path, now, ec);
+  auto it = this->files.find(filekey);
+  if (it != this->files.end()) it->second.accessed = now;
+  return geom;
+}
+
+bool GeometryDiskCache::insert(const NodeHash& id, const IdStringFunc& idstring, const std::shared_ptr<const Geometry>& geom)
+{
+  if (!isEnabled() || !geom || geom->isEmpty()) return false;
+  const auto filekey = fileKey(id);
+  size_t maxsize;
+  {
+    std::lock_guard lock(this->mutex);
+    if (this->files.find(filekey) != this->files.end() || addFile(filekey)) return true;
+    maxsize = this->maxsize;
+  }
+
+  BlobWriter out;
+  out.buffer.append(MAGIC, sizeof(MAGIC));
+  out.write(FORMAT_VERSION);
+  out.write(id);
+  out.writeString(idstring());
+  GeometrySerializer serializer(out);
+  geom->accept(serializer);
+  if (!serializer.supported || out.buffer.size() > maxsize) return false;
+
+  // Write to a temporary file first, so concurrent readers never see partial files
+  const auto path = filePath(filekey);
+  auto tmppath = path;
+  tmppath += TEMP_EXTENSION + std::to_string(std::random_device{}());
+  {
+    std::ofstream stream(tmppath, std::ios::out | std::ios::binary | std::ios::trunc);
+    stream.write(out.buffer.data(), out.buffer.size());
+    if (!stream.good()) {
+      LOG(message_group::Warning, "Geometry disk cache: Unable to write '%1$s'", tmppath.generic_string());
+      std::error_code ec;
+      fs::remove(tmppath, ec);
+      return false;
+    }
+  }
+  std::error_code ec;
+  fs::rename(tmppath, path, ec);
+  if (ec) {
+    fs::remove(tmppath, ec);
+    return false;
+  }
+
+  std::lock_guard lock(this->mutex);
+  auto& entry = this->files[filekey];
+  this->total -= entry.size;
+  entry = {out.buffer.size(), fs::file_time_type::clock::now()};
+  this->total += entry.size;
+  // Other processes sharing the directory count towards the cap too
+  this->written += entry.size;
+  if (this->written > this->maxsize / 16) scan();
+  trim(this->maxsize);
+  return true;
+}
+
+/*!
+   Removes the least recently used files until the total size is within limit.
+   Must be called with the mutex held.
+ */
+void GeometryDiskCache::trim(size_t limit)
+{
+  if (this->total <= limit) return;
+  std::vector<std::pair<fs::file_time_type, std::string>> lru;
+  lru.reserve(this->files.size());
+  for (const auto& [filekey, entry] : this->files) lru.emplace_back(entry.accessed, filekey);
+  std::sort(lru.begin(), lru.end());
+  for (const auto& [accessed, filekey] : lru) {
+    if (this->total <= limit) break;
+    std::error_code ec;
+    fs::remove(filePath(filekey), ec);
+    this->total -= this->files[filekey].size;
+    this->files.erase(filekey);
+  }
+}
+
+size_t GeometryDiskCache::size() const
+{
+  std::lock_guard lock(this->mutex);
+  return this->files.size();
+}
+
+size_t GeometryDiskCache::totalCost() const
+{
+  std::lock_guard lock(this->mutex);
+  return this->total;
+}
+
+void GeometryDiskCache::print() const
+{
+  if (!isEnabled()) return;
+  std::lock_guard lock(this->mutex);
+  LOG("Geometries in disk cache: %1$d", this->files.size());
+  LOG("Geometry disk cache size in bytes: %1$d", this->total);
+  LOG("Geometry disk cache hits: %1$d, misses: %2$d", this->hits, this->misses);
+}
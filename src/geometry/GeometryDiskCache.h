@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "core/NodeHash.h"
+#include "geometry/Geometry.h"
+
+/*!
+   Optional, persistent second tier behind GeometryCache and CGALCache.
+
+   Geometries are serialized to one file per node, named after a hash of the
+   node's structural hash, the 3D backend and the OpenSCAD version, so that later runs
+   (e.g. separate `openscad -o` invocations) can load identical subtrees
+   instead of re-evaluating them. Files are memory-mapped when loaded.
+
+   The total size of the cache directory is capped; when the cap is exceeded,
+   the least recently used files are removed. Files are touched on every hit,
+   so the LRU order is shared between processes using the same directory.
+   Files written by other processes are picked up on a miss, and the directory
+   is rescanned after every sixteenth of the cap written, so the cap holds for
+   all processes together.
+ */
+class GeometryDiskCache
+{
+public:
+  static GeometryDiskCache *instance() { if (!inst) inst = new GeometryDiskCache; return inst; }
+
+  /*! Enables the disk cache, using (and creating if needed) the given directory. */
+  bool setDirectory(const std::filesystem::path& dir, size_t maxSizeMB = 1024);
+  bool isEnabled() const { return !this->directory.empty(); }
+
+  /*!
+     Files are named after the hash; idstring returns the node's full ID string,
+     stored in the file and compared on read to rule out hash collisions. As it
+     dumps the whole tree on first use, it is only called once a file with a
+     matching hash is found, or when a file is actually written.
+   */
+  using IdStringFunc = std::function<std::string()>;
+  std::shared_ptr<const Geometry> get(const NodeHash& id, const IdStringFunc& idstring);
+  bool insert(const NodeHash& id, const IdStringFunc& idstring, const std::shared_ptr<const Geometry>& geom);
+
+  size_t size() const;
+  size_t totalCost() const;
+  size_t maxSizeMB() const { return this->maxsize / (1024ul * 1024ul); }
+  size_t getHits() const { std::lock_guard lock(this->mutex); return this->hits; }
+  size_t getMisses() const { std::lock_guard lock(this->mutex); return this->misses; }
+  void print() const;
+
+private:
+  static GeometryDiskCache *inst;
+
+  struct FileEntry {
+    size_t size;
+    std::filesystem::file_time_type accessed;
+  };
+
+  std::string fileKey(const NodeHash& id) const;
+  std::filesystem::path filePath(const std::string& filekey) const;
+  bool addFile(const std::string& filekey);
+  void scan();
+  void trim(size_t limit);
+
+  std::filesystem::path directory;
+  size_t maxsize{0};
+  size_t total{0};
+  size_t written{0}; // bytes written since the last scan()
+  size_t hits{0};
+  size_t misses{0};
+  std::unordered_map<std::string, FileEntry> files;
+  mutable std::mutex mutex;
+};
@@ -3,6 +3,7 @@
 #include "geometry/linalg.h"
 #include "core/Tree.h"
 #include "geometry/GeometryCache.h"
+#include "geometry/GeometryDiskCache.h"
 #include "geometry/Polygon2d.h"
 #include "core/ModuleInstantiation.h"
 #include "core/State.h"
@@ -19,13 +20,18 @@
 #include "core/CsgOpNode.h"
 #include "core/TextNode.h"
 #include "core/RenderNode.h"
+#include "core/ImportNode.h"
+#include "Feature.h"
+#include "Profiler.h"
 #include "geometry/ClipperUtils.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/PolySetUtils.h"
 #include "geometry/PolySet.h"
 #include "geometry/PolySetBuilder.h"
 #include "utils/calc.h"
 #include "utils/printutils.h"
 #include "utils/calc.h"
+#include "utils/parallel.h"
 #include "io/DxfData.h"
 #include "glview/RenderSettings.h"
 #include "utils/degree_trig.h"
@@ -56,7 +62,16 @@ class Geometry;
 class Polygon2d;
 class Tree;
 
-GeometryEvaluator::GeometryEvaluator(const Tree& tree) : tree(tree) { }
+GeometryEvaluator::GeometryEvaluator(const Tree& tree, bool parallel_safe) : tree(tree), parallel_safe(parallel_safe) { }
+
+/*!
+   Traverses node like NodeVisitor::traverse(), measuring it for --profile.
+ */
+Response GeometryEvaluator::traverse(const AbstractNode& node, const State& state)
+{
+  Profiler::Scope profile(Profiler::Phase::GEOMETRY, node);
+  return NodeVisitor::traverse(node, state);
+}
 
 /*!
    Set allownef to false to force the result to _not_ be a Nef polyhedron
@@ -133,6 +148,13 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
   Geometry::Geometries children = collectChildren3D(node);
   if (children.empty()) return {};
 
+  Profiler::Scope profile(Profiler::Phase::BOOLEAN, node);
+
+  if (op == OpenSCADOperator::HULL || op == OpenSCADOperator::MINKOWSKI) {
+    // These read the vertices of their operands directly
+    for (auto& item : children) item.second = InstancedGeometry::flatten(item.second);
+  }
+
   if (op == OpenSCADOperator::HULL) {
     return ResultObject::mutableResult(std::shared_ptr<Geometry>(applyHull(children)));
   } else if (op == OpenSCADOperator::FILL) {
@@ -320,7 +342,7 @@ std::vector<std::shared_ptr<const Polygon2d>> GeometryEvaluator::collectChildren
 void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
                                          const std::shared_ptr<const Geometry>& geom)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const NodeHash key = this->tree.getHash(node);
 
   if (CGALCache::acceptsGeometry(geom)) {
     if (!CGALCache::instance()->contains(key)) {
@@ -337,22 +359,68 @@ void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
       LOG(message_group::Warning, "GeometryEvaluator: Node didn't fit into cache.");
     }
   }
+
+  // Leaf nodes are cheap to re-evaluate, so only persist results of operations.
+  // Instances would be persisted as full copies of their mesh.
+  if (!node.children.empty() && GeometryDiskCache::instance()->isEnabled() &&
+      !std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    GeometryDiskCache::instance()->insert(key, [&] { return this->tree.getIdString(node); }, geom);
+  }
+}
+
+/*!
+   Looks up a node in the disk cache and, if found, promotes it into the
+   corresponding in-memory cache.
+ */
+std::shared_ptr<const Geometry> GeometryEvaluator::diskCacheGet(const AbstractNode& node, const NodeHash& key)
+{
+  if (node.children.empty() || !GeometryDiskCache::instance()->isEnabled()) return {};
+  if (!this->diskchecked.insert(node.index()).second) return {};
+  auto geom = GeometryDiskCache::instance()->get(key, [&] { return this->tree.getIdString(node); });
+  if (!geom) return {};
+  if (CGALCache::acceptsGeometry(geom)) CGALCache::instance()->insert(key, geom);
+  else GeometryCache::instance()->insert(key, geom);
+  return geom;
+}
+
+GeometryEvaluator::CachedGeometry GeometryEvaluator::smartCacheLookup(const AbstractNode& node)
+{
+  const NodeHash key = this->tree.getHash(node);
+  CachedGeometry cached;
+  cached.found = GeometryCache::instance()->get(key, cached.geom);
+  cached.nef = CGALCache::instance()->get(key);
+  if (cached.nef) cached.found = true;
+  if (!cached.found) {
+    if (auto geom = diskCacheGet(node, key)) {
+      if (CGALCache::acceptsGeometry(geom)) cached.nef = std::move(geom);
+      else cached.geom = std::move(geom);
+      cached.found = true;
+    }
+  }
+  return cached;
 }
 
+/*!
+   Returns true if the node is cached. The cached geometry is held until the
+   node is added to its parent, as other evaluations may evict it from the
+   cache after its children were pruned.
+ */
 bool GeometryEvaluator::isSmartCached(const AbstractNode& node)
 {
-  const std::string& key = this->tree.getIdString(node);
-  return GeometryCache::instance()->contains(key) || CGALCache::instance()->contains(key);
+  if (this->smartcached.count(node.index())) return true;
+  auto cached = smartCacheLookup(node);
+  if (!cached.found) return false;
+  this->smartcached.emplace(node.index(), std::move(cached));
+  return true;
 }
 
 std::shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode& node, bool preferNef)
 {
-  const std::string& key = this->tree.getIdString(node);
-  const bool hasgeom = GeometryCache::instance()->contains(key);
-  const bool hascgal = CGALCache::instance()->contains(key);
-  if (hascgal && (preferNef || !hasgeom)) return CGALCache::instance()->get(key);
-  if (hasgeom) return GeometryCache::instance()->get(key);
-  return {};
+  const auto it = this->smartcached.find(node.index());
+  const CachedGeometry cached = it != this->smartcached.end() ? it->second : smartCacheLookup(node);
+  if (cached.found) Profiler::cacheHit(node);
+  if (cached.nef && (preferNef || !cached.geom)) return cached.nef;
+  return cached.geom;
 }
 
 /*!
@@ -390,6 +458,7 @@ Geometry::Geometries GeometryEvaluator::collectChildren3D(const AbstractNode& no
 std::unique_ptr<Polygon2d> GeometryEvaluator::applyToChildren2D(const AbstractNode& node, OpenSCADOperator op)
 {
   node.progress_report();
+  Profiler::Scope profile(Profiler::Phase::BOOLEAN, node);
   if (op == OpenSCADOperator::MINKOWSKI) {
     return applyMinkowski2D(node);
   } else if (op == OpenSCADOperator::HULL) {
@@ -445,7 +514,10 @@ void GeometryEvaluator::addToParent(const State& state,
                                     const AbstractNode& node,
                                     const std::shared_ptr<const Geometry>& geom)
 {
+  Profiler::result(node, geom);
   this->visitedchildren.erase(node.index());
+  this->smartcached.erase(node.index());
+  this->diskchecked.erase(node.index());
   if (state.parent()) {
     this->visitedchildren[state.parent()->index()].push_back(std::make_pair(node.shared_from_this(), geom));
   } else {
@@ -455,6 +527,78 @@ void GeometryEvaluator::addToParent(const State& state,
   }
 }
 
+/*!
+   Returns true if no node in the given subtree relies on state which cannot be shared
+   between threads: CGAL's exact numerics (hull, minkowski, resize, roof, Nef import).
+   text() is safe, since the FontCache is used under its mutex.
+ */
+bool GeometryEvaluator::isParallelSafe(const AbstractNode& node)
+{
+  std::map<int, bool> memo;
+  return isParallelSafe(node, memo);
+}
+
+/*!
+   As above, memoized by node index, since evaluateChildrenInParallel() asks
+   again at every level of a subtree which is not safe.
+ */
+bool GeometryEvaluator::isParallelSafe(const AbstractNode& node, std::map<int, bool>& memo)
+{
+  if (const auto it = memo.find(node.index()); it != memo.end()) return it->second;
+  bool safe = true;
+  if (dynamic_cast<const CgalAdvNode *>(&node) ||
+      dynamic_cast<const RoofNode *>(&node)) {
+    safe = false;
+  } else if (const auto importnode = dynamic_cast<const ImportNode *>(&node)) {
+    safe = importnode->type != ImportType::NEF3;
+  }
+  if (safe) {
+    const auto& children = node.getChildren();
+    safe = std::all_of(children.begin(), children.end(),
+                       [&memo](const auto& child) { return isParallelSafe(*child, memo); });
+  }
+  memo.emplace(node.index(), safe);
+  return safe;
+}
+
+/*!
+   Evaluates all children of the given node concurrently, each child subtree on its
+   own GeometryEvaluator, and collects the results in child order as if the children
+   had been traversed sequentially.
+   Call this from prefix; if it returns true, the children are already evaluated
+   and traversal should be pruned.
+ */
+bool GeometryEvaluator::evaluateChildrenInParallel(const State& state, const AbstractNode& node)
+{
+#if ENABLE_TBB
+  if (!Feature::ExperimentalParallelGeometry.is_enabled()) return false;
+  if (RenderSettings::inst()->backend3D != RenderBackend3D::ManifoldBackend) return false;
+  const auto& children = node.getChildren();
+  if (children.size() < 2) return false;
+  if (!this->parallel_safe && !isParallelSafe(node, this->parallelsafe)) return false;
+
+  // Same state as NodeVisitor::traverse() would pass on to the children
+  State childstate = state;
+  childstate.setParent(node.shared_from_this());
+
+  std::vector<Geometry::Geometries> results(children.size());
+  parallelizable_transform(children.begin(), children.end(), results.begin(),
+                           [&](const std::shared_ptr<AbstractNode>& child) {
+    GeometryEvaluator evaluator(this->tree, true);
+    evaluator.traverse(*child, childstate);
+    return std::move(evaluator.visitedchildren[node.index()]);
+  });
+
+  auto& visited = this->visitedchildren[node.index()];
+  for (auto& result : results) {
+    std::move(result.begin(), result.end(), std::back_inserter(visited));
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 Response GeometryEvaluator::visit(State& state, const ColorNode& node)
 {
   if (state.isPrefix() && isSmartCached(node)) return Response::PruneTraversal;
@@ -485,6 +629,7 @@ Response GeometryEvaluator::visit(State& state, const AbstractNode& node)
   if (state.isPrefix()) {
     if (isSmartCached(node)) return Response::PruneTraversal;
     state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
   }
   if (state.isPostfix()) {
     std::shared_ptr<const Geometry> geom;
@@ -509,6 +654,9 @@ Response GeometryEvaluator::visit(State& state, const ListNode& node)
       if (node.modinst->isBackground()) state.setBackground(true);
       return Response::PruneTraversal;
     }
+    if (state.isPrefix() && evaluateChildrenInParallel(state, node)) {
+      return Response::PruneTraversal;
+    }
     if (state.isPostfix()) {
       unsigned int dim = 0;
       for (const auto& item : this->visitedchildren[node.index()]) {
@@ -545,6 +693,13 @@ Response GeometryEvaluator::lazyEvaluateRootNode(State& state, const AbstractNod
   }
   if (state.isPostfix()) {
     std::shared_ptr<const Geometry> geom;
+    this->diskchecked.erase(node.index());
+    if (const auto it = this->smartcached.find(node.index()); it != this->smartcached.end()) {
+      // Pruned at prefix
+      this->root = smartCacheGet(node, state.preferNef());
+      this->smartcached.erase(it);
+      return Response::ContinueTraversal;
+    }
 
     unsigned int dim = 0;
     GeometryList::Geometries geometries;
@@ -670,7 +825,7 @@ Response GeometryEvaluator::visit(State& state, const TextNode& node)
       auto polygonlist = node.createPolygonList();
       geom = ClipperUtils::apply(polygonlist, Clipper2Lib::ClipType::Union);
     } else {
-      geom = GeometryCache::instance()->get(this->tree.getIdString(node));
+      geom = smartCacheGet(node, false);
     }
     addToParent(state, node, geom);
     node.progress_report();
@@ -690,6 +845,7 @@ Response GeometryEvaluator::visit(State& state, const CsgOpNode& node)
   if (state.isPrefix()) {
     if (isSmartCached(node)) return Response::PruneTraversal;
     state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
   }
   if (state.isPostfix()) {
     std::shared_ptr<const Geometry> geom;
@@ -742,9 +898,16 @@ Response GeometryEvaluator::visit(State& state, const TransformNode& node)
               geom = ClipperUtils::sanitize(*polygons);
             }
           } else if (geom->getDimension() == 3) {
-            auto mutableGeom = res.asMutableGeometry();
-            if (mutableGeom) mutableGeom->transform(node.matrix);
-            geom = mutableGeom;
+            const auto ps = std::dynamic_pointer_cast<const PolySet>(geom);
+            if (ps && res.isConst() && Feature::ExperimentalInstancedGeometry.is_enabled()) {
+              // Places the shared mesh instead of copying it. Transforming an
+              // instance below only composes the transforms.
+              geom = std::make_shared<InstancedGeometry>(ps, node.matrix);
+            } else {
+              auto mutableGeom = res.asMutableGeometry();
+              if (mutableGeom) mutableGeom->transform(node.matrix);
+              geom = mutableGeom;
+            }
           }
         }
       }
@@ -855,7 +1018,7 @@ static std::unique_ptr<Geometry> rotatePolygon(const RotateExtrudeNode& node, co
     ps_start->transform(rotz1 * rotx);
     // Flip vertex ordering
     if (!flip_faces) {
-      for (auto& p : ps_start->indices) {
+      for (auto p : ps_start->indices) {
         std::reverse(p.begin(), p.end());
       }
     }
@@ -865,7 +1028,7 @@ static std::unique_ptr<Geometry> rotatePolygon(const RotateExtrudeNode& node, co
     Transform3d rotz2(angle_axis_degrees(node.start + node.angle, Vector3d::UnitZ()));
     ps_end->transform(rotz2 * rotx);
     if (flip_faces) {
-      for (auto& p : ps_end->indices) {
+      for (auto p : ps_end->indices) {
         std::reverse(p.begin(), p.end());
       }
     }
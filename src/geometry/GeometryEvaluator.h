@@ -4,12 +4,14 @@
 #include "geometry/linalg.h"
 #include "core/enums.h"
 #include "geometry/Geometry.h"
+#include "core/NodeHash.h"
 
 #include <cassert>
 #include <memory>
 #include <utility>
 #include <vector>
 #include <map>
+#include <set>
 
 class CGAL_Nef_polyhedron;
 class Polygon2d;
@@ -21,9 +23,12 @@ class Tree;
 class GeometryEvaluator : public NodeVisitor
 {
 public:
-  GeometryEvaluator(const Tree& tree);
+  GeometryEvaluator(const Tree& tree, bool parallel_safe = false);
 
   std::shared_ptr<const Geometry> evaluateGeometry(const AbstractNode& node, bool allownef);
+  Response traverse(const AbstractNode& node, const State& state = NodeVisitor::nullstate) override;
+  // True if the subtree can be evaluated concurrently with other evaluations
+  static bool isParallelSafe(const AbstractNode& node);
 
   Response visit(State& state, const AbstractNode& node) override;
   Response visit(State& state, const ColorNode& node) override;
@@ -64,6 +69,7 @@ public:
     // Default constructor with nullptr can be used to represent empty geometry,
     // for example union() with no children, etc.
     ResultObject() : is_const(true) {}
+    [[nodiscard]] bool isConst() const { return is_const; }
     std::shared_ptr<Geometry> ptr() { assert(!is_const); return pointer; }
     [[nodiscard]] std::shared_ptr<const Geometry> constptr() const {
       return is_const ? const_pointer : std::static_pointer_cast<const Geometry>(pointer);
@@ -81,9 +87,18 @@ private:
     std::shared_ptr<const Geometry> const_pointer;
   };
 
+  // A node's entries in the GeometryCache and the CGALCache
+  struct CachedGeometry {
+    bool found = false; // the GeometryCache may hold an empty result
+    std::shared_ptr<const Geometry> geom;
+    std::shared_ptr<const Geometry> nef;
+  };
+
   void smartCacheInsert(const AbstractNode& node, const std::shared_ptr<const Geometry>& geom);
   std::shared_ptr<const Geometry> smartCacheGet(const AbstractNode& node, bool preferNef);
   bool isSmartCached(const AbstractNode& node);
+  CachedGeometry smartCacheLookup(const AbstractNode& node);
+  std::shared_ptr<const Geometry> diskCacheGet(const AbstractNode& node, const NodeHash& key);
   bool isValidDim(const Geometry::GeometryItem& item, unsigned int& dim) const;
   std::vector<std::shared_ptr<const Polygon2d>> collectChildren2D(const AbstractNode& node);
   Geometry::Geometries collectChildren3D(const AbstractNode& node);
@@ -99,11 +114,22 @@ private:
   std::shared_ptr<const Geometry> projectionNoCut(const ProjectionNode& node);
 
   void addToParent(const State& state, const AbstractNode& node, const std::shared_ptr<const Geometry>& geom);
+  bool evaluateChildrenInParallel(const State& state, const AbstractNode& node);
+  static bool isParallelSafe(const AbstractNode& node, std::map<int, bool>& memo);
   Response lazyEvaluateRootNode(State& state, const AbstractNode& node);
 
   std::map<int, Geometry::Geometries> visitedchildren;
+  // Cache hits of nodes being traversed, held until their postfix visit so
+  // they can't be evicted after their children were pruned
+  std::map<int, CachedGeometry> smartcached;
+  // Nodes already looked up in the disk cache, which is only checked once per node
+  std::set<int> diskchecked;
   const Tree& tree;
   std::shared_ptr<const Geometry> root;
+  // True if the subtree being evaluated is already known to be safe for parallel evaluation
+  bool parallel_safe;
+  // isParallelSafe() of the subtrees seen so far, by node index
+  std::map<int, bool> parallelsafe;
 
 public:
 };
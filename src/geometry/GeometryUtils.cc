@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/linalg.h"
 #include "libtess2/Include/tesselator.h"
 #include "utils/printutils.h"
@@ -528,6 +529,8 @@ std::shared_ptr<const Geometry> GeometryUtils::getBackendSpecificGeometry(const
       return ManifoldUtils::createManifoldFromPolySet(*ps);
     } else if (auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
       return geom;
+    } else if (std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+      return ManifoldUtils::createManifoldFromGeometry(geom);
     } else {
       assert(false && "Unexpected geometry");
     }
@@ -538,6 +541,8 @@ std::shared_ptr<const Geometry> GeometryUtils::getBackendSpecificGeometry(const
     return CGALUtils::createNefPolyhedronFromPolySet(*ps);
   } else if (auto poly = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
     return geom;
+  } else if (std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    return CGALUtils::getNefPolyhedronFromGeometry(geom);
   } else {
     assert(false && "Unexpected geometry");
   }
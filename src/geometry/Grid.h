@@ -1,13 +1,14 @@
 #pragma once
 
 #include "geometry/linalg.h"
+#include "utils/FlatIndexTable.h"
 #include "utils/hash.h"
-#include <boost/functional/hash.hpp>
 #include <cmath>
+#include <cstdlib>
 
+#include <cstddef>
 #include <cstdint> // int64_t
-#include <unordered_map>
-#include <utility>
+#include <vector>
 
 //const double GRID_COARSE = 0.001;
 //const double GRID_FINE   = 0.000001;
@@ -19,12 +20,50 @@
 const double GRID_COARSE = 0.0009765625;
 const double GRID_FINE = 0.00000095367431640625;
 
+/*!
+   Open-addressing index of integer grid cells, used by Grid2d and Grid3d.
+   Cells are stored in insertion order; their position is their index.
+ */
+template <typename Key>
+class GridCells
+{
+public:
+  static constexpr int32_t npos = FlatIndexTable::npos;
+
+  [[nodiscard]] size_t size() const { return this->keys.size(); }
+  void reserve(size_t n) {
+    this->table.reserve(n);
+    this->keys.reserve(n);
+  }
+  [[nodiscard]] const Key& key(int32_t index) const { return this->keys[index]; }
+
+  [[nodiscard]] int32_t find(const Key& key) const {
+    return this->table.find(hash(key), [&](int32_t i) { return this->keys[i] == key; });
+  }
+  // Adds a cell which must not already exist. Returns its index.
+  int32_t insert(const Key& key) {
+    this->table.insert(hash(key), this->keys.size());
+    this->keys.push_back(key);
+    return this->keys.size() - 1;
+  }
+
+private:
+  static size_t hash(const Key& key) {
+    uint64_t h = 0;
+    for (int i = 0; i < key.size(); ++i) h = (h ^ static_cast<uint64_t>(key[i])) * 0x9e3779b97f4a7c15ull;
+    return FlatIndexTable::mix(h);
+  }
+
+  FlatIndexTable table;
+  std::vector<Key> keys;
+};
+
 template <typename T>
 class Grid2d
 {
 public:
+  using Key = Eigen::Matrix<int64_t, 2, 1>;
   double res;
-  std::unordered_map<std::pair<int64_t, int64_t>, T, boost::hash<std::pair<int64_t, int64_t>>> db;
 
   Grid2d(double resolution) {
     res = resolution;
@@ -32,36 +71,41 @@ public:
   /*!
      Aligns x,y to the grid or to existing point if one close enough exists.
      Returns the value stored if a point already existing or an uninitialized new value
-     if not.
+     if not. The reference is valid until the next point is added.
    */
   T& align(double& x, double& y) {
     auto ix = (int64_t)std::round(x / res);
     auto iy = (int64_t)std::round(y / res);
-    if (db.find(std::make_pair(ix, iy)) == db.end()) {
+    auto index = cells.find(Key(ix, iy));
+    if (index == cells.npos) {
       int dist = 10;
       for (int64_t jx = ix - 1; jx <= ix + 1; ++jx) {
         for (int64_t jy = iy - 1; jy <= iy + 1; ++jy) {
-          if (db.find(std::make_pair(jx, jy)) == db.end()) continue;
+          const auto j = cells.find(Key(jx, jy));
+          if (j == cells.npos) continue;
           int d = abs(int(ix - jx)) + abs(int(iy - jy));
           if (d < dist) {
             dist = d;
             ix = jx;
             iy = jy;
+            index = j;
           }
         }
       }
     }
+    if (index == cells.npos) {
+      index = cells.insert(Key(ix, iy));
+      values.emplace_back();
+    }
     x = ix * res, y = iy * res;
-    return db[std::make_pair(ix, iy)];
+    return values[index];
   }
 
   [[nodiscard]] bool has(double x, double y) const {
-    auto ix = (int64_t)std::round(x / res);
-    auto iy = (int64_t)std::round(y / res);
-    if (db.find(std::make_pair(ix, iy)) != db.end()) return true;
-    for (int64_t jx = ix - 1; jx <= ix + 1; ++jx)
-      for (int64_t jy = iy - 1; jy <= iy + 1; ++jy) {
-        if (db.find(std::make_pair(jx, jy)) != db.end()) return true;
+    const Key key((int64_t)std::round(x / res), (int64_t)std::round(y / res));
+    for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx)
+      for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy) {
+        if (cells.find(Key(jx, jy)) != cells.npos) return true;
       }
     return false;
   }
@@ -78,59 +122,51 @@ public:
   T& operator()(double x, double y) {
     return align(x, y);
   }
+
+private:
+  GridCells<Key> cells;
+  std::vector<T> values;
 };
 
+/*!
+   Snaps vertices to a grid and welds vertices falling into neighboring cells.
+   Each distinct cell gets the next index, in order of first use.
+ */
 template <typename T>
 class Grid3d
 {
 public:
   double res;
   using Key = Vector3l;
-  using GridContainer = std::unordered_map<Key, T>;
-  GridContainer db;
 
   Grid3d(double resolution) {
     res = resolution;
   }
 
-  inline void createGridVertex(const Vector3d& v, Vector3l& i) {
+  inline void createGridVertex(const Vector3d& v, Vector3l& i) const {
     i[0] = int64_t(v[0] / this->res);
     i[1] = int64_t(v[1] / this->res);
     i[2] = int64_t(v[2] / this->res);
   }
 
+  [[nodiscard]] size_t size() const { return cells.size(); }
+  void reserve(size_t n) { cells.reserve(n); }
+
   // Aligns vertex to the grid. Returns index of the vertex.
   // Will automatically increase the index as new unique vertices are added.
   T align(Vector3d& v) {
     Vector3l key;
     createGridVertex(v, key);
-    auto iter = db.find(key);
-    if (iter == db.end()) {
-      float dist = 10.0f; // > max possible distance
-      for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx) {
-        for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy) {
-          for (int64_t jz = key[2] - 1; jz <= key[2] + 1; ++jz) {
-            Vector3l k(jx, jy, jz);
-            auto tmpiter = db.find(k);
-            if (tmpiter == db.end()) continue;
-            float d = sqrt((key - k).squaredNorm());
-            if (d < dist) {
-              dist = d;
-              iter = tmpiter;
-            }
-          }
-        }
-      }
+    auto index = cells.find(key);
+    if (index == cells.npos) {
+      index = findNeighbor(key);
     }
 
-    T data;
-    if (iter == db.end()) { // Not found: insert using key
-      data = db.size();
-      db[key] = data;
+    if (index == cells.npos) { // Not found: insert using key
+      index = cells.insert(key);
     } else {
       // If found return existing data
-      key = iter->first;
-      data = iter->second;
+      key = cells.key(index);
     }
 
     // Align vertex
@@ -138,30 +174,53 @@ public:
     v[1] = key[1] * this->res;
     v[2] = key[2] * this->res;
 
-    return data;
+    return static_cast<T>(index);
   }
 
-  bool has(const Vector3d& v, T *data = nullptr) {
-    Vector3l key = createGridVertex(v);
-    typename GridContainer::iterator pos = db.find(key);
-    if (pos != db.end()) {
-      if (data) *data = pos->second;
-      return true;
-    }
-    for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx)
-      for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy)
-        for (int64_t jz = key[2] - 1; jz <= key[2] + 1; ++jz) {
-          pos = db.find(Vector3l(jx, jy, jz));
-          if (pos != db.end()) {
-            if (data) *data = pos->second;
-            return true;
-          }
-        }
-    return false;
+  /*!
+     Aligns all vertices in place, appending their indices to indices.
+   */
+  void addVertices(std::vector<Vector3d>& vertices, std::vector<T>& indices) {
+    reserve(size() + vertices.size());
+    indices.reserve(indices.size() + vertices.size());
+    for (auto& v : vertices) indices.push_back(align(v));
+  }
+
+  bool has(const Vector3d& v, T *data = nullptr) const {
+    Vector3l key;
+    createGridVertex(v, key);
+    auto index = cells.find(key);
+    if (index == cells.npos) index = findNeighbor(key);
+    if (index == cells.npos) return false;
+    if (data) *data = static_cast<T>(index);
+    return true;
   }
 
   T data(Vector3d v) {
     return align(v);
   }
 
+private:
+  // Returns the closest existing cell of the 26 neighbors of key, or npos
+  int32_t findNeighbor(const Vector3l& key) const {
+    int32_t index = cells.npos;
+    float dist = 10.0f; // > max possible distance
+    for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx) {
+      for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy) {
+        for (int64_t jz = key[2] - 1; jz <= key[2] + 1; ++jz) {
+          Vector3l k(jx, jy, jz);
+          const auto j = cells.find(k);
+          if (j == cells.npos) continue;
+          float d = sqrt((key - k).squaredNorm());
+          if (d < dist) {
+            dist = d;
+            index = j;
+          }
+        }
+      }
+    }
+    return index;
+  }
+
+  GridCells<Key> cells;
 };
@@ -0,0 +1,104 @@
+#include "geometry/InstancedGeometry.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "geometry/Geometry.h"
+#include "geometry/GeometryUtils.h"
+#include "geometry/linalg.h"
+#include "geometry/PolySet.h"
+
+InstancedGeometry::InstancedGeometry(std::shared_ptr<const PolySet> mesh, const Transform3d& transform)
+  : mesh(std::move(mesh)), matrix(transform)
+{
+  this->convexity = this->mesh->getConvexity();
+}
+
+void InstancedGeometry::accept(GeometryVisitor& visitor) const
+{
+  visitor.visit(*toPolySet());
+}
+
+// A shared mesh is accounted for where it is cached itself
+size_t InstancedGeometry::memsize() const
+{
+  size_t size = sizeof(InstancedGeometry);
+  if (this->owns_mesh || this->mesh.use_count() == 1) size += this->mesh->memsize();
+  return size;
+}
+
+BoundingBox InstancedGeometry::getBoundingBox() const
+{
+  BoundingBox bbox;
+  for (const auto& v : this->mesh->vertices) {
+    bbox.extend(this->matrix * v);
+  }
+  return bbox;
+}
+
+std::string InstancedGeometry::dump() const
+{
+  return toPolySet()->dump();
+}
+
+bool InstancedGeometry::isEmpty() const
+{
+  return this->mesh->isEmpty();
+}
+
+std::unique_ptr<Geometry> InstancedGeometry::copy() const
+{
+  return std::make_unique<InstancedGeometry>(*this);
+}
+
+size_t InstancedGeometry::numFacets() const
+{
+  return this->mesh->numFacets();
+}
+
+void InstancedGeometry::transform(const Transform3d& mat)
+{
+  this->matrix = mat * this->matrix;
+}
+
+void InstancedGeometry::resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize)
+{
+  transform(GeometryUtils::getResizeTransform(getBoundingBox(), newsize, autosize));
+}
+
+// Colors are part of the mesh, so this instance gets its own copy of it
+void InstancedGeometry::setColor(const Color4f& c)
+{
+  auto colored = std::make_shared<PolySet>(*this->mesh);
+  colored->setColor(c);
+  this->mesh = std::move(colored);
+  this->owns_mesh = true;
+}
+
+std::unique_ptr<PolySet> InstancedGeometry::toPolySet() const
+{
+  auto ps = std::make_unique<PolySet>(*this->mesh);
+  ps->transform(this->matrix);
+  ps->setConvexity(this->convexity);
+  return ps;
+}
+
+std::shared_ptr<const Geometry> InstancedGeometry::flatten(const std::shared_ptr<const Geometry>& geom)
+{
+  if (const auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    return instance->toPolySet();
+  }
+  if (const auto geomlist = std::dynamic_pointer_cast<const GeometryList>(geom)) {
+    bool changed = false;
+    Geometry::Geometries children;
+    for (const auto& [node, child] : geomlist->getChildren()) {
+      auto flat = flatten(child);
+      changed |= flat != child;
+      children.emplace_back(node, std::move(flat));
+    }
+    if (changed) return std::make_shared<GeometryList>(children);
+  }
+  return geom;
+}
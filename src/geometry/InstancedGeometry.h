@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "geometry/Geometry.h"
+#include "geometry/linalg.h"
+
+class PolySet;
+
+/*!
+   A placement of a shared, immutable 3D PolySet: the mesh with a transform
+   applied lazily, with the experimental "instanced-geometry" feature.
+
+   Transforming a cached PolySet makes an instance instead of a copy, and
+   transforming an instance composes the transforms, so placing the same
+   object many times keeps a single mesh in memory. Operations which need
+   real coordinates flatten instances with toPolySet(); the conversions to
+   CGAL and Manifold geometry do so, as does export.
+
+   GeometryVisitors are given the flattened PolySet.
+ */
+class InstancedGeometry : public Geometry
+{
+public:
+  InstancedGeometry(std::shared_ptr<const PolySet> mesh, const Transform3d& transform);
+
+  void accept(GeometryVisitor& visitor) const override;
+
+  [[nodiscard]] size_t memsize() const override;
+  [[nodiscard]] BoundingBox getBoundingBox() const override;
+  [[nodiscard]] std::string dump() const override;
+  [[nodiscard]] unsigned int getDimension() const override { return 3; }
+  [[nodiscard]] bool isEmpty() const override;
+  [[nodiscard]] std::unique_ptr<Geometry> copy() const override;
+  [[nodiscard]] size_t numFacets() const override;
+
+  void transform(const Transform3d& mat) override;
+  void resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize) override;
+  void setColor(const Color4f& c) override;
+
+  [[nodiscard]] const std::shared_ptr<const PolySet>& getMesh() const { return this->mesh; }
+  [[nodiscard]] const Transform3d& getTransform() const { return this->matrix; }
+
+  // The mesh with the transform applied
+  [[nodiscard]] std::unique_ptr<PolySet> toPolySet() const;
+
+  /*!
+     Returns geom with all instances flattened, also inside GeometryLists,
+     for consumers which don't know about instances.
+   */
+  static std::shared_ptr<const Geometry> flatten(const std::shared_ptr<const Geometry>& geom);
+
+private:
+  std::shared_ptr<const PolySet> mesh;
+  Transform3d matrix;
+  bool owns_mesh{false}; // the mesh was copied for this instance, by setColor()
+};
@@ -32,9 +32,11 @@
 #include "geometry/Grid.h"
 #include <algorithm>
 #include <sstream>
+#include <utility>
 #include <memory>
 #include <Eigen/LU>
 #include <cstddef>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -92,7 +94,7 @@ BoundingBox PolySet::getBoundingBox() const
 size_t PolySet::memsize() const
 {
   size_t mem = 0;
-  for (const auto& p : this->indices) mem += p.size() * sizeof(int);
+  mem += this->indices.memsize();
   for (const auto& p : this->vertices) mem += p.size() * sizeof(Vector3d);
   mem += sizeof(PolySet);
   return mem;
@@ -106,7 +108,7 @@ void PolySet::transform(const Transform3d& mat)
       v = mat * v;
 
   if(mirrored)
-    for (auto& p : this->indices) {
+    for (auto p : this->indices) {
       std::reverse(p.begin(), p.end());
   }
   bbox_.setNull();
@@ -139,16 +141,29 @@ void PolySet::quantizeVertices(std::vector<Vector3d> *pPointsOut)
 {
   const bool has_colors = !this->color_indices.empty();
   Grid3d<unsigned int> grid(GRID_FINE);
+  grid.reserve(this->vertices.size());
+  // Grid index of each vertex, aligned once on first use
+  constexpr unsigned int unaligned = std::numeric_limits<unsigned int>::max();
+  std::vector<unsigned int> grid_indices(this->vertices.size(), unaligned);
   std::vector<unsigned int> polygon_indices; // Vertex indices in one polygon
-  for (size_t i=0; i < this->indices.size();) {
-    IndexedFace& ind_f = this->indices[i];
+  FaceIndices quantized;
+  quantized.reserve(this->indices.size(), this->indices.numIndices());
+  IndexedFace ind_f;
+  size_t kept = 0;
+  for (size_t i=0; i < this->indices.size(); ++i) {
+    const auto face = this->indices[i];
+    ind_f.assign(face.begin(), face.end());
     polygon_indices.resize(ind_f.size());
     // Quantize all vertices. Build index list
     for (unsigned int i = 0; i < ind_f.size(); ++i) {
-      polygon_indices[i] = grid.align(this->vertices[ind_f[i]]);
-      if (pPointsOut && pPointsOut->size() < grid.db.size()) {
-        pPointsOut->push_back(this->vertices[ind_f[i]]);
+      auto& grid_index = grid_indices[ind_f[i]];
+      if (grid_index == unaligned) {
+        grid_index = grid.align(this->vertices[ind_f[i]]);
+        if (pPointsOut && pPointsOut->size() < grid.size()) {
+          pPointsOut->push_back(this->vertices[ind_f[i]]);
+        }
       }
+      polygon_indices[i] = grid_index;
     }
     // Remove consecutive duplicate vertices
     auto currp = ind_f.begin();
@@ -160,10 +175,12 @@ void PolySet::quantizeVertices(std::vector<Vector3d> *pPointsOut)
     ind_f.erase(currp, ind_f.end());
     if (ind_f.size() < 3) {
       PRINTD("Removing collapsed polygon due to quantizing");
-      this->indices.erase(this->indices.begin()+i);
-      if (has_colors) this->color_indices.erase(this->color_indices.begin()+i);
     } else {
-      i++;
+      quantized.push_back(ind_f);
+      if (has_colors) this->color_indices[kept] = this->color_indices[i];
+      kept++;
     }
   }
+  this->indices = std::move(quantized);
+  if (has_colors) this->color_indices.resize(kept);
 }
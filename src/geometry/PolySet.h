@@ -1,6 +1,7 @@
 #pragma once
 
 #include "geometry/Geometry.h"
+#include "geometry/FaceIndices.h"
 #include "geometry/linalg.h"
 #include "geometry/GeometryUtils.h"
 #include "geometry/Polygon2d.h"
@@ -19,7 +20,7 @@ class PolySet : public Geometry
   friend class PolySetBuilder;	
 public:
   VISITABLE_GEOMETRY();
-  PolygonIndices indices;
+  FaceIndices indices;
   std::vector<Vector3d> vertices;
   // Per polygon color, indexing the colors vector below. Can be empty, and -1 means no specific color.
   std::vector<int32_t> color_indices; 
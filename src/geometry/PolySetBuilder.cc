@@ -28,6 +28,7 @@
 #include "geometry/linalg.h"
 #include "geometry/PolySet.h"
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 
 #ifdef ENABLE_CGAL
 #include "geometry/cgal/cgalutils.h"
@@ -87,6 +88,12 @@ int PolySetBuilder::vertexIndex(const Vector3d& pt)
   return vertices_.lookup(pt);
 }
 
+void PolySetBuilder::vertexIndices(const std::vector<Vector3d>& coords, std::vector<int>& indices)
+{
+  vertices_.reserve(vertices_.size() + coords.size());
+  vertices_.lookup(coords.begin(), coords.end(), indices);
+}
+
 void PolySetBuilder::appendGeometry(const std::shared_ptr<const Geometry>& geom)
 {
   if (const auto geomlist = std::dynamic_pointer_cast<const GeometryList>(geom)) {
@@ -95,6 +102,8 @@ void PolySetBuilder::appendGeometry(const std::shared_ptr<const Geometry>& geom)
     }
   } else if (const auto ps = std::dynamic_pointer_cast<const PolySet>(geom)) {
     appendPolySet(*ps);
+  } else if (const auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    appendPolySet(*instance->toPolySet());
 #ifdef ENABLE_CGAL
   } else if (const auto N = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
     if (const auto ps = CGALUtils::createPolySetFromNefPolyhedron3(*(N->p3))) {
@@ -202,11 +211,15 @@ void PolySetBuilder::appendPolySet(const PolySet& ps)
     color_indices_.resize(color_indices_.size() + ps.indices.size(), -1);
   }
 
-  reserve(numVertices() + ps.vertices.size(), numPolygons() + ps.indices.size());
+  vertices_.reserve(numVertices() + ps.vertices.size());
+  indices_.reserve(numPolygons() + ps.indices.size(), indices_.numIndices() + ps.indices.numIndices());
+  // Look up each vertex once, in order of first use
+  std::vector<int> vertex_map(ps.vertices.size(), -1);
   for (const auto& poly : ps.indices) {
     beginPolygon(poly.size());
     for (const auto& ind: poly) {
-      addVertex(ps.vertices[ind]);
+      if (vertex_map[ind] < 0) vertex_map[ind] = vertexIndex(ps.vertices[ind]);
+      addVertex(vertex_map[ind]);
     }
     endPolygon();
   }
@@ -217,18 +230,12 @@ std::unique_ptr<PolySet> PolySetBuilder::build()
   endPolygon();
   std::unique_ptr<PolySet> polyset;
   polyset = std::make_unique<PolySet>(dim_, convex_);
-  vertices_.copy(std::back_inserter(polyset->vertices));
+  polyset->vertices = vertices_.takeArray();
   polyset->indices = std::move(indices_);
   polyset->color_indices = std::move(color_indices_);
   polyset->colors = std::move(colors_);
   polyset->setConvexity(convexity_);
-  bool is_triangular = true;
-  for (const auto& face : polyset->indices) {
-    if (face.size() > 3) {
-      is_triangular = false;
-      break;
-    }
-  }
-  polyset->setTriangular(is_triangular);
+  // Polygons have at least three vertices, so they are triangles if they are stored as such
+  polyset->setTriangular(polyset->indices.onlyTriangles());
   return polyset;
 }
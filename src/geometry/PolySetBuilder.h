@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 
+#include "geometry/FaceIndices.h"
 #include "geometry/Reindexer.h"
 #include "geometry/Geometry.h"
 #include "geometry/linalg.h"
@@ -20,6 +21,8 @@ public:
   void reserve(int vertices_count = 0, int indices_count = 0);
   void setConvexity(int n);
   int vertexIndex(const Vector3d& coord);
+  // Looks up all vertices at once, appending their indices to indices
+  void vertexIndices(const std::vector<Vector3d>& coords, std::vector<int>& indices);
   int numVertices() const;
   int numPolygons() const;
   bool isEmpty() const;
@@ -41,7 +44,7 @@ public:
   std::unique_ptr<PolySet> build();
 private:
   Reindexer<Vector3d> vertices_;
-  PolygonIndices indices_;
+  FaceIndices indices_;
   std::vector<int32_t> color_indices_;
   std::vector<Color4f> colors_;
   int convexity_{1};
@@ -10,6 +10,7 @@
 #include <boost/range/adaptor/reversed.hpp>
 
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/linalg.h"
 #include "geometry/PolySet.h"
 #include "geometry/PolySetBuilder.h"
@@ -80,9 +81,9 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
   result->indices.reserve(polyset.indices.size());
 
   std::vector<bool> used(polyset.vertices.size(), false);
-  // best estimate without iterating all polygons, to reduce reallocations
-  std::vector<IndexedFace> polygons;
-  polygons.reserve(polyset.indices.size());
+  FaceIndices polygons;
+  polygons.reserve(polyset.indices.size(), polyset.indices.numIndices());
+  IndexedFace currface;
   std::vector<int32_t> polygon_color_indices;
   auto has_colors = !polyset.color_indices.empty();
   if (has_colors) {
@@ -96,7 +97,7 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
       degeneratePolygons++;
       continue;
     }
-    auto& currface = polygons.emplace_back();
+    currface.clear();
     for (const auto& ind : pgon) {
       const Vector3f v = polyset.vertices[ind].cast<float>();
       if (currface.empty() || v != polyset.vertices[currface.back()].cast<float>())
@@ -106,9 +107,9 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
     while (!currface.empty() && head == polyset.vertices[currface.back()].cast<float>())
       currface.pop_back();
     if (currface.size() < 3) {
-      polygons.pop_back();
       continue;
     }
+    polygons.push_back(currface);
     if (has_colors) {
       polygon_color_indices.push_back(polyset.color_indices[i]);
     }
@@ -128,7 +129,7 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
   }
   if (verts.size() != polyset.vertices.size()) {
     // only remap indices when some vertices are really removed
-    for (auto& face : polygons) {
+    for (auto face : polygons) {
       for (auto& ind : face)
         ind = indexMap[ind];
     }
@@ -149,7 +150,7 @@ std::unique_ptr<PolySet> tessellate_faces(const PolySet& polyset)
     // So everything more complex than triangles goes into the general case.
     else {
       triangles.clear();
-      facesBuffer[0] = face;
+      facesBuffer[0].assign(face.begin(), face.end());
       auto err = GeometryUtils::tessellatePolygonWithHoles(verts, facesBuffer, triangles, nullptr);
       if (!err) {
         for (const auto& t : triangles) {
@@ -183,6 +184,8 @@ std::shared_ptr<const PolySet> getGeometryAsPolySet(const std::shared_ptr<const
     return builder.build();
   } else if (auto ps = std::dynamic_pointer_cast<const PolySet>(geom)) {
     return ps;
+  } else if (auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    return instance->toPolySet();
   }
 #ifdef ENABLE_CGAL
   if (auto N = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
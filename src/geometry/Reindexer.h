@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstddef>
-#include <unordered_map>
+#include <functional>
+#include <iterator>
+#include <utility>
 #include <vector>
 #include <algorithm>
+#include "utils/FlatIndexTable.h"
 #include "utils/hash.h" // IWYU pragma: keep
 
 /*!
@@ -12,6 +15,9 @@
    a new array or to merge two index tables to two arrays into a common index.
    The latter is necessary for VBO's or for unifying texture coordinate indices to
    multiple texture coordinate arrays.
+
+   Elements are stored once, in index order; a flat hash index maps them back
+   to their index.
  */
 template <typename T>
 class Reindexer
@@ -21,48 +27,64 @@ public:
      Looks up a value. Will insert the value if it doesn't already exist.
      Returns the new index. */
   int lookup(const T& val) {
-    auto iter = this->map.find(val);
-    if (iter != this->map.end()) return iter->second;
-    else {
-      this->map.insert(std::make_pair(val, this->map.size()));
-      return this->map.size() - 1;
-    }
+    const size_t hash = FlatIndexTable::mix(std::hash<T>{}(val));
+    const int index = this->table.find(hash, [&](int i) { return this->vec[i] == val; });
+    if (index != FlatIndexTable::npos) return index;
+    this->table.insert(hash, this->vec.size());
+    this->vec.push_back(val);
+    return this->vec.size() - 1;
+  }
+
+  /*!
+     Looks up all values in order, appending their indices to indices.
+   */
+  template <class InputIterator>
+  void lookup(InputIterator begin, InputIterator end, std::vector<int>& indices) {
+    indices.reserve(indices.size() + std::distance(begin, end));
+    for (auto it = begin; it != end; ++it) indices.push_back(lookup(*it));
   }
 
   /*!
      Returns the current size of the new element array
    */
   [[nodiscard]] std::size_t size() const {
-    return this->map.size();
+    return this->vec.size();
   }
 
   /*!
      Reserve the requested size for the new element map
    */
   void reserve(std::size_t n) {
-    return this->map.reserve(n);
+    this->table.reserve(n);
+    // Grow geometrically, as callers often reserve a little more at a time
+    if (n > this->vec.capacity()) this->vec.reserve(std::max(n, 2 * this->vec.capacity()));
   }
 
   /*!
-     Return a copy of the new element array
+     Return the new element array
    */
-  const std::vector<T>& getArray() {
-    this->vec.resize(this->map.size());
-    for (const auto& entry : map) {
-      this->vec[entry.second] = entry.first;
-    }
+  const std::vector<T>& getArray() const {
     return this->vec;
   }
 
+  /*!
+     Moves the new element array out, leaving the reindexer empty
+   */
+  std::vector<T> takeArray() {
+    std::vector<T> result = std::move(this->vec);
+    this->vec.clear();
+    this->table.clear();
+    return result;
+  }
+
   /*!
      Copies the internal vector to the given destination
    */
-  template <class OutputIterator> void copy(OutputIterator dest) {
-    this->getArray();
+  template <class OutputIterator> void copy(OutputIterator dest) const {
     std::copy(this->vec.begin(), this->vec.end(), dest);
   }
 
 private:
-  std::unordered_map<T, int> map;
+  FlatIndexTable table;
   std::vector<T> vec;
 };
@@ -14,17 +14,18 @@
 #include "geometry/manifold/ManifoldGeometry.h"
 #endif
 
-CGALCache *CGALCache::inst = nullptr;
-
 CGALCache::CGALCache(size_t limit) : cache(limit)
 {
 }
 
-std::shared_ptr<const Geometry> CGALCache::get(const std::string& id) const
+std::shared_ptr<const Geometry> CGALCache::get(const NodeHash& id) const
 {
-  const auto& N = this->cache[id]->N;
+  const auto entry = this->cache.get(id);
+  // The entry may have been evicted by another thread since contains() was called
+  if (!entry) return nullptr;
+  const auto& N = entry->N;
 #ifdef DEBUG
-  LOG("CGAL Cache hit: %1$s (%2$d bytes)", id.substr(0, 40), N ? N->memsize() : 0);
+  LOG("CGAL Cache hit: %1$s (%2$d bytes)", id.toString(), N ? N->memsize() : 0);
 #endif
   return N;
 }
@@ -40,13 +41,13 @@ bool CGALCache::acceptsGeometry(const std::shared_ptr<const Geometry>& geom) {
     ;
 }
 
-bool CGALCache::insert(const std::string& id, const std::shared_ptr<const Geometry>& N)
+bool CGALCache::insert(const NodeHash& id, const std::shared_ptr<const Geometry>& N)
 {
   assert(acceptsGeometry(N));
-  auto inserted = this->cache.insert(id, new cache_entry(N), N ? N->memsize() : 0);
+  auto inserted = this->cache.insert(id, std::make_shared<const cache_entry>(N), N ? N->memsize() : 0);
 #ifdef DEBUG
-  if (inserted) LOG("CGAL Cache insert: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
-  else LOG("CGAL Cache insert failed: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
+  if (inserted) LOG("CGAL Cache insert: %1$s (%2$d bytes)", id.toString(), (N ? N->memsize() : 0));
+  else LOG("CGAL Cache insert failed: %1$s (%2$d bytes)", id.toString(), (N ? N->memsize() : 0));
 #endif
   return inserted;
 }
@@ -6,6 +6,7 @@
 #include "geometry/cgal/cgalutils.h"
 
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/linalg.h"
 #include "geometry/cgal/cgal.h"
 #include "geometry/PolySet.h"
@@ -250,6 +251,8 @@ std::shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const st
     return std::shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolySet(*ps));
   } else if (auto nef = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
     return nef;
+  } else if (auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    return std::shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolySet(*instance->toPolySet()));
 #if ENABLE_MANIFOLD
   } else if (auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
     return std::shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolySet(*mani->toPolySet()));
@@ -486,6 +489,9 @@ std::shared_ptr<const PolySet> getGeometryAsPolySet(const std::shared_ptr<const
   if (auto ps = std::dynamic_pointer_cast<const PolySet>(geom)) {
     return ps;
   }
+  if (auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    return instance->toPolySet();
+  }
   if (auto N = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
     auto ps = std::make_shared<PolySet>(3);
     if (!N->isEmpty()) {
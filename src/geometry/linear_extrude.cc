@@ -200,7 +200,7 @@ Outline2d splitOutlineByFs(
 
 std::unique_ptr<PolySet> assemblePolySetForManifold(
   const Polygon2d& polyref,
-  std::vector<Vector3d>& vertices, PolygonIndices& indices,
+  std::vector<Vector3d>& vertices, FaceIndices& indices,
   int convexity, boost::tribool isConvex, int index_offset) {
   auto final_polyset = std::make_unique<PolySet>(3, isConvex);
   final_polyset->setTriangular(true);
@@ -211,13 +211,13 @@ std::unique_ptr<PolySet> assemblePolySetForManifold(
   // Create top and bottom face.
   auto ps_bottom = polyref.tessellate(); // bottom
   // Flip vertex ordering for bottom polygon
-  for (auto& p : ps_bottom->indices) {
+  for (auto p : ps_bottom->indices) {
     std::reverse(p.begin(), p.end());
   }
   std::copy(ps_bottom->indices.begin(), ps_bottom->indices.end(),
      std::back_inserter(final_polyset->indices));
 
-  for (auto& p : ps_bottom->indices) {
+  for (auto p : ps_bottom->indices) {
     std::reverse(p.begin(), p.end());
     for (auto& i : p) {
       i += index_offset;
@@ -232,7 +232,7 @@ std::unique_ptr<PolySet> assemblePolySetForManifold(
 }
 
 std::unique_ptr<PolySet> assemblePolySetForCGAL(const Polygon2d& polyref,
-  std::vector<Vector3d>& vertices, PolygonIndices& indices,
+  std::vector<Vector3d>& vertices, FaceIndices& indices,
   int convexity, boost::tribool isConvex,
   double scale_x, double scale_y,
   const Vector3d& h1, const Vector3d& h2, double twist) {
@@ -256,7 +256,7 @@ std::unique_ptr<PolySet> assemblePolySetForCGAL(const Polygon2d& polyref,
   // Create bottom face.
   auto ps_bottom = polyref.tessellate(); // bottom
   // Flip vertex ordering for bottom polygon
-  for (auto& p : ps_bottom->indices) {
+  for (auto p : ps_bottom->indices) {
     std::reverse(p.begin(), p.end());
   }
   translatePolySet(*ps_bottom, h1);
@@ -283,7 +283,7 @@ std::unique_ptr<PolySet> assemblePolySetForCGAL(const Polygon2d& polyref,
    Quads are triangulated across the shorter of the two diagonals, which works well in most cases.
    However, when diagonals are equal length, decision may flip depending on other factors.
  */
-void add_slice_indices(PolygonIndices &indices, int slice_idx, int slice_stride, const Polygon2d& poly,
+void add_slice_indices(FaceIndices &indices, int slice_idx, int slice_stride, const Polygon2d& poly,
                               double rot1, double rot2,
                               const Vector2d& scale1, const Vector2d& scale2)
 {
@@ -479,7 +479,7 @@ std::unique_ptr<Geometry> extrudePolygon(const LinearExtrudeNode& node, const Po
   }
   std::vector<Vector3d> vertices;
   vertices.reserve(slice_stride * (num_slices + 1));
-  PolygonIndices indices;
+  FaceIndices indices;
   indices.reserve(slice_stride * (num_slices + 1) * 2); // sides + endcaps
 
   // Calculate all vertices
@@ -71,6 +71,9 @@ public:
   void foreachVertexUntilTrue(const std::function<bool(const manifold::vec3& pt)>& f) const;
 
   const manifold::Manifold& getManifold() const;
+  const std::set<uint32_t>& getOriginalIDs() const { return originalIDs_; }
+  const std::map<uint32_t, Color4f>& getOriginalIDToColor() const { return originalIDToColor_; }
+  const std::set<uint32_t>& getSubtractedIDs() const { return subtractedIDs_; }
 
 private:
   ManifoldGeometry binOp(const ManifoldGeometry& lhs, const ManifoldGeometry& rhs, manifold::OpType opType) const;
@@ -3,17 +3,134 @@
 
 #ifdef ENABLE_MANIFOLD
 
+#include <algorithm>
+#include <cassert>
+#include <map>
 #include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
 #include "geometry/manifold/manifoldutils.h"
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "core/AST.h"
 #include "geometry/manifold/ManifoldGeometry.h"
 #include "core/node.h"
 #include "core/progress.h"
 #include "utils/printutils.h"
+#include "utils/parallel.h"
 
 namespace ManifoldUtils {
 
+namespace {
+
+using ManifoldOperands = std::vector<std::shared_ptr<const ManifoldGeometry>>;
+
+/*!
+   Converts all children to Manifold geometry in parallel.
+   Empty or invalid children are returned as nullptr, preserving child order.
+   The mesh shared by instances is converted once for all of them.
+ */
+ManifoldOperands convertChildren(const Geometry::Geometries& children)
+{
+  // Geometries is a list; parallelizable_transform() needs random access
+  const std::vector<Geometry::GeometryItem> items(children.begin(), children.end());
+
+  std::map<const PolySet *, std::shared_ptr<const ManifoldGeometry>> meshes;
+  std::vector<std::shared_ptr<const PolySet>> distinct;
+  for (const auto& item : items) {
+    if (const auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(item.second)) {
+      if (meshes.emplace(instance->getMesh().get(), nullptr).second) distinct.push_back(instance->getMesh());
+    }
+  }
+  ManifoldOperands converted(distinct.size());
+  parallelizable_transform(distinct.begin(), distinct.end(), converted.begin(),
+                           [](const std::shared_ptr<const PolySet>& mesh) -> std::shared_ptr<const ManifoldGeometry> {
+    return createManifoldFromPolySet(*mesh);
+  });
+  for (size_t i = 0; i < distinct.size(); ++i) meshes[distinct[i].get()] = converted[i];
+
+  ManifoldOperands operands(items.size());
+  parallelizable_transform(items.begin(), items.end(), operands.begin(),
+                           [&meshes](const Geometry::GeometryItem& item) -> std::shared_ptr<const ManifoldGeometry> {
+    std::shared_ptr<const ManifoldGeometry> chN;
+    if (const auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(item.second)) {
+      // Manifold applies transforms lazily, so the placed copies share the mesh
+      const auto& mesh = meshes.at(instance->getMesh().get());
+      if (!mesh) return nullptr;
+      auto placed = std::make_shared<ManifoldGeometry>(*mesh);
+      placed->transform(instance->getTransform());
+      chN = std::move(placed);
+    } else if (item.second) {
+      chN = createManifoldFromGeometry(item.second);
+    }
+    if (!chN || chN->isEmpty()) return nullptr;
+    return chN;
+  });
+  return operands;
+}
+
+/*!
+   Unions the given non-empty operands as a balanced binary tree of pairwise unions,
+   instead of folding each operand into a growing accumulated mesh.
+   The unions within one level of the tree are independent and run in parallel.
+   Pairing is purely positional, so the result does not depend on scheduling.
+ */
+std::shared_ptr<const ManifoldGeometry> unionBalanced(ManifoldOperands operands)
+{
+  if (operands.empty()) return nullptr;
+  while (operands.size() > 1) {
+    std::vector<size_t> pairs((operands.size() + 1) / 2);
+    std::iota(pairs.begin(), pairs.end(), 0);
+    ManifoldOperands next(pairs.size());
+    parallelizable_transform(pairs.begin(), pairs.end(), next.begin(),
+                             [&operands](size_t i) -> std::shared_ptr<const ManifoldGeometry> {
+      // An odd operand out is carried over to the next level as is
+      if (2 * i + 1 == operands.size()) return operands[2 * i];
+      auto result = std::make_shared<ManifoldGeometry>(*operands[2 * i] + *operands[2 * i + 1]);
+      // Manifold evaluates booleans lazily; query the status to force
+      // the evaluation to happen here, on this worker thread.
+      (void)result->isValid();
+      return result;
+    });
+    // Progress is reported from the calling thread, as the GUI's callback may cancel by throwing
+    for (size_t i = 0; i < operands.size() / 2; ++i) progress_tick();
+    operands = std::move(next);
+  }
+  return operands.front();
+}
+
+/*!
+   Union: balanced reduction over all non-empty children.
+   Difference: first child minus the balanced union of all other children.
+ */
+std::shared_ptr<ManifoldGeometry> applyBatchedOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op)
+{
+  assert(op == OpenSCADOperator::UNION || op == OpenSCADOperator::DIFFERENCE);
+  auto operands = convertChildren(children);
+  if (operands.empty()) return nullptr;
+
+  std::shared_ptr<const ManifoldGeometry> first;
+  if (op == OpenSCADOperator::DIFFERENCE) {
+    // Subtracting from nothing results in nothing
+    first = operands.front();
+    if (!first) return nullptr;
+    operands.erase(operands.begin());
+  }
+  operands.erase(std::remove(operands.begin(), operands.end(), nullptr), operands.end());
+
+  auto united = unionBalanced(std::move(operands));
+  if (op == OpenSCADOperator::UNION) {
+    return united ? std::make_shared<ManifoldGeometry>(*united) : nullptr;
+  }
+  if (!united) return std::make_shared<ManifoldGeometry>(*first);
+  auto result = std::make_shared<ManifoldGeometry>(*first - *united);
+  progress_tick();
+  return result;
+}
+
+} // namespace
+
 Location getLocation(const std::shared_ptr<const AbstractNode>& node)
 {
   return node && node->modinst ? node->modinst->location() : Location::NONE;
@@ -25,6 +142,10 @@ Location getLocation(const std::shared_ptr<const AbstractNode>& node)
  */
 std::shared_ptr<ManifoldGeometry> applyOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op)
 {
+  if (op == OpenSCADOperator::UNION || op == OpenSCADOperator::DIFFERENCE) {
+    return applyBatchedOperator3DManifold(children, op);
+  }
+
   std::shared_ptr<ManifoldGeometry> geom;
 
   bool foundFirst = false;
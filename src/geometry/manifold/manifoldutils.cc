@@ -1,10 +1,12 @@
 // Portions of this file are Copyright 2023 Google LLC, and licensed under GPL2+. See COPYING.
 #include "geometry/manifold/manifoldutils.h"
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/linalg.h"
 #include "geometry/manifold/ManifoldGeometry.h"
-#include "geometry/PolySetBuilder.h"
+#include "geometry/Reindexer.h"
 #include "Feature.h"
+#include "utils/FlatIndexTable.h"
 #include "utils/printutils.h"
 #ifdef ENABLE_CGAL
 #include "geometry/cgal/cgalutils.h"
@@ -23,7 +25,12 @@
 #include <manifold/polygon.h>
 
 #include <cstddef>
+#include <cstdint>
+#include <map>
 #include <optional>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 using Error = manifold::Manifold::Error;
@@ -98,53 +105,103 @@ template std::shared_ptr<ManifoldGeometry> createManifoldFromSurfaceMesh(const C
 template std::shared_ptr<ManifoldGeometry> createManifoldFromSurfaceMesh(const CGAL_DoubleMesh &tm);
 #endif
 
-std::shared_ptr<ManifoldGeometry> createManifoldFromTriangularPolySet(const PolySet& ps)
+namespace {
+
+/*!
+   Checks that every edge of the triangles is used once in each direction,
+   i.e. that they form a closed, consistently oriented 2-manifold.
+   Returns why they don't, or nullptr.
+ */
+const char *checkManifold(const std::vector<uint64_t>& triVerts)
+{
+  std::vector<std::pair<uint64_t, uint64_t>> edges;
+  edges.reserve(triVerts.size());
+  FlatIndexTable table;
+  table.reserve(triVerts.size());
+  const auto hash = [](uint64_t from, uint64_t to) {
+    return FlatIndexTable::mix(from * 0x9e3779b97f4a7c15ull ^ to);
+  };
+  for (size_t i = 0; i < triVerts.size(); i += 3) {
+    if (triVerts[i] == triVerts[i + 1] || triVerts[i + 1] == triVerts[i + 2] || triVerts[i + 2] == triVerts[i]) {
+      return "a face is degenerate";
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      const std::pair<uint64_t, uint64_t> edge{triVerts[i + j], triVerts[i + (j + 1) % 3]};
+      const size_t h = hash(edge.first, edge.second);
+      if (table.find(h, [&](int32_t e) { return edges[e] == edge; }) != FlatIndexTable::npos) {
+        return "an edge is shared by more than two faces, or faces are oriented inconsistently";
+      }
+      table.insert(h, static_cast<int32_t>(edges.size()));
+      edges.push_back(edge);
+    }
+  }
+  for (const auto& [from, to] : edges) {
+    const std::pair<uint64_t, uint64_t> reverse{to, from};
+    if (table.find(hash(to, from), [&](int32_t e) { return edges[e] == reverse; }) == FlatIndexTable::npos) {
+      return "the mesh is not closed";
+    }
+  }
+  return nullptr;
+}
+
+// Merges vertices with identical positions and drops the triangles which collapse
+std::vector<Vector3d> weldVertices(const std::vector<Vector3d>& vertices, std::vector<std::vector<uint64_t>>& runs)
 {
-  assert(ps.isTriangular());
+  Reindexer<Vector3d> reindexer;
+  reindexer.reserve(vertices.size());
+  std::vector<uint64_t> welded;
+  welded.reserve(vertices.size());
+  for (const auto& v : vertices) welded.push_back(reindexer.lookup(v));
+
+  for (auto& triVerts : runs) {
+    size_t out = 0;
+    for (size_t i = 0; i < triVerts.size(); i += 3) {
+      const uint64_t a = welded[triVerts[i]], b = welded[triVerts[i + 1]], c = welded[triVerts[i + 2]];
+      if (a == b || b == c || c == a) continue;
+      triVerts[out++] = a;
+      triVerts[out++] = b;
+      triVerts[out++] = c;
+    }
+    triVerts.resize(out);
+  }
+  return reindexer.takeArray();
+}
 
+// Builds a Manifold from triangle runs by color, as made by createManifoldDirectly()
+std::shared_ptr<ManifoldGeometry> createManifoldFromRuns(const std::vector<Vector3d>& vertices,
+                                                         const std::vector<std::vector<uint64_t>>& runs,
+                                                         const std::vector<std::optional<Color4f>>& runColors)
+{
   manifold::MeshGL64 mesh;
-
   mesh.numProp = 3;
-  mesh.vertProperties.reserve(ps.vertices.size() * 3);
-  for (const auto& v : ps.vertices) {
+  mesh.vertProperties.reserve(vertices.size() * 3);
+  for (const auto& v : vertices) {
     mesh.vertProperties.push_back(v.x());
     mesh.vertProperties.push_back(v.y());
     mesh.vertProperties.push_back(v.z());
   }
 
-  mesh.triVerts.reserve(ps.indices.size() * 3);
+  size_t numRuns = 0;
+  size_t total = 0;
+  for (const auto& triVerts : runs) {
+    if (!triVerts.empty()) ++numRuns;
+    total += triVerts.size();
+  }
+  mesh.triVerts.reserve(total);
 
   std::set<uint32_t> originalIDs;
   std::map<uint32_t, Color4f> originalIDToColor;
-
-  std::map<std::optional<Color4f>, std::vector<size_t>> colorToFaceIndices;
-  for (size_t i = 0, n = ps.indices.size(); i < n; i++) {
-    auto color_index = i < ps.color_indices.size() ? ps.color_indices[i] : -1;
-    std::optional<Color4f> color;
-    if (color_index >= 0) {
-      color = ps.colors[color_index];
-    }
-    colorToFaceIndices[color].push_back(i);
-  }
-  auto next_id = manifold::Manifold::ReserveIDs(colorToFaceIndices.size());
-  for (const auto& [color, faceIndices] : colorToFaceIndices) {
-
+  auto next_id = manifold::Manifold::ReserveIDs(numRuns);
+  for (size_t r = 0; r < runs.size(); ++r) {
+    if (runs[r].empty()) continue;
     auto id = next_id++;
-    if (color.has_value()) {
-      originalIDToColor[id] = color.value();
+    if (runColors[r].has_value()) {
+      originalIDToColor[id] = runColors[r].value();
     }
-
     mesh.runIndex.push_back(mesh.triVerts.size());
     mesh.runOriginalID.push_back(id);
     originalIDs.insert(id);
-
-    for (size_t faceIndex : faceIndices) {
-      auto & face = ps.indices[faceIndex];
-      assert(face.size() == 3);
-      mesh.triVerts.push_back(face[0]);
-      mesh.triVerts.push_back(face[1]);
-      mesh.triVerts.push_back(face[2]);
-    }
+    mesh.triVerts.insert(mesh.triVerts.end(), runs[r].begin(), runs[r].end());
   }
   mesh.runIndex.push_back(mesh.triVerts.size());
 
@@ -152,43 +209,84 @@ std::shared_ptr<ManifoldGeometry> createManifoldFromTriangularPolySet(const Poly
   return std::make_shared<ManifoldGeometry>(mani, originalIDs, originalIDToColor);
 }
 
-std::shared_ptr<ManifoldGeometry> createManifoldFromPolySet(const PolySet& ps)
+/*!
+   Converts a PolySet to a Manifold, building the MeshGL64 straight from
+   the triangles by color. If Manifold rejects the mesh, vertices with
+   identical positions are welded and it is tried again, which fixes the
+   most common cause: a polygon soup of manifold topology. Meshes Manifold
+   accepts as given aren't welded, so manifold topologies with duplicate
+   vertex positions (touching cubes, a donut with a vertex in the center
+   etc.) are kept as they are.
+
+   Returns nullptr and sets reason if the PolySet isn't manifold.
+ */
+std::shared_ptr<ManifoldGeometry> createManifoldDirectly(const PolySet& ps, std::string& reason)
 {
-  // 1. If the PolySet is already manifold, we should be able to build a Manifold object directly
-  // (through using manifold::Mesh).
-  // We need to make sure our PolySet is triangulated before doing that.
-  // Note: We currently don't have a way of directly checking if a PolySet is manifold,
-  // so we just try converting to a Manifold object and check its status.
+  for (const auto& v : ps.vertices) {
+    if (!v.allFinite()) {
+      reason = "the mesh has a non-finite vertex";
+      return nullptr;
+    }
+  }
+
   std::unique_ptr<const PolySet> triangulated;
   if (!ps.isTriangular()) {
     triangulated = PolySetUtils::tessellate_faces(ps);
   }
   const PolySet& triangle_set = ps.isTriangular() ? ps : *triangulated;
 
-  auto mani = createManifoldFromTriangularPolySet(triangle_set);
-  if (mani->getManifold().Status() == Error::NoError) {
-    return mani;
+  // One run of triangles per distinct color, the first one for faces without color
+  std::map<std::optional<Color4f>, size_t> colorToRun;
+  std::vector<std::optional<Color4f>> runColors;
+  std::vector<size_t> colorIndexToRun(triangle_set.colors.size() + 1);
+  const auto runOf = [&](const std::optional<Color4f>& color) {
+    auto [it, inserted] = colorToRun.emplace(color, runColors.size());
+    if (inserted) runColors.push_back(color);
+    return it->second;
+  };
+  colorIndexToRun[0] = runOf(std::nullopt);
+  for (size_t i = 0; i < triangle_set.colors.size(); ++i) {
+    colorIndexToRun[i + 1] = runOf(triangle_set.colors[i]);
   }
 
-  // Before announcing that the conversion failed, let's try to fix the most common
-  // causes of a non-manifold topology:
-  // Polygon soup of manifold topology with co-incident vertices having identical vertex positions
-  //
-  // Note: This causes us to lose the ability to represent manifold topologies with duplicate
-  // vertex positions (touching cubes, donut with vertex in the center etc.)
-  PolySetBuilder builder(ps.vertices.size(), ps.indices.size(),
-                         ps.getDimension(), ps.convexValue());
-  builder.appendPolySet(triangle_set);
-  const std::unique_ptr<PolySet> rebuilt_ps = builder.build();
-  mani = createManifoldFromTriangularPolySet(*rebuilt_ps);
-  if (mani->getManifold().Status() == Error::NoError) {
+  std::vector<std::vector<uint64_t>> runs(runColors.size());
+  if (triangle_set.color_indices.empty()) runs[0].reserve(triangle_set.indices.size() * 3);
+  for (size_t i = 0, n = triangle_set.indices.size(); i < n; ++i) {
+    const auto& face = triangle_set.indices[i];
+    const int32_t color_index = i < triangle_set.color_indices.size() ? triangle_set.color_indices[i] : -1;
+    auto& triVerts = runs[colorIndexToRun[color_index + 1]];
+    triVerts.insert(triVerts.end(), face.begin(), face.end());
+  }
+
+  auto mani = createManifoldFromRuns(triangle_set.vertices, runs, runColors);
+  if (mani->getManifold().Status() == Error::NoError) return mani;
+
+  const auto welded = weldVertices(triangle_set.vertices, runs);
+  mani = createManifoldFromRuns(welded, runs, runColors);
+  if (mani->getManifold().Status() == Error::NoError) return mani;
+
+  std::vector<uint64_t> all;
+  for (const auto& triVerts : runs) all.insert(all.end(), triVerts.begin(), triVerts.end());
+  const char *why = checkManifold(all);
+  reason = why ? why : ManifoldUtils::statusToString(mani->getManifold().Status());
+  return nullptr;
+}
+
+} // namespace
+
+std::shared_ptr<ManifoldGeometry> createManifoldFromPolySet(const PolySet& ps)
+{
+  // 1. If the PolySet is manifold, possibly after welding identical vertices,
+  // we can build a Manifold object directly.
+  std::string reason;
+  if (auto mani = createManifoldDirectly(ps, reason)) {
     return mani;
   }
 
   // FIXME: Should we attempt merging vertices within epsilon distance before issuing this warning?
   LOG(message_group::Warning,"PolySet -> Manifold conversion failed: %1$s\n"
       "Trying to repair and reconstruct mesh..",
-      ManifoldUtils::statusToString(mani->getManifold().Status()));
+      reason);
 
   // 2. If the PolySet couldn't be converted into a Manifold object, let's try to repair it.
   // We currently have to utilize some CGAL functions to do this.
@@ -240,6 +338,13 @@ std::shared_ptr<const ManifoldGeometry> createManifoldFromGeometry(const std::sh
   if (auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
     return mani;
   }
+  if (auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    // Manifold applies transforms lazily, sharing the converted mesh
+    auto mani = createManifoldFromPolySet(*instance->getMesh());
+    if (!mani) return nullptr;
+    mani->transform(instance->getTransform());
+    return mani;
+  }
   if (auto ps = PolySetUtils::getGeometryAsPolySet(geom)) {
     return createManifoldFromPolySet(*ps);
   }
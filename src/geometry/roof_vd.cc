@@ -375,7 +375,7 @@ std::unique_ptr<PolySet> voronoi_diagram_roof(const Polygon2d& poly, double fa,
       outline.vertices = face;
       face_poly.addOutline(outline);
       auto tess = face_poly.tessellate();
-      for (const IndexedFace& triangle : tess->indices) {
+      for (const auto& triangle : tess->indices) {
         std::vector<int> roof;
         for (int tvind : triangle) {
           Vector3d tv=tess->vertices[tvind];
@@ -403,7 +403,7 @@ std::unique_ptr<PolySet> voronoi_diagram_roof(const Polygon2d& poly, double fa,
         poly_floor.addOutline(o);
       }
       auto tess = poly_floor.tessellate();
-      for (const IndexedFace & triangle : tess->indices) {
+      for (const auto& triangle : tess->indices) {
         std::vector<int> floor;
         for (const int  tv : triangle) {
           floor.push_back(hatbuilder.vertexIndex(tess->vertices[tv]));
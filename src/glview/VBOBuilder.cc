@@ -445,17 +445,17 @@ void VBOBuilder::create_surface(const PolySet& ps, const Transform3d& m,
                           ? ps.colors[color_index]
                           : default_color;
     if (poly.size() == 3) {
-      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(0)], m);
-      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(1)], m);
-      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(2)], m);
+      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly[0]], m);
+      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[1]], m);
+      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[2]], m);
 
       create_triangle(color, p0, p1, p2, 0, poly.size(), false, enable_barycentric, mirrored);
       triangle_count++;
     } else if (poly.size() == 4) {
-      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(0)], m);
-      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(1)], m);
-      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(2)], m);
-      const Vector3d p3 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(3)], m);
+      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly[0]], m);
+      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[1]], m);
+      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[2]], m);
+      const Vector3d p3 = uniqueMultiply(vert_mult_map, ps.vertices[poly[3]], m);
 
       create_triangle(color, p0, p1, p3, 0, poly.size(), false, enable_barycentric, mirrored);
       create_triangle(color, p2, p3, p1, 1, poly.size(), false, enable_barycentric, mirrored);
@@ -468,8 +468,8 @@ void VBOBuilder::create_surface(const PolySet& ps, const Transform3d& m,
       center /= poly.size();
       for (size_t i = 1; i <= poly.size(); i++) {
         const Vector3d p0 = uniqueMultiply(vert_mult_map, center, m);
-        const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(i % poly.size())], m);
-        const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(i - 1)], m);
+        const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[i % poly.size()]], m);
+        const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[i - 1]], m);
 
         create_triangle(color, p0, p2, p1, i - 1, poly.size(), false, enable_barycentric, mirrored);
         triangle_count++;
@@ -540,17 +540,17 @@ void VBOBuilder::create_polygons(const PolySet& ps, const Transform3d& m, const
 
   for (const auto& poly : ps.indices) {
     if (poly.size() == 3) {
-      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(0)], m);
-      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(1)], m);
-      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(2)], m);
+      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly[0]], m);
+      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[1]], m);
+      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[2]], m);
 
       create_triangle(color, p0, p1, p2, 0, poly.size(), false, false, mirrored);
       triangle_count++;
     } else if (poly.size() == 4) {
-      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(0)], m);
-      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(1)], m);
-      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(2)], m);
-      const Vector3d p3 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(3)], m);
+      const Vector3d p0 = uniqueMultiply(vert_mult_map, ps.vertices[poly[0]], m);
+      const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[1]], m);
+      const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[2]], m);
+      const Vector3d p3 = uniqueMultiply(vert_mult_map, ps.vertices[poly[3]], m);
 
       create_triangle(color, p0, p1, p3, 0, poly.size(), false, false, mirrored);
       create_triangle(color, p2, p3, p1, 1, poly.size(), false, false, mirrored);
@@ -566,8 +566,8 @@ void VBOBuilder::create_polygons(const PolySet& ps, const Transform3d& m, const
 
       for (size_t i = 1; i <= poly.size(); i++) {
         const Vector3d p0 = uniqueMultiply(vert_mult_map, center, m);
-        const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(i % poly.size())], m);
-        const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly.at(i - 1)], m);
+        const Vector3d p1 = uniqueMultiply(vert_mult_map, ps.vertices[poly[i % poly.size()]], m);
+        const Vector3d p2 = uniqueMultiply(vert_mult_map, ps.vertices[poly[i - 1]], m);
 
         create_triangle(color, p0, p2, p1, i - 1, poly.size(), false, false, mirrored);
         triangle_count++;
@@ -37,6 +37,7 @@
 #endif
 
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "geometry/linalg.h"
 #include "Feature.h"
 #include "geometry/PolySet.h"
@@ -51,11 +52,49 @@
 #include "geometry/manifold/ManifoldGeometry.h"
 #endif
 
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 // #include "gui/Preferences.h"
 
+namespace {
+
+// Draws the states of one mesh once for each placement, with the placement on the modelview matrix
+class InstancedVertexState : public VertexState
+{
+public:
+  InstancedVertexState(std::vector<std::shared_ptr<VertexState>> states, std::vector<Transform3d> transforms)
+    : states_(std::move(states)), transforms_(std::move(transforms)) {}
+
+  void draw() const override {
+    GL_TRACE0("glEnable(GL_NORMALIZE)");
+    GL_CHECKD(glEnable(GL_NORMALIZE)); // for scaled placements
+    for (const auto& transform : transforms_) {
+      const bool mirrored = transform.matrix().determinant() < 0;
+      GL_CHECKD(glPushMatrix());
+      GL_CHECKD(glMultMatrixd(transform.data()));
+      if (mirrored) {
+        GL_CHECKD(glFrontFace(GL_CW));
+      }
+      for (const auto& state : states_) state->draw();
+      if (mirrored) {
+        GL_CHECKD(glFrontFace(GL_CCW));
+      }
+      GL_CHECKD(glPopMatrix());
+    }
+    GL_TRACE0("glDisable(GL_NORMALIZE)");
+    GL_CHECKD(glDisable(GL_NORMALIZE));
+  }
+
+private:
+  std::vector<std::shared_ptr<VertexState>> states_;
+  std::vector<Transform3d> transforms_;
+};
+
+} // namespace
+
 CGALRenderer::CGALRenderer(const std::shared_ptr<const class Geometry> &geom) {
   this->addGeometry(geom);
   PRINTD("CGALRenderer::CGALRenderer() -> createPolyhedrons()");
@@ -77,6 +116,10 @@ void CGALRenderer::addGeometry(const std::shared_ptr<const Geometry> &geom) {
     // concave polygons See
     // tests/data/scad/3D/features/polyhedron-concave-test.scad
     this->polysets_.push_back(PolySetUtils::tessellate_faces(*ps));
+  } else if (const auto instance = std::dynamic_pointer_cast<const InstancedGeometry>(geom)) {
+    auto& instances = this->instances_[instance->getMesh().get()];
+    if (!instances.mesh) instances.mesh = PolySetUtils::tessellate_faces(*instance->getMesh());
+    instances.transforms.push_back(instance->getTransform());
   } else if (const auto poly =
                  std::dynamic_pointer_cast<const Polygon2d>(geom)) {
     this->polygons_.emplace_back(
@@ -147,6 +190,9 @@ void CGALRenderer::createPolySetStates() {
   for (const auto &polyset : this->polysets_) {
     num_vertices += calcNumVertices(*polyset);
   }
+  for (const auto &[_, instances] : this->instances_) {
+    num_vertices += calcNumVertices(*instances.mesh);
+  }
   vbo_builder.allocateBuffers(num_vertices);
 
   for (const auto &polyset : this->polysets_) {
@@ -156,7 +202,29 @@ void CGALRenderer::createPolySetStates() {
     vbo_builder.create_surface(*polyset, Transform3d::Identity(), color, false);
   }
 
+  // Each instanced mesh is written once; its states are drawn for every placement below
+  std::vector<std::pair<size_t, size_t>> instance_states;
+  for (const auto &[_, instances] : this->instances_) {
+    Color4f color;
+    getColorSchemeColor(ColorMode::MATERIAL, color);
+    const size_t first = vertex_state_container.states().size();
+    vbo_builder.writeSurface();
+    vbo_builder.create_surface(*instances.mesh, Transform3d::Identity(), color, false);
+    instance_states.emplace_back(first, vertex_state_container.states().size());
+  }
+
   vbo_builder.createInterleavedVBOs();
+  if (instance_states.empty()) return;
+
+  auto &states = vertex_state_container.states();
+  std::vector<std::shared_ptr<VertexState>> drawn(states.begin(), states.begin() + instance_states.front().first);
+  auto range = instance_states.begin();
+  for (const auto &[_, instances] : this->instances_) {
+    const auto [first, last] = *range++;
+    drawn.push_back(std::make_shared<InstancedVertexState>(
+      std::vector<std::shared_ptr<VertexState>>(states.begin() + first, states.begin() + last), instances.transforms));
+  }
+  states = std::move(drawn);
 }
 
 void CGALRenderer::createPolygonStates() {
@@ -238,7 +306,7 @@ void CGALRenderer::prepare(const ShaderUtils::ShaderInfo * /*shaderinfo*/) {
   if (!vertex_state_containers_.size()) {
     if (!this->polysets_.empty() && !this->polygons_.empty()) {
       LOG(message_group::Error, "CGALRenderer::prepare() called with both polysets and polygons");
-    } else if (!this->polysets_.empty()) {
+    } else if (!this->polysets_.empty() || !this->instances_.empty()) {
       createPolySetStates();
     } else if (!this->polygons_.empty()) {
       createPolygonStates();
@@ -307,34 +375,83 @@ BoundingBox CGALRenderer::getBoundingBox() const {
   for (const auto &ps : this->polysets_) {
     bbox.extend(ps->getBoundingBox());
   }
+  for (const auto &[_, instances] : this->instances_) {
+    for (const auto &transform : instances.transforms) {
+      for (const auto &v : instances.mesh->vertices) bbox.extend(transform * v);
+    }
+  }
   for (const auto &[polygon, polyset] : this->polygons_) {
     bbox.extend(polygon->getBoundingBox());
   }
   return bbox;
 }
 
+void CGALRenderer::createPickingMeshes() {
+  for (const auto &ps : this->polysets_) {
+    this->picking_meshes_.push_back(PickingMesh{ps.get(), MeshBVH(*ps), nullptr});
+  }
+  for (const auto &[_, instances] : this->instances_) {
+    this->picking_meshes_.push_back(
+        PickingMesh{instances.mesh.get(), MeshBVH(*instances.mesh), &instances.transforms});
+  }
+  for (const auto &[_, ps] : this->polygons_) {
+    this->picking_meshes_.push_back(PickingMesh{ps.get(), MeshBVH(*ps), nullptr});
+  }
+  this->picking_meshes_created_ = true;
+}
+
 std::vector<SelectedObject>
 CGALRenderer::findModelObject(Vector3d near_pt, Vector3d far_pt, int mouse_x,
                               int mouse_y, double tolerance) {
-  double dist_near;
+  if (!this->picking_meshes_created_) createPickingMeshes();
+
+  // Calls test(vertex, face) for the faces near the ray, where vertex(i)
+  // returns the placed position of the vertex with index i
+  const auto for_each_face_near_ray = [&](const auto &test) {
+    for (const auto &picking : this->picking_meshes_) {
+      const PolySet &ps = *picking.mesh;
+      if (!picking.transforms) {
+        const auto vertex = [&](int i) { return ps.vertices[i]; };
+        picking.bvh.query(near_pt, far_pt, tolerance,
+                          [&](uint32_t face) { test(vertex, ps.indices[face]); });
+        continue;
+      }
+      for (const auto &transform : *picking.transforms) {
+        // Query in the coordinates of the mesh, where distances grow by at most the norm of the inverse
+        const Transform3d inverse = transform.inverse();
+        if (!inverse.matrix().allFinite()) continue;
+        const auto vertex = [&](int i) { return Vector3d(transform * ps.vertices[i]); };
+        picking.bvh.query(inverse * near_pt, inverse * far_pt, tolerance * inverse.linear().norm(),
+                          [&](uint32_t face) { test(vertex, ps.indices[face]); });
+      }
+    }
+  };
+
   double dist_nearest = std::numeric_limits<double>::max();
   Vector3d pt1_nearest;
   Vector3d pt2_nearest;
-  const auto find_nearest_point = [&](const std::vector<Vector3d> &vertices){
-    for (const Vector3d &pt : vertices) {
-      const double dist_pt =
-          calculateLinePointDistance(near_pt, far_pt, pt, dist_near);
-      if (dist_pt < tolerance && dist_near < dist_nearest) {
-        dist_nearest = dist_near;
-        pt1_nearest = pt;
-      }
+  const auto test_point = [&](const Vector3d &pt) {
+    double dist_near;
+    const double dist_pt =
+        calculateLinePointDistance(near_pt, far_pt, pt, dist_near);
+    if (dist_pt < tolerance && dist_near < dist_nearest) {
+      dist_nearest = dist_near;
+      pt1_nearest = pt;
     }
   };
-  for (const std::shared_ptr<const PolySet> &ps : this->polysets_) {
-    find_nearest_point(ps->vertices);
-  }
-  for (const auto &[polygon, ps] : this->polygons_) {
-    find_nearest_point(ps->vertices);
+  for_each_face_near_ray([&](const auto &vertex, const auto &face) {
+    for (const int ind : face) test_point(vertex(ind));
+  });
+  // Vertices without faces aren't in the BVH, but can be picked as well
+  for (const auto &picking : this->picking_meshes_) {
+    const PolySet &ps = *picking.mesh;
+    for (const uint32_t ind : picking.bvh.looseVertices()) {
+      if (!picking.transforms) {
+        test_point(ps.vertices[ind]);
+        continue;
+      }
+      for (const auto &transform : *picking.transforms) test_point(transform * ps.vertices[ind]);
+    }
   }
   if (dist_nearest < std::numeric_limits<double>::max()) {
     SelectedObject obj = {
@@ -344,28 +461,21 @@ CGALRenderer::findModelObject(Vector3d near_pt, Vector3d far_pt, int mouse_x,
     return std::vector<SelectedObject>{obj};
   }
 
-  const auto find_nearest_line = [&](const std::vector<Vector3d> &vertices, const PolygonIndices& indices) {
-    for (const auto &poly : indices) {
-      for (int i = 0; i < poly.size(); i++) {
-        int ind1 = poly[i];
-        int ind2 = poly[(i + 1) % poly.size()];
-        double dist_lat;
-        double dist_norm = fabs(calculateLineLineDistance(
-            vertices[ind1], vertices[ind2], near_pt, far_pt, dist_lat));
-        if (dist_lat >= 0 && dist_lat <= 1 && dist_norm < tolerance) {
-          dist_nearest = dist_lat;
-          pt1_nearest = vertices[ind1];
-          pt2_nearest = vertices[ind2];
-        }
+  // The edge closest to the ray
+  for_each_face_near_ray([&](const auto &vertex, const auto &face) {
+    for (size_t i = 0; i < face.size(); i++) {
+      const Vector3d pt1 = vertex(face[i]);
+      const Vector3d pt2 = vertex(face[(i + 1) % face.size()]);
+      double dist_lat;
+      double dist_norm = fabs(calculateLineLineDistance(
+          pt1, pt2, near_pt, far_pt, dist_lat));
+      if (dist_lat >= 0 && dist_lat <= 1 && dist_norm < tolerance && dist_norm < dist_nearest) {
+        dist_nearest = dist_norm;
+        pt1_nearest = pt1;
+        pt2_nearest = pt2;
       }
     }
-  };
-  for (const std::shared_ptr<const PolySet> &ps : this->polysets_) {
-    find_nearest_line(ps->vertices, ps->indices);
-  }
-  for (const auto &[polygon, ps] : this->polygons_) {
-    find_nearest_line(ps->vertices, ps->indices);
-  }
+  });
   if (dist_nearest < std::numeric_limits<double>::max()) {
     SelectedObject obj = {
       .type = SelectionType::SELECTION_LINE,
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <utility>
+#include <map>
 #include <memory>
 #include <vector>
 
 #include "glview/VBORenderer.h"
+#include "glview/cgal/MeshBVH.h"
 #include "geometry/Geometry.h"
 #include "geometry/linalg.h"
 #include "geometry/Polygon2d.h"
@@ -33,9 +35,16 @@ private:
   void createPolygonStates();
   void createPolygonSurfaceStates();
   void createPolygonEdgeStates();
+  void createPickingMeshes();
   bool last_render_state_; // FIXME: this is temporary to make switching between renderers seamless.
 
   std::vector<std::shared_ptr<const class PolySet>> polysets_;
+  // Placements of the meshes of InstancedGeometry, which are drawn from one VBO each
+  struct Instances {
+    std::shared_ptr<const PolySet> mesh; // tessellated
+    std::vector<Transform3d> transforms;
+  };
+  std::map<const PolySet *, Instances> instances_; // by the shared mesh
   std::vector<std::pair<std::shared_ptr<const Polygon2d>, std::shared_ptr<const PolySet>>> polygons_;
 #ifdef ENABLE_CGAL
   std::vector<std::shared_ptr<class VBOPolyhedron>> polyhedrons_;
@@ -43,4 +52,13 @@ private:
 #endif
 
   std::vector<VertexStateContainer> vertex_state_containers_;
+
+  // The meshes of polysets_, instances_ and polygons_ with a BVH each, built on the first pick
+  struct PickingMesh {
+    const PolySet *mesh;
+    MeshBVH bvh;
+    const std::vector<Transform3d> *transforms; // placements of an instanced mesh, or nullptr
+  };
+  std::vector<PickingMesh> picking_meshes_;
+  bool picking_meshes_created_{false};
 };
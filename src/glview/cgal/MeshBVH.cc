@@ -0,0 +1,92 @@
+#include "glview/cgal/MeshBVH.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "geometry/linalg.h"
+#include "geometry/PolySet.h"
+
+namespace {
+
+constexpr uint32_t max_leaf_faces = 4;
+
+} // namespace
+
+MeshBVH::MeshBVH(const PolySet& ps)
+{
+  std::vector<Vector3f> centers;
+  centers.reserve(ps.indices.size());
+  std::vector<bool> referenced(ps.vertices.size());
+  for (const auto& face : ps.indices) {
+    BoundingBox bbox;
+    for (const int ind : face) {
+      bbox.extend(ps.vertices[ind]);
+      referenced[ind] = true;
+    }
+    centers.push_back(bbox.isEmpty() ? Vector3f::Zero() : Vector3f(bbox.center().cast<float>()));
+  }
+  for (size_t i = 0; i < referenced.size(); ++i) {
+    if (!referenced[i]) this->loose_vertices.push_back(static_cast<uint32_t>(i));
+  }
+  if (centers.empty()) return;
+
+  this->faces.resize(centers.size());
+  std::iota(this->faces.begin(), this->faces.end(), 0);
+  this->nodes.reserve(2 * centers.size() / max_leaf_faces + 1);
+  build(ps, centers, 0, this->faces.size());
+}
+
+uint32_t MeshBVH::build(const PolySet& ps, const std::vector<Vector3f>& centers, uint32_t begin, uint32_t end)
+{
+  const auto index = static_cast<uint32_t>(this->nodes.size());
+  this->nodes.push_back({BoundingBox(), begin, end - begin});
+
+  BoundingBox bbox;
+  Eigen::AlignedBox<float, 3> center_bbox;
+  for (uint32_t i = begin; i < end; ++i) {
+    for (const int ind : ps.indices[this->faces[i]]) bbox.extend(ps.vertices[ind]);
+    center_bbox.extend(centers[this->faces[i]]);
+  }
+  this->nodes[index].bbox = bbox;
+  if (end - begin <= max_leaf_faces) return index;
+
+  int axis;
+  center_bbox.sizes().maxCoeff(&axis);
+  const uint32_t mid = begin + (end - begin) / 2;
+  std::nth_element(this->faces.begin() + begin, this->faces.begin() + mid, this->faces.begin() + end,
+                   [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+  build(ps, centers, begin, mid);
+  const uint32_t second = build(ps, centers, mid, end);
+  this->nodes[index].offset = second;
+  this->nodes[index].count = 0;
+  return index;
+}
+
+// Slab test against the box grown by tolerance, for the infinite line
+bool MeshBVH::lineCrossesBox(const Vector3d& origin, const Vector3d& dir, const BoundingBox& bbox, double tolerance)
+{
+  if (bbox.isEmpty()) return false;
+  double tmin = std::numeric_limits<double>::lowest();
+  double tmax = std::numeric_limits<double>::max();
+  for (int i = 0; i < 3; ++i) {
+    const double lo = bbox.min()[i] - tolerance;
+    const double hi = bbox.max()[i] + tolerance;
+    if (dir[i] == 0) {
+      if (origin[i] < lo || origin[i] > hi) return false;
+      continue;
+    }
+    double t1 = (lo - origin[i]) / dir[i];
+    double t2 = (hi - origin[i]) / dir[i];
+    if (t1 > t2) std::swap(t1, t2);
+    tmin = std::max(tmin, t1);
+    tmax = std::min(tmax, t2);
+    if (tmin > tmax) return false;
+  }
+  return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "geometry/linalg.h"
+
+class PolySet;
+
+/*!
+   A bounding volume hierarchy over the faces of a PolySet, to find the faces
+   near a line without testing all of them, as when picking in the 3D view.
+
+   Nodes are stored depth first in one array: the first child of an inner
+   node follows it, and the second one is at the node's offset. Faces are
+   split at the median of their centers along the longest axis, down to a
+   few faces per leaf. Vertices no face refers to are kept in a list of
+   their own, since they can be picked too.
+ */
+class MeshBVH
+{
+public:
+  explicit MeshBVH(const PolySet& ps);
+
+  /*!
+     Calls visit(face) with the index of each face in a leaf whose bounding
+     box, grown by tolerance, is crossed by the line through p1 and p2.
+   */
+  template <class Visitor>
+  void query(const Vector3d& p1, const Vector3d& p2, double tolerance, Visitor&& visit) const {
+    if (this->nodes.empty()) return;
+    const Vector3d dir = p2 - p1;
+    std::vector<uint32_t> stack{0};
+    while (!stack.empty()) {
+      const uint32_t index = stack.back();
+      stack.pop_back();
+      const Node& node = this->nodes[index];
+      if (!lineCrossesBox(p1, dir, node.bbox, tolerance)) continue;
+      if (node.count == 0) {
+        stack.push_back(node.offset);
+        stack.push_back(index + 1);
+      } else {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) visit(this->faces[i]);
+      }
+    }
+  }
+
+  // Indices of the vertices no face refers to
+  [[nodiscard]] const std::vector<uint32_t>& looseVertices() const { return this->loose_vertices; }
+
+private:
+  struct Node {
+    BoundingBox bbox;
+    uint32_t offset; // first face of a leaf, or second child of an inner node
+    uint32_t count;  // faces of a leaf, 0 for an inner node
+  };
+
+  static bool lineCrossesBox(const Vector3d& origin, const Vector3d& dir, const BoundingBox& bbox, double tolerance);
+  uint32_t build(const PolySet& ps, const std::vector<Vector3f>& centers, uint32_t begin, uint32_t end);
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> faces; // face indices, grouped by leaf
+  std::vector<uint32_t> loose_vertices;
+};
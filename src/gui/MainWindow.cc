@@ -85,6 +85,7 @@
 #include "core/ScopeContext.h"
 #include "core/progress.h"
 #include "io/dxfdim.h"
+#include "Feature.h"
 #include "io/fileutils.h"
 #include "core/Settings.h"
 #include "gui/AboutDialog.h"
@@ -1231,7 +1232,11 @@ void MainWindow::instantiateRoot()
     LOG("Compiling design (CSG Tree generation)...");
     this->processEvents();
 
-    AbstractNode::resetIndexCounter();
+    const bool incremental = Feature::ExperimentalIncrementalInstantiation.is_enabled();
+    if (!incremental) {
+      this->instantiationCache.clear();
+      AbstractNode::resetIndexCounter();
+    }
 
     EvaluationSession session{doc.parent_path().string()};
     ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
@@ -1242,7 +1247,9 @@ void MainWindow::instantiateRoot()
     if (python_result_node != NULL && this->python_active) this->absoluteRootNode = python_result_node;
     else
 #endif
-    this->absoluteRootNode = this->rootFile->instantiate(*builtin_context, &file_context);
+    if (incremental) this->absoluteRootNode = this->instantiationCache.instantiate(this->rootFile, *builtin_context, &file_context);
+    else this->absoluteRootNode = this->rootFile->instantiate(*builtin_context, &file_context);
+    session.functionMemo().printStatistics();
     if (file_context) {
       this->qglview->cam.updateView(file_context, false);
       viewportControlWidget->cameraChanged();
@@ -2036,7 +2043,8 @@ void MainWindow::parseTopLevelDocument()
 
   auto fnameba = activeEditor->filepath.toLocal8Bit();
   const char *fname = activeEditor->filepath.isEmpty() ? "" : fnameba;
-  delete this->parsedFile;
+  // Cached nodes may still point into the previous parse
+  this->instantiationCache.retire(this->parsedFile);
 #ifdef ENABLE_PYTHON
   this->python_active = false;
   if (fname != NULL) {
@@ -38,6 +38,7 @@
 #include "gui/Measurement.h"
 #include "RenderStatistic.h"
 #include "gui/TabManager.h"
+#include "core/InstantiationCache.h"
 #include "core/Tree.h"
 #include "gui/UIUtils.h"
 #include "gui/qtgettext.h" // IWYU pragma: keep
@@ -76,6 +77,7 @@ public:
 
   SourceFile *rootFile; // Result of parsing
   SourceFile *parsedFile; // Last parse for include list
+  InstantiationCache instantiationCache; // Nodes of the last evaluation, for incremental-instantiation
   std::shared_ptr<AbstractNode> absoluteRootNode; // Result of tree evaluation
   std::shared_ptr<AbstractNode> rootNode; // Root if the root modifier (!) is used
 #ifdef ENABLE_PYTHON
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <string>
 #include <cstdlib> // for system()
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 #include <boost/regex.hpp>
@@ -18,6 +19,8 @@ const char *make_command = nullptr;
 
 void handle_dep(const std::string& filename)
 {
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
   fs::path filepath(filename);
   std::string dep = boost::regex_replace(filepath.generic_string(), boost::regex("\\ "), "\\\\ ");
   if (dependencies.find(dep) != dependencies.end()) {
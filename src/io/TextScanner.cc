@@ -0,0 +1,136 @@
+#include "io/TextScanner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <locale>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace bip = boost::interprocess;
+
+struct MappedFile::Mapping {
+  bip::file_mapping file;
+  bip::mapped_region region;
+};
+
+MappedFile::MappedFile(const std::string& filename)
+{
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(filename, ec);
+  if (ec) return;
+  // Mapping an empty file fails, but it is still a valid (empty) input
+  if (size == 0) {
+    this->open = true;
+    return;
+  }
+  try {
+    bip::file_mapping file(filename.c_str(), bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+    region.advise(bip::mapped_region::advice_sequential);
+    this->data = std::string_view(static_cast<const char *>(region.get_address()), region.get_size());
+    this->mapping = std::make_unique<Mapping>(Mapping{std::move(file), std::move(region)});
+    this->open = true;
+  } catch (const bip::interprocess_exception&) {
+    this->data = {};
+  }
+}
+
+MappedFile::~MappedFile() = default;
+
+namespace TextScanner {
+
+namespace {
+
+template <typename T>
+bool parseInteger(std::string_view token, T& value)
+{
+  if (!token.empty() && token.front() == '+') token.remove_prefix(1);
+  const auto end = token.data() + token.size();
+  const auto result = std::from_chars(token.data(), end, value);
+  return !token.empty() && result.ec == std::errc{} && result.ptr == end;
+}
+
+template <typename T>
+bool parseFloat(std::string_view token, T& value)
+{
+  // from_chars doesn't accept an explicit '+' sign
+  if (token.size() > 1 && token.front() == '+' && token[1] != '-') token.remove_prefix(1);
+  if (token.empty()) return false;
+#ifdef __cpp_lib_to_chars
+  const auto end = token.data() + token.size();
+  const auto result = std::from_chars(token.data(), end, value);
+  return result.ec == std::errc{} && result.ptr == end;
+#else
+  // fall back for standard libraries without floating point from_chars
+  std::istringstream istr{std::string(token)};
+  istr.imbue(std::locale::classic());
+  istr >> value;
+  return !istr.fail() && istr.peek() == EOF;
+#endif
+}
+
+} // namespace
+
+bool parseNumber(std::string_view token, double& value) { return parseFloat(token, value); }
+bool parseNumber(std::string_view token, float& value) { return parseFloat(token, value); }
+bool parseNumber(std::string_view token, int& value) { return parseInteger(token, value); }
+bool parseNumber(std::string_view token, long& value) { return parseInteger(token, value); }
+bool parseNumber(std::string_view token, unsigned int& value) { return parseInteger(token, value); }
+bool parseNumber(std::string_view token, unsigned long& value) { return parseInteger(token, value); }
+
+bool LineScanner::next(std::string_view& line)
+{
+  if (this->pos == this->end) return false;
+  const auto *newline = static_cast<const char *>(std::memchr(this->pos, '\n', this->end - this->pos));
+  const char *lineEnd = newline ? newline : this->end;
+  line = std::string_view(this->pos, lineEnd - this->pos);
+  this->pos = newline ? newline + 1 : this->end;
+  ++this->lineno;
+  return true;
+}
+
+std::vector<std::string_view> splitIntoChunks(std::string_view text, LinePredicate isBoundary)
+{
+  // Below this size, thread startup costs more than it saves
+  constexpr size_t minChunkSize = 4 * 1024 * 1024;
+  const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t numChunks = std::min(text.size() / minChunkSize, 4 * threads);
+  if (numChunks <= 1) return {text};
+
+  std::vector<std::string_view> chunks;
+  chunks.reserve(numChunks);
+  const size_t chunkSize = text.size() / numChunks;
+  const char *begin = text.data();
+  const char *end = text.data() + text.size();
+  const char *chunkStart = begin;
+  while (chunkStart != end) {
+    const char *target = chunkStart + std::min<size_t>(chunkSize, end - chunkStart);
+    // Advance to the start of the next boundary line
+    const char *split = end;
+    LineScanner scanner(std::string_view(target, end - target));
+    std::string_view line;
+    scanner.next(line); // the (partial) line containing target
+    while (scanner.next(line)) {
+      if (isBoundary(line)) {
+        split = line.data();
+        break;
+      }
+    }
+    chunks.emplace_back(chunkStart, split - chunkStart);
+    chunkStart = split;
+  }
+  return chunks;
+}
+
+} // namespace TextScanner
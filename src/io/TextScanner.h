@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*!
+   Read-only memory mapping of a whole file.
+   Importers scan the mapped bytes directly instead of copying lines out of
+   an ifstream.
+ */
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  [[nodiscard]] bool isOpen() const { return open; }
+  [[nodiscard]] std::string_view contents() const { return data; }
+
+private:
+  struct Mapping;
+  std::unique_ptr<Mapping> mapping;
+  std::string_view data;
+  bool open{false};
+};
+
+namespace TextScanner {
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline std::string_view trim(std::string_view s) {
+  size_t begin = 0;
+  while (begin < s.size() && isSpace(s[begin])) ++begin;
+  size_t end = s.size();
+  while (end > begin && isSpace(s[end - 1])) --end;
+  return s.substr(begin, end - begin);
+}
+
+inline bool startsWith(std::string_view s, std::string_view prefix) {
+  return s.substr(0, prefix.size()) == prefix;
+}
+
+/*!
+   Returns the next whitespace separated token of s and removes it from s.
+   Returns an empty token when s has no more tokens.
+ */
+inline std::string_view nextToken(std::string_view& s) {
+  size_t begin = 0;
+  while (begin < s.size() && isSpace(s[begin])) ++begin;
+  size_t end = begin;
+  while (end < s.size() && !isSpace(s[end])) ++end;
+  const auto token = s.substr(begin, end - begin);
+  s.remove_prefix(end);
+  return token;
+}
+
+// Splits s into whitespace separated tokens, reusing the tokens vector.
+inline void tokenize(std::string_view s, std::vector<std::string_view>& tokens) {
+  tokens.clear();
+  for (auto token = nextToken(s); !token.empty(); token = nextToken(s)) {
+    tokens.push_back(token);
+  }
+}
+
+// Parse the whole token as a number, returning false on any trailing garbage.
+bool parseNumber(std::string_view token, double& value);
+bool parseNumber(std::string_view token, float& value);
+bool parseNumber(std::string_view token, int& value);
+bool parseNumber(std::string_view token, long& value);
+bool parseNumber(std::string_view token, unsigned int& value);
+bool parseNumber(std::string_view token, unsigned long& value);
+
+/*!
+   Iterates over the lines of a buffer. Lines are returned without their line
+   terminator; "\r\n" terminated lines keep their '\r', which trim() removes.
+ */
+class LineScanner
+{
+public:
+  LineScanner(std::string_view text) : pos(text.data()), end(text.data() + text.size()) {}
+
+  bool next(std::string_view& line);
+  [[nodiscard]] bool atEnd() const { return pos == end; }
+  // 1-based number of the line last returned by next()
+  [[nodiscard]] size_t lineNumber() const { return lineno; }
+
+private:
+  const char *pos;
+  const char *end;
+  size_t lineno{0};
+};
+
+using LinePredicate = bool (*)(std::string_view line);
+
+/*!
+   Splits text into chunks of whole lines for parsing on several threads.
+   Each chunk except the first starts at a line for which isBoundary returns
+   true, so parsers can start each chunk from a known state.
+   Small inputs are returned as a single chunk.
+ */
+std::vector<std::string_view> splitIntoChunks(std::string_view text, LinePredicate isBoundary);
+
+} // namespace TextScanner
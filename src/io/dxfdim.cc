@@ -41,12 +41,15 @@
 #include <cstddef>
 #include <cmath>
 #include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include <filesystem>
 std::unordered_map<std::string, double> dxf_dim_cache;
 std::unordered_map<std::string, std::vector<double>> dxf_cross_cache;
+// Guards both caches, as animation frames may be evaluated concurrently
+std::mutex dxf_cache_mutex;
 namespace fs = std::filesystem;
 
 Value builtin_dxf_dim(Arguments arguments, const Location& loc)
@@ -87,6 +90,7 @@ Value builtin_dxf_dim(Arguments arguments, const Location& loc)
   std::string key = STR(filename, "|", layername, "|", name, "|", xorigin,
                         "|", yorigin, "|", scale, "|", lastwritetime,
                         "|", filesize);
+  std::lock_guard<std::mutex> lock(dxf_cache_mutex);
   auto result = dxf_dim_cache.find(key);
   if (result != dxf_dim_cache.end()) return {result->second};
   handle_dep(filepath.string());
@@ -185,6 +189,7 @@ Value builtin_dxf_cross(Arguments arguments, const Location& loc)
                         "|", scale, "|", lastwritetime,
                         "|", filesize);
 
+  std::lock_guard<std::mutex> lock(dxf_cache_mutex);
   auto result = dxf_cross_cache.find(key);
   if (result != dxf_cross_cache.end()) {
     VectorType ret(session);
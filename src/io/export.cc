@@ -32,6 +32,7 @@
 #include "geometry/PolySet.h"
 #include "utils/printutils.h"
 #include "geometry/Geometry.h"
+#include "geometry/InstancedGeometry.h"
 #include "glview/RenderSettings.h"
 
 #include <unordered_map>
@@ -204,8 +205,10 @@ ExportInfo createExportInfo(const FileFormat& format, const FileFormatInfo& info
   return exportInfo;
 }
 
-void exportFile(const std::shared_ptr<const Geometry>& root_geom, std::ostream& output, const ExportInfo& exportInfo)
+void exportFile(const std::shared_ptr<const Geometry>& geom, std::ostream& output, const ExportInfo& exportInfo)
 {
+  // The exporters need real coordinates
+  const auto root_geom = InstancedGeometry::flatten(geom);
   switch (exportInfo.format) {
   case FileFormat::ASCII_STL:
     export_stl(root_geom, output, false);
@@ -359,34 +362,33 @@ std::unique_ptr<PolySet> createSortedPolySet(const PolySet& ps)
     out->vertices.push_back(v);
   }
 
-  for (auto& poly : out->indices) {
-    IndexedFace polygon;
-    for (const auto idx : poly) {
-      polygon.push_back(indexTranslationMap[idx]);
+  for (auto poly : out->indices) {
+    for (auto& idx : poly) {
+      idx = indexTranslationMap[idx];
     }
-    std::rotate(polygon.begin(), std::min_element(polygon.begin(), polygon.end()), polygon.end());
-    poly = polygon;
+    std::rotate(poly.begin(), std::min_element(poly.begin(), poly.end()), poly.end());
   }
-  if (ps.color_indices.empty()) {
-    std::sort(out->indices.begin(), out->indices.end());
-  } else {
-    struct ColoredFace {
-      IndexedFace face;
-      int32_t color_index;
-    };
-    std::vector<ColoredFace> faces;
-    faces.reserve(ps.indices.size());
-    for (size_t i = 0, n = ps.indices.size(); i < n; i++) {
-      faces.push_back({out->indices[i], out->color_indices[i]});
-    }
-    std::sort(faces.begin(), faces.end(), [](const ColoredFace& a, const ColoredFace& b) {
-      return a.face < b.face;
-    });
-    for (size_t i = 0, n = faces.size(); i < n; i++) {
-      auto & face = faces[i];
-      out->indices[i] = face.face;
-      out->color_indices[i] = face.color_index;
-    }
+
+  struct ColoredFace {
+    IndexedFace face;
+    int32_t color_index;
+  };
+  const bool has_colors = !out->color_indices.empty();
+  std::vector<ColoredFace> faces;
+  faces.reserve(out->indices.size());
+  for (size_t i = 0, n = out->indices.size(); i < n; i++) {
+    const auto poly = out->indices[i];
+    faces.push_back({IndexedFace(poly.begin(), poly.end()), has_colors ? out->color_indices[i] : -1});
+  }
+  std::sort(faces.begin(), faces.end(), [](const ColoredFace& a, const ColoredFace& b) {
+    return a.face < b.face;
+  });
+  FaceIndices sorted;
+  sorted.reserve(faces.size(), out->indices.numIndices());
+  for (size_t i = 0, n = faces.size(); i < n; i++) {
+    sorted.push_back(faces[i].face);
+    if (has_colors) out->color_indices[i] = faces[i].color_index;
   }
+  out->indices = std::move(sorted);
   return out;
 }
\ No newline at end of file
@@ -183,7 +183,7 @@ bool append_polyset(const std::shared_ptr<const PolySet>& ps, ExportContext& ctx
     return lib3mf_meshobject_addvertex(mesh, &v, nullptr) == LIB3MF_OK;
   };
 
-  auto triangleFunc = [&](const IndexedFace& indices) -> bool {
+  auto triangleFunc = [&](const auto& indices) -> bool {
     MODELMESHTRIANGLE t{(DWORD)indices[0], (DWORD)indices[1], (DWORD)indices[2]};
     return lib3mf_meshobject_addtriangle(mesh, &t, nullptr) == LIB3MF_OK;
   };
@@ -180,7 +180,7 @@ bool append_polyset(const std::shared_ptr<const PolySet>& ps, ExportContext& ctx
       return true;
     };
 
-    auto triangleFunc = [&](const IndexedFace& indices, int color_index) -> bool {
+    auto triangleFunc = [&](const auto& indices, int color_index) -> bool {
       try {
         const auto triangle = mesh->AddTriangle({
           static_cast<Lib3MF_uint32>(indices[0]),
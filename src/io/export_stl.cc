@@ -29,13 +29,14 @@
 #include "geometry/linalg.h"
 #include "geometry/PolySet.h"
 #include "geometry/PolySetUtils.h"
-#include <sstream>
 #include <algorithm>
 #include <cassert>
 #include <array>
 #include <ios>
 #include <ostream>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <double-conversion/double-conversion.h>
 #ifdef ENABLE_MANIFOLD
@@ -64,81 +65,177 @@ namespace {
 #define DC_MAX_LEADING_ZEROES (5)
 #define DC_MAX_TRAILING_ZEROES (0)
 
-std::string toString(const Vector3d& v)
+const double_conversion::DoubleToStringConverter& converter()
 {
-  double_conversion::DoubleToStringConverter dc(
+  static const double_conversion::DoubleToStringConverter dc(
     DC_FLAGS, DC_INF, DC_NAN, DC_EXP,
     DC_DECIMAL_LOW_EXP, DC_DECIMAL_HIGH_EXP, DC_MAX_LEADING_ZEROES, DC_MAX_TRAILING_ZEROES
   );
+  return dc;
+}
 
-  char buffer[DC_BUFFER_SIZE];
-
+/*!
+   Formats the shortest representation of v, which round-trips, into buffer
+   and returns the length.
+ */
+size_t toChars(const Vector3d& v, char *buffer)
+{
+  const auto& dc = converter();
   double_conversion::StringBuilder builder(buffer, DC_BUFFER_SIZE);
   dc.ToShortest(v[0], &builder);
   builder.AddCharacter(' ');
   dc.ToShortest(v[1], &builder);
   builder.AddCharacter(' ');
   dc.ToShortest(v[2], &builder);
+  const size_t length = builder.position();
   builder.Finalize();
+  return length;
+}
 
-  return buffer;
+std::string toString(const Vector3d& v)
+{
+  char buffer[DC_BUFFER_SIZE];
+  return {buffer, toChars(v, buffer)};
 }
 
-int32_t flipEndianness(int32_t x) {
+/*!
+   Collects output in a fixed-size buffer and writes it to the stream in large
+   chunks, so exports never hold more than one chunk of the file in memory.
+ */
+class StreamBuffer
+{
+public:
+  StreamBuffer(std::ostream& output) : output(output) {}
+  ~StreamBuffer() { flush(); }
+
+  void append(const char *data, size_t size) {
+    if (size > buffer.size() - pos) {
+      flush();
+      if (size > buffer.size()) {
+        output.write(data, size);
+        return;
+      }
+    }
+    std::memcpy(buffer.data() + pos, data, size);
+    pos += size;
+  }
+  void append(const std::string& str) { append(str.data(), str.size()); }
+  template <size_t N>
+  void append(const char (&literal)[N]) { append(literal, N - 1); }
+
+  void flush() {
+    if (pos > 0) output.write(buffer.data(), pos);
+    pos = 0;
+  }
+
+private:
+  std::ostream& output;
+  std::array<char, 256 * 1024> buffer;
+  size_t pos{0};
+};
+
+uint32_t toLittleEndian(uint32_t x) {
+  static const uint16_t test = 0x0001;
+  static const bool isLittleEndian = *reinterpret_cast<const char *>(&test) == 1;
+  if (isLittleEndian) return x;
   return
     ((x << 24) & 0xff000000) | ((x >> 24) & 0xff) |
     ((x << 8) & 0xff0000) | ((x >> 8) & 0xff00);
 }
 
-template <size_t N>
-void write_floats(std::ostream& output, const std::array<float, N>& data) {
-  static uint16_t test = 0x0001;
-  static bool isLittleEndian = *reinterpret_cast<char *>(&test) == 1;
-
-  if (isLittleEndian) {
-    output.write(reinterpret_cast<char *>(const_cast<float *>(&data[0])), N * sizeof(float));
-  } else {
-    std::array<float, N> copy(data);
-
-    auto *ints = reinterpret_cast<int32_t *>(&copy[0]);
-    for (size_t i = 0; i < N; i++) {
-      ints[i] = flipEndianness(ints[i]);
+void append_triangle_binary(StreamBuffer& output, const Vector3d& normal,
+                            const Vector3d& p0, const Vector3d& p1, const Vector3d& p2)
+{
+  static_assert(sizeof(float) == 4, "Need 32 bit float");
+  // 12 floats followed by a 2 byte attribute count
+  char record[4 * 3 * 4 + 2] = {};
+  size_t offset = 0;
+  for (const auto *v : {&normal, &p0, &p1, &p2}) {
+    for (auto i : {0, 1, 2}) {
+      const float f = (*v)[i];
+      uint32_t bits;
+      std::memcpy(&bits, &f, sizeof(bits));
+      bits = toLittleEndian(bits);
+      std::memcpy(record + offset, &bits, sizeof(bits));
+      offset += sizeof(bits);
     }
-
-    output.write(reinterpret_cast<char *>(&copy[0]), N * sizeof(float));
   }
+  output.append(record, sizeof(record));
 }
 
-
-uint64_t append_stl(std::shared_ptr<const PolySet> polyset, std::ostream& output, bool binary)
+/*!
+   Converts the geometry to triangulated PolySets and passes them to handle
+   in export order, one at a time, so only one of them is held at once.
+   Set report to false to convert without logging warnings and errors again.
+ */
+void for_each_polyset(const std::shared_ptr<const Geometry>& geom, bool report,
+                      const std::function<void(const PolySet&)>& handle)
 {
-  static_assert(sizeof(float) == 4, "Need 32 bit float");
+  std::shared_ptr<const PolySet> ps;
+  if (const auto geomlist = std::dynamic_pointer_cast<const GeometryList>(geom)) {
+    for (const Geometry::GeometryItem& item : geomlist->getChildren()) {
+      for_each_polyset(item.second, report, handle);
+    }
+    return;
+  } else if (const auto polyset = std::dynamic_pointer_cast<const PolySet>(geom)) {
+    ps = polyset;
+#ifdef ENABLE_CGAL
+  } else if (const auto N = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
+    if (report && !N->p3->is_simple()) {
+      LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
+    }
+    ps = CGALUtils::createPolySetFromNefPolyhedron3(*(N->p3));
+    if (report && !ps) LOG(message_group::Export_Error, "Nef->PolySet failed");
+#endif
+#ifdef ENABLE_MANIFOLD
+  } else if (const auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
+    if (report && !mani->isManifold()) {
+      LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
+    }
+    ps = mani->toPolySet();
+    if (report && !ps) LOG(message_group::Export_Error, "Manifold->PolySet failed");
+#endif
+  } else if (std::dynamic_pointer_cast<const Polygon2d>(geom)) { //NOLINT(bugprone-branch-clone)
+    assert(false && "Unsupported file format");
+  } else { //NOLINT(bugprone-branch-clone)
+    assert(false && "Not implemented");
+  }
+  if (!ps) return;
 
-  std::shared_ptr<const PolySet> ps = polyset;
   if (!ps->isTriangular()) {
     ps = PolySetUtils::tessellate_faces(*ps);
   }
   if (Feature::ExperimentalPredictibleOutput.is_enabled()) {
     ps = createSortedPolySet(*ps);
   }
+  handle(*ps);
+}
 
-  uint64_t triangle_count = 0;
+std::array<char, 4> countBytes(uint64_t triangle_count)
+{
+  if (triangle_count > 4294967295) {
+    LOG(message_group::Export_Error, "Triangle count exceeded 4294967295, so the STL file is not valid");
+  }
+  const uint32_t count = toLittleEndian(static_cast<uint32_t>(triangle_count));
+  std::array<char, 4> bytes;
+  std::memcpy(bytes.data(), &count, sizeof(count));
+  return bytes;
+}
 
+void append_stl(const PolySet& ps, StreamBuffer& output, bool binary)
+{
   // In ASCII mode only, convert each vertex to string.
   std::vector<std::string> vertexStrings;
   if (!binary) {
-    vertexStrings.resize(ps->vertices.size());
-    std::transform(ps->vertices.begin(), ps->vertices.end(), vertexStrings.begin(),
+    vertexStrings.resize(ps.vertices.size());
+    std::transform(ps.vertices.begin(), ps.vertices.end(), vertexStrings.begin(),
       [](const auto& p) { return toString(p); });
   }
 
-  // Used for binary mode only
-  std::array<float, 4lu * 3> coords;
-
-  for (const auto &t : ps->indices) {
-    const auto &p0 = ps->vertices[t[0]];
-    const auto &p1 = ps->vertices[t[1]];
-    const auto &p2 = ps->vertices[t[2]];
+  for (const auto &t : ps.indices) {
+    const auto &p0 = ps.vertices[t[0]];
+    const auto &p1 = ps.vertices[t[1]];
+    const auto &p2 = ps.vertices[t[2]];
 
     // Tessellation already eliminated these cases.
     assert(p0 != p1 && p0 != p2 && p1 != p2);
@@ -149,19 +246,7 @@ uint64_t append_stl(std::shared_ptr<const PolySet> polyset, std::ostream& output
     }
 
     if (binary) {
-      auto coords_offset = 0;
-      auto addCoords = [&](const auto& v) {
-        for (auto i : {0, 1, 2})
-          coords[coords_offset++] = v[i];
-      };
-      addCoords(normal);
-      addCoords(p0);
-      addCoords(p1);
-      addCoords(p2);
-      assert(coords_offset == 4 * 3);
-      write_floats(output, coords);
-      char attrib[2] = {0, 0};
-      output.write(attrib, 2);
+      append_triangle_binary(output, normal, p0, p1, p2);
     } else {
       const auto &s0 = vertexStrings[t[0]];
       const auto &s1 = vertexStrings[t[1]];
@@ -172,95 +257,18 @@ uint64_t append_stl(std::shared_ptr<const PolySet> polyset, std::ostream& output
       // different too.
       assert(s0 != s1 && s0 != s2 && s1 != s2);
 
-      output << "  facet normal ";
-      output << toString(normal) << "\n";
-      output << "    outer loop\n";
-      output << "      vertex " << s0 << "\n";
-      output << "      vertex " << s1 << "\n";
-      output << "      vertex " << s2 << "\n";
-      output << "    endloop\n";
-      output << "  endfacet\n";
-    }
-    triangle_count++;
-  }
-
-  return triangle_count;
-}
-
-#ifdef ENABLE_CGAL
-/*!
-    Saves the current 3D CGAL Nef polyhedron as STL to the given file.
-    The file must be open.
- */
-uint64_t append_stl(const CGAL_Nef_polyhedron& root_N, std::ostream& output,
-                    bool binary)
-{
-  uint64_t triangle_count = 0;
-  if (!root_N.p3->is_simple()) {
-    LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
-  }
-
-  if (std::shared_ptr<PolySet> ps = CGALUtils::createPolySetFromNefPolyhedron3(*(root_N.p3))) {
-    triangle_count += append_stl(ps, output, binary);
-  } else {
-    LOG(message_group::Export_Error, "Nef->PolySet failed");
-  }
-
-  return triangle_count;
-}
-
-#endif  // ENABLE_CGAL
-
-#ifdef ENABLE_MANIFOLD
-/*!
-   Saves the current 3D Manifold geometry as STL to the given file.
-   The file must be open.
- */
-uint64_t append_stl(const ManifoldGeometry& mani, std::ostream& output,
-                    bool binary)
-{
-  uint64_t triangle_count = 0;
-  if (!mani.isManifold()) {
-    LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
-  }
-
-  const auto ps = mani.toPolySet();
-  if (ps) {
-    triangle_count += append_stl(ps, output, binary);
-  } else {
-    LOG(message_group::Export_Error, "Manifold->PolySet failed");
-  }
-
-  return triangle_count;
-}
-#endif  // ENABLE_MANIFOLD
-
-
-uint64_t append_stl(const std::shared_ptr<const Geometry>& geom, std::ostream& output,
-                    bool binary)
-{
-  uint64_t triangle_count = 0;
-  if (const auto geomlist = std::dynamic_pointer_cast<const GeometryList>(geom)) {
-    for (const Geometry::GeometryItem& item : geomlist->getChildren()) {
-      triangle_count += append_stl(item.second, output, binary);
+      char normalString[DC_BUFFER_SIZE];
+      output.append("  facet normal ");
+      output.append(normalString, toChars(normal, normalString));
+      output.append("\n    outer loop\n      vertex ");
+      output.append(s0);
+      output.append("\n      vertex ");
+      output.append(s1);
+      output.append("\n      vertex ");
+      output.append(s2);
+      output.append("\n    endloop\n  endfacet\n");
     }
-  } else if (const auto ps = std::dynamic_pointer_cast<const PolySet>(geom)) {
-    triangle_count += append_stl(ps, output, binary);
-#ifdef ENABLE_CGAL
-  } else if (const auto N = std::dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
-    triangle_count += append_stl(*N, output, binary);
-#endif
-#ifdef ENABLE_MANIFOLD
-  } else if (const auto mani = std::dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
-    triangle_count += append_stl(*mani, output, binary);
-#endif
-  } else if (std::dynamic_pointer_cast<const Polygon2d>(geom)) { //NOLINT(bugprone-branch-clone)
-    assert(false && "Unsupported file format");
-  } else { //NOLINT(bugprone-branch-clone)
-    assert(false && "Not implemented");
   }
-
-  return triangle_count;
 }
 
 } // namespace
@@ -269,41 +277,42 @@ void export_stl(const std::shared_ptr<const Geometry>& geom, std::ostream& outpu
                 bool binary)
 {
   // FIXME: In lazy union mode, should we export multiple solids?
+  StreamBuffer buffer(output);
   if (binary) {
-    std::ostringstream buffer; // Using a memory buffer
     char header[80] = "OpenSCAD Model\n";
-    buffer.write(header, sizeof(header));
-    
-  // Placeholder for triangle count
-    uint32_t triangle_count = 0;
-    char tmp_triangle_count[4] = {0, 0, 0, 0};
-    buffer.write(tmp_triangle_count, 4);
-
-    // Writing triangles and counting them
-    triangle_count = append_stl(geom, buffer, binary);
-
-  if (triangle_count > 4294967295) {
-    LOG(message_group::Export_Error, "Triangle count exceeded 4294967295, so the STL file is not valid");
+    buffer.append(header, sizeof(header));
+
+    // The triangle count precedes the triangles. It is written afterwards
+    // into seekable outputs; for others, e.g. pipes, the geometry is
+    // converted twice, to count the triangles first.
+    buffer.flush();
+    const auto count_pos = output.tellp();
+    const bool seekable = count_pos != std::ostream::pos_type(-1);
+    uint64_t triangle_count = 0;
+    if (!seekable) {
+      for_each_polyset(geom, false, [&triangle_count](const PolySet& ps) { triangle_count += ps.indices.size(); });
+    }
+    const auto count = countBytes(triangle_count);
+    buffer.append(count.data(), count.size());
+
+    for_each_polyset(geom, true, [&buffer, &triangle_count, seekable](const PolySet& ps) {
+      if (seekable) triangle_count += ps.indices.size();
+      append_stl(ps, buffer, true);
+    });
+
+    if (seekable) {
+      buffer.flush();
+      const auto actual = countBytes(triangle_count);
+      output.seekp(count_pos);
+      output.write(actual.data(), actual.size());
+      output.seekp(0, std::ios::end);
     }
-
-  // Updating the triangle count in the buffer
-    char triangle_count_bytes[4] = {
-        static_cast<char>(triangle_count & 0xff),
-        static_cast<char>((triangle_count >> 8) & 0xff),
-        static_cast<char>((triangle_count >> 16) & 0xff),
-        static_cast<char>((triangle_count >> 24) & 0xff)};
-    buffer.seekp(80, std::ios_base::beg);
-    buffer.write(triangle_count_bytes, 4);
-    
-    // Flushing the buffer to the output stream
-    output << buffer.str();
-
   } else {
-    // ASCII mode: Write directly to the output stream
     setlocale(LC_NUMERIC, "C"); // Ensure radix is . (not ,) in output
-    output << "solid OpenSCAD_Model\n";
-    append_stl(geom, output, binary);
-    output << "endsolid OpenSCAD_Model\n";
+    buffer.append("solid OpenSCAD_Model\n");
+    for_each_polyset(geom, true, [&buffer](const PolySet& ps) { append_stl(ps, buffer, false); });
+    buffer.append("endsolid OpenSCAD_Model\n");
+    buffer.flush();
     setlocale(LC_NUMERIC, ""); // Restore default locale
   }
 }
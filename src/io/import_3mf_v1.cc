@@ -337,10 +337,8 @@ std::string import_3mf_mesh(const std::string& filename, unsigned int mesh_idx,
     if (lib3mf_meshobject_gettriangle(mo->obj, idx, &triangle) != LIB3MF_OK) {
       return "Could not read triangle from object";
     }
-    ps->indices.emplace_back();
-    for (DWORD vertex_idx : triangle.m_nIndices) {
-      ps->indices.back().push_back(vertex_idx);
-    }
+    ps->indices.push_back({static_cast<int>(triangle.m_nIndices[0]), static_cast<int>(triangle.m_nIndices[1]),
+                          static_cast<int>(triangle.m_nIndices[2])});
 
     const Color4f col = get_triangle_color(model, propertyhandler, idx);
     if (col.isValid()) {
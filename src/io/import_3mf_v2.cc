@@ -229,10 +229,8 @@ std::string import_3mf_mesh(const std::string& filename, unsigned int mesh_idx,
   std::unordered_map<Color4f, int32_t> color_indices;
   for (Lib3MF_uint32 idx = 0; idx < triangle_count; ++idx) {
     const auto triangle = object->GetTriangle(idx);
-    ps->indices.emplace_back();
-    for (const auto& idx : triangle.m_Indices) {
-      ps->indices.back().push_back(idx);
-    }
+    ps->indices.push_back({static_cast<int>(triangle.m_Indices[0]), static_cast<int>(triangle.m_Indices[1]),
+                          static_cast<int>(triangle.m_Indices[2])});
 
     const Color4f col = get_triangle_color(model, object, idx);
     if (col.isValid()) {
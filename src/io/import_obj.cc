@@ -1,96 +1,164 @@
 #include "io/import.h"
+#include "io/TextScanner.h"
 #include "geometry/linalg.h"
 #include "core/AST.h"
 #include "geometry/PolySet.h"
 #include "geometry/PolySetBuilder.h"
-#include <ios>
+#include "utils/parallel.h"
+#include "utils/printutils.h"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
 
-std::unique_ptr<PolySet> import_obj(const std::string& filename, const Location& loc) {
-  PolySetBuilder builder;
+namespace {
+
+// Result of parsing a range of lines of an OBJ file
+struct ObjChunk {
+  struct Face {
+    size_t line; // relative to the start of the chunk
+    size_t begin; // first index in indices
+    size_t size;
+    size_t vertices_before; // number of vertices of this chunk preceding the face
+  };
+  struct Diagnostic {
+    size_t line;
+    std::string text;
+    bool fatal; // fatal errors abort the import, other lines are just unrecognized
+    const char *message;
+  };
+  std::vector<Vector3d> vertices;
+  std::vector<long> indices;
+  std::vector<Face> faces;
+  std::vector<Diagnostic> diagnostics;
+  size_t lines{0};
+};
+
+bool is_obj_chunk_boundary(std::string_view /*line*/)
+{
+  return true;
+}
+
+bool is_ignored_obj_line(std::string_view line)
+{
+  using TextScanner::startsWith;
+  // texture coords, normal coords, material lib, usemtl, object name, smoothing, group name
+  return startsWith(line, "vt") || startsWith(line, "vn") || startsWith(line, "mtllib") ||
+         startsWith(line, "usemtl") || line[0] == 'o' || line[0] == 's' || line[0] == 'g';
+}
+
+ObjChunk parse_obj_chunk(std::string_view text)
+{
+  using namespace TextScanner;
+  ObjChunk chunk;
+  LineScanner scanner(text);
+  std::string_view line;
+  std::vector<std::string_view> words;
+
+  while (scanner.next(line)) {
+    line = trim(line);
+    if (line.empty() || line[0] == '#') continue;
+
+    tokenize(line, words);
+    if (words[0] == "v" && words.size() >= 4) {
+      // Optional w or vertex colors following x y z are ignored
+      Vector3d v;
+      if (!parseNumber(words[1], v[0]) || !parseNumber(words[2], v[1]) || !parseNumber(words[3], v[2])) {
+        chunk.diagnostics.push_back({scanner.lineNumber(), std::string(line), true, "can't parse vertex"});
+        break;
+      }
+      chunk.vertices.push_back(v);
+    } else if (words[0] == "f" && words.size() >= 2) {
+      ObjChunk::Face face{scanner.lineNumber(), chunk.indices.size(), words.size() - 1, chunk.vertices.size()};
+      bool ok = true;
+      for (size_t i = 1; i < words.size() && ok; ++i) {
+        // Only the vertex index of "v/vt/vn" is used
+        const auto word = words[i];
+        long ind;
+        ok = parseNumber(word.substr(0, word.find('/')), ind);
+        chunk.indices.push_back(ind);
+      }
+      if (!ok) {
+        chunk.diagnostics.push_back({scanner.lineNumber(), std::string(line), true, "can't parse face"});
+        break;
+      }
+      chunk.faces.push_back(face);
+    } else if (!is_ignored_obj_line(line)) {
+      chunk.diagnostics.push_back({scanner.lineNumber(), std::string(line), false, nullptr});
+    }
+  }
+  chunk.lines = scanner.lineNumber();
+  return chunk;
+}
 
-  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary );
-  if (!f.good()) {
+} // namespace
+
+std::unique_ptr<PolySet> import_obj(const std::string& filename, const Location& loc) {
+  const MappedFile file(filename);
+  if (!file.isOpen()) {
     LOG(message_group::Warning,
         "Can't open import file '%1$s', import() at line %2$d",
         filename, loc.firstLine());
     return PolySet::createEmpty();
   }
-  boost::regex ex_comment(R"(^\s*#)");
-  boost::regex ex_v( R"(^\s*v\s+([^\s]+)\s+([^\s]+)\s+([^\s]+)\s*$)");
-  boost::regex ex_f( R"(^\s*f\s+(.*)$)");
-  boost::regex ex_vt( R"(^\s*vt)");
-  boost::regex ex_vn( R"(^\s*vn)");
-  boost::regex ex_mtllib( R"(^\s*mtllib)");
-  boost::regex ex_usemtl( R"(^\s*usemtl)");
-  boost::regex ex_o( R"(^\s*o)");
-  boost::regex ex_s( R"(^\s*s)");
-  boost::regex ex_g( R"(^\s*g)");
-  int lineno = 1;
-  std::string line;
 
-  auto AsciiError = [&](const auto& errstr){
+  const auto chunks = TextScanner::splitIntoChunks(file.contents(), is_obj_chunk_boundary);
+  std::vector<ObjChunk> results(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), results.begin(), parse_obj_chunk);
+
+  size_t vertices_count = 0;
+  size_t faces_count = 0;
+  for (const auto& chunk : results) {
+    vertices_count += chunk.vertices.size();
+    faces_count += chunk.faces.size();
+  }
+  PolySetBuilder builder(vertices_count, faces_count);
+  std::vector<int> vertex_map;
+  vertex_map.reserve(vertices_count);
+
+  size_t first_line = 0;
+  auto AsciiError = [&](const auto& errstr, size_t lineno, const std::string& line){
     LOG(message_group::Error, loc, "",
     "OBJ File line %1$s, %2$s line '%3$s' importing file '%4$s'",
     lineno, errstr, line, filename);
   };
-  std::vector<int> vertex_map;
 
-  while (!f.eof()) {
-    lineno++;
-    std::getline(f, line);
-    boost::trim(line);
+  for (const auto& chunk : results) {
+    const size_t chunk_vertices = vertex_map.size();
+    builder.vertexIndices(chunk.vertices, vertex_map);
 
-    boost::smatch results;
-    if (line.length() == 0 || boost::regex_search(line, ex_comment)) {
-      continue;
-    } else if (boost::regex_search(line, results, ex_v) && results.size() >= 4) {
-      try {
-        Vector3d v;
-        for (int i = 0; i < 3; i++) {
-          v[i]= boost::lexical_cast<double>(results[i + 1]);
+    // Report diagnostics and index warnings in line order
+    auto diagnostic = chunk.diagnostics.begin();
+    auto report_until = [&](size_t line) {
+      for (; diagnostic != chunk.diagnostics.end() && diagnostic->line < line; ++diagnostic) {
+        const size_t lineno = first_line + diagnostic->line;
+        if (diagnostic->fatal) {
+          AsciiError(diagnostic->message, lineno, diagnostic->text);
+          return false;
         }
-        vertex_map.push_back(builder.vertexIndex(v));
-      } catch (const boost::bad_lexical_cast& blc) {
-        AsciiError("can't parse vertex");
-        return PolySet::createEmpty();
+        LOG(message_group::Warning, "Unrecognized Line  %1$s in line Line %2$d", diagnostic->text, lineno);
       }
-    } else if (boost::regex_search(line, results, ex_f) && results.size() >= 2) {
-      std::vector<std::string> words;
-      boost::split(words, results[1], boost::is_any_of(" \t"));
-      builder.beginPolygon(words.size());
-      for (const std::string& word : words) {
-        std::vector<std::string> wordindex;
-        boost::split(wordindex, word, boost::is_any_of("/"));
-        if(wordindex.size() < 1)
-          LOG(message_group::Warning, "Invalid Face index in File %1$s in Line %2$d", filename, lineno);
-        else {
-          size_t ind=boost::lexical_cast<int>(wordindex[0]);
-          if(ind >= 1 && ind  <= vertex_map.size()) {
-            builder.addVertex(vertex_map[ind-1]);
-          } else {
-            LOG(message_group::Warning, "Index %1$d out of range in Line %2$d", filename, lineno);
-          }
+      return true;
+    };
+
+    for (const auto& face : chunk.faces) {
+      if (!report_until(face.line)) return PolySet::createEmpty();
+      // Negative indices are relative to the last vertex read so far
+      const long available = chunk_vertices + face.vertices_before;
+      builder.beginPolygon(face.size);
+      for (size_t i = face.begin; i < face.begin + face.size; ++i) {
+        const long ind = chunk.indices[i] < 0 ? available + chunk.indices[i] + 1 : chunk.indices[i];
+        if (ind >= 1 && ind <= available) {
+          builder.addVertex(vertex_map[ind - 1]);
+        } else {
+          LOG(message_group::Warning, "Index %1$d out of range in Line %2$d", chunk.indices[i], first_line + face.line);
         }
       }
-
-    } else if (boost::regex_search(line, results, ex_vt)) { // ignore texture coords
-    } else if (boost::regex_search(line, results, ex_vn)) { // ignore normal coords
-    } else if (boost::regex_search(line, results, ex_mtllib)) { // ignore material lib
-    } else if (boost::regex_search(line, results, ex_usemtl)) { // ignore usemtl
-    } else if (boost::regex_search(line, results, ex_o)) { // ignore object name
-    } else if (boost::regex_search(line, results, ex_s)) { // ignore smooting
-    } else if (boost::regex_search(line, results, ex_g)) { // ignore group name
-    } else {
-      LOG(message_group::Warning, "Unrecognized Line  %1$s in line Line %2$d", line, lineno);
     }
+    if (!report_until(SIZE_MAX)) return PolySet::createEmpty();
+    first_line += chunk.lines;
   }
   return builder.build();
 }
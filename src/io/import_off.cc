@@ -4,36 +4,66 @@
 #include "geometry/PolySet.h"
 #include "utils/printutils.h"
 #include "core/AST.h"
-#include <system_error>
+#include "io/TextScanner.h"
 #include <map>
-#include <ios>
 #include <cstdint>
 #include <memory>
-#include <charconv>
 #include <cstddef>
-#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include <boost/format.hpp>
 
 // References:
 // http://www.geomview.org/docs/html/OFF.html
 
-std::unique_ptr<PolySet> import_off(const std::string& filename, const Location& loc)
+namespace {
+
+struct OffHeader {
+  bool has_normals = false;
+  bool has_color = false;
+  bool has_textures = false;
+  bool has_ndim = false;
+  bool is_binary = false;
+  unsigned int dimension = 3;
+};
+
+// Parses "[ST][C][N][4][n]OFF[ BINARY]" at the start of line and removes it.
+// XXX: are ST C N always in order?
+bool parse_off_magic(std::string_view& line, OffHeader& header)
 {
-  boost::regex ex_magic(R"(^(ST)?(C)?(N)?(4)?(n)?OFF( BINARY)? *)");
-  // XXX: are ST C N always in order?
-  boost::regex ex_cr(R"(\r$)");
-  boost::regex ex_comment(R"(\s*#.*$)");
-  boost::smatch results;
+  using TextScanner::startsWith;
+  auto rest = line;
+  auto optional = [&](std::string_view prefix) {
+    if (!startsWith(rest, prefix)) return false;
+    rest.remove_prefix(prefix.size());
+    return true;
+  };
+  OffHeader result;
+  result.has_textures = optional("ST");
+  result.has_color = optional("C");
+  result.has_normals = optional("N");
+  if (optional("4")) result.dimension = 4;
+  result.has_ndim = optional("n");
+  if (!optional("OFF")) return false;
+  result.is_binary = optional(" BINARY");
+  while (optional(" ")) {}
+  line = rest;
+  header = result;
+  return true;
+}
 
-  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary);
+} // namespace
 
-  int lineno = 0;
-  std::string line;
+std::unique_ptr<PolySet> import_off(const std::string& filename, const Location& loc)
+{
+  using TextScanner::parseNumber;
+  const MappedFile file(filename);
+  TextScanner::LineScanner scanner(file.contents());
+
+  size_t lineno = 0;
+  std::string_view line;
 
   auto AsciiError = [&](const auto& errstr){
     LOG(message_group::Error, loc, "",
@@ -43,110 +73,80 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
 
   auto getline_clean = [&](const auto& errstr){
     do {
-      lineno++;
-      std::getline(f, line);
-      if (line.empty() && f.eof()) {
+      if (!scanner.next(line)) {
+        lineno++;
+        line = {};
         AsciiError(errstr);
         return false;
       }
-      // strip DOS line endings
-      if (boost::regex_search(line, results, ex_cr)) {
-        line = line.erase(results.position(), results[0].length());
-      }
+      lineno = scanner.lineNumber();
       // strip comments
-      if (boost::regex_search(line, results, ex_comment)) {
-        line = line.erase(results.position(), results[0].length());
-      }
-      boost::trim(line);
+      line = line.substr(0, line.find('#'));
+      // strip DOS line endings and whitespace
+      line = TextScanner::trim(line);
     } while (line.empty());
 
     return true;
   };
 
-  auto getcolor = [&](const auto& word){
+  auto getcolor = [&](std::string_view word){
     int c;
-    if (boost::contains(word, ".")) {
+    if (word.find('.') != std::string_view::npos) {
       float f;
-#ifdef __cpp_lib_to_chars
-      auto result = std::from_chars(word.data(), word.data() + word.length(), f);
-      if (result.ec != std::errc{}) {
-        AsciiError("Parse error");
-        return 0;
-      }
-#else
-      // fall back for pre C++17
-      std::istringstream istr(word);
-      istr.imbue(std::locale("C"));
-      istr >> f;
-      if (istr.peek() != EOF) {
+      if (!parseNumber(word, f)) {
         AsciiError("Parse error");
         return 0;
       }
-#endif
       c = (int)(f * 255);
-    } else {
-      c = boost::lexical_cast<int>(word);
+    } else if (!parseNumber(word, c)) {
+      throw std::invalid_argument("bad color");
     }
     return c;
   };
 
 
-  if (!f.good()) {
+  if (!file.isOpen()) {
     AsciiError("File error");
     return PolySet::createEmpty();
   }
 
-  // defaults
-  bool has_normals = false;
-  bool has_color = false;
-  bool has_textures = false;
-  bool has_ndim = false;
-  bool is_binary = false;
-  unsigned int dimension = 3;
+  OffHeader header;
 
-  if (line.empty() && !getline_clean("bad header: end of file")) {
+  if (!getline_clean("bad header: end of file")) {
       return PolySet::createEmpty();
   }
 
-  if (boost::regex_search(line, results, ex_magic) > 0) {
-    // Remove the matched part, we might have numbers next.
-    line = line.erase(0, results[0].length());
-    has_normals = results[3].matched;
-    has_color = results[2].matched;
-    has_textures = results[1].matched;
-    is_binary = results[6].matched;
-    if (results[4].matched)
-      dimension = 4;
-    has_ndim = results[5].matched;
-  }
+  // Remove the matched part, we might have numbers next.
+  parse_off_magic(line, header);
+  unsigned int dimension = header.dimension;
 
   // TODO: handle binary format
-  if (is_binary) {
+  if (header.is_binary) {
     AsciiError("binary OFF format not supported");
     return PolySet::createEmpty();
   }
 
-  std::vector<std::string> words;
+  std::vector<std::string_view> words;
 
-  if (has_ndim) {
+  if (header.has_ndim) {
     if (line.empty() && !getline_clean("bad header: end of file")) {
         return PolySet::createEmpty();
     }
-    boost::split(words, line, boost::is_any_of(" \t"), boost::token_compress_on);
-    if (f.eof() || words.size() < 1) {
+    const auto ndim = TextScanner::nextToken(line);
+    unsigned int n;
+    if (ndim.empty() || scanner.atEnd()) {
       AsciiError("bad header: missing Ndim");
       return PolySet::createEmpty();
     }
-    line = line.erase(0, words[0].length() + ((words.size() > 1) ? 1 : 0));
-    try {
-      dimension = boost::lexical_cast<unsigned int>(words[0]) + dimension - 3;
-    } catch (const boost::bad_lexical_cast& blc) {
+    if (!parseNumber(ndim, n)) {
       AsciiError("bad header: bad data for Ndim");
       return PolySet::createEmpty();
     }
+    dimension = n + dimension - 3;
+    line = TextScanner::trim(line);
   }
 
-  PRINTDB("Header flags: N:%d C:%d ST:%d Ndim:%d B:%d", has_normals % has_color % has_textures % dimension % is_binary);
+  PRINTDB("Header flags: N:%d C:%d ST:%d Ndim:%d B:%d", header.has_normals % header.has_color % header.has_textures % dimension % header.is_binary);
 
   if (dimension != 3) {
     AsciiError((boost::format("unhandled vertex dimensions (%d)") % dimension).str().c_str());
@@ -157,8 +157,8 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
       return PolySet::createEmpty();
   }
 
-  boost::split(words, line, boost::is_any_of(" \t"), boost::token_compress_on);
-  if (f.eof() || words.size() < 3) {
+  TextScanner::tokenize(line, words);
+  if (scanner.atEnd() || words.size() < 3) {
     AsciiError("bad header: missing data");
     return PolySet::createEmpty();
   }
@@ -168,17 +168,14 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
   unsigned long edges_count;
   unsigned long vertex = 0;
   unsigned long face = 0;
-  try {
-    vertices_count = boost::lexical_cast<unsigned long>(words[0]);
-    faces_count = boost::lexical_cast<unsigned long>(words[1]);
-    edges_count = boost::lexical_cast<unsigned long>(words[2]);
-    (void)edges_count; // ignored
-  } catch (const boost::bad_lexical_cast& blc) {
+  if (!parseNumber(words[0], vertices_count) || !parseNumber(words[1], faces_count) ||
+      !parseNumber(words[2], edges_count)) {
     AsciiError("bad header: bad data");
     return PolySet::createEmpty();
   }
+  (void)edges_count; // ignored
 
-  if (f.eof() || vertices_count < 1 || faces_count < 1) {
+  if (scanner.atEnd() || vertices_count < 1 || faces_count < 1) {
     AsciiError("bad header: not enough data");
     return PolySet::createEmpty();
   }
@@ -189,50 +186,36 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
   ps->vertices.reserve(vertices_count);
   ps->indices.reserve(faces_count);
 
-  while ((!f.eof()) && (vertex++ < vertices_count)) {
+  while (vertex++ < vertices_count) {
     if (!getline_clean("reading vertices: end of file")) {
       return PolySet::createEmpty();
     }
 
-    boost::split(words, line, boost::is_any_of(" \t"), boost::token_compress_on);
+    TextScanner::tokenize(line, words);
     if (words.size() < 3) {
       AsciiError("can't parse vertex: not enough data");
       return PolySet::createEmpty();
     }
 
-    try {
-      Vector3d v = {0, 0, 0};
-      int i;
-      for (i = 0; i < dimension; i++) {
-        v[i]= boost::lexical_cast<double>(words[i]);
-      }
-      //PRINTDB("Vertex[%ld] = { %f, %f, %f }", vertex % v[0] % v[1] % v[2]);
-      if (has_normals) {
-        ; // TODO words[i++]
-        i += 0;
-      }
-      if (has_color) {
-        ; // TODO: Meshlab appends color there, probably to allow gradients
-        i += 3; // 4?
-      }
-      if (has_textures) {
-        ; // TODO words[i++]
+    Vector3d v = {0, 0, 0};
+    for (unsigned int i = 0; i < dimension; i++) {
+      if (!parseNumber(words[i], v[i])) {
+        AsciiError("can't parse vertex: bad data");
+        return PolySet::createEmpty();
       }
-      ps->vertices.push_back(v);
-    } catch (const boost::bad_lexical_cast& blc) {
-      AsciiError("can't parse vertex: bad data");
-      return PolySet::createEmpty();
     }
+    //PRINTDB("Vertex[%ld] = { %f, %f, %f }", vertex % v[0] % v[1] % v[2]);
+    // TODO: normals, colors (Meshlab appends color there, probably to allow gradients) and textures
+    ps->vertices.push_back(v);
   }
 
-  auto logged_color_warning = false;
-
-  while (!f.eof() && (face++ < faces_count)) {
+  IndexedFace face_indices;
+  while (face++ < faces_count) {
     if (!getline_clean("reading faces: end of file")) {
       return PolySet::createEmpty();
     }
 
-    boost::split(words, line, boost::is_any_of(" \t"), boost::token_compress_on);
+    TextScanner::tokenize(line, words);
     if (words.size() < 1) {
       AsciiError("can't parse face: not enough data");
       return PolySet::createEmpty();
@@ -240,25 +223,28 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
 
     std::map<Color4f, int32_t> color_indices;
     try {
-      unsigned long face_size=boost::lexical_cast<unsigned long>(words[0]);
+      unsigned long face_size;
+      if (!parseNumber(words[0], face_size)) throw std::invalid_argument("bad face size");
       unsigned long i;
       if (words.size() - 1 < face_size) {
         AsciiError("can't parse face: missing indices");
         return PolySet::createEmpty();
       }
       size_t face_idx = ps->indices.size();
-      ps->indices.emplace_back().reserve(face_size);
+      face_indices.clear();
       //PRINTDB("Index[%d] [%d] = { ", face % n);
       for (i = 0; i < face_size; i++) {
-        int ind=boost::lexical_cast<int>(words[i+1]);
+        int ind;
+        if (!parseNumber(words[i + 1], ind)) throw std::invalid_argument("bad index");
         //PRINTDB("%d, ", ind);
         if (ind >= 0 && ind < vertices_count) {
-          ps->indices.back().push_back(ind);
+          face_indices.push_back(ind);
         } else {
           AsciiError((boost::format("ignored bad face vertex index: %d") % ind).str().c_str());
         }
       }
       //PRINTD("}");
+      ps->indices.push_back(face_indices);
       if (words.size() >= face_size + 4) {
         i = face_size + 1;
         // handle optional color info (r g b [a])
@@ -273,7 +259,7 @@ std::unique_ptr<PolySet> import_off(const std::string& filename, const Location&
         ps->color_indices.resize(face_idx, -1);
         ps->color_indices.push_back(iter_pair.first->second);
       }
-    } catch (const boost::bad_lexical_cast& blc) {
+    } catch (const std::invalid_argument&) {
       AsciiError("can't parse face: bad data");
       return PolySet::createEmpty();
     }
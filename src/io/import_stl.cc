@@ -4,17 +4,19 @@
 #include "utils/printutils.h"
 #include "core/AST.h"
 
+#include "io/TextScanner.h"
+#include "utils/parallel.h"
+
+#include <algorithm>
 #include <array>
-#include <ios>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <cstddef>
-#include <fstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <boost/predef.h>
-#include <boost/regex.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
 
 #if !defined(BOOST_ENDIAN_BIG_BYTE_AVAILABLE) && !defined(BOOST_ENDIAN_LITTLE_BYTE_AVAILABLE)
 #error Byte order undefined or unknown. Currently only BOOST_ENDIAN_BIG_BYTE and BOOST_ENDIAN_LITTLE_BYTE are supported.
@@ -57,11 +59,8 @@ static void uint32_byte_swap(uint32_t& x) {
 }
 #endif // if BOOST_ENDIAN_BIG_BYTE
 
-static void read_stl_facet(std::ifstream& f, stl_facet& facet) {
-  f.read((char *)facet.data8, STL_FACET_NUMBYTES);
-  if (static_cast<size_t>(f.gcount()) < STL_FACET_NUMBYTES) {
-    throw std::ios_base::failure("facet data truncated");
-  }
+static void read_stl_facet(const char *data, stl_facet& facet) {
+  std::memcpy(facet.data8, data, STL_FACET_NUMBYTES);
 #if BOOST_ENDIAN_BIG_BYTE
   for (int i = 0; i < 12; ++i) {
     uint32_byte_swap(facet.data8 + i * 4);
@@ -70,135 +69,166 @@ static void read_stl_facet(std::ifstream& f, stl_facet& facet) {
 #endif
 }
 
+namespace {
+
+// Result of parsing a range of lines of an ASCII STL file
+struct StlAsciiChunk {
+  struct Diagnostic {
+    size_t line; // relative to the start of the chunk
+    const char *message;
+    std::string text;
+  };
+  std::vector<Vector3d> vertices; // three per complete facet
+  std::vector<Diagnostic> diagnostics;
+  size_t lines{0};
+  bool reached_end{false};
+  bool failed{false}; // the last diagnostic is fatal
+};
+
+// Chunks start at "outer loop", which resets the facet state.
+bool is_stl_chunk_boundary(std::string_view line)
+{
+  return TextScanner::trim(line) == "outer loop";
+}
+
+StlAsciiChunk parse_stl_ascii_chunk(std::string_view text)
+{
+  using namespace TextScanner;
+  StlAsciiChunk chunk;
+  chunk.vertices.reserve(text.size() / 80);
+  LineScanner scanner(text);
+  std::array<Vector3d, 3> vdata;
+  int i = 0;
+  std::string_view line;
+
+  auto error = [&](const char *message) {
+    chunk.diagnostics.push_back({scanner.lineNumber(), message, std::string(line)});
+  };
+
+  while (scanner.next(line)) {
+    line = trim(line);
+    if (line.empty() || startsWith(line, "solid") || startsWith(line, "facet") || startsWith(line, "endfacet")) {
+      continue;
+    } else if (line == "outer loop") {
+      i = 0;
+    } else if (line == "endloop") {
+      if (i < 3) error("missing vertex");
+    } else if (startsWith(line, "endsolid")) {
+      chunk.reached_end = true;
+      break;
+    } else if (i >= 3) {
+      error("extra vertex");
+      chunk.failed = true;
+      break;
+    } else if (startsWith(line, "vertex")) {
+      auto rest = line;
+      std::array<std::string_view, 4> words;
+      for (auto& word : words) word = nextToken(rest);
+      // Lines not of the form "vertex x y z" are ignored
+      if (words[0] != "vertex" || words[3].empty() || !nextToken(rest).empty()) continue;
+      if (!parseNumber(words[1], vdata[i][0]) || !parseNumber(words[2], vdata[i][1]) ||
+          !parseNumber(words[3], vdata[i][2])) {
+        error("can't parse vertex");
+        chunk.failed = true;
+        break;
+      }
+      if (++i == 3) {
+        chunk.vertices.insert(chunk.vertices.end(), vdata.begin(), vdata.end());
+      }
+    }
+  }
+  chunk.lines = scanner.lineNumber();
+  return chunk;
+}
+
+std::unique_ptr<PolySet> import_stl_ascii(std::string_view text, const std::string& filename, const Location& loc)
+{
+  // Skip the "solid" line
+  TextScanner::LineScanner header(text);
+  std::string_view line;
+  header.next(line);
+  text.remove_prefix(std::min(text.size(), line.size() + 1));
+
+  const auto chunks = TextScanner::splitIntoChunks(text, is_stl_chunk_boundary);
+  std::vector<StlAsciiChunk> results(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), results.begin(), parse_stl_ascii_chunk);
+
+  size_t lineno = 1;
+  auto AsciiError = [&](const auto& errstr, size_t line, const std::string& text) {
+      LOG(message_group::Error, loc, "",
+          "STL line %1$s, %2$s line '%3$s' importing file '%4$s'",
+          line, errstr, text, filename);
+    };
+
+  size_t facets = 0;
+  for (const auto& chunk : results) facets += chunk.vertices.size() / 3;
+  PolySetBuilder builder(0, facets);
+  bool reached_end = false;
+  for (const auto& chunk : results) {
+    for (const auto& diagnostic : chunk.diagnostics) {
+      AsciiError(diagnostic.message, lineno + diagnostic.line, diagnostic.text);
+    }
+    if (chunk.failed) return PolySet::createEmpty();
+    for (size_t v = 0; v < chunk.vertices.size(); v += 3) {
+      builder.beginPolygon(3);
+      for (int j = 0; j < 3; j++) {
+        builder.addVertex(chunk.vertices[v + j]);
+      }
+    }
+    lineno += chunk.lines;
+    if (chunk.reached_end) {
+      reached_end = true;
+      break;
+    }
+  }
+  if (!reached_end) {
+    AsciiError("file incomplete", lineno, "");
+  }
+  return builder.build();
+}
+
+} // namespace
+
 std::unique_ptr<PolySet> import_stl(const std::string& filename, const Location& loc) {
-  // Open file and position at the end
-  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-  if (!f.good()) {
+  const MappedFile file(filename);
+  if (!file.isOpen()) {
     LOG(message_group::Warning,
         "Can't open import file '%1$s', import() at line %2$d",
         filename, loc.firstLine());
     return PolySet::createEmpty();
   }
+  const auto data = file.contents();
 
   uint32_t facenum = 0;
-  boost::regex ex_sfe(R"(^\s*solid|^\s*facet|^\s*endfacet)");
-  boost::regex ex_outer("^\\s*outer loop$");
-  boost::regex ex_loopend("^\\s*endloop$");
-  boost::regex ex_vertex("^\\s*vertex");
-  boost::regex ex_vertices(
-    R"(^\s*vertex\s+([^\s]+)\s+([^\s]+)\s+([^\s]+)\s*$)");
-  boost::regex ex_endsolid("^\\s*endsolid");
-
   bool binary = false;
-  std::streampos file_size = f.tellg();
-  f.seekg(80);
-  if (f.good() && !f.eof()) {
-    f.read((char *)&facenum, sizeof(uint32_t));
+  if (data.size() >= 80 + sizeof(uint32_t)) {
+    std::memcpy(&facenum, data.data() + 80, sizeof(uint32_t));
 #if BOOST_ENDIAN_BIG_BYTE
     uint32_byte_swap(facenum);
 #endif
-    if (file_size == static_cast<std::streamoff>(80ul + 4ul + 50ul * facenum)) {
+    if (data.size() == 80ul + 4ul + 50ul * facenum) {
       binary = true;
     }
   }
-  if(!binary) facenum=0;
-  PolySetBuilder builder(0, facenum);
-  f.seekg(0);
-
-  char data[5];
-  f.read(data, 5);
-  if (!binary && !f.eof() && f.good() && !memcmp(data, "solid", 5)) {
-    int i = 0;
-    int lineno = 1;
-    std::array<std::array<double, 3>, 3> vdata;
-    std::string line;
-
-    auto AsciiError = [&](const auto& errstr){
-        LOG(message_group::Error, loc, "",
-            "STL line %1$s, %2$s line '%3$s' importing file '%4$s'",
-            lineno, errstr, line, filename);
-      };
-
-    std::getline(f, line);
-    bool reached_end = false;
-    while (!f.eof()) {
-      lineno++;
-      std::getline(f, line);
-      boost::trim(line);
-      boost::smatch results;
-
-      if (line.length() == 0 || boost::regex_search(line, ex_sfe)) {
-        continue;
-      } else if (boost::regex_search(line, ex_outer)) {
-        i = 0;
-        continue;
-      } else if (boost::regex_search(line, ex_loopend)) {
-        if (i < 3) {
-          AsciiError("missing vertex");
-        }
-        continue;
-      } else if (boost::regex_search(line, ex_endsolid)) {
-        reached_end = true;
-        break;
-      } else if (i >= 3) {
-        AsciiError("extra vertex");
-        return PolySet::createEmpty();
-      } else if (boost::regex_search(line, results, ex_vertices) &&
-                 results.size() >= 4) {
-        try {
-          for (int v = 0; v < 3; ++v) {
-            vdata.at(i).at(v) = boost::lexical_cast<double>(results[v + 1]);
-          }
-          if (++i == 3) {
-            builder.beginPolygon(3);
-            for(int j=0;j<3;j++) {
-              builder.addVertex(Vector3d(vdata[j][0], vdata[j][1], vdata[j][2]));
-            }
-          }
-        } catch (const boost::bad_lexical_cast& blc) {
-          AsciiError("can't parse vertex");
-          return PolySet::createEmpty();
-        }
-      }
-    }
-    if (!reached_end) {
-      AsciiError("file incomplete");
-    }
-  } else if (binary && !f.eof() && f.good()) {
-    try {
-      f.ignore(80 - 5 + 4);
-      while (!f.eof() ) {
-        stl_facet facet;
-        try {
-          read_stl_facet(f, facet);
-        } catch (const std::ios_base::failure& ex) {
-          if (f.eof()) break;
-          throw;
-        }
-        builder.appendPolygon({
-                Vector3d(facet.data.x1, facet.data.y1, facet.data.z1),
-                Vector3d(facet.data.x2, facet.data.y2, facet.data.z2),
-                Vector3d(facet.data.x3, facet.data.y3, facet.data.z3)
-        });
-      }
-    } catch (const std::ios_base::failure& ex) {
-      int64_t offset = -1;
-      try { offset = f.tellg(); } catch (...) {}
-      if (offset < 0) {
-        LOG(message_group::Error, loc, "",
-            "Binary STL '%1$s' error: %3$s",
-            filename, ex.what());
-      } else {
-        LOG(message_group::Error, loc, "",
-            "Binary STL '%1$s' error at byte %2$s: %3$s",
-            filename, offset, ex.what());
-      }
-      return PolySet::createEmpty();
+
+  if (binary) {
+    PolySetBuilder builder(0, facenum);
+    const char *p = data.data() + 80 + sizeof(uint32_t);
+    for (uint32_t n = 0; n < facenum; ++n, p += STL_FACET_NUMBYTES) {
+      stl_facet facet;
+      read_stl_facet(p, facet);
+      builder.appendPolygon({
+              Vector3d(facet.data.x1, facet.data.y1, facet.data.z1),
+              Vector3d(facet.data.x2, facet.data.y2, facet.data.z2),
+              Vector3d(facet.data.x3, facet.data.y3, facet.data.z3)
+      });
     }
+    return builder.build();
+  } else if (TextScanner::startsWith(data, "solid")) {
+    return import_stl_ascii(data, filename, loc);
   } else {
     LOG(message_group::Error, loc, "",
         "STL format not recognized in '%1$s'.", filename);
     return PolySet::createEmpty();
   }
-  return builder.build();
 }
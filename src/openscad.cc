@@ -26,10 +26,21 @@
 
 #include "openscad.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
 #include <ostream>
 #include <sstream>
 #include <array>
+#include <atomic>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <chrono>
@@ -42,11 +53,15 @@
 #include "core/AST.h"
 #include "core/ColorUtil.h"
 #include "core/Context.h"
+#include "core/InstantiationCache.h"
 #include "core/Settings.h"
 
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
 
 #include <boost/algorithm/string.hpp>
@@ -69,6 +84,7 @@
 #include "core/customizer/ParameterSet.h"
 #include "core/parsersettings.h"
 #include "core/RenderVariables.h"
+#include "geometry/GeometryDiskCache.h"
 #include "geometry/GeometryEvaluator.h"
 #include "geometry/GeometryUtils.h"
 #include "geometry/PolySet.h"
@@ -81,10 +97,17 @@
 #include "openscad_gui.h"
 #include "openscad_mimalloc.h"
 #include "platform/PlatformUtils.h"
+#include "Profiler.h"
+#include "RenderServer.h"
 #include "RenderStatistic.h"
 #include "utils/StackCheck.h"
+#include "utils/parallel.h"
 #include "utils/printutils.h"
 
+#if ENABLE_TBB
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+#endif
 
 #ifdef ENABLE_PYTHON
 extern std::shared_ptr<AbstractNode> python_result_node;
@@ -111,16 +134,23 @@ public:
   {
     set_output_handler(&Echostream::output, nullptr, this);
   }
+  Echostream(const Echostream&) = delete;
+  Echostream& operator=(const Echostream&) = delete;
   static void output(const Message& msgObj, void *userdata)
   {
     auto self = static_cast<Echostream *>(userdata);
     self->stream << msgObj.str() << "\n";
   }
   ~Echostream() {
+    // Later messages, e.g. of the next batch variant, must not reach a destroyed stream
+    set_output_handler(prevhandler, prevhandler2, prevdata);
     if (fstream.is_open()) fstream.close();
   }
 
 private:
+  OutputHandlerFunc *prevhandler{outputhandler};
+  OutputHandlerFunc2 *prevhandler2{outputhandler2};
+  void *prevdata{outputhandler_data};
   std::ofstream fstream;
   std::ostream& stream;
 };
@@ -283,6 +313,7 @@ struct AnimateArgs {
   unsigned frames = 0;
   unsigned num_shards = 1;
   unsigned shard = 1;
+  unsigned jobs = 1; // frames rendered concurrently
 };
 
 struct CommandLine
@@ -301,6 +332,8 @@ struct CommandLine
   const AnimateArgs animate;
   const std::vector<std::string> summaryOptions;
   const std::string summaryFile;
+  // Reuses unchanged top-level statements of an earlier job on the same file, in server mode
+  InstantiationCache *instantiationCache{nullptr};
 };
 
 AnimateArgs get_animate(const po::variables_map& vm) {
@@ -308,6 +341,9 @@ AnimateArgs get_animate(const po::variables_map& vm) {
   if (vm.count("animate")) {
     animate.frames = vm["animate"].as<unsigned>();
   }
+  if (vm.count("jobs")) {
+    animate.jobs = std::max(1u, vm["jobs"].as<unsigned>());
+  }
   if (vm.count("animate_sharding")) {
     std::vector<std::string> strs;
     boost::split(strs, vm["animate_sharding"].as<std::string>(),
@@ -398,7 +434,40 @@ Camera get_camera(const po::variables_map& vm)
   return camera;
 }
 
-int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat export_format, SourceFile *root_file)
+/*!
+   Serializes the parts of exporting animation frames that can't run
+   concurrently: evaluating geometry that isn't
+   GeometryEvaluator::isParallelSafe() or uses the CGAL backend, and rendering
+   and writing the output, which may need an OpenGL context. When frames are
+   rendered concurrently, the geometry lock is always taken before the output
+   lock.
+ */
+struct FrameLocks {
+  std::mutex geometry;
+  std::mutex output;
+};
+
+/*!
+   Changes the working directory, and changes it back to restore when
+   destroyed, also if a job throws, e.g. with --hardwarnings.
+ */
+class CurrentPathGuard
+{
+public:
+  CurrentPathGuard(const fs::path& path, fs::path restore) : restore(std::move(restore)) { fs::current_path(path); }
+  ~CurrentPathGuard() {
+    std::error_code ec;
+    fs::current_path(this->restore, ec);
+  }
+  CurrentPathGuard(const CurrentPathGuard&) = delete;
+  CurrentPathGuard& operator=(const CurrentPathGuard&) = delete;
+
+private:
+  fs::path restore;
+};
+
+int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat export_format, SourceFile *root_file,
+              FrameLocks *locks = nullptr)
 {
   auto filename_str = fs::path(cmd.output_file).generic_string();
   // Avoid possibility of fs::absolute throwing when passed an empty path
@@ -406,7 +475,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   auto fparent = fpath.parent_path();
 
   // set CWD relative to source file
-  fs::current_path(fparent);
+  std::optional<CurrentPathGuard> source_cwd(std::in_place, fparent, cmd.original_path);
 
   EvaluationSession session{fparent.string()};
   ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
@@ -416,19 +485,25 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   PRINTDB("BuiltinContext:\n%s", builtin_context->dump());
 #endif
 
-  AbstractNode::resetIndexCounter();
   std::shared_ptr<const FileContext> file_context;
   std::shared_ptr<AbstractNode> absolute_root_node;
 
 #ifdef ENABLE_PYTHON    
   if(python_result_node != NULL && python_active) {
+    AbstractNode::resetIndexCounter();
     absolute_root_node = python_result_node;
   } else {
 #endif	    
-  absolute_root_node = root_file->instantiate(*builtin_context, &file_context);
+  if (cmd.instantiationCache) {
+    absolute_root_node = cmd.instantiationCache->instantiate(root_file, *builtin_context, &file_context);
+  } else {
+    AbstractNode::resetIndexCounter();
+    absolute_root_node = root_file->instantiate(*builtin_context, &file_context);
+  }
 #ifdef ENABLE_PYTHON
   }
 #endif
+  session.functionMemo().printStatistics();
 
   Camera camera = cmd.camera;
   if (file_context) {
@@ -436,7 +511,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   }
 
   // restore CWD after module instantiation finished
-  fs::current_path(cmd.original_path);
+  source_cwd.reset();
 
   // Do we have an explicit root node (! modifier)?
   std::shared_ptr<const AbstractNode> root_node;
@@ -455,17 +530,15 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
     // statements become relative. But unfortunately they become relative to
     // the current working dir and neither to the location of the input nor
     // the output.
-    fs::current_path(fparent); // Force exported filenames to be relative to document path
+    CurrentPathGuard document_cwd(fparent, cmd.original_path); // Force exported filenames to be relative to document path
     with_output(cmd.is_stdout, filename_str, [&tree, root_node](std::ostream& stream) {
       stream << tree.getString(*root_node, "\t") << "\n";
     });
-    fs::current_path(cmd.original_path);
   } else if (export_format == FileFormat::AST) {
-    fs::current_path(fparent); // Force exported filenames to be relative to document path
+    CurrentPathGuard document_cwd(fparent, cmd.original_path); // Force exported filenames to be relative to document path
     with_output(cmd.is_stdout, filename_str, [root_file](std::ostream& stream) {
       stream << root_file->dump("");
     });
-    fs::current_path(cmd.original_path);
   } else if (export_format == FileFormat::PARAM) {
     with_output(cmd.is_stdout, filename_str, [&root_file, &fpath](std::ostream& stream) {
       export_param(root_file, fpath, stream);
@@ -483,6 +556,13 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   } else if (export_format == FileFormat::ECHO) {
     // echo -> don't need to evaluate any geometry
   } else {
+    // Declared first, so they are released after the OpenGL context is destroyed
+    std::unique_lock<std::mutex> geometry_lock;
+    std::unique_lock<std::mutex> output_lock;
+    if (locks && (RenderSettings::inst()->backend3D != RenderBackend3D::ManifoldBackend || !GeometryEvaluator::isParallelSafe(*root_node))) {
+      geometry_lock = std::unique_lock<std::mutex>(locks->geometry);
+    }
+
     // start measuring render time
     RenderStatistic renderStatistic;
     GeometryEvaluator geomevaluator(tree);
@@ -490,6 +570,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
     std::shared_ptr<const Geometry> root_geom;
     if ((export_format == FileFormat::ECHO || export_format == FileFormat::PNG) && (cmd.viewOptions.renderer == RenderType::OPENCSG || cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)) {
       // OpenCSG or throwntogether png -> just render a preview
+      if (locks) output_lock = std::unique_lock<std::mutex>(locks->output);
       glview = prepare_preview(tree, cmd.viewOptions, camera);
       if (!glview) return 1;
     } else {
@@ -515,6 +596,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
       }
     }
 
+    if (locks && !output_lock) output_lock = std::unique_lock<std::mutex>(locks->output);
     const std::string input_filename = cmd.is_stdin ? "<stdin>" : cmd.filename;
     const int dim = fileformat::is3D(export_format) ? 3 : fileformat::is2D(export_format) ? 2 : 0;
     ExportInfo exportInfo = createExportInfo(export_format, fileformat::info(export_format), input_filename, &cmd.camera, cmd.exportOptions);
@@ -541,10 +623,11 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   return 0;
 }
 
-int cmdline(const CommandLine& cmd)
+/*!
+   Determines the export format of a command line, and checks that its output directory exists.
+ */
+bool get_export_format(const CommandLine& cmd, FileFormat& export_format)
 {
-  FileFormat export_format;
-
   // Determine output file format and assign it to formatName
   if (cmd.export_format.is_initialized()) {
     export_format = cmd.export_format.get();
@@ -556,7 +639,7 @@ int cmdline(const CommandLine& cmd)
 
     if (!fileformat::fromIdentifier(suffix, export_format)) {
       LOG("Invalid suffix %1$s. Either add a valid suffix or specify one using the --export-format option.", suffix);
-      return 1;
+      return false;
     }
   }
 
@@ -568,28 +651,115 @@ int cmdline(const CommandLine& cmd)
   }
   if (!fs::is_directory(output_dir)) {
     LOG("\n'%1$s' is not a directory for output file %2$s - Skipping\n", output_dir.generic_string(), cmd.output_file);
-    return 1;
-  }
-
-  set_render_color_scheme(arg_colorscheme, true);
-
-  std::shared_ptr<Echostream> echostream;
-  if (export_format == FileFormat::ECHO) {
-    echostream.reset(cmd.is_stdout ? new Echostream(std::cout) : new Echostream(cmd.output_file));
+    return false;
   }
+  return true;
+}
 
-  std::string text;
+bool read_input(const CommandLine& cmd, std::string& text)
+{
   if (cmd.is_stdin) {
     text = std::string((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
   } else {
     std::ifstream ifs(cmd.filename);
     if (!ifs.is_open()) {
       LOG("Can't open input file '%1$s'!\n", cmd.filename);
-      return 1;
+      return false;
     }
     handle_dep(cmd.filename);
     text = std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
   }
+  return true;
+}
+
+/*!
+   Returns the output file of an animation frame, i.e. the frame number
+   inserted before the extension.
+ */
+std::string frame_output_file(const std::string& output_file, unsigned frame)
+{
+  std::ostringstream oss;
+  oss << std::setw(5) << std::setfill('0') << frame;
+
+  auto frame_file = fs::path(output_file);
+  auto extension = frame_file.extension();
+  frame_file.replace_extension();
+  frame_file += oss.str();
+  frame_file.replace_extension(extension);
+  return frame_file.generic_string();
+}
+
+#if ENABLE_TBB
+/*!
+   Exports animation frames on up to cmd.animate.jobs threads, which share the
+   parsed file, the geometry caches and the font cache. Frames are written as
+   they finish, so in no particular order. The working directory stays at the
+   directory of the input file meanwhile, so all paths are made absolute first.
+ */
+int export_frames_concurrently(const CommandLine& cmd, RenderVariables render_variables, FileFormat export_format,
+                               SourceFile *root_file, unsigned start_frame, unsigned limit_frame)
+{
+  const std::string input_path = cmd.filename.empty() ? "" : fs::absolute(fs::path(cmd.filename)).generic_string();
+  const fs::path document_path = input_path.empty() ? fs::current_path() : fs::path(input_path).parent_path();
+  const std::string output_file = fs::absolute(fs::path(cmd.output_file)).generic_string();
+
+  FrameLocks locks;
+  std::atomic<int> rc{0};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  const auto caller = std::this_thread::get_id();
+
+  CurrentPathGuard document_cwd(document_path, cmd.original_path);
+  // Give the workers the stack of the main thread, which the recursion limit of StackCheck is sized for
+  tbb::global_control stack_size(tbb::global_control::thread_stack_size, STACKSIZE);
+  tbb::task_arena arena(static_cast<int>(cmd.animate.jobs));
+  arena.execute([&] {
+    tbb::parallel_for(tbb::blocked_range<unsigned>(start_frame, limit_frame, 1), [&](const tbb::blocked_range<unsigned>& range) {
+      if (std::this_thread::get_id() != caller) {
+        // The stack of a worker thread is usually smaller than that of the main thread
+        if (size_t stack_size = parallel_worker_stack_size()) StackCheck::inst().restart(stack_size);
+      }
+      for (unsigned frame = range.begin(); frame != range.end(); ++frame) {
+        // Waiting for Manifold's nested parallelism must not pick up another frame while holding its locks
+        tbb::this_task_arena::isolate([&] {
+          RenderVariables frame_variables = render_variables;
+          frame_variables.time = frame * (1.0 / cmd.animate.frames);
+          const std::string frame_str = frame_output_file(output_file, frame);
+          LOG("Exporting %1$s...", frame_str);
+
+          CommandLine frame_cmd{cmd.is_stdin, input_path, cmd.is_stdout, frame_str, document_path,
+                                cmd.parameterFile, cmd.setName, cmd.viewOptions, cmd.camera, cmd.export_format,
+                                cmd.exportOptions, cmd.animate, cmd.summaryOptions, cmd.summaryFile};
+          try {
+            if (do_export(frame_cmd, frame_variables, export_format, root_file, &locks) != 0) rc = 1;
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+          }
+        });
+      }
+    });
+  });
+
+  if (error) std::rethrow_exception(error);
+  return rc;
+}
+#endif // if ENABLE_TBB
+
+int cmdline(const CommandLine& cmd)
+{
+  FileFormat export_format;
+  if (!get_export_format(cmd, export_format)) return 1;
+
+  set_render_color_scheme(arg_colorscheme, true);
+
+  std::shared_ptr<Echostream> echostream;
+  if (export_format == FileFormat::ECHO) {
+    echostream.reset(cmd.is_stdout ? new Echostream(std::cout) : new Echostream(cmd.output_file));
+  }
+
+  std::string text;
+  if (!read_input(cmd, text)) return 1;
 
 #ifdef ENABLE_PYTHON  
   python_active = false;
@@ -619,6 +789,14 @@ int cmdline(const CommandLine& cmd)
     return 1;
   }
 
+  // root_file is parsed anew for every command line, and the server mode runs many.
+  // Nodes kept for incremental instantiation may still point into it.
+  auto release_root_file = [cache = cmd.instantiationCache](SourceFile *file) {
+    if (cache) cache->retire(file);
+    else delete file;
+  };
+  std::unique_ptr<SourceFile, decltype(release_root_file)> root_file_owner(root_file, release_root_file);
+
   // add parameter to AST
   CommentParser::collectParameters(text.c_str(), root_file);
   if (!cmd.parameterFile.empty() && !cmd.setName.empty()) {
@@ -653,23 +831,19 @@ int cmdline(const CommandLine& cmd)
       / cmd.animate.num_shards;
     const unsigned limit_frame = (cmd.animate.shard * cmd.animate.frames)
       / cmd.animate.num_shards;
+#if ENABLE_TBB
+    // Hard warnings must stop at the first frame that warns
+    if (cmd.animate.jobs > 1 && limit_frame - start_frame > 1 && parallelization_enabled() && !OpenSCAD::hardwarnings) {
+      return export_frames_concurrently(cmd, render_variables, export_format, root_file, start_frame, limit_frame);
+    }
+#endif
     for (unsigned frame = start_frame; frame < limit_frame; ++frame) {
       render_variables.time = frame * (1.0 / cmd.animate.frames);
 
-      std::ostringstream oss;
-      oss << std::setw(5) << std::setfill('0') << frame;
-
-      auto frame_file = fs::path(cmd.output_file);
-      auto extension = frame_file.extension();
-      frame_file.replace_extension();
-      frame_file += oss.str();
-      frame_file.replace_extension(extension);
-      std::string frame_str = frame_file.generic_string();
-
       LOG("Exporting %1$s...", cmd.filename);
 
       CommandLine frame_cmd = cmd;
-      frame_cmd.output_file = frame_str;
+      frame_cmd.output_file = frame_output_file(cmd.output_file, frame);
 
       int r = do_export(frame_cmd, render_variables, export_format, root_file);
       if (r != 0) {
@@ -681,6 +855,262 @@ int cmdline(const CommandLine& cmd)
   }
 }
 
+struct BatchArgs {
+  bool allParameterSets = false;
+  std::string definesCsv;
+  unsigned jobs = 1;
+};
+
+struct BatchVariant {
+  std::string name;
+  std::string output_file;
+  ParameterSet parameters; // used with -p
+  std::string commands; // -D style assignments, used with --defines-csv
+};
+
+/*!
+   Splits CSV text into rows of fields (RFC 4180: fields containing commas,
+   quotes or newlines are quoted, and quotes inside them are doubled).
+ */
+std::vector<std::vector<std::string>> parse_csv(const std::string& text)
+{
+  std::vector<std::vector<std::string>> rows(1);
+  std::string field;
+  bool quoted = false;
+  bool pending = false;
+  for (size_t i = 0; i < text.size(); ++i) {
+    const char c = text[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < text.size() && text[i + 1] == '"') {
+        field += '"';
+        ++i;
+      } else if (c == '"') {
+        quoted = false;
+      } else {
+        field += c;
+      }
+    } else if (c == '"') {
+      quoted = true;
+      pending = true;
+    } else if (c == ',') {
+      rows.back().push_back(std::move(field));
+      field.clear();
+      pending = true;
+    } else if (c == '\n' || c == '\r') {
+      if (c == '\r' && i + 1 < text.size() && text[i + 1] == '\n') ++i;
+      if (pending || !field.empty()) rows.back().push_back(std::move(field));
+      field.clear();
+      pending = false;
+      rows.emplace_back();
+    } else {
+      field += c;
+      pending = true;
+    }
+  }
+  if (pending || !field.empty()) rows.back().push_back(std::move(field));
+  rows.erase(std::remove_if(rows.begin(), rows.end(), [](const auto& row) { return row.empty(); }), rows.end());
+  return rows;
+}
+
+/*!
+   Reads the batch variants: every set of the parameter file, or every row of a
+   CSV file whose header row names the variables to define. A column named
+   "name" names the row's output file instead of defining a variable.
+ */
+bool read_batch_variants(const CommandLine& cmd, const BatchArgs& batch, std::vector<BatchVariant>& variants)
+{
+  if (!batch.definesCsv.empty()) {
+    std::ifstream ifs(batch.definesCsv);
+    if (!ifs.is_open()) {
+      LOG("Can't open defines file '%1$s'!\n", batch.definesCsv);
+      return false;
+    }
+    const auto rows = parse_csv(std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()));
+    if (rows.size() < 2) {
+      LOG("Defines file '%1$s' needs a header row and at least one row of values", batch.definesCsv);
+      return false;
+    }
+    const auto& header = rows.front();
+    for (size_t r = 1; r < rows.size(); ++r) {
+      const auto& row = rows[r];
+      if (row.size() != header.size()) {
+        LOG("Defines file '%1$s': row %2$d has %3$d fields, expected %4$d", batch.definesCsv, r, row.size(), header.size());
+        return false;
+      }
+      BatchVariant variant;
+      variant.name = std::to_string(r);
+      for (size_t i = 0; i < header.size(); ++i) {
+        const auto column = boost::algorithm::trim_copy(header[i]);
+        if (column == "name") {
+          variant.name = row[i];
+        } else {
+          variant.commands += column + "=" + row[i] + ";\n";
+        }
+      }
+      variants.push_back(std::move(variant));
+    }
+  } else {
+    ParameterSets sets;
+    if (!sets.readFile(cmd.parameterFile)) {
+      LOG("Can't read parameter file '%1$s'!\n", cmd.parameterFile);
+      return false;
+    }
+    for (const auto& set : sets) {
+      variants.push_back({set.name(), {}, set, {}});
+    }
+  }
+  return true;
+}
+
+/*!
+   Returns the output file of one batch variant, i.e. the name of the variant
+   inserted before the extension.
+ */
+std::string batch_output_file(const std::string& output_file, const std::string& name)
+{
+  std::string suffix = name;
+  for (auto& c : suffix) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') c = '_';
+  }
+  auto path = fs::path(output_file);
+  const auto extension = path.extension();
+  path.replace_extension();
+  path += "-" + suffix;
+  path += extension;
+  return path.generic_string();
+}
+
+/*!
+   Exports one file per parameter set or CSV row, sharing the parse of the input
+   file and its libraries. With jobs > 1 the variants are distributed over worker
+   processes forked after parsing; the evaluator relies on process-global state
+   (working directory, node indices), so it cannot run variants on threads.
+   Workers don't share their in-memory geometry caches; with --disk-cache they
+   share evaluated subtrees through the cache directory.
+ */
+int batch_export(const CommandLine& cmd, const BatchArgs& batch)
+{
+  FileFormat export_format;
+  if (!get_export_format(cmd, export_format)) return 1;
+  if (cmd.is_stdout) {
+    LOG("Batch export is not supported when exporting to stdout.");
+    return 1;
+  }
+  if (cmd.animate.frames) {
+    LOG("Option --animate is not supported for batch export.");
+    return 1;
+  }
+
+  set_render_color_scheme(arg_colorscheme, true);
+
+  std::vector<BatchVariant> variants;
+  if (!read_batch_variants(cmd, batch, variants)) return 1;
+  // Names which only differ in characters replaced in file names would overwrite each other
+  std::map<std::string, const BatchVariant *> outputs;
+  for (auto& variant : variants) {
+    variant.output_file = batch_output_file(cmd.output_file, variant.name);
+    const auto [it, inserted] = outputs.emplace(variant.output_file, &variant);
+    if (!inserted) {
+      LOG(message_group::Error, "Batch variants '%1$s' and '%2$s' would both be exported to '%3$s'",
+          it->second->name, variant.name, variant.output_file);
+      return 1;
+    }
+  }
+
+  std::string text;
+  if (!read_input(cmd, text)) return 1;
+  text += "\n\x03\n" + commandline_commands;
+
+  // Parse once up front, which also loads all used/included libraries into the SourceFileCache
+  SourceFile *parsed = nullptr;
+  if (!parse(parsed, text, cmd.filename, cmd.filename, false)) {
+    delete parsed;
+    parsed = nullptr;
+  }
+  if (!parsed) {
+    LOG("Can't parse file '%1$s'!\n", cmd.filename);
+    return 1;
+  }
+  std::unique_ptr<SourceFile> root_file(parsed);
+  CommentParser::collectParameters(text.c_str(), root_file.get());
+  root_file->handleDependencies();
+  ParameterObjects parameters = ParameterObjects::fromSourceFile(root_file.get());
+
+  const RenderVariables render_variables = {
+    .preview = fileformat::canPreview(export_format)
+      ? (cmd.viewOptions.renderer == RenderType::OPENCSG
+        || cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)
+      : false,
+    .time = 0,
+    .camera = cmd.camera,
+  };
+
+  auto export_variant = [&](const BatchVariant& variant) {
+    CommandLine variant_cmd = cmd;
+    variant_cmd.output_file = variant.output_file;
+    LOG("Exporting %1$s...", variant_cmd.output_file);
+
+    std::shared_ptr<Echostream> echostream;
+    if (export_format == FileFormat::ECHO) echostream = std::make_shared<Echostream>(variant_cmd.output_file);
+
+    if (variant.commands.empty()) {
+      parameters.importValues(variant.parameters);
+      parameters.apply(root_file.get());
+      return do_export(variant_cmd, render_variables, export_format, root_file.get());
+    }
+    const std::string variant_text = text + variant.commands;
+    SourceFile *variant_file = nullptr;
+    if (!parse(variant_file, variant_text, cmd.filename, cmd.filename, false)) {
+      delete variant_file;
+      LOG("Can't parse file '%1$s' with the defines of '%2$s'!\n", cmd.filename, variant.name);
+      return 1;
+    }
+    std::unique_ptr<SourceFile> variant_owner(variant_file);
+    variant_file->handleDependencies();
+    return do_export(variant_cmd, render_variables, export_format, variant_file);
+  };
+
+  auto export_variants = [&](unsigned worker, unsigned workers) {
+    int rc = 0;
+    for (size_t i = worker; i < variants.size(); i += workers) {
+      try {
+        rc |= export_variant(variants[i]);
+      } catch (const HardWarningException&) {
+        rc = 1;
+      }
+    }
+    return rc;
+  };
+
+  const unsigned workers = std::max(1u, std::min<unsigned>(batch.jobs, variants.size()));
+#ifndef _WIN32
+  if (workers > 1) {
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> children;
+    for (unsigned worker = 0; worker < workers; ++worker) {
+      const pid_t pid = fork();
+      if (pid == 0) {
+        std::cout.flush();
+        _exit(export_variants(worker, workers));
+      }
+      if (pid < 0) {
+        LOG(message_group::Error, "Unable to start batch worker: %1$s", std::strerror(errno));
+        break;
+      }
+      children.push_back(pid);
+    }
+    int rc = children.size() == workers ? 0 : 1;
+    for (const auto pid : children) {
+      int status = 0;
+      if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) rc = 1;
+    }
+    return rc;
+  }
+#endif
+  return export_variants(0, 1);
+}
+
 #ifdef Q_OS_MACOS
 std::pair<std::string, std::string> customSyntax(const std::string& s)
 {
@@ -801,6 +1231,9 @@ int main(int argc, char **argv)
     ("D,D", po::value<std::vector<std::string>>(), "var=val -pre-define variables")
     ("p,p", po::value<std::string>(), "customizer parameter file")
     ("P,P", po::value<std::string>(), "customizer parameter set")
+    ("all-parameter-sets", "export every parameter set of the -p file, adding the set name to the output file name")
+    ("defines-csv", po::value<std::string>(), "=file -export once per row of a CSV file, whose header row names the variables to define (-D) and whose optional 'name' column names the output files")
+    ("jobs", po::value<unsigned>(), "=n -number of worker processes for --all-parameter-sets and --defines-csv, or of threads rendering --animate frames (default 1)")
 #ifdef ENABLE_EXPERIMENTAL
   ("enable", po::value<std::vector<std::string>>(), ("enable experimental features (specify 'all' for enabling all available features): " +
                                            str_join(boost::make_iterator_range(Feature::begin(), Feature::end()), " | ",
@@ -828,6 +1261,10 @@ int main(int argc, char **argv)
     ("csglimit", po::value<unsigned int>(), "=n -stop rendering at n CSG elements when exporting png")
     ("summary", po::value<std::vector<std::string>>(), "enable additional render summary and statistics: all | cache | time | camera | geometry | bounding-box | area")
     ("summary-file", po::value<std::string>(), "output summary information in JSON format to the given file, using '-' outputs to stdout")
+    ("profile", po::value<std::string>(), "=file -record the time spent instantiating modules, evaluating node geometry and applying booleans as a Chrome trace (speedscope, chrome://tracing) in the given file, using '-' outputs to stdout, and log the hottest source lines")
+    ("server", po::value<std::string>()->implicit_value(""), "[=socket] -run as a render server, reading JSON jobs line by line from stdin, or from clients of the given Unix socket, and keeping caches warm between jobs")
+    ("disk-cache", po::value<std::string>(), "=directory -persist evaluated geometry in the given directory and reuse it in later runs")
+    ("disk-cache-size", po::value<size_t>(), "=n -maximum size of the disk cache in MB (default 1024)")
     ("colorscheme", po::value<std::string>(), ("=colorscheme: " +
                                           str_join(ColorMap::inst()->colorSchemeNames(), " | ",
                                                    [](const std::string& colorScheme) {
@@ -917,6 +1354,11 @@ int main(int argc, char **argv)
     RenderSettings::inst()->backend3D = renderBackend3DFromString(vm["backend"].as<std::string>());
   }
 
+  if (vm.count("disk-cache")) {
+    const size_t size = vm.count("disk-cache-size") ? vm["disk-cache-size"].as<size_t>() : 1024;
+    GeometryDiskCache::instance()->setDirectory(vm["disk-cache"].as<std::string>(), size);
+  }
+
   if (vm.count("preview")) {
     if (vm["preview"].as<std::string>() == "throwntogether") viewOptions.renderer = RenderType::THROWNTOGETHER;
   } else if (vm.count("render")) {
@@ -1021,6 +1463,19 @@ int main(int argc, char **argv)
   AnimateArgs animate = get_animate(vm);
   Camera camera = get_camera(vm);
 
+  BatchArgs batch;
+  batch.allParameterSets = vm.count("all-parameter-sets");
+  if (vm.count("defines-csv")) batch.definesCsv = vm["defines-csv"].as<std::string>();
+  if (vm.count("jobs")) batch.jobs = vm["jobs"].as<unsigned>();
+  if (batch.allParameterSets && parameterFile.empty()) {
+    LOG("Option --all-parameter-sets requires a parameter file (-p).");
+    return 1;
+  }
+  if (batch.allParameterSets && !batch.definesCsv.empty()) {
+    LOG("Options --all-parameter-sets and --defines-csv cannot be combined.");
+    return 1;
+  }
+
   if (animate.frames) {
     for (const auto& filename : output_files) {
       if (filename == "-") {
@@ -1035,6 +1490,56 @@ int main(int argc, char **argv)
 
   PRINTDB("Application location detected as %s", applicationPath);
 
+  if (vm.count("server")) {
+    parser_init();
+    localization_init();
+    const auto export_options = convert_export_options(vm);
+    const std::string base_commands = commandline_commands;
+    // Jobs on the same file are evaluated like edits of it in the GUI
+    std::map<std::string, InstantiationCache> instantiation_caches;
+    RenderServer server([&](const RenderJob& job) {
+      boost::optional<FileFormat> job_format = export_format;
+      if (!job.exportFormat.empty()) {
+        FileFormat format;
+        if (!fileformat::fromIdentifier(job.exportFormat, format)) {
+          LOG(message_group::Error, "Unknown export format '%1$s'", job.exportFormat);
+          return 1;
+        }
+        job_format.emplace(format);
+      }
+      commandline_commands = base_commands;
+      for (const auto& define : job.defines) {
+        commandline_commands += define;
+        commandline_commands += ";\n";
+      }
+      const CommandLine cmd{
+        false,
+        job.file,
+        false,
+        job.output,
+        original_path,
+        job.parameterFile.empty() ? parameterFile : job.parameterFile,
+        job.parameterSet.empty() ? parameterSet : job.parameterSet,
+        viewOptions,
+        camera,
+        job_format,
+        export_options,
+        AnimateArgs{},
+        {},
+        "",
+        Feature::ExperimentalIncrementalInstantiation.is_enabled()
+          ? &instantiation_caches[fs::absolute(job.file).generic_string()] : nullptr
+      };
+      const int result = cmdline(cmd);
+      commandline_commands = base_commands;
+      return result;
+    });
+    const auto socket = vm["server"].as<std::string>();
+    rc = socket.empty() ? server.serveStdio() : server.serveSocket(socket);
+    Builtins::instance(true);
+    return rc;
+  }
+
   auto cmdlinemode = false;
   if (!output_files.empty()) { // cmd-line mode
     cmdlinemode = true;
@@ -1049,6 +1554,9 @@ int main(int argc, char **argv)
       if (arg_info) {
         rc = info();
       } else {
+        if (vm.count("profile")) {
+          Profiler::start(inputFiles[0] == "-" ? fs::current_path().string() : fs::absolute(inputFiles[0]).parent_path().string());
+        }
         for (const auto& filename : output_files) {
           const bool is_stdin = inputFiles[0] == "-";
           const std::string input_file = is_stdin ? "<stdin>" : inputFiles[0];
@@ -1071,12 +1579,13 @@ int main(int argc, char **argv)
             vm.count("summary") ? vm["summary"].as<std::vector<std::string>>() : std::vector<std::string>{},
             vm.count("summary-file") ? vm["summary-file"].as<std::string>() : ""
           };
-          rc |= cmdline(cmd);
+          rc |= batch.allParameterSets || !batch.definesCsv.empty() ? batch_export(cmd, batch) : cmdline(cmd);
         }
       }
     } catch (const HardWarningException&) {
       rc = 1;
     }
+    if (vm.count("profile") && !Profiler::finish(vm["profile"].as<std::string>())) rc = 1;
 
     if (deps_output_file) {
       std::string deps_out(deps_output_file);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+   Open-addressing hash index mapping keys to dense indices 0..n-1.
+
+   The keys themselves are owned by the caller, usually in a vector in
+   insertion order, so the table only stores a hash and an index per slot.
+   Lookups probe one contiguous array instead of chasing hash map nodes, and
+   inserting never allocates per element.
+ */
+class FlatIndexTable
+{
+public:
+  static constexpr int32_t npos = -1;
+
+  [[nodiscard]] size_t size() const { return this->count; }
+
+  void reserve(size_t n) {
+    size_t capacity = 16;
+    while (capacity * 3 < n * 4) capacity *= 2; // max load factor 0.75
+    if (capacity > this->slots.size()) rehash(capacity);
+  }
+
+  void clear() {
+    this->slots.clear();
+    this->count = 0;
+  }
+
+  /*!
+     Returns the index of the key with the given hash for which isKey(index)
+     returns true, or npos.
+   */
+  template <class Predicate>
+  [[nodiscard]] int32_t find(size_t hash, Predicate&& isKey) const {
+    if (this->slots.empty()) return npos;
+    const size_t mask = this->slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const Slot& slot = this->slots[i];
+      if (slot.index == npos) return npos;
+      if (slot.hash == hash && isKey(slot.index)) return slot.index;
+    }
+  }
+
+  // Adds an index for a key which must not already be in the table
+  void insert(size_t hash, int32_t index) {
+    if ((this->count + 1) * 4 > this->slots.size() * 3) {
+      rehash(this->slots.empty() ? 16 : this->slots.size() * 2);
+    }
+    place(hash, index);
+    ++this->count;
+  }
+
+  // Spreads the entropy of weak hashes (e.g. boost::hash_combine of small integers) over all bits
+  static size_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+private:
+  struct Slot {
+    size_t hash;
+    int32_t index;
+  };
+
+  void place(size_t hash, int32_t index) {
+    const size_t mask = this->slots.size() - 1;
+    size_t i = hash & mask;
+    while (this->slots[i].index != npos) i = (i + 1) & mask;
+    this->slots[i] = {hash, index};
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{0, npos});
+    old.swap(this->slots);
+    for (const auto& slot : old) {
+      if (slot.index != npos) place(slot.hash, slot.index);
+    }
+  }
+
+  std::vector<Slot> slots;
+  size_t count{0};
+};
@@ -1,19 +1,36 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include "platform/PlatformUtils.h"
 
 class StackCheck
 {
 public:
+  // Each thread measures its own stack
   static StackCheck& inst()
   {
-    static StackCheck instance;
+    thread_local StackCheck instance;
     return instance;
   }
 
   inline bool check() { return size() >= limit; }
 
+  /*
+   * Measures the stack from the caller's frame on, for a worker thread whose
+   * stack has the given size rather than the size of the main thread's stack.
+   */
+  void restart(size_t stackSize) {
+    unsigned char c;
+    ptr = &c; // NOLINT(*StackAddressEscape)
+    if (stackSize > 2 * STACK_BUFFER_SIZE) {
+      limit = std::min<unsigned long>(limit, stackSize - 2 * STACK_BUFFER_SIZE);
+    } else {
+      limit = std::min<unsigned long>(limit, stackSize / 2);
+    }
+  }
+
 private:
   StackCheck() : limit(PlatformUtils::stackLimit()) {
     unsigned char c;
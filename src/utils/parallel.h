@@ -1,13 +1,33 @@
 #pragma once
 #include <algorithm>
 #include <cstddef>
+#include <cstdlib>
 #include <vector>
 
 #if ENABLE_TBB
+#include <tbb/global_control.h>
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_for_each.h>
 #endif
 
+// Whether parallelizable_transform() may actually run on several threads
+inline bool parallelization_enabled() {
+#if ENABLE_TBB
+  return !getenv("OPENSCAD_NO_PARALLEL");
+#else
+  return false;
+#endif
+}
+
+// Stack size of the worker threads of parallelizable_transform(), or 0 if unknown
+inline size_t parallel_worker_stack_size() {
+#if ENABLE_TBB
+  return tbb::global_control::active_value(tbb::global_control::thread_stack_size);
+#else
+  return 0;
+#endif
+}
+
 template <class InputIterator, class OutputIterator, class Operation>
 void parallelizable_transform(const InputIterator begin1,
                               const InputIterator end1, OutputIterator out,
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <set>
 #include <list>
+#include <mutex>
 #include <iostream>
 #include <string>
 #include <cstdio>
@@ -37,6 +38,9 @@ int count = 0;
 namespace {
 bool no_throw;
 bool deferred;
+// Messages may be printed from multiple geometry evaluation threads
+std::recursive_mutex print_mutex;
+thread_local MessageCapture *message_capture = nullptr;
 }
 
 void set_output_handler(OutputHandlerFunc *newhandler, OutputHandlerFunc2 *newhandler2, void *userdata)
@@ -81,6 +85,7 @@ void PRINT(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
 
+  std::lock_guard lock(print_mutex);
   if (print_messages_stack.size() > 0) {
     if (!print_messages_stack.back().empty()) {
       print_messages_stack.back() += "\n";
@@ -98,11 +103,57 @@ void PRINT(const Message& msgObj)
   }
 }
 
+MessageCapture::MessageCapture() : previous(message_capture)
+{
+  message_capture = this;
+}
+
+MessageCapture::~MessageCapture()
+{
+  message_capture = previous;
+}
+
+std::vector<Message> MessageCapture::take()
+{
+  std::vector<Message> result;
+  result.swap(messages);
+  return result;
+}
+
+void LOG(Message&& msgObj)
+{
+  if (message_capture) {
+    message_capture->messages.push_back(std::move(msgObj));
+    return;
+  }
+
+  // Deprecations and the suppression in PRINT_NOCACHE are shared by frames exported concurrently
+  std::lock_guard lock(print_mutex);
+
+  //check for deprecations
+  if (msgObj.group == message_group::Deprecated) {
+    auto key = msgObj.msg + msgObj.loc.toRelativeString(msgObj.docPath);
+    if (printedDeprecations.find(key) != printedDeprecations.end()) return;
+    printedDeprecations.insert(std::move(key));
+  }
+
+  PRINT(msgObj);
+}
+
+void LOG(std::vector<Message>&& messages)
+{
+  for (auto& msgObj : messages) {
+    LOG(std::move(msgObj));
+  }
+  messages.clear();
+}
+
 void PRINT_NOCACHE(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
 
   const auto msg = msgObj.str();
+  std::lock_guard lock(print_mutex);
 
   if (msgObj.group == message_group::Warning || msgObj.group == message_group::Error || msgObj.group == message_group::Trace) {
     size_t i;
@@ -171,6 +222,7 @@ std::string two_digit_exp_format(double x)
 
 void resetSuppressedMessages()
 {
+  std::lock_guard lock(print_mutex);
   printedDeprecations.clear();
   lastmessages.clear();
 }
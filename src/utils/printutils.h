@@ -8,6 +8,7 @@
 #include <list>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <tuple>
 #include <utility>
 
@@ -84,6 +85,7 @@ using OutputHandlerFunc = void (const Message&, void *);
 using OutputHandlerFunc2 = void (const Message&, void *);
 
 extern OutputHandlerFunc *outputhandler;
+extern OutputHandlerFunc2 *outputhandler2;
 extern void *outputhandler_data;
 
 namespace OpenSCAD {
@@ -111,6 +113,29 @@ void resetSuppressedMessages();
 void PRINT(const Message& msgObj);
 
 void PRINT_NOCACHE(const Message& msgObj);
+
+/*
+ * Collects the messages logged on the current thread while it exists
+ * instead of printing them. Lets work that is done out of order, e.g. on
+ * several threads, report its messages in order afterwards, see LOG(Message).
+ */
+class MessageCapture
+{
+public:
+  MessageCapture();
+  ~MessageCapture();
+  MessageCapture(const MessageCapture&) = delete;
+  MessageCapture& operator=(const MessageCapture&) = delete;
+
+  // Returns the messages captured so far, and starts collecting anew
+  std::vector<Message> take();
+
+private:
+  friend void LOG(Message&& msgObj);
+  std::vector<Message> messages;
+  MessageCapture *previous;
+};
+
 #define PRINTB_NOCACHE(_fmt, _arg) do { } while (0)
 // #define PRINTB_NOCACHE(_fmt, _arg) do { PRINT_NOCACHE(str(boost::format(_fmt) % _arg)); } while (0)
 
@@ -219,18 +244,16 @@ public:
 
 extern std::set<std::string> printedDeprecations;
 
+// Prints a formatted message, or collects it if a MessageCapture is active
+void LOG(Message&& msgObj);
+// Prints messages collected by a MessageCapture
+void LOG(std::vector<Message>&& messages);
+
 template <typename ... Args>
 void LOG(const message_group& msgGroup, Location loc, std::string docPath, std::string&& f, Args&&... args)
 {
   auto formatted = MessageClass<Args...>{std::move(f), std::forward<Args>(args)...}.format();
-
-  //check for deprecations
-  if (msgGroup == message_group::Deprecated && printedDeprecations.find(formatted + loc.toRelativeString(docPath)) != printedDeprecations.end()) return;
-  if (msgGroup == message_group::Deprecated) printedDeprecations.insert(formatted + loc.toRelativeString(docPath));
-
-  Message msgObj{std::move(formatted), msgGroup, std::move(loc), std::move(docPath)};
-
-  PRINT(msgObj);
+  LOG(Message{std::move(formatted), msgGroup, std::move(loc), std::move(docPath)});
 }
 
 template <typename ... Args>
@@ -0,0 +1,74 @@
+#!/usr/bin/env python
+
+# Concurrent animation export test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] --jobs=<n> --frame-name=<name> [<openscad args>] file.txt
+#
+# step 1. Export the animation frames of the .scad file with --jobs=1 to a temporary directory
+# step 2. Export them again with the given number of --jobs to another one
+# step 3. Write every frame file name, and whether it is identical in both runs, to the .txt file
+# step 4. (done in CTest) - compare the generated .txt file to expected output
+#
+# All the optional openscad args (which must include --animate) are passed on
+# to OpenSCAD in steps 1 and 2.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, filecmp, shutil, subprocess, tempfile, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('animate_frames_test args:',str(sys.argv), file=sys.stderr)
+    print('exiting animate_frames_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--jobs', required=True, help='Number of threads for the concurrent run')
+parser.add_argument('--frame-name', required=True, help='Name of the frame files, e.g. frame.off')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+txtfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+def export_frames(jobs):
+    outputdir = tempfile.mkdtemp()
+    export_cmd = [args.openscad, inputfile, '-o', os.path.join(outputdir, args.frame_name), '--jobs=' + str(jobs)] + remaining_args
+    print('Running OpenSCAD:', file=sys.stderr)
+    print(' '.join(export_cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(export_cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+    return outputdir
+
+serialdir = export_frames(1)
+paralleldir = export_frames(args.jobs)
+
+frames = sorted(set(os.listdir(serialdir)) | set(os.listdir(paralleldir)))
+with open(txtfile, 'w', newline='\n') as f:
+    for frame in frames:
+        serial = os.path.join(serialdir, frame)
+        parallel = os.path.join(paralleldir, frame)
+        if not os.path.exists(parallel):
+            f.write(frame + ': missing with --jobs=' + args.jobs + '\n')
+        elif not os.path.exists(serial):
+            f.write(frame + ': only written with --jobs=' + args.jobs + '\n')
+        elif filecmp.cmp(serial, parallel, shallow=False):
+            f.write(frame + ': identical\n')
+        else:
+            f.write(frame + ': differs with --jobs=' + args.jobs + '\n')
+shutil.rmtree(serialdir, ignore_errors=True)
+shutil.rmtree(paralleldir, ignore_errors=True)
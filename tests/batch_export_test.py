@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+# Batch export test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.echo
+#
+# step 1. Run OpenSCAD on the .scad file, exporting batch.echo to a temporary directory
+#         (the openscad args select the batch, e.g. --defines-csv or --all-parameter-sets)
+# step 2. Write the return code and every file written, sorted by name, to the .echo file
+# step 3. (done in CTest) - compare the generated .echo file to expected output.
+#         With --jobs, it must be the same as that of a serial run.
+#
+# All the optional openscad args are passed on to OpenSCAD in step 1.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, shutil, subprocess, tempfile, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('batch_export_test args:',str(sys.argv), file=sys.stderr)
+    print('exiting batch_export_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+echofile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+outputdir = tempfile.mkdtemp()
+export_cmd = [args.openscad, inputfile, '-o', os.path.join(outputdir, 'batch.echo')] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(export_cmd), file=sys.stderr)
+sys.stderr.flush()
+result = subprocess.call(export_cmd)
+
+with open(echofile, 'w', newline='\n') as f:
+    f.write('exit code: ' + str(result) + '\n')
+    for filename in sorted(os.listdir(outputdir)):
+        f.write('== ' + filename + ' ==\n')
+        with open(os.path.join(outputdir, filename), 'r') as output:
+            f.write(output.read())
+shutil.rmtree(outputdir, ignore_errors=True)
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+
+# Benchmarks the geometry pipeline on the models in data/scad/benchmarks
+#
+#
+# Usage: <script> --openscad=<executable-path> [--backend=cgal --backend=manifold]
+#                 [--repeat=3] [--output=results.json] [--baseline=old.json --threshold=10]
+#                 [models...]
+#
+#
+# Each model is exported to STL with each backend, and the time is split into
+# phases: parsing, instantiation, geometry evaluation and export. Parsing is
+# timed by exporting the AST, minus the time of the same on an empty file.
+# Instantiation and geometry evaluation come from the --profile trace of the
+# STL export. Export is the rest of the time of the STL export. The median of
+# the repetitions is reported, as JSON for regression tracking.
+#
+# With --baseline, phases that got slower than the baseline by more than the
+# threshold (in percent, and at least 10 ms) are reported, and the script
+# returns 1.
+#
+
+import argparse
+import datetime
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCHMARK_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'data', 'scad', 'benchmarks')
+PHASES = ['parse', 'instantiate', 'evaluate', 'export']
+
+
+def run(openscad, args):
+    start = time.perf_counter()
+    result = subprocess.run([openscad] + args, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+    elapsed = (time.perf_counter() - start) * 1000
+    if result.returncode != 0:
+        raise RuntimeError('openscad ' + ' '.join(args) + ' failed:\n' + result.stderr)
+    return elapsed
+
+
+def covered_ms(events, category):
+    """Returns the time covered by the spans of a category on any thread, in ms."""
+    intervals = sorted((e['ts'], e['ts'] + e['dur']) for e in events if e.get('cat') == category)
+    total = 0.0
+    end = None
+    for begin, finish in intervals:
+        if end is None or begin > end:
+            total += finish - begin
+            end = finish
+        elif finish > end:
+            total += finish - end
+            end = finish
+    return total / 1000
+
+
+def root_facets(events):
+    """Returns the facet count of the geometry of the root node, which takes longest."""
+    spans = [e for e in events if e.get('cat') == 'geometry']
+    if not spans:
+        return 0
+    return max(spans, key=lambda e: e['dur'])['args'].get('facets', 0)
+
+
+def measure(openscad, model, backend, workdir, startup_ms):
+    ast = os.path.join(workdir, 'out.ast')
+    stl = os.path.join(workdir, 'out.stl')
+    profile = os.path.join(workdir, 'profile.json')
+
+    parse_ms = max(0.0, run(openscad, [model, '-o', ast]) - startup_ms)
+    total_ms = run(openscad, [model, '-o', stl, '--backend=' + backend, '--profile=' + profile])
+    with open(profile) as f:
+        events = json.load(f)['traceEvents']
+    instantiate_ms = covered_ms(events, 'instantiation')
+    evaluate_ms = covered_ms(events, 'geometry')
+    export_ms = max(0.0, total_ms - startup_ms - parse_ms - instantiate_ms - evaluate_ms)
+    return {
+        'parse': parse_ms,
+        'instantiate': instantiate_ms,
+        'evaluate': evaluate_ms,
+        'export': export_ms,
+        'total': total_ms,
+        'facets': root_facets(events),
+        'output_bytes': os.path.getsize(stl),
+    }
+
+
+def compare(results, baseline, threshold):
+    previous = {(r['model'], r['backend']): r for r in baseline['results']}
+    regressions = []
+    for result in results:
+        old = previous.get((result['model'], result['backend']))
+        if not old:
+            continue
+        for phase in PHASES + ['total']:
+            before, after = old[phase], result[phase]
+            if after - before > 10 and after > before * (1 + threshold / 100):
+                regressions.append('%s (%s) %s: %.0f ms -> %.0f ms (+%.0f%%)' %
+                                   (result['model'], result['backend'], phase, before, after,
+                                    100 * (after - before) / max(before, 1)))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--openscad', default=os.environ.get('OPENSCAD_BINARY'),
+                        help='OpenSCAD executable, defaults to env["OPENSCAD_BINARY"]')
+    parser.add_argument('--backend', action='append', choices=['cgal', 'manifold'],
+                        help='Backend to benchmark, may be repeated (default: both)')
+    parser.add_argument('--repeat', type=int, default=3, help='Runs per model and backend (default 3)')
+    parser.add_argument('--output', help='Write the results as JSON to this file instead of stdout')
+    parser.add_argument('--baseline', help='Results of an earlier run to compare with')
+    parser.add_argument('--threshold', type=float, default=10, help='Allowed slowdown in percent (default 10)')
+    parser.add_argument('models', nargs='*', help='Model names or files (default: all in data/scad/benchmarks)')
+    args = parser.parse_args()
+
+    if not args.openscad or not os.path.exists(args.openscad):
+        print('cant find openscad executable named: ' + str(args.openscad), file=sys.stderr)
+        return 1
+    backends = args.backend or ['cgal', 'manifold']
+    models = args.models or sorted(f[:-5] for f in os.listdir(BENCHMARK_DIR) if f.endswith('.scad'))
+
+    results = []
+    with tempfile.TemporaryDirectory() as workdir:
+        empty = os.path.join(workdir, 'empty.scad')
+        open(empty, 'w').close()
+        startup_ms = statistics.median(run(args.openscad, [empty, '-o', os.path.join(workdir, 'empty.ast')])
+                                       for _ in range(max(args.repeat, 3)))
+
+        for name in models:
+            model = name if name.endswith('.scad') else os.path.join(BENCHMARK_DIR, name + '.scad')
+            for backend in backends:
+                runs = [measure(args.openscad, model, backend, workdir, startup_ms) for _ in range(args.repeat)]
+                result = {'model': os.path.basename(model)[:-5], 'backend': backend}
+                for key in PHASES + ['total']:
+                    result[key] = round(statistics.median(r[key] for r in runs), 1)
+                result['facets'] = runs[0]['facets']
+                result['output_bytes'] = runs[0]['output_bytes']
+                print('%-20s %-9s ' % (result['model'], backend) +
+                      ' '.join('%s %.0f ms' % (key, result[key]) for key in PHASES + ['total']), file=sys.stderr)
+                results.append(result)
+
+    version = subprocess.run([args.openscad, '--version'], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                             universal_newlines=True).stdout.strip()
+    report = {
+        'openscad': version,
+        'date': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        'startup_ms': round(startup_ms, 1),
+        'repeat': args.repeat,
+        'results': results,
+    }
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = compare(results, json.load(f), args.threshold)
+        for regression in regressions:
+            print('Slower: ' + regression, file=sys.stderr)
+        if regressions:
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+
+# Disk cache test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [--corrupt] [--disk-cache-size=<MB>] [<openscad args>] file.png
+#
+# step 1. Run two OpenSCAD processes concurrently on the .scad file, filling an empty disk cache directory
+# step 2. If --corrupt is given, truncate every file in the cache
+# step 3. Leave a stale and a fresh temporary file in the cache, as if written by crashed and running processes
+# step 4. Run OpenSCAD again, as a new process using the same directory, and export to the given .png file
+# step 5. Check the disk cache statistics of step 4: it must have hit, unless the cache was corrupted
+#         or capped to 0 MB. The cache must not exceed its size. Only the stale temporary file must be removed.
+# step 6. (done in CTest) - compare the generated .png file to expected output
+#         of the original .scad file. they should be the same!
+#
+# All the optional openscad args are passed on to OpenSCAD in steps 1 and 4.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, json, shutil, subprocess, argparse, tempfile, time
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('disk_cache_pngtest args:',str(sys.argv), file=sys.stderr)
+    print('exiting disk_cache_pngtest.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def cachesize(cachedir):
+    return sum(os.path.getsize(os.path.join(cachedir, f)) for f in os.listdir(cachedir) if f.endswith('.geom'))
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--corrupt', action='store_true', help='Truncate the cached files before the second run')
+parser.add_argument('--disk-cache-size', dest='cachesize', type=int, default=1024, help='Disk cache size in MB')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+pngfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+outputdir = os.path.dirname(pngfile)
+cachedir = tempfile.mkdtemp(prefix='disk-cache-', dir=outputdir or None)
+cacheargs = ['--disk-cache=' + cachedir, '--disk-cache-size=' + str(args.cachesize)]
+summaryfile = os.path.join(cachedir, 'summary.json')
+
+fontdir = os.path.abspath(os.path.join(os.path.dirname(__file__), "data/ttf"))
+fontenv = os.environ.copy()
+fontenv["OPENSCAD_FONT_PATH"] = fontdir
+
+#
+# First run: two processes filling the same cache
+#
+procs = []
+for i in range(2):
+    exportfile = os.path.join(cachedir, 'fill' + str(i) + '.png')
+    fill_cmd = [args.openscad, inputfile, '-o', exportfile] + cacheargs + remaining_args
+    print('Running OpenSCAD #1.' + str(i) + ':', file=sys.stderr)
+    print(' '.join(fill_cmd), file=sys.stderr)
+    sys.stderr.flush()
+    procs.append(subprocess.Popen(fill_cmd, env = fontenv))
+for proc in procs:
+    if proc.wait() != 0:
+        failquit('OpenSCAD #1 failed with return code ' + str(proc.returncode))
+
+if args.corrupt:
+    for f in os.listdir(cachedir):
+        if not f.endswith('.geom'): continue
+        path = os.path.join(cachedir, f)
+        with open(path, 'r+b') as blob:
+            blob.truncate(os.path.getsize(path) // 2)
+
+# Temporary files are removed once they are older than a grace period of ten minutes
+staletmp = os.path.join(cachedir, '0' * 32 + '.geom.tmp1')
+freshtmp = os.path.join(cachedir, '1' * 32 + '.geom.tmp2')
+for path in [staletmp, freshtmp]:
+    with open(path, 'wb') as f:
+        f.write(b'OSGC')
+hourago = time.time() - 3600
+os.utime(staletmp, (hourago, hourago))
+
+#
+# Second run: render from the cache
+#
+render_cmd = [args.openscad, inputfile, '-o', pngfile] + cacheargs + remaining_args + \
+    ['--summary', 'cache', '--summary-file', summaryfile]
+print('Running OpenSCAD #2:', file=sys.stderr)
+print(' '.join(render_cmd), file=sys.stderr)
+sys.stderr.flush()
+result = subprocess.call(render_cmd, env = fontenv)
+if result != 0:
+    failquit('OpenSCAD #2 failed with return code ' + str(result))
+
+try:
+    with open(summaryfile) as f:
+        summary = json.load(f)
+    hits = summary['cache']['disk_cache']['hits']
+except Exception:
+    failquit('failure reading disk cache statistics from ' + summaryfile + ': ' + str(sys.exc_info()))
+
+print('Disk cache hits: ' + str(hits) + ', size: ' + str(cachesize(cachedir)), file=sys.stderr)
+if args.corrupt or args.cachesize == 0:
+    if hits != 0: failquit('Expected no disk cache hits')
+elif hits == 0:
+    failquit('Expected disk cache hits')
+if cachesize(cachedir) > args.cachesize * 1024 * 1024:
+    failquit('Disk cache exceeds its size')
+if os.path.exists(staletmp):
+    failquit('Stale temporary file was not removed')
+if not os.path.exists(freshtmp):
+    failquit('Temporary file of a running process was removed')
+
+shutil.rmtree(cachedir, ignore_errors=True)
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+
+# Incremental instantiation test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] --edit-from=<text> --edit-to=<text> [<openscad args>] file.txt
+#
+# step 1. Copy the .scad file to a temporary directory
+# step 2. Start OpenSCAD with --server on stdin/stdout and --enable=incremental-instantiation,
+#         and export the copy to .csg
+# step 3. Replace the text --edit-from with --edit-to in the copy, which must change one top-level
+#         statement without moving the others, and export it to .csg again with the same server
+# step 4. Export the edited copy to .csg with a new OpenSCAD process, without the server
+# step 5. Write the echoes and the number of reused statements of both server jobs, and whether the
+#         second .csg file is identical to the one of step 4, to the .txt file
+# step 6. (done in CTest) - compare the generated .txt file to expected output
+#
+# All the optional openscad args are passed on to OpenSCAD in steps 2 and 4.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, json, filecmp, shutil, subprocess, tempfile, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('incremental_instantiation_test args:',str(sys.argv), file=sys.stderr)
+    print('exiting incremental_instantiation_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--edit-from', required=True, help='Text of the .scad file to replace before the second job')
+parser.add_argument('--edit-to', required=True, help='Replacement text')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+txtfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+tmpdir = tempfile.mkdtemp()
+scadfile = os.path.join(tmpdir, os.path.basename(inputfile))
+shutil.copyfile(inputfile, scadfile)
+
+server_cmd = [args.openscad, '--server', '--enable=incremental-instantiation'] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(server_cmd), file=sys.stderr)
+sys.stderr.flush()
+server = subprocess.Popen(server_cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, universal_newlines=True)
+
+def render(job_id):
+    request = {'id': job_id, 'file': scadfile, 'output': os.path.join(tmpdir, 'job' + str(job_id) + '.csg')}
+    server.stdin.write(json.dumps(request) + '\n')
+    server.stdin.flush()
+    line = server.stdout.readline()
+    if not line: failquit('server exited during job ' + str(job_id))
+    response = json.loads(line)
+    if response.get('status') != 'ok':
+        failquit('job ' + str(job_id) + ' failed: ' + line)
+    return [msg['text'] for msg in response['messages']
+            if msg['text'].startswith('ECHO:') or msg['text'].startswith('Reused ')]
+
+try:
+    first = render(1)
+    with open(scadfile, 'r', newline='') as f:
+        text = f.read()
+    if text.count(args.edit_from) != 1:
+        failquit('text to edit must occur exactly once: ' + args.edit_from)
+    with open(scadfile, 'w', newline='') as f:
+        f.write(text.replace(args.edit_from, args.edit_to))
+    second = render(2)
+    server.stdin.write('{"command": "shutdown"}\n')
+    server.stdin.flush()
+    server.stdout.readline()
+    if server.wait(timeout=60) != 0:
+        failquit('server failed with return code ' + str(server.returncode))
+finally:
+    if server.poll() is None: server.kill()
+
+freshfile = os.path.join(tmpdir, 'fresh.csg')
+export_cmd = [args.openscad, scadfile, '-o', freshfile] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(export_cmd), file=sys.stderr)
+sys.stderr.flush()
+result = subprocess.call(export_cmd)
+if result != 0:
+    failquit('OpenSCAD failed with return code ' + str(result))
+identical = filecmp.cmp(os.path.join(tmpdir, 'job2.csg'), freshfile, shallow=False)
+shutil.rmtree(tmpdir, ignore_errors=True)
+
+with open(txtfile, 'w', newline='\n') as f:
+    for text in first:
+        f.write('first render: ' + text + '\n')
+    for text in second:
+        f.write('second render: ' + text + '\n')
+    if identical:
+        f.write('second render: identical to a fresh export of the edited file\n')
+    else:
+        f.write('second render: differs from a fresh export of the edited file\n')
@@ -0,0 +1,54 @@
+#!/usr/bin/env python
+
+# Memoized function echo test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.echo
+#
+# step 1. Run OpenSCAD with --enable=memoize on the .scad file, exporting its console output
+# step 2. Remove the memoization statistics, which are only printed when memoization is enabled
+# step 3. (done in CTest) - compare the generated .echo file to expected output
+#         of the original .scad file. they should be the same!
+#
+# All the optional openscad args are passed on to OpenSCAD in step 1.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, subprocess, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('memoize_echotest args:',str(sys.argv), file=sys.stderr)
+    print('exiting memoize_echotest.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+echofile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+export_cmd = [args.openscad, inputfile, '-o', echofile, '--enable=memoize'] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(export_cmd), file=sys.stderr)
+sys.stderr.flush()
+result = subprocess.call(export_cmd)
+if result != 0:
+    failquit('OpenSCAD failed with return code ' + str(result))
+
+with open(echofile, 'r', newline='') as f:
+    lines = f.readlines()
+with open(echofile, 'w', newline='') as f:
+    f.writelines(line for line in lines if not line.startswith('Memoized function calls:'))
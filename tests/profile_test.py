@@ -0,0 +1,74 @@
+#!/usr/bin/env python
+
+# Profile trace test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the .scad file to a temporary .off file with --profile, writing the trace to a temporary file
+# step 2. Parse the trace as JSON and check that every event is a complete Chrome trace event
+# step 3. Write the category, name and source location of every distinct event with a location to the .txt file
+# step 4. (done in CTest) - compare the generated .txt file to expected output
+#
+# Timings and cache statistics vary between runs, so they are left out.
+# All the optional openscad args are passed on to OpenSCAD in step 1.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, json, shutil, subprocess, tempfile, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('profile_test args:',str(sys.argv), file=sys.stderr)
+    print('exiting profile_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+txtfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+outputdir = tempfile.mkdtemp()
+tracefile = os.path.join(outputdir, 'profile.json')
+export_cmd = [args.openscad, inputfile, '-o', os.path.join(outputdir, 'out.off'), '--profile=' + tracefile] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(export_cmd), file=sys.stderr)
+sys.stderr.flush()
+result = subprocess.call(export_cmd)
+if result != 0:
+    failquit('OpenSCAD failed with return code ' + str(result))
+
+try:
+    with open(tracefile, 'r') as f:
+        trace = json.load(f)
+except (OSError, ValueError) as e:
+    failquit('cant read trace: ' + str(e))
+shutil.rmtree(outputdir, ignore_errors=True)
+
+events = set()
+for event in trace['traceEvents']:
+    if event.get('ph') != 'X':
+        failquit('not a complete event: ' + str(event))
+    for key in ['ts', 'dur', 'tid']:
+        if not isinstance(event.get(key), (int, float)):
+            failquit('event without ' + key + ': ' + str(event))
+    location = event['args'].get('location')
+    if location:
+        events.add(event['cat'] + ': ' + event['name'] + ' @ ' + location)
+
+with open(txtfile, 'w', newline='\n') as f:
+    for event in sorted(events):
+        f.write(event + '\n')
@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+
+# Render echo test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.echo
+#
+# step 1. Render the .scad file to a temporary .off file, from the directory of the .scad file,
+#         capturing the console output. Unlike an .echo export, this evaluates the geometry,
+#         so messages of e.g. importers are printed too
+# step 2. Write the echoes, warnings and errors to the .echo file, with quoted paths shortened
+#         to their file names
+# step 3. (done in CTest) - compare the generated .echo file to expected output
+#
+# All the optional openscad args are passed on to OpenSCAD in step 1.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, re, shutil, subprocess, tempfile, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('render_echotest args:',str(sys.argv), file=sys.stderr)
+    print('exiting render_echotest.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = os.path.abspath(remaining_args[0])
+echofile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+outputdir = tempfile.mkdtemp()
+export_cmd = [os.path.abspath(args.openscad), inputfile, '-o', os.path.join(outputdir, 'out.off')] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(export_cmd), file=sys.stderr)
+sys.stderr.flush()
+# Locations are printed relative to the working directory
+result = subprocess.run(export_cmd, cwd=os.path.dirname(inputfile), stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                        universal_newlines=True)
+shutil.rmtree(outputdir, ignore_errors=True)
+sys.stderr.write(result.stdout)
+if result.returncode != 0:
+    failquit('OpenSCAD failed with return code ' + str(result.returncode))
+
+with open(echofile, 'w', newline='\n') as f:
+    for line in result.stdout.splitlines():
+        if not line.startswith(('ECHO:', 'WARNING:', 'ERROR:')): continue
+        f.write(re.sub(r"'[^']*[/\\]([^'/\\]*)'", r"'\1'", line) + '\n')
@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+
+# Render server test
+#
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.json
+#
+# step 1. Start OpenSCAD with --server on a Unix socket in a temporary directory
+# step 2. Send two jobs over one connection: the .scad file exported to .csg,
+#         and the same file with an unknown export format, which must fail
+# step 3. Check that the .csg file was written, then shut the server down
+# step 4. Write both responses without their timing, and without messages
+#         other than echoes, warnings and errors, to the .json file
+# step 5. (done in CTest) - compare the generated .json file to expected output
+#
+# All the optional openscad args are passed on to OpenSCAD in step 1.
+#
+# This script should return 0 on success, not-0 on error.
+
+
+import sys, os, json, shutil, socket, subprocess, tempfile, time, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(args, file=sys.stderr)
+    print('server_test args:',str(sys.argv), file=sys.stderr)
+    print('exiting server_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args,remaining_args = parser.parse_known_args()
+
+inputfile = os.path.abspath(remaining_args[0])
+jsonfile = remaining_args[-1]
+remaining_args = remaining_args[1:-1] # Passed on to the OpenSCAD executable
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+tmpdir = tempfile.mkdtemp()
+socketpath = os.path.join(tmpdir, 'server.sock')
+csgfile = os.path.join(tmpdir, 'job.csg')
+
+server_cmd = [args.openscad, '--server=' + socketpath] + remaining_args
+print('Running OpenSCAD:', file=sys.stderr)
+print(' '.join(server_cmd), file=sys.stderr)
+sys.stderr.flush()
+server = subprocess.Popen(server_cmd)
+
+def receive_lines(conn, count):
+    data = b''
+    while data.count(b'\n') < count:
+        chunk = conn.recv(4096)
+        if not chunk: failquit('server closed the connection after: ' + str(data))
+        data += chunk
+    return data.decode('utf-8').splitlines()
+
+try:
+    for _ in range(300):
+        if os.path.exists(socketpath) or server.poll() is not None: break
+        time.sleep(0.1)
+    if not os.path.exists(socketpath):
+        failquit('server did not create its socket')
+
+    requests = [
+        {'id': 1, 'file': inputfile, 'output': csgfile},
+        {'id': 2, 'file': inputfile, 'output': csgfile + '2', 'export_format': 'nonsense'},
+    ]
+    conn = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    conn.settimeout(120)
+    conn.connect(socketpath)
+    conn.sendall(''.join(json.dumps(request) + '\n' for request in requests).encode('utf-8'))
+    responses = [json.loads(line) for line in receive_lines(conn, len(requests))]
+    conn.sendall(b'{"command": "shutdown"}\n')
+    receive_lines(conn, 1)
+    conn.close()
+    if server.wait(timeout=60) != 0:
+        failquit('server failed with return code ' + str(server.returncode))
+finally:
+    if server.poll() is None: server.kill()
+
+csgwritten = os.path.exists(csgfile)
+shutil.rmtree(tmpdir, ignore_errors=True)
+if not csgwritten:
+    failquit('first job did not write ' + csgfile)
+
+with open(jsonfile, 'w', newline='\n') as f:
+    for response in responses:
+        if 'time_ms' not in response:
+            failquit('response without time_ms: ' + str(response))
+        del response['time_ms']
+        response['messages'] = [msg for msg in response['messages'] if msg['group'] in ('ECHO', 'WARNING', 'ERROR')]
+        f.write(json.dumps(response, sort_keys=True) + '\n')